@@ -0,0 +1,106 @@
+#include "can_display.h"
+#include <stdbool.h>
+#include <string.h>
+
+// "00".."99", two digits per division
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Digits are produced backwards into tmp, then copied out with the sign
+static size_t format_digits(char *buf, uint32_t v, bool negative, uint8_t decimals) {
+    char tmp[CAN_FORMAT_INT_MAX];
+    char *p = tmp + sizeof(tmp);
+    uint32_t ndigits = 0;
+    uint32_t min_digits = decimals + 1u;  // at least "0.x" / "0"
+
+    while (v >= 100) {
+        uint32_t r = v % 100;
+        v /= 100;
+        *--p = digit_pairs[r * 2 + 1];
+        *--p = digit_pairs[r * 2];
+        ndigits += 2;
+    }
+    if (v >= 10) {
+        *--p = digit_pairs[v * 2 + 1];
+        *--p = digit_pairs[v * 2];
+        ndigits += 2;
+    } else {
+        *--p = (char)('0' + v);
+        ndigits++;
+    }
+    while (ndigits < min_digits) {
+        *--p = '0';
+        ndigits++;
+    }
+
+    char *out = buf;
+    if (negative) *out++ = '-';
+    size_t int_digits = ndigits - decimals;
+    memcpy(out, p, int_digits);
+    out += int_digits;
+    if (decimals > 0) {
+        *out++ = '.';
+        memcpy(out, p + int_digits, decimals);
+        out += decimals;
+    }
+    *out = '\0';
+    return (size_t)(out - buf);
+}
+
+size_t can_format_int(char *buf, int32_t value, uint8_t decimals) {
+    uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    return format_digits(buf, mag, value < 0, decimals);
+}
+
+size_t can_format_uint(char *buf, uint32_t value) {
+    return format_digits(buf, value, false, 0);
+}
+
+int32_t can_display_field(const can_display_t *d, const void *base) {
+    const uint8_t *p = (const uint8_t *)base + d->field_offset;
+    bool is_signed = d->flags & CAN_SIG_SIGNED;
+    switch (d->field_size) {
+        case 1: {
+            uint8_t v;
+            memcpy(&v, p, 1);
+            return is_signed ? (int32_t)(int8_t)v : (int32_t)v;
+        }
+        case 2: {
+            uint16_t v;
+            memcpy(&v, p, 2);
+            return is_signed ? (int32_t)(int16_t)v : (int32_t)v;
+        }
+        default: {
+            uint32_t v;
+            memcpy(&v, p, 4);
+            return (int32_t)v;
+        }
+    }
+}
+
+size_t can_display_format(const can_display_t *d, const void *base, char *buf, size_t size) {
+    if (size == 0) return 0;
+    int32_t field = can_display_field(d, base);
+
+    if (d->kind == CAN_DISP_TEXT) {
+        const char *s = (field >= 0 && field < d->num_texts) ? d->texts[field] : "?";
+        size_t n = strlen(s);
+        if (n >= size) n = size - 1;
+        memcpy(buf, s, n);
+        buf[n] = '\0';
+        return n;
+    }
+
+    char num[CAN_FORMAT_INT_MAX];
+    int32_t value = (field * d->mul + d->add) / d->div;
+    size_t n = can_format_int(num, value, d->decimals);
+    size_t u = d->unit ? strlen(d->unit) : 0;
+    if (n >= size) n = size - 1;
+    if (n + u >= size) u = size - 1 - n;
+    memcpy(buf, num, n);
+    if (u > 0) memcpy(buf + n, d->unit, u);
+    buf[n + u] = '\0';
+    return n + u;
+}
@@ -1,12 +1,15 @@
 #include "can_driver.h"
+#include "can_config.h"
+#include "can_ring.h"
+#include "can_filter.h"
 #include "can_sniffer.h"
 #include "mercedes_decode.h"
 #include "sd_logger.h"
 #include "driver/twai.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 #include "freertos/task.h"
 #include <inttypes.h>
 #include <string.h>
@@ -14,90 +17,319 @@
 
 static bool logging_session_active = false;
 
+// Per-minute summary of the SD session (CAN_LOG_SUMMARY_SIGNALS)
+typedef struct {
+    uint16_t channel;
+    int16_t mul;
+    int16_t add;
+} log_summary_signal_t;
+
+#define LOG_SUMMARY_SIGNAL(ch, dec, m, a) { .channel = ch, .mul = m, .add = a },
+static const log_summary_signal_t log_summary_signals[] = { CAN_LOG_SUMMARY_SIGNALS(LOG_SUMMARY_SIGNAL) };
+#undef LOG_SUMMARY_SIGNAL
+#define LOG_SUMMARY_COUNT (sizeof(log_summary_signals) / sizeof(log_summary_signals[0]))
+static int64_t log_summary_last_us = 0;
+
 static const char *TAG = "CAN_DRIVER";
 
-// Message queue
-static QueueHandle_t can_rx_queue = NULL;
+// Ingest ring (lock-free SPSC: can_rx_task produces, can_proc_task consumes)
+static can_message_t can_ingest_slots[CAN_INGEST_RING_SIZE];
+static can_ring_t can_ingest_ring;
+
+// Response mailbox (lock-free SPSC: can_rx_task produces diagnostic responses, one requester consumes)
+static can_message_t can_response_slots[CAN_RESPONSE_MAILBOX_SIZE];
+static can_ring_t can_response_ring;
+static volatile TaskHandle_t can_response_waiter = NULL;  // requester blocked in can_receive_message
+static uint32_t response_routed = 0;                      // frames routed to the mailbox (can_rx_task only)
 static bool can_initialized = false;
 
-// CAN RX task handle
+// CAN ingest / processing / alert task handles
 static TaskHandle_t can_rx_task_handle = NULL;
+static TaskHandle_t can_proc_task_handle = NULL;
+static TaskHandle_t can_alert_task_handle = NULL;
+
+// Per-burst statistics (written by can_rx_task only)
+static uint32_t rx_burst_count = 0;
+static uint32_t rx_burst_frames = 0;
+static uint32_t rx_burst_largest = 0;
+static uint32_t rx_burst_full = 0;
+
+// Per-stage CPU time (time spent working, excluding blocking waits), each
+// written by its own task only; 32-bit so a reader on the other core never sees
+// half an update, wrapping every ~71 minutes
+static int64_t pipeline_start_us = 0;
+static uint32_t ingest_busy_us = 0;
+static uint32_t proc_busy_us = 0;
 
 /**
- * CAN RX task - receives messages from CAN bus
+ * Run every consumer over a batch, one stage at a time
+ */
+static void can_process_batch(const can_message_t *batch, size_t count) {
+    // Record in sniffer (sees ALL CAN traffic)
+    for (size_t i = 0; i < count; i++) {
+        can_sniffer_record(batch[i].identifier, batch[i].data, batch[i].data_length_code,
+                           batch[i].timestamp);
+    }
+
+    // Decode known Mercedes broadcast messages
+    for (size_t i = 0; i < count; i++) {
+        mercedes_decode_message(batch[i].identifier, batch[i].data, batch[i].data_length_code,
+                                batch[i].timestamp);
+    }
+
+    // Log to SD card
+    if (sd_logger_is_mounted()) {
+        if (!logging_session_active) {
+            sd_logger_start_session();
+            logging_session_active = true;
+        }
+        for (size_t i = 0; i < count; i++) {
+            sd_logger_write(batch[i].identifier, batch[i].data, batch[i].data_length_code,
+                            batch[i].timestamp);
+        }
+    }
+}
+
+/**
+ * Name the summary signals for the SD logger, decoder channel names and decimals
+ */
+static void can_log_summary_define(void) {
+    static const uint8_t decimals[] = {
+#define LOG_SUMMARY_DECIMALS(ch, dec, m, a) dec,
+        CAN_LOG_SUMMARY_SIGNALS(LOG_SUMMARY_DECIMALS)
+#undef LOG_SUMMARY_DECIMALS
+    };
+    sd_log_summary_signal_t defs[LOG_SUMMARY_COUNT];
+    memset(defs, 0, sizeof(defs));
+    for (size_t i = 0; i < LOG_SUMMARY_COUNT; i++) {
+        const char *name = mercedes_decode_channel_name(log_summary_signals[i].channel);
+        strncpy(defs[i].name, name ? name : "", sizeof(defs[i].name));
+        defs[i].decimals = decimals[i];
+    }
+    sd_logger_summary_define(defs, LOG_SUMMARY_COUNT);
+}
+
+/**
+ * Sample the summary signals into the SD session every CAN_LOG_SUMMARY_SAMPLE_MS
+ */
+static void can_log_summary_sample(void) {
+    int64_t now = esp_timer_get_time();
+    if (!logging_session_active || now - log_summary_last_us < CAN_LOG_SUMMARY_SAMPLE_MS * 1000LL) {
+        return;
+    }
+    log_summary_last_us = now;
+
+    const mercedes_data_t *mb = mercedes_decode_get_data();
+    for (size_t i = 0; i < LOG_SUMMARY_COUNT; i++) {
+        const log_summary_signal_t *sig = &log_summary_signals[i];
+        int32_t value;
+        if (!mercedes_decode_is_stale(sig->channel) && mercedes_decode_get_signal(mb, sig->channel, &value)) {
+            sd_logger_summary_add((uint8_t)i, value * sig->mul + sig->add);
+        }
+    }
+}
+
+/**
+ * Copy one TWAI frame into the ingest ring with its arrival time; diagnostic
+ * responses also go straight to the response mailbox
+ * @return true if the frame was routed to the mailbox
+ */
+static bool can_ingest_frame(const twai_message_t *message, uint32_t timestamp) {
+    bool routed = false;
+
+    if (message->identifier >= CAN_RESPONSE_ID_FIRST && message->identifier <= CAN_RESPONSE_ID_LAST &&
+        !message->extd) {
+        can_message_t *slot;
+        if (can_ring_reserve(&can_response_ring, &slot, 1) == 0) {
+            can_ring_note_dropped(&can_response_ring, 1);
+        } else {
+            slot->identifier = message->identifier;
+            slot->data_length_code = message->data_length_code;
+            slot->timestamp = timestamp;
+            memcpy(slot->data, message->data, sizeof(slot->data));
+            can_ring_commit(&can_response_ring, 1);
+            response_routed++;
+            routed = true;
+        }
+    }
+
+    can_message_t *slot;
+    if (can_ring_reserve(&can_ingest_ring, &slot, 1) == 0) {
+        can_ring_note_dropped(&can_ingest_ring, 1);
+        return routed;
+    }
+    slot->identifier = message->identifier;
+    slot->data_length_code = message->data_length_code;
+    slot->timestamp = timestamp;
+    memcpy(slot->data, message->data, sizeof(slot->data));
+    can_ring_commit(&can_ingest_ring, 1);
+    return routed;
+}
+
+/**
+ * CAN RX (ingest) task - receives messages from CAN bus
+ * Blocks for the first frame of a burst, then drains whatever else is already
+ * pending in the TWAI RX queue (up to CAN_RX_BATCH_MAX) without blocking.
+ * Frames are only timestamped and handed to can_proc_task.
  */
 static void can_rx_task(void *arg) {
     twai_message_t message;
-    can_message_t can_msg;
-
-    ESP_LOGI(TAG, "CAN RX task started");
 
-    // Enable bus-off recovery alerts
-    twai_reconfigure_alerts(TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED | TWAI_ALERT_ERR_PASS, NULL);
+    ESP_LOGI(TAG, "CAN ingest task started on core %d (batch=%d)", xPortGetCoreID(), CAN_RX_BATCH_MAX);
 
     while (can_initialized) {
-        // Check for alerts (bus-off recovery)
-        uint32_t alerts;
-        if (twai_read_alerts(&alerts, 0) == ESP_OK) {
-            if (alerts & TWAI_ALERT_BUS_OFF) {
-                ESP_LOGW(TAG, "Bus-off detected, initiating recovery");
-                twai_initiate_recovery();
-            }
-            if (alerts & TWAI_ALERT_BUS_RECOVERED) {
-                ESP_LOGI(TAG, "Bus recovered, restarting");
-                twai_start();
-            }
-            if (alerts & TWAI_ALERT_ERR_PASS) {
-                ESP_LOGW(TAG, "Error passive state");
-            }
+        // Wait for message with 100ms timeout
+        if (twai_receive(&message, pdMS_TO_TICKS(100)) != ESP_OK) {
+            continue;
         }
 
-        // Wait for message with 100ms timeout
-        if (twai_receive(&message, pdMS_TO_TICKS(100)) == ESP_OK) {
-            // Record in sniffer (sees ALL CAN traffic)
-            can_sniffer_record(message.identifier, message.data, message.data_length_code);
-
-            // Decode known Mercedes broadcast messages
-            mercedes_decode_message(message.identifier, message.data, message.data_length_code);
-
-            // Log to SD card
-            if (sd_logger_is_mounted()) {
-                if (!logging_session_active) {
-                    sd_logger_start_session();
-                    logging_session_active = true;
-                }
-                sd_logger_write(message.identifier, message.data, message.data_length_code);
+        int64_t t0 = esp_timer_get_time();
+        size_t count = 0;
+        bool routed = false;
+        do {
+            routed |= can_ingest_frame(&message, (uint32_t)esp_timer_get_time());
+            count++;
+        } while (count < CAN_RX_BATCH_MAX && twai_receive(&message, 0) == ESP_OK);
+
+        // A waiting requester is woken here, without a pass through can_proc_task
+        if (routed) {
+            atomic_thread_fence(memory_order_seq_cst);  // pairs with the fence in can_receive_message
+            TaskHandle_t waiter = can_response_waiter;
+            if (waiter != NULL) {
+                xTaskNotifyGive(waiter);
             }
+        }
 
-            // Convert TWAI message to our format and queue it
-            can_msg.identifier = message.identifier;
-            can_msg.data_length_code = message.data_length_code;
-            can_msg.timestamp = xTaskGetTickCount();
+        TaskHandle_t proc = can_proc_task_handle;
+        if (proc != NULL) {
+            xTaskNotifyGive(proc);
+        }
 
-            for (int i = 0; i < message.data_length_code; i++) {
-                can_msg.data[i] = message.data[i];
-            }
+        rx_burst_count++;
+        rx_burst_frames += count;
+        if (count > rx_burst_largest) rx_burst_largest = count;
+        if (count == CAN_RX_BATCH_MAX) rx_burst_full++;
+        ingest_busy_us += (uint32_t)(esp_timer_get_time() - t0);
+    }
+
+    can_rx_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * CAN processing task - sniffer, decoder and SD logger over ingested frames
+ */
+static void can_proc_task(void *arg) {
+    ESP_LOGI(TAG, "CAN processing task started on core %d", xPortGetCoreID());
 
-            // Send to queue (silently drop if full - no log spam)
-            xQueueSend(can_rx_queue, &can_msg, 0);
+    while (can_initialized) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        const can_message_t *batch;
+        uint32_t count;
+        while ((count = can_ring_peek(&can_ingest_ring, &batch, CAN_RX_BATCH_MAX)) > 0) {
+            int64_t t0 = esp_timer_get_time();
+            can_process_batch(batch, count);
+            can_ring_release(&can_ingest_ring, count);
+            proc_busy_us += (uint32_t)(esp_timer_get_time() - t0);
         }
+
+        // Runs at least every 100 ms even when the bus is silent
+        mercedes_decode_apply_posted();
+        mercedes_decode_check_stale();
+        mercedes_decode_detect_profile();
+        can_log_summary_sample();
     }
 
+    can_proc_task_handle = NULL;
     vTaskDelete(NULL);
 }
 
+/**
+ * CAN alert task - sleeps until the TWAI driver raises an alert (bus-off recovery)
+ */
+static void can_alert_task(void *arg) {
+    // Enable bus-off recovery alerts
+    twai_reconfigure_alerts(TWAI_ALERT_BUS_OFF | TWAI_ALERT_BUS_RECOVERED | TWAI_ALERT_ERR_PASS, NULL);
+
+    while (can_initialized) {
+        uint32_t alerts;
+        // Timeout only bounds how long deinit waits for this task to exit
+        if (twai_read_alerts(&alerts, pdMS_TO_TICKS(100)) != ESP_OK) {
+            continue;
+        }
+        if (alerts & TWAI_ALERT_BUS_OFF) {
+            ESP_LOGW(TAG, "Bus-off detected, initiating recovery");
+            twai_initiate_recovery();
+        }
+        if (alerts & TWAI_ALERT_BUS_RECOVERED) {
+            ESP_LOGI(TAG, "Bus recovered, restarting");
+            twai_start();
+        }
+        if (alerts & TWAI_ALERT_ERR_PASS) {
+            ESP_LOGW(TAG, "Error passive state");
+        }
+    }
+
+    can_alert_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+#if CAN_FILTER_DECODE_ONLY
+/**
+ * Build the acceptance filter from the decoder ID set plus CAN_FILTER_EXTRA_IDS
+ */
+static void can_build_decode_only_filter(twai_filter_config_t *f_config) {
+    static const uint32_t extra_ids[] = { CAN_FILTER_EXTRA_IDS };
+    uint32_t ids[64];
+    size_t n = mercedes_decode_get_ids(ids, 64);
+    if (n > 64) n = 64;
+    for (size_t i = 0; i < sizeof(extra_ids) / sizeof(extra_ids[0]) && n < 64; i++) {
+        ids[n++] = extra_ids[i];
+    }
+
+    can_filter_plan_t plan;
+    if (!can_filter_plan(ids, n, &plan)) {
+        ESP_LOGW(TAG, "Filter planning failed, accepting all IDs");
+        return;
+    }
+    can_filter_to_registers(&plan, &f_config->acceptance_code,
+                            &f_config->acceptance_mask, &f_config->single_filter);
+
+    if (plan.dual) {
+        ESP_LOGI(TAG, "Decode-only filter: dual 0x%03X/0x%03X + 0x%03X/0x%03X",
+                 plan.code[0], plan.mask[0], plan.code[1], plan.mask[1]);
+    } else {
+        ESP_LOGI(TAG, "Decode-only filter: single 0x%03X/0x%03X", plan.code[0], plan.mask[0]);
+    }
+    ESP_LOGI(TAG, "Filter accepts %" PRIu32 " IDs for %" PRIu32 " wanted (%" PRIu32 " left to software)",
+             plan.accepted_ids, plan.wanted_ids, plan.false_accepts);
+}
+#endif
+
 esp_err_t can_driver_init(void) {
     if (can_initialized) {
         ESP_LOGW(TAG, "CAN driver already initialized");
         return ESP_OK;
     }
 
-    // Create message queue
-    can_rx_queue = xQueueCreate(32, sizeof(can_message_t));
-    if (can_rx_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create CAN RX queue");
-        return ESP_ERR_NO_MEM;
-    }
+    // Reset ingest ring and response mailbox
+    can_ring_init(&can_ingest_ring, can_ingest_slots, CAN_INGEST_RING_SIZE);
+    can_ring_init(&can_response_ring, can_response_slots, CAN_RESPONSE_MAILBOX_SIZE);
+    can_response_waiter = NULL;
+    response_routed = 0;
+    pipeline_start_us = esp_timer_get_time();
+    ingest_busy_us = 0;
+    proc_busy_us = 0;
+    rx_burst_count = 0;
+    rx_burst_frames = 0;
+    rx_burst_largest = 0;
+    rx_burst_full = 0;
+
+    // Decoder first: the decode-only filter is built from the active profile's IDs
+    mercedes_decode_init();
+    can_log_summary_define();
+    log_summary_last_us = 0;
 
     // NO_ACK mode: proven to work on real Mercedes CAN bus
     // Does not require ACK from other nodes, works both standalone and on live bus
@@ -105,11 +337,13 @@ esp_err_t can_driver_init(void) {
     g_config.rx_queue_len = 32;  // Default 5 is too small for busy CAN bus
     twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
     twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+#if CAN_FILTER_DECODE_ONLY
+    can_build_decode_only_filter(&f_config);
+#endif
 
     // Install TWAI driver
     if (twai_driver_install(&g_config, &t_config, &f_config) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to install TWAI driver");
-        vQueueDelete(can_rx_queue);
         return ESP_FAIL;
     }
 
@@ -117,25 +351,40 @@ esp_err_t can_driver_init(void) {
     if (twai_start() != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start TWAI driver");
         twai_driver_uninstall();
-        vQueueDelete(can_rx_queue);
         return ESP_FAIL;
     }
 
     can_initialized = true;
     can_sniffer_init();
-    mercedes_decode_init();
 
-    // Create CAN RX task
-    if (xTaskCreate(can_rx_task, "can_rx", 4096, NULL, 10, &can_rx_task_handle) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create CAN RX task");
+    // Create CAN processing task first so ingest always has someone to notify
+    if (xTaskCreatePinnedToCore(can_proc_task, "can_proc", CAN_PROC_TASK_STACK_SIZE, NULL,
+                                CAN_PROC_TASK_PRIORITY, &can_proc_task_handle, CAN_PROC_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create CAN processing task");
         twai_stop();
         twai_driver_uninstall();
-        vQueueDelete(can_rx_queue);
         can_initialized = false;
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "CAN driver initialized (NO_ACK mode, 500kbps, rx_q=32)");
+    // Create CAN RX (ingest) task
+    if (xTaskCreatePinnedToCore(can_rx_task, "can_rx", CAN_RX_TASK_STACK_SIZE, NULL,
+                                CAN_RX_TASK_PRIORITY, &can_rx_task_handle, CAN_RX_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create CAN RX task");
+        can_initialized = false;  // processing task exits on its next wakeup
+        vTaskDelay(pdMS_TO_TICKS(200));
+        twai_stop();
+        twai_driver_uninstall();
+        return ESP_FAIL;
+    }
+
+    // Create CAN alert task (bus-off recovery)
+    if (xTaskCreate(can_alert_task, "can_alert", 2048, NULL, CAN_RX_TASK_PRIORITY, &can_alert_task_handle) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create CAN alert task, bus-off recovery disabled");
+    }
+
+    ESP_LOGI(TAG, "CAN driver initialized (NO_ACK mode, 500kbps, responses 0x%03X-0x%03X -> mailbox of %d)",
+             CAN_RESPONSE_ID_FIRST, CAN_RESPONSE_ID_LAST, CAN_RESPONSE_MAILBOX_SIZE);
     ESP_LOGI(TAG, "TX GPIO: %d, RX GPIO: %d", CAN_TX_GPIO, CAN_RX_GPIO);
 
     return ESP_OK;
@@ -154,8 +403,8 @@ esp_err_t can_driver_deinit(void) {
         logging_session_active = false;
     }
 
-    // Wait for RX task to finish
-    if (can_rx_task_handle != NULL) {
+    // Wait for ingest, processing and alert tasks to finish
+    if (can_rx_task_handle != NULL || can_proc_task_handle != NULL || can_alert_task_handle != NULL) {
         vTaskDelay(pdMS_TO_TICKS(100));
     }
 
@@ -163,11 +412,8 @@ esp_err_t can_driver_deinit(void) {
     twai_stop();
     twai_driver_uninstall();
 
-    // Delete queue
-    if (can_rx_queue != NULL) {
-        vQueueDelete(can_rx_queue);
-        can_rx_queue = NULL;
-    }
+    can_ring_reset(&can_ingest_ring);
+    can_ring_reset(&can_response_ring);
 
     ESP_LOGI(TAG, "CAN driver deinitialized");
     return ESP_OK;
@@ -206,19 +452,47 @@ esp_err_t can_receive_message(can_message_t *msg, uint32_t timeout_ms) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    if (xQueueReceive(can_rx_queue, msg, pdMS_TO_TICKS(timeout_ms)) == pdTRUE) {
-        return ESP_OK;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+
+    while (!can_ring_pop(&can_response_ring, msg)) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        // Register as waiter, then re-check so a frame committed in between is not missed
+        can_response_waiter = xTaskGetCurrentTaskHandle();
+        atomic_thread_fence(memory_order_seq_cst);
+        if (can_ring_count(&can_response_ring) == 0) {
+            ulTaskNotifyTake(pdTRUE, timeout - elapsed);
+        }
+        can_response_waiter = NULL;
+    }
+
+    return ESP_OK;
+}
+
+size_t can_receive_claim(const can_message_t **msgs, size_t max) {
+    if (!can_initialized || msgs == NULL) {
+        return 0;
     }
+    return can_ring_peek(&can_response_ring, msgs, (uint32_t)max);
+}
 
-    return ESP_ERR_TIMEOUT;
+void can_receive_release(size_t count) {
+    if (!can_initialized) {
+        return;
+    }
+    can_ring_release(&can_response_ring, (uint32_t)count);
 }
 
 bool can_message_available(void) {
-    if (!can_initialized || can_rx_queue == NULL) {
+    if (!can_initialized) {
         return false;
     }
 
-    return uxQueueMessagesWaiting(can_rx_queue) > 0;
+    return can_ring_count(&can_response_ring) > 0;
 }
 
 bool can_driver_is_running(void) {
@@ -241,7 +515,35 @@ esp_err_t can_driver_get_debug_info(can_debug_info_t *info) {
         info->bus_error_count = status.bus_error_count;
         info->arb_lost_count = status.arb_lost_count;
         info->msgs_to_rx = status.msgs_to_rx;
+        info->rx_ring_dropped = atomic_load(&can_response_ring.dropped);
+        info->rx_ring_high_water = can_response_ring.high_water;
+        info->rx_batch_max = CAN_RX_BATCH_MAX;
+        info->rx_burst_count = rx_burst_count;
+        info->rx_burst_frames = rx_burst_frames;
+        info->rx_burst_largest = rx_burst_largest;
+        info->rx_burst_full = rx_burst_full;
         return ESP_OK;
     }
     return ESP_FAIL;
 }
+
+esp_err_t can_driver_get_pipeline_stats(can_pipeline_stats_t *stats) {
+    if (stats == NULL) return ESP_ERR_INVALID_ARG;
+    memset(stats, 0, sizeof(can_pipeline_stats_t));
+    stats->ingest_core = CAN_RX_TASK_CORE;
+    stats->proc_core = CAN_PROC_TASK_CORE;
+    if (!can_initialized) {
+        return ESP_OK;
+    }
+    stats->uptime_us = (uint64_t)(esp_timer_get_time() - pipeline_start_us);
+    stats->ingest_busy_us = ingest_busy_us;
+    stats->proc_busy_us = proc_busy_us;
+    stats->ingest_depth = can_ring_count(&can_ingest_ring);
+    stats->ingest_high_water = can_ingest_ring.high_water;
+    stats->ingest_dropped = atomic_load(&can_ingest_ring.dropped);
+    stats->rx_depth = can_ring_count(&can_response_ring);
+    stats->rx_high_water = can_response_ring.high_water;
+    stats->rx_dropped = atomic_load(&can_response_ring.dropped);
+    stats->rx_routed = response_routed;
+    return ESP_OK;
+}
@@ -0,0 +1,193 @@
+#include "can_filter.h"
+#include <string.h>
+
+// Planner works on at most this many distinct IDs (membership kept in a uint64_t)
+#define CAN_FILTER_MAX_IDS 64
+
+// Local-search passes per starting partition
+#define CAN_FILTER_MAX_PASSES 16
+
+typedef struct {
+    uint16_t code;
+    uint16_t dont_care;
+} filter_cube_t;
+
+static uint32_t popcount11(uint32_t v) {
+    return (uint32_t)__builtin_popcount(v & CAN_FILTER_STD_ID_MASK);
+}
+
+// Smallest code/mask covering every ID selected by members
+static filter_cube_t cube_of(const uint16_t *ids, size_t n, uint64_t members) {
+    filter_cube_t c = {0, 0};
+    bool first = true;
+    for (size_t i = 0; i < n; i++) {
+        if (!(members & (1ULL << i))) continue;
+        if (first) {
+            c.code = ids[i];
+            first = false;
+        } else {
+            c.dont_care |= (uint16_t)(ids[i] ^ c.code);
+        }
+    }
+    c.code &= (uint16_t)~c.dont_care;
+    return c;
+}
+
+static uint32_t cube_size(filter_cube_t c) {
+    return 1u << popcount11(c.dont_care);
+}
+
+// Number of distinct IDs accepted by the union of two filters
+static uint32_t union_size(filter_cube_t a, filter_cube_t b) {
+    uint32_t total = cube_size(a) + cube_size(b);
+    uint16_t both_care = (uint16_t)(~a.dont_care & ~b.dont_care & CAN_FILTER_STD_ID_MASK);
+    if (((a.code ^ b.code) & both_care) == 0) {
+        total -= 1u << popcount11(a.dont_care & b.dont_care);
+    }
+    return total;
+}
+
+static uint32_t partition_cost(const uint16_t *ids, size_t n, uint64_t g1, uint64_t all) {
+    return union_size(cube_of(ids, n, g1), cube_of(ids, n, all & ~g1));
+}
+
+// Move single IDs between the two groups while that shrinks the accepted set
+static uint64_t improve_partition(const uint16_t *ids, size_t n, uint64_t g1, uint64_t all,
+                                  uint32_t *cost) {
+    *cost = partition_cost(ids, n, g1, all);
+    for (int pass = 0; pass < CAN_FILTER_MAX_PASSES; pass++) {
+        bool improved = false;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t cand = g1 ^ (1ULL << i);
+            if (cand == 0 || cand == all) continue;  // both filters must keep an ID
+            uint32_t c = partition_cost(ids, n, cand, all);
+            if (c < *cost) {
+                *cost = c;
+                g1 = cand;
+                improved = true;
+            }
+        }
+        if (!improved) break;
+    }
+    return g1;
+}
+
+static void try_partition(const uint16_t *ids, size_t n, uint64_t g1, uint64_t all,
+                          uint64_t *best_g1, uint32_t *best_cost) {
+    if (g1 == 0 || g1 == all) return;
+    uint32_t cost;
+    g1 = improve_partition(ids, n, g1, all, &cost);
+    if (cost < *best_cost) {
+        *best_cost = cost;
+        *best_g1 = g1;
+    }
+}
+
+bool can_filter_plan(const uint32_t *ids, size_t count, can_filter_plan_t *plan) {
+    if (ids == NULL || plan == NULL) return false;
+    memset(plan, 0, sizeof(*plan));
+
+    // Collect distinct standard IDs, sorted ascending (insertion sort, tiny n)
+    uint16_t set[CAN_FILTER_MAX_IDS];
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (ids[i] > CAN_FILTER_STD_ID_MASK) continue;
+        uint16_t id = (uint16_t)ids[i];
+        size_t pos = 0;
+        while (pos < n && set[pos] < id) pos++;
+        if (pos < n && set[pos] == id) continue;
+        if (n == CAN_FILTER_MAX_IDS) return false;
+        memmove(&set[pos + 1], &set[pos], (n - pos) * sizeof(set[0]));
+        set[pos] = id;
+        n++;
+    }
+    if (n == 0) return false;
+
+    uint64_t all = (n == 64) ? ~0ULL : ((1ULL << n) - 1);
+
+    // Single filter: one cube over everything
+    filter_cube_t single = cube_of(set, n, all);
+    uint32_t best_cost = cube_size(single);
+    uint64_t best_g1 = all;
+
+    if (n >= 2) {
+        // Starting partitions: split on each ID bit, then at each point of the sorted order
+        for (int bit = 0; bit < 11; bit++) {
+            uint64_t g1 = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (set[i] & (1u << bit)) g1 |= 1ULL << i;
+            }
+            try_partition(set, n, g1, all, &best_g1, &best_cost);
+        }
+        for (size_t k = 1; k < n; k++) {
+            try_partition(set, n, (1ULL << k) - 1, all, &best_g1, &best_cost);
+        }
+    }
+
+    plan->wanted_ids = (uint32_t)n;
+    if (best_g1 == all) {
+        plan->dual = false;
+        plan->code[0] = plan->code[1] = single.code;
+        plan->mask[0] = plan->mask[1] = single.dont_care;
+    } else {
+        filter_cube_t a = cube_of(set, n, best_g1);
+        filter_cube_t b = cube_of(set, n, all & ~best_g1);
+        plan->dual = true;
+        plan->code[0] = a.code;
+        plan->mask[0] = a.dont_care;
+        plan->code[1] = b.code;
+        plan->mask[1] = b.dont_care;
+    }
+    plan->accepted_ids = best_cost;
+    plan->false_accepts = best_cost - (uint32_t)n;
+    return true;
+}
+
+bool can_filter_accepts(const can_filter_plan_t *plan, uint32_t id) {
+    if (id > CAN_FILTER_STD_ID_MASK) return false;
+    int filters = plan->dual ? 2 : 1;
+    for (int f = 0; f < filters; f++) {
+        if (((id ^ plan->code[f]) & ~plan->mask[f] & CAN_FILTER_STD_ID_MASK) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t can_filter_count_false_accepts(const can_filter_plan_t *plan,
+                                        const uint32_t *wanted, size_t wanted_count,
+                                        const uint32_t *traffic, size_t traffic_count) {
+    // Bitmap of the 2048 standard IDs that are wanted
+    uint32_t wanted_map[(CAN_FILTER_STD_ID_MASK + 1) / 32];
+    memset(wanted_map, 0, sizeof(wanted_map));
+    for (size_t i = 0; i < wanted_count; i++) {
+        if (wanted[i] <= CAN_FILTER_STD_ID_MASK) {
+            wanted_map[wanted[i] >> 5] |= 1u << (wanted[i] & 31);
+        }
+    }
+
+    uint32_t false_accepts = 0;
+    for (size_t i = 0; i < traffic_count; i++) {
+        uint32_t id = traffic[i];
+        if (!can_filter_accepts(plan, id)) continue;
+        if (!(wanted_map[id >> 5] & (1u << (id & 31)))) false_accepts++;
+    }
+    return false_accepts;
+}
+
+void can_filter_to_registers(const can_filter_plan_t *plan, uint32_t *acceptance_code,
+                             uint32_t *acceptance_mask, bool *single_filter) {
+    if (!plan->dual) {
+        // Single filter, standard frame: ID in bits 31..21, RTR + data bytes below
+        *acceptance_code = (uint32_t)plan->code[0] << 21;
+        *acceptance_mask = ((uint32_t)plan->mask[0] << 21) | 0x001FFFFF;
+        *single_filter = true;
+    } else {
+        // Dual filter, standard frame: filter 1 ID in bits 31..21, filter 2 ID in bits 15..5
+        uint32_t care1 = (uint32_t)(~plan->mask[0] & CAN_FILTER_STD_ID_MASK) << 21;
+        uint32_t care2 = (uint32_t)(~plan->mask[1] & CAN_FILTER_STD_ID_MASK) << 5;
+        *acceptance_code = ((uint32_t)plan->code[0] << 21) | ((uint32_t)plan->code[1] << 5);
+        *acceptance_mask = ~(care1 | care2);
+        *single_filter = false;
+    }
+}
@@ -1,75 +1,587 @@
 #include "can_manager.h"
+#include "can_config.h"
 #include "can_driver.h"
+#include "can_seqlock.h"
+#include "isotp.h"
+#include "mercedes_decode.h"
 #include "obd2_pids.h"
+#include "uds_poller.h"
 #include "vehicle_data.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <string.h>
 
 static const char *TAG = "CAN_MANAGER";
 
-static const uint8_t priority_pids[] = {
-    PID_ENGINE_RPM,
-    PID_VEHICLE_SPEED,
-    PID_ENGINE_COOLANT_TEMP,
-    PID_ENGINE_LOAD,
-    PID_THROTTLE_POSITION,
-    PID_FUEL_LEVEL,
-    PID_INTAKE_AIR_TEMP,
-    PID_FUEL_PRESSURE,
-    PID_CONTROL_MODULE_VOLTAGE,
-    PID_O2_SENSOR_1_B1,
+// Polled PIDs and their target periods (OBD2_PID_SCHEDULE in can_config.h)
+static const struct {
+    uint8_t pid;
+    uint32_t period_ms;
+} schedule[] = {
+#define OBD2_SCHEDULE_ENTRY(pid, period_ms) { pid, period_ms },
+    OBD2_PID_SCHEDULE(OBD2_SCHEDULE_ENTRY)
+#undef OBD2_SCHEDULE_ENTRY
 };
 
-#define NUM_PRIORITY_PIDS (sizeof(priority_pids) / sizeof(priority_pids[0]))
+#define NUM_SCHEDULED_PIDS (sizeof(schedule) / sizeof(schedule[0]))
+
+_Static_assert(NUM_SCHEDULED_PIDS <= CAN_MANAGER_MAX_PIDS, "OBD2_PID_SCHEDULE has too many PIDs");
+
+// Scheduler state per schedule[] entry (can_manager task only)
+typedef struct {
+    int64_t deadline_us;        // when the next value is due
+    uint8_t misses;             // consecutive unanswered requests (back-off exponent)
+    bool supported;             // some ECU lists the PID (or discovery found no ECU)
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t window_responses;  // responses at the start of the stats window
+} pid_sched_t;
+
+static pid_sched_t sched[NUM_SCHEDULED_PIDS];
 
 static TaskHandle_t can_manager_task_handle = NULL;
 static bool can_manager_running = false;
 static can_manager_stats_t stats = {0};
+static can_manager_pid_stats_t pid_stats[NUM_SCHEDULED_PIDS];
 
-static void can_manager_task(void *arg) {
+#if ENABLE_DTC_READING
+#define RESPONSE_BUF_LEN OBD2_MAX_DTC_RESPONSE_LEN
+#else
+#define RESPONSE_BUF_LEN (OBD2_MAX_RESPONSE_LEN > UDS_MAX_RESPONSE_LEN ? OBD2_MAX_RESPONSE_LEN : UDS_MAX_RESPONSE_LEN)
+#endif
+
+// One ISO-TP session per ECU (0x7E0 + n -> 0x7E8 + n), reassembling into ecu_buf[n]
+static isotp_link_t ecu_link[OBD2_NUM_ECUS];
+static uint8_t ecu_buf[OBD2_NUM_ECUS][RESPONSE_BUF_LEN];
+
+#if ENABLE_DTC_READING
+// Last completed DTC read, published to readers under dtc_lock
+static can_seqlock_t dtc_lock;
+static can_manager_dtc_t dtcs[CAN_MANAGER_MAX_DTCS];
+static size_t dtc_count;
+static uint32_t dtc_generation;
+static atomic_bool dtc_requested;
+
+// Read in progress (can_manager task only)
+static can_manager_dtc_t dtc_scratch[CAN_MANAGER_MAX_DTCS];
+static size_t dtc_scratch_count;
+static uint8_t dtc_service;
+#endif
+
+// Support bitmaps from the last discovery, valid for ECUs in stats.ecu_mask
+static obd2_supported_t ecu_supported[OBD2_NUM_ECUS];
+
+// Set when an ECU outside stats.ecu_mask answers (can_manager task only)
+static bool rediscover;
+
+// Smoothed time from request to first complete response (us, 0 = no sample yet)
+static uint32_t latency_us;
+
+// One P2 period from now, but never past the request timeout
+static TickType_t p2_deadline(TickType_t limit) {
+    TickType_t p2 = pdMS_TO_TICKS(OBD2_P2_MAX_MS);
+    TickType_t deadline = xTaskGetTickCount() + (p2 ? p2 : 1);
+    return (int32_t)(limit - deadline) < 0 ? limit : deadline;
+}
+
+// Wait for a first answer: a few measured latencies, bounded by OBD2_REQUEST_TIMEOUT_MS
+static uint32_t request_timeout_ms(void) {
+    if (latency_us == 0) return OBD2_REQUEST_TIMEOUT_MS;
+    uint32_t ms = latency_us * 4 / 1000 + OBD2_P2_MAX_MS;
+    return ms < OBD2_REQUEST_TIMEOUT_MS ? ms : OBD2_REQUEST_TIMEOUT_MS;
+}
+
+/**
+ * Handle one reassembled response
+ * @param ecu Responding ECU (0 = 0x7E8)
+ * @param msg Response starting at the 0x41 byte
+ * @return Bit k set for each pids[k] the response answers, 0 if it answers none
+ */
+typedef uint32_t (*response_handler_t)(uint32_t ecu, const uint8_t *msg, size_t len,
+                                       const uint8_t *pids, size_t count);
+
+/**
+ * Send a functional request and collect the answers until every parameter has
+ * one (unless all_ecus is set), the request times out, or (once an ECU has
+ * answered) no ECU frame follows within P2. Each responding ECU answers with
+ * what it supports, possibly over several frames.
+ * @param service OBD-II service, followed in the request by pids
+ * @param all_ecus Keep listening after every PID is answered, for answers from other ECUs
+ * @return Bit k set if pids[k] was answered
+ */
+static uint32_t can_manager_request(uint8_t service, const uint8_t *pids, size_t count,
+                                    response_handler_t handler, bool all_ecus) {
     can_message_t rx_msg;
-    uint8_t current_pid_index = 0;
 
-    ESP_LOGI(TAG, "CAN Manager task started");
-    vehicle_data_init();
+    // Drop late answers to the previous request so they are not taken for this one
+    for (size_t i = 0; i < CAN_RESPONSE_MAILBOX_SIZE && can_receive_message(&rx_msg, 0) == ESP_OK; i++) {
+    }
 
-    while (can_manager_running) {
-        uint8_t pid = priority_pids[current_pid_index];
+    if (obd2_request_service(service, pids, count) != ESP_OK) {
+        stats.error_count++;
+        return 0;
+    }
+    stats.request_count++;
+    for (uint32_t e = 0; e < OBD2_NUM_ECUS; e++) {
+        isotp_rx_start(&ecu_link[e], ecu_buf[e], sizeof(ecu_buf[e]));
+    }
+
+    uint32_t all = (1u << count) - 1;
+    uint32_t pending = all;
+    bool answered = false;
+    int64_t sent_us = esp_timer_get_time();
+    TickType_t limit = xTaskGetTickCount() + pdMS_TO_TICKS(request_timeout_ms());
+    TickType_t deadline = limit;
+
+    while (all_ecus || pending != 0) {
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(deadline - now) <= 0 ||
+            can_receive_message(&rx_msg, (deadline - now) * portTICK_PERIOD_MS) != ESP_OK) {
+            break;
+        }
+        uint32_t ecu = rx_msg.identifier - OBD2_RESPONSE_CAN_ID_BASE;
+        if (ecu >= OBD2_NUM_ECUS) {
+            continue;
+        }
+        // PIDs nobody supports stay pending; stop once the ECUs fall silent
+        if (answered) {
+            deadline = p2_deadline(limit);
+        }
+
+        // Flow control for multi-frame answers is sent from here
+        isotp_link_t *link = &ecu_link[ecu];
+        if (isotp_on_frame(link, rx_msg.data, rx_msg.data_length_code, esp_timer_get_time()) != ESP_OK) {
+            continue;
+        }
+
+        uint32_t got = handler(ecu, ecu_buf[ecu], link->rx_len, pids, count);
+        if (got == 0) {
+            continue;
+        }
+        if (!answered) {
+            // First complete answer: fold into the latency estimate (1/8 weight)
+            uint32_t sample = (uint32_t)(esp_timer_get_time() - sent_us);
+            latency_us = latency_us == 0 ? sample : latency_us - latency_us / 8 + sample / 8;
+            answered = true;
+            deadline = p2_deadline(limit);
+        }
+        stats.response_count++;
+        if (link->rx_multi_frame) {
+            stats.multi_frame_count++;
+        }
+        pending &= ~got;
+    }
+
+    if (!answered) {
+        stats.error_count++;
+    }
+    return ~pending & all;
+}
+
+#if ENABLE_UDS_POLLING
+/**
+ * Send one physical request on an ECU's ISO-TP link and wait for the answer
+ * The answer must start within P2 of the request going out (P2* after each
+ * response-pending answer); after that the ECU's consecutive frames are
+ * bounded by N_Cr. A multi-frame request is paced by the ECU's flow control.
+ * @return Answer length in ecu_buf[ecu], 0 if none came
+ */
+static size_t can_manager_transact(uint32_t ecu, const uint8_t *req, size_t len) {
+    isotp_link_t *link = &ecu_link[ecu];
+    can_message_t rx_msg;
+
+    // Drop late answers to the previous request so they are not taken for this one
+    for (size_t i = 0; i < CAN_RESPONSE_MAILBOX_SIZE && can_receive_message(&rx_msg, 0) == ESP_OK; i++) {
+    }
+
+    isotp_abort(link);
+    isotp_rx_start(link, ecu_buf[ecu], sizeof(ecu_buf[ecu]));
+    if (isotp_send(link, req, len, esp_timer_get_time()) != ESP_OK) {
+        return 0;
+    }
+
+    int64_t p2_deadline = INT64_MAX;    // armed once the whole request is out
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        if (isotp_poll(link, now) != ESP_OK || link->tx_state == ISOTP_ERROR) {
+            break;
+        }
+        if (link->tx_state == ISOTP_TX_DONE && p2_deadline == INT64_MAX) {
+            p2_deadline = now + UDS_P2_MS * 1000LL;
+        }
+        int64_t wake = isotp_next_poll_us(link);
+        if (link->rx_state != ISOTP_RX_BUSY) {
+            if (now >= p2_deadline) break;
+            if (p2_deadline < wake) wake = p2_deadline;
+        }
+
+        uint32_t wait_ms = wake == INT64_MAX ? OBD2_REQUEST_TIMEOUT_MS : (uint32_t)((wake - now + 999) / 1000);
+        if (can_receive_message(&rx_msg, wait_ms) != ESP_OK || rx_msg.identifier != link->rx_id) {
+            continue;
+        }
+        esp_err_t ret = isotp_on_frame(link, rx_msg.data, rx_msg.data_length_code, esp_timer_get_time());
+        if (ret == ESP_OK) {
+            const uint8_t *msg = ecu_buf[ecu];
+            if (link->rx_len >= 3 && msg[0] == UDS_NEGATIVE_RESPONSE && msg[2] == UDS_NRC_RESPONSE_PENDING) {
+                isotp_rx_start(link, ecu_buf[ecu], sizeof(ecu_buf[ecu]));
+                p2_deadline = esp_timer_get_time() + UDS_P2_EXT_MS * 1000LL;
+                continue;
+            }
+            return link->rx_len;
+        }
+        if (ret != ESP_ERR_NOT_FINISHED && link->rx_state == ISOTP_ERROR) {
+            break;
+        }
+    }
+    isotp_abort(link);
+    return 0;
+}
+#endif
+
+// Response to a batch of value PIDs: decode into vehicle_data
+static uint32_t handle_values(uint32_t ecu, const uint8_t *msg, size_t len,
+                              const uint8_t *pids, size_t count) {
+    obd2_pid_value_t values[OBD2_MAX_PIDS_PER_REQUEST];
+    size_t n = obd2_parse_multi_response(msg, len, values, OBD2_MAX_PIDS_PER_REQUEST);
+    uint32_t got = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        vehicle_data_update(vehicle_data_get(), values[i].pid, values[i].value);
+        stats.pid_count++;
+        stats.last_response_pid = values[i].pid;
+        stats.last_response_value = values[i].value;
+        for (size_t k = 0; k < count; k++) {
+            if (pids[k] == values[i].pid) got |= 1u << k;
+        }
+    }
+    // An ECU the last discovery did not see: the vehicle changed
+    if (n > 0 && !(stats.ecu_mask & (1u << ecu))) {
+        rediscover = true;
+    }
+    return got;
+}
+
+// Response to a batch of support PIDs: merge into that ECU's bitmap
+static uint32_t handle_supported(uint32_t ecu, const uint8_t *msg, size_t len,
+                                 const uint8_t *pids, size_t count) {
+    if (obd2_parse_supported_pids(msg, len, &ecu_supported[ecu]) == 0) {
+        return 0;
+    }
+    stats.ecu_mask |= 1u << ecu;
+    // Discovery listens for every ECU, so which support PIDs came back does not matter
+    return (1u << count) - 1;
+}
+
+/**
+ * Find the responding ECUs and the Mode 01 PIDs each supports
+ * Support PIDs are batched like value PIDs: the first request asks for the
+ * first OBD2_PIDS_PER_REQUEST ranges, later ones for ranges an ECU flagged
+ * (PID base + 0x20 set) that were not asked yet.
+ * @return true if any ECU answered
+ */
+static bool can_manager_discover(void) {
+    uint32_t asked = 0;                                 // bit r = support PID r * 0x20
+    uint32_t wanted = (1u << OBD2_PIDS_PER_REQUEST) - 1;
+
+    memset(ecu_supported, 0, sizeof(ecu_supported));
+    stats.ecu_mask = 0;
+    stats.discovery_count++;
+
+    while (wanted & ~asked) {
+        uint8_t pids[OBD2_PIDS_PER_REQUEST];
+        size_t n = 0;
+        for (uint32_t r = 0; r < OBD2_NUM_SUPPORT_RANGES && n < OBD2_PIDS_PER_REQUEST; r++) {
+            if ((wanted & ~asked) & (1u << r)) {
+                pids[n++] = (uint8_t)(r * OBD2_SUPPORT_RANGE);
+                asked |= 1u << r;
+            }
+        }
+        can_manager_request(OBD2_SERVICE_CURRENT_DATA, pids, n, handle_supported, true);
 
-        if (obd2_request_pid(pid) == ESP_OK) {
-            stats.request_count++;
+        for (uint32_t e = 0; e < OBD2_NUM_ECUS; e++) {
+            if (!(stats.ecu_mask & (1u << e))) continue;
+            for (uint32_t r = 1; r < OBD2_NUM_SUPPORT_RANGES; r++) {
+                if (obd2_pid_supported(&ecu_supported[e], (uint8_t)(r * OBD2_SUPPORT_RANGE))) {
+                    wanted |= 1u << r;
+                }
+            }
+        }
+    }
+    return stats.ecu_mask != 0;
+}
 
-            if (can_receive_message(&rx_msg, 250) == ESP_OK) {
-                if ((rx_msg.identifier >= OBD2_RESPONSE_CAN_ID_BASE) &&
-                    (rx_msg.identifier <= OBD2_RESPONSE_CAN_ID_BASE + 7)) {
+#if ENABLE_DTC_READING
+// Response to a DTC request: append the ECU's codes to the read in progress
+static uint32_t handle_dtcs(uint32_t ecu, const uint8_t *msg, size_t len,
+                            const uint8_t *pids, size_t count) {
+    (void)pids;
+    (void)count;
+    if (len < 2 || msg[0] != dtc_service + 0x40) {
+        return 0;
+    }
+    uint16_t codes[OBD2_MAX_DTC_RESPONSE_LEN / 2];
+    size_t n = obd2_parse_dtcs(msg, len, codes, sizeof(codes) / sizeof(codes[0]));
+    for (size_t i = 0; i < n && dtc_scratch_count < CAN_MANAGER_MAX_DTCS; i++) {
+        dtc_scratch[dtc_scratch_count++] = (can_manager_dtc_t){codes[i], (uint8_t)ecu, dtc_service};
+    }
+    // No PIDs to match; nonzero marks the request answered
+    return 1;
+}
+
+/**
+ * Read stored, pending and permanent DTCs from every ECU and publish them
+ * Each service is one functional request; ECUs with many codes answer in
+ * several frames, reassembled concurrently on their own ISO-TP links.
+ */
+static void can_manager_read_all_dtcs(void) {
+    static const uint8_t services[] = {
+        OBD2_SERVICE_DTC, OBD2_SERVICE_PENDING_DTC, OBD2_SERVICE_PERMANENT_DTC,
+    };
+    size_t stored = 0;
+
+    dtc_scratch_count = 0;
+    for (size_t i = 0; i < sizeof(services); i++) {
+        dtc_service = services[i];
+        can_manager_request(services[i], NULL, 0, handle_dtcs, true);
+        if (services[i] == OBD2_SERVICE_DTC) {
+            stored = dtc_scratch_count;
+        }
+    }
+
+    can_seqlock_write_begin(&dtc_lock);
+    memcpy(dtcs, dtc_scratch, dtc_scratch_count * sizeof(dtcs[0]));
+    dtc_count = dtc_scratch_count;
+    dtc_generation++;
+    can_seqlock_write_end(&dtc_lock);
 
-                    uint8_t response_pid;
-                    float value;
+    vehicle_data_get()->dtc_count = stored > UINT8_MAX ? UINT8_MAX : (uint8_t)stored;
+    ESP_LOGI(TAG, "DTCs: %d stored, %d pending/permanent", (int)stored, (int)(dtc_scratch_count - stored));
+    for (size_t i = 0; i < dtc_scratch_count; i++) {
+        char code[6];
+        obd2_format_dtc(dtc_scratch[i].code, code);
+        ESP_LOGD(TAG, "ECU 0x%03X mode %02X: %s", OBD2_RESPONSE_CAN_ID_BASE + dtc_scratch[i].ecu,
+                 dtc_scratch[i].service, code);
+    }
+}
+#endif
 
-                    if (obd2_parse_response(rx_msg.data, &response_pid, &value) == ESP_OK) {
-                        vehicle_data_update(vehicle_data_get(), response_pid, value);
-                        stats.response_count++;
-                        stats.last_response_pid = response_pid;
-                        stats.last_response_value = value;
-                    }
+// Whether any discovered ECU supports a PID (all PIDs count as supported until one answers)
+static bool pid_supported(uint8_t pid) {
+    if (stats.ecu_mask == 0) return true;
+    for (uint32_t e = 0; e < OBD2_NUM_ECUS; e++) {
+        if ((stats.ecu_mask & (1u << e)) && obd2_pid_supported(&ecu_supported[e], pid)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Everything the ECUs support is due now, without back-off; the rest is not polled
+static void schedule_reset(int64_t now_us) {
+    for (size_t i = 0; i < NUM_SCHEDULED_PIDS; i++) {
+        sched[i].deadline_us = now_us;
+        sched[i].misses = 0;
+        sched[i].supported = pid_supported(schedule[i].pid);
+    }
+}
+
+/**
+ * Earliest-deadline-first pick of the next request
+ * A PID is eligible once its deadline is less than one measured response
+ * latency away, so the answer lands around the deadline; up to
+ * OBD2_PIDS_PER_REQUEST eligible PIDs are batched, earliest first.
+ * @param picked Output: schedule[] indices
+ * @param wait_us Output when nothing is eligible: time until something is
+ * @return Number of PIDs picked
+ */
+static size_t schedule_pick(int64_t now_us, size_t *picked, int64_t *wait_us) {
+    int64_t horizon = now_us + latency_us;
+    size_t count = 0;
+    *wait_us = INT64_MAX;
+
+    for (size_t i = 0; i < NUM_SCHEDULED_PIDS; i++) {
+        int64_t deadline = sched[i].deadline_us;
+        if (!sched[i].supported) {
+            continue;
+        }
+        if (deadline > horizon) {
+            if (deadline - horizon < *wait_us) *wait_us = deadline - horizon;
+            continue;
+        }
+        // Insertion into the deadline-sorted pick list, dropping the latest when full
+        size_t pos = count;
+        while (pos > 0 && sched[picked[pos - 1]].deadline_us > deadline) pos--;
+        if (pos == OBD2_PIDS_PER_REQUEST) continue;
+        if (count < OBD2_PIDS_PER_REQUEST) count++;
+        memmove(&picked[pos + 1], &picked[pos], (count - 1 - pos) * sizeof(picked[0]));
+        picked[pos] = i;
+    }
+    return count;
+}
+
+// Next deadline: one period on when answered, doubling per consecutive miss
+static void schedule_advance(size_t i, bool answered, int64_t now_us) {
+    pid_sched_t *s = &sched[i];
+    int64_t period_us = (int64_t)schedule[i].period_ms * 1000;
+
+    s->requests++;
+    if (answered) {
+        s->responses++;
+        s->misses = 0;
+        s->deadline_us += period_us;
+        // Overloaded or paused: restart the phase instead of bursting to catch up
+        if (s->deadline_us < now_us - period_us) s->deadline_us = now_us;
+    } else {
+        if (s->misses < OBD2_BACKOFF_MAX_SHIFT) s->misses++;
+        s->deadline_us = now_us + (period_us << s->misses);
+    }
+}
+
+// Achieved vs target rate per PID over the window since the last call
+static void schedule_report(int64_t window_us) {
+    for (size_t i = 0; i < NUM_SCHEDULED_PIDS; i++) {
+        pid_sched_t *s = &sched[i];
+        can_manager_pid_stats_t *ps = &pid_stats[i];
+        ps->pid = schedule[i].pid;
+        ps->target_hz = 1000.0f / (float)schedule[i].period_ms;
+        ps->achieved_hz = window_us > 0 ? (s->responses - s->window_responses) * 1e6f / (float)window_us : 0;
+        ps->requests = s->requests;
+        ps->responses = s->responses;
+        ps->backoff = s->misses;
+        ps->supported = s->supported;
+        s->window_responses = s->responses;
+        ESP_LOGD(TAG, "PID 0x%02X %-24s %5.2f/%5.2f Hz%s", ps->pid, obd2_get_pid_name(ps->pid),
+                 ps->achieved_hz, ps->target_hz,
+                 !ps->supported ? " (unsupported)" : ps->backoff ? " (backing off)" : "");
+    }
+}
+
+static void can_manager_task(void *arg) {
+    uint32_t window_pids = 0;
+    uint32_t window_requests = 0;
+    int64_t window_start = esp_timer_get_time();
+    bool discovered = false;
+    int64_t next_discovery = window_start;
+    uint32_t silent = 0;                    // consecutive requests nobody answered
+    const can_profile_t *vehicle = NULL;    // decoder profile at the last discovery
+
+    ESP_LOGI(TAG, "CAN Manager task started (%d PIDs scheduled, %d per request)",
+             (int)NUM_SCHEDULED_PIDS, OBD2_PIDS_PER_REQUEST);
+    vehicle_data_init();
+    memset(sched, 0, sizeof(sched));
+    latency_us = 0;
+    stats.ecu_mask = 0;
+    schedule_reset(window_start);
+#if ENABLE_UDS_POLLING
+    uds_poller_reset(window_start);
+#endif
+
+    isotp_config_t isotp_config = {ISOTP_BLOCK_SIZE, ISOTP_ST_MIN};
+    for (uint32_t e = 0; e < OBD2_NUM_ECUS; e++) {
+        uint32_t rx_id = OBD2_RESPONSE_CAN_ID_BASE + e;
+        isotp_link_init(&ecu_link[e], rx_id - OBD2_PHYSICAL_ID_OFFSET, rx_id, &isotp_config);
+    }
+
+    while (can_manager_running) {
+        // Probe again when the vehicle may have changed: an unknown ECU answered,
+        // the ECUs went silent, or the decoder settled on another profile
+        bool detecting;
+        const can_profile_t *profile = mercedes_decode_get_profile(&detecting);
+        if (discovered && (rediscover || silent >= OBD2_REDISCOVER_MISSES ||
+                           (!detecting && vehicle != NULL && profile != vehicle))) {
+            discovered = false;
+            next_discovery = esp_timer_get_time();
+        }
+        if (!detecting) {
+            vehicle = profile;
+        }
+
+        if (!discovered && esp_timer_get_time() >= next_discovery) {
+            rediscover = false;
+            silent = 0;
+            discovered = can_manager_discover();
+            next_discovery = esp_timer_get_time() + (int64_t)OBD2_DISCOVERY_RETRY_MS * 1000;
+            if (discovered) {
+                schedule_reset(esp_timer_get_time());
+#if ENABLE_UDS_POLLING
+                uds_poller_reset(esp_timer_get_time());
+#endif
+                size_t polled = 0;
+                for (size_t i = 0; i < NUM_SCHEDULED_PIDS; i++) {
+                    polled += sched[i].supported;
                 }
-            } else {
-                stats.error_count++;
+                ESP_LOGI(TAG, "ECUs 0x%02" PRIX32 " support %d of %d scheduled PIDs", stats.ecu_mask,
+                         (int)polled, (int)NUM_SCHEDULED_PIDS);
+#if ENABLE_DTC_READING
+                atomic_store(&dtc_requested, true);
+#endif
             }
+            continue;
+        }
+
+#if ENABLE_DTC_READING
+        if (atomic_exchange(&dtc_requested, false)) {
+            can_manager_read_all_dtcs();
+            continue;
         }
+#endif
 
-        current_pid_index = (current_pid_index + 1) % NUM_PRIORITY_PIDS;
+        // UDS reads go first when due; the token bucket keeps them to their share of the bus
+        int64_t uds_wait = INT64_MAX;
+#if ENABLE_UDS_POLLING
+        uint32_t uds_ecu;
+        uint8_t uds_req[UDS_MAX_REQUEST_LEN];
+        size_t uds_len = uds_poller_next(esp_timer_get_time(), &uds_ecu, uds_req, &uds_wait);
+        if (uds_len > 0) {
+            size_t n = can_manager_transact(uds_ecu, uds_req, uds_len);
+            uds_poller_response(esp_timer_get_time(), n > 0 ? ecu_buf[uds_ecu] : NULL, n);
+            vTaskDelay(1);
+            continue;
+        }
+#endif
+
+        size_t picked[OBD2_PIDS_PER_REQUEST];
+        int64_t wait_us;
+        size_t count = schedule_pick(esp_timer_get_time(), picked, &wait_us);
+        if (count == 0) {
+            if (uds_wait < wait_us) wait_us = uds_wait;
+            TickType_t ticks = pdMS_TO_TICKS(wait_us / 1000);
+            vTaskDelay(ticks ? ticks : 1);
+            continue;
+        }
+
+        uint8_t batch[OBD2_PIDS_PER_REQUEST];
+        for (size_t k = 0; k < count; k++) {
+            batch[k] = schedule[picked[k]].pid;
+        }
+        uint32_t answered = can_manager_request(OBD2_SERVICE_CURRENT_DATA, batch, count, handle_values, false);
+        int64_t now = esp_timer_get_time();
+        for (size_t k = 0; k < count; k++) {
+            schedule_advance(picked[k], (answered >> k) & 1u, now);
+        }
+        silent = answered ? 0 : silent + 1;
+        stats.response_latency_us = latency_us;
 
-        if (stats.request_count > 0 && stats.request_count % 100 == 0) {
-            ESP_LOGI(TAG, "Req: %" PRIu32 " Resp: %" PRIu32 " Err: %" PRIu32 " (%.0f%%)",
+        if (stats.request_count - window_requests >= CAN_MANAGER_STATS_INTERVAL) {
+            if (now > window_start) {
+                stats.pids_per_second = (stats.pid_count - window_pids) * 1e6f / (float)(now - window_start);
+            }
+            schedule_report(now - window_start);
+            window_pids = stats.pid_count;
+            window_requests = stats.request_count;
+            window_start = now;
+            ESP_LOGI(TAG, "Req: %" PRIu32 " Resp: %" PRIu32 " Err: %" PRIu32 " (%.0f%%) PIDs: %" PRIu32 " (%.1f/s) Latency: %" PRIu32 " us",
                 stats.request_count, stats.response_count, stats.error_count,
-                (stats.response_count * 100.0f) / stats.request_count);
+                ((stats.request_count - stats.error_count) * 100.0f) / stats.request_count,
+                stats.pid_count, stats.pids_per_second, stats.response_latency_us);
         }
 
-        vTaskDelay(pdMS_TO_TICKS(50));
+        // Let lower-priority tasks run between back-to-back requests
+        vTaskDelay(1);
     }
 
     vTaskDelete(NULL);
@@ -131,3 +643,39 @@ bool can_manager_is_running(void) {
 const can_manager_stats_t* can_manager_get_stats(void) {
     return &stats;
 }
+
+size_t can_manager_get_pid_stats(can_manager_pid_stats_t *out, size_t max) {
+    size_t n = max < NUM_SCHEDULED_PIDS ? max : NUM_SCHEDULED_PIDS;
+    memcpy(out, pid_stats, n * sizeof(out[0]));
+    return n;
+}
+
+esp_err_t can_manager_read_dtcs(void) {
+#if ENABLE_DTC_READING
+    atomic_store(&dtc_requested, true);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+size_t can_manager_get_dtcs(can_manager_dtc_t *out, size_t max, uint32_t *generation) {
+#if ENABLE_DTC_READING
+    for (int i = 0; i < CAN_SEQLOCK_READ_TRIES; i++) {
+        uint32_t start = can_seqlock_read_begin(&dtc_lock);
+        if (start & 1) continue;
+        size_t n = dtc_count < max ? dtc_count : max;
+        uint32_t gen = dtc_generation;
+        memcpy(out, dtcs, n * sizeof(out[0]));
+        if (!can_seqlock_read_retry(&dtc_lock, start)) {
+            if (generation != NULL) *generation = gen;
+            return n;
+        }
+    }
+#else
+    (void)out;
+    (void)max;
+#endif
+    if (generation != NULL) *generation = 0;
+    return 0;
+}
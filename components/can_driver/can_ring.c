@@ -0,0 +1,100 @@
+#include "can_ring.h"
+#include <string.h>
+
+bool can_ring_init(can_ring_t *ring, can_message_t *storage, uint32_t capacity) {
+    if (ring == NULL || storage == NULL || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+    ring->slots = storage;
+    ring->mask = capacity - 1;
+    can_ring_reset(ring);
+    return true;
+}
+
+void can_ring_reset(can_ring_t *ring) {
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->dropped, 0, memory_order_relaxed);
+    ring->high_water = 0;
+}
+
+uint32_t can_ring_count(const can_ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+uint32_t can_ring_capacity(const can_ring_t *ring) {
+    return ring->mask + 1;
+}
+
+uint32_t can_ring_reserve(can_ring_t *ring, can_message_t **slots, uint32_t max) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t free_slots = (ring->mask + 1) - (head - tail);
+    uint32_t idx = head & ring->mask;
+    uint32_t to_end = (ring->mask + 1) - idx;  // stop at the wrap so the run is contiguous
+
+    uint32_t n = max;
+    if (n > free_slots) n = free_slots;
+    if (n > to_end) n = to_end;
+
+    *slots = &ring->slots[idx];
+    return n;
+}
+
+void can_ring_commit(can_ring_t *ring, uint32_t n) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed) + n;
+    // Release: slot contents become visible before the new head
+    atomic_store_explicit(&ring->head, head, memory_order_release);
+
+    uint32_t fill = head - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (fill > ring->high_water) ring->high_water = fill;
+}
+
+bool can_ring_push(can_ring_t *ring, const can_message_t *msg) {
+    can_message_t *slot;
+    if (can_ring_reserve(ring, &slot, 1) == 0) {
+        can_ring_note_dropped(ring, 1);
+        return false;
+    }
+    *slot = *msg;
+    can_ring_commit(ring, 1);
+    return true;
+}
+
+void can_ring_note_dropped(can_ring_t *ring, uint32_t n) {
+    atomic_fetch_add_explicit(&ring->dropped, n, memory_order_relaxed);
+}
+
+uint32_t can_ring_peek(can_ring_t *ring, const can_message_t **msgs, uint32_t max) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    // Acquire: pairs with the producer's release in can_ring_commit()
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t avail = head - tail;
+    uint32_t idx = tail & ring->mask;
+    uint32_t to_end = (ring->mask + 1) - idx;
+
+    uint32_t n = max;
+    if (n > avail) n = avail;
+    if (n > to_end) n = to_end;
+
+    *msgs = &ring->slots[idx];
+    return n;
+}
+
+void can_ring_release(can_ring_t *ring, uint32_t n) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed) + n;
+    // Release: the producer must not reuse the slots before we are done reading
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
+
+bool can_ring_pop(can_ring_t *ring, can_message_t *msg) {
+    const can_message_t *slot;
+    if (can_ring_peek(ring, &slot, 1) == 0) {
+        return false;
+    }
+    *msg = *slot;
+    can_ring_release(ring, 1);
+    return true;
+}
@@ -1,44 +1,328 @@
 #include "can_sniffer.h"
+#include "can_seqlock.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
 
+#define SLOT_NONE 0xFFFF
+#define EXT_ID_EMPTY 0xFFFFFFFFu
+
 static sniffer_state_t state;
 
+// Writer: CAN processing task. state_lock guards the table-wide counters,
+// entry_lock[n] guards entries[n].
+static can_seqlock_t state_lock;
+static can_seqlock_t entry_lock[SNIFFER_MAX_IDS];
+
+// ID -> entry slot maps (SLOT_NONE = not seen yet)
+static uint16_t std_index[SNIFFER_STD_ID_SPACE];
+static struct {
+    uint32_t id;
+    uint16_t slot;
+} ext_index[SNIFFER_EXT_HASH_SIZE];
+static int ext_ids;
+
+static void clear_indexes(void) {
+    for (int i = 0; i < SNIFFER_STD_ID_SPACE; i++) {
+        std_index[i] = SLOT_NONE;
+    }
+    for (int i = 0; i < SNIFFER_EXT_HASH_SIZE; i++) {
+        ext_index[i].id = EXT_ID_EMPTY;
+        ext_index[i].slot = SLOT_NONE;
+    }
+    ext_ids = 0;
+}
+
+static uint32_t ext_hash(uint32_t id) {
+    // Fibonacci hashing, top bits select the bucket
+    return (id * 2654435769u) >> (32 - __builtin_ctz(SNIFFER_EXT_HASH_SIZE));
+}
+
+// Find the slot for an extended ID; if absent, return the free bucket in *bucket
+static uint16_t ext_lookup(uint32_t id, int *bucket) {
+    uint32_t h = ext_hash(id);
+    for (int probe = 0; probe < SNIFFER_EXT_HASH_SIZE; probe++) {
+        uint32_t b = (h + probe) & (SNIFFER_EXT_HASH_SIZE - 1);
+        if (ext_index[b].id == id) {
+            return ext_index[b].slot;
+        }
+        if (ext_index[b].id == EXT_ID_EMPTY) {
+            *bucket = (int)b;
+            return SLOT_NONE;
+        }
+    }
+    *bucket = -1;  // hash full
+    return SLOT_NONE;
+}
+
+static uint16_t lookup_slot(uint32_t id) {
+    int bucket;
+    return (id < SNIFFER_STD_ID_SPACE) ? std_index[id] : ext_lookup(id, &bucket);
+}
+
+static uint64_t load_le64(const uint8_t *b) {
+    uint64_t v;
+    memcpy(&v, b, 8);
+    return v;  // little-endian target: byte n lands in bits 8n..8n+7
+}
+
+static void update_change_stats(sniffer_entry_t *e, const uint8_t *cur, uint8_t len) {
+    uint64_t diff = load_le64(e->last_data) ^ load_le64(cur);
+
+    // Fold each byte onto its bit 0, then gather those bits into one byte
+    uint64_t t = diff | (diff >> 4);
+    t |= t >> 2;
+    t |= t >> 1;
+    t &= 0x0101010101010101ULL;
+    e->changed_mask |= (uint8_t)((t * 0x0102040810204080ULL) >> 56);
+    e->flip_total += (uint32_t)__builtin_popcountll(diff);
+
+    // Only toggled bits are visited; a steady frame costs nothing here
+    while (diff) {
+        int bit = __builtin_ctzll(diff);
+        e->bit_flips[bit] += (e->bit_flips[bit] != UINT32_MAX);
+        diff &= diff - 1;
+    }
+
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t v = cur[i];
+        e->byte_min[i] = v < e->byte_min[i] ? v : e->byte_min[i];
+        e->byte_max[i] = v > e->byte_max[i] ? v : e->byte_max[i];
+    }
+}
+
+// Jitter within mean / 2^SNIFFER_APERIODIC_SHIFT, i.e. m2 / (n - 1) <= (mean >> shift)^2
+// (multiplied out: no 64-bit division on the per-frame path)
+static bool is_periodic(const sniffer_entry_t *e) {
+    uint64_t mean_us = (uint64_t)(e->period_mean_q8 >> 8);
+    uint64_t limit;
+    if (__builtin_mul_overflow((uint64_t)(e->period_samples - 1),
+                               (mean_us * mean_us) >> (2 * SNIFFER_APERIODIC_SHIFT), &limit)) {
+        return true;
+    }
+    return (e->period_m2_q8 >> 8) <= limit;
+}
+
+// Q8 deviation to Q4, clamped to ±SNIFFER_MAX_DEVIATION_US
+static int64_t deviation_q4(int64_t d_q8) {
+    const int64_t max = (int64_t)SNIFFER_MAX_DEVIATION_US << 4;
+    int64_t d = d_q8 / 16;
+    return d > max ? max : (d < -max ? -max : d);
+}
+
+static void update_timing(sniffer_entry_t *e, uint32_t ts_us) {
+    uint32_t period = ts_us - e->last_us;  // wraps correctly across the 32-bit rollover
+    e->last_us = ts_us;
+
+    if (period < e->period_min_us || e->period_min_us == 0) e->period_min_us = period;
+    if (period > e->period_max_us) e->period_max_us = period;
+
+    int64_t x = (int64_t)period << 8;
+    if (e->period_samples >= SNIFFER_TIMING_WARMUP && e->period_mean_q8 > 0) {
+        int64_t band = e->period_mean_q8 >> SNIFFER_GAP_SHIFT;
+        bool off_rate = x > e->period_mean_q8 + band || x < e->period_mean_q8 - band;
+        if (off_rate && is_periodic(e)) {
+            if (x > e->period_mean_q8) {
+                // Frames went missing: count them, keep the gap out of mean and variance
+                uint32_t missed = (uint32_t)((x + e->period_mean_q8 / 2) / e->period_mean_q8) - 1;
+                e->missed_cycles += missed;
+                e->run_missed += missed;
+                state.missed_cycles += missed;
+            }
+            if (++e->off_rate_run < SNIFFER_REBASE_RUN) return;
+
+            // Not gaps but a new rate: start over from this period
+            e->missed_cycles -= e->run_missed;
+            state.missed_cycles -= e->run_missed;
+            e->period_samples = 0;
+            e->period_mean_q8 = 0;
+            e->period_m2_q8 = 0;
+        }
+        e->off_rate_run = 0;
+        e->run_missed = 0;
+    }
+
+    // Welford update in fixed point. The squared deviations are summed in Q8
+    // from deviations clamped to SNIFFER_MAX_DEVIATION_US, so one product stays
+    // below 2^62, and the sum saturates: an ID that gets there is event-driven.
+    e->period_samples++;
+    int64_t delta = x - e->period_mean_q8;
+    e->period_mean_q8 += delta / (int64_t)e->period_samples;
+    int64_t delta2 = x - e->period_mean_q8;
+    uint64_t sq = (uint64_t)(deviation_q4(delta) * deviation_q4(delta2));
+    if (__builtin_add_overflow(e->period_m2_q8, sq, &e->period_m2_q8)) e->period_m2_q8 = UINT64_MAX;
+}
+
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t r = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
 void can_sniffer_init(void) {
     memset(&state, 0, sizeof(state));
+    clear_indexes();
 }
 
-void can_sniffer_record(uint32_t id, const uint8_t *data, uint8_t dlc) {
+void can_sniffer_record(uint32_t id, const uint8_t *data, uint8_t dlc, uint32_t ts_us) {
+    can_seqlock_write_begin(&state_lock);
     state.total_msgs++;
 
-    // Find existing entry
-    for (int i = 0; i < state.num_ids; i++) {
-        if (state.entries[i].id == id) {
-            state.entries[i].count++;
-            state.entries[i].last_dlc = dlc;
-            state.entries[i].last_tick = xTaskGetTickCount();
-            memcpy(state.entries[i].last_data, data, dlc > 8 ? 8 : dlc);
+    int bucket = -1;
+    uint16_t slot = (id < SNIFFER_STD_ID_SPACE) ? std_index[id] : ext_lookup(id, &bucket);
+
+    if (slot == SLOT_NONE) {
+        // New ID
+        if (state.num_ids >= SNIFFER_MAX_IDS ||
+            (id >= SNIFFER_STD_ID_SPACE && (bucket < 0 || ext_ids >= SNIFFER_EXT_MAX_IDS))) {
+            state.untracked_msgs++;
+            can_seqlock_write_end(&state_lock);
             return;
         }
-    }
-
-    // New ID
-    if (state.num_ids < SNIFFER_MAX_IDS) {
-        sniffer_entry_t *e = &state.entries[state.num_ids];
+        slot = (uint16_t)state.num_ids;
+        sniffer_entry_t *e = &state.entries[slot];
+        can_seqlock_write_begin(&entry_lock[slot]);
+        memset(e, 0, sizeof(*e));
         e->id = id;
-        e->count = 1;
-        e->last_dlc = dlc;
-        e->last_tick = xTaskGetTickCount();
-        memcpy(e->last_data, data, dlc > 8 ? 8 : dlc);
+        can_seqlock_write_end(&entry_lock[slot]);
+        if (id < SNIFFER_STD_ID_SPACE) {
+            std_index[id] = slot;
+        } else {
+            ext_index[bucket].id = id;
+            ext_index[bucket].slot = slot;
+            ext_ids++;
+        }
         state.num_ids++;
     }
+
+    sniffer_entry_t *e = &state.entries[slot];
+    uint8_t len = dlc > 8 ? 8 : dlc;
+    uint8_t cur[8] = {0};
+    memcpy(cur, data, len);
+
+    can_seqlock_write_begin(&entry_lock[slot]);
+    if (e->count == 0) {
+        memcpy(e->byte_min, cur, 8);
+        memcpy(e->byte_max, cur, 8);
+        e->last_us = ts_us;
+    } else {
+        update_change_stats(e, cur, len);
+        update_timing(e, ts_us);
+    }
+
+    e->count++;
+    e->last_dlc = dlc;
+    e->last_tick = xTaskGetTickCount();
+    memcpy(e->last_data, cur, 8);
+    can_seqlock_write_end(&entry_lock[slot]);
+
+    can_seqlock_write_end(&state_lock);
 }
 
 const sniffer_state_t *can_sniffer_get_state(void) {
     return &state;
 }
 
+const sniffer_entry_t *can_sniffer_find(uint32_t id) {
+    uint16_t slot = lookup_slot(id);
+    return slot == SLOT_NONE ? NULL : &state.entries[slot];
+}
+
+bool can_sniffer_snapshot_summary(sniffer_summary_t *out) {
+    for (int i = 0; i < CAN_SEQLOCK_READ_TRIES; i++) {
+        uint32_t start = can_seqlock_read_begin(&state_lock);
+        sniffer_summary_t tmp = {
+            .num_ids = state.num_ids,
+            .total_msgs = state.total_msgs,
+            .untracked_msgs = state.untracked_msgs,
+            .missed_cycles = state.missed_cycles,
+        };
+        if (!can_seqlock_read_retry(&state_lock, start)) {
+            *out = tmp;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool can_sniffer_snapshot_entry(uint32_t id, sniffer_entry_t *out) {
+    uint16_t slot = lookup_slot(id);
+    if (slot == SLOT_NONE) return false;
+    sniffer_entry_t tmp;
+    if (!can_seqlock_read(&entry_lock[slot], &tmp, &state.entries[slot], sizeof(tmp))) {
+        return false;
+    }
+    *out = tmp;
+    return true;
+}
+
+size_t can_sniffer_top_bits(sniffer_bit_rank_t *out, size_t max) {
+    if (out == NULL || max == 0) return 0;
+    size_t n = 0;
+    int num_ids = state.num_ids;
+
+    for (int i = 0; i < num_ids; i++) {
+        const sniffer_entry_t *e = &state.entries[i];
+        uint32_t bit_flips[64];
+        uint32_t id = 0;
+        bool ok = false;
+        for (int t = 0; t < CAN_SEQLOCK_READ_TRIES && !ok; t++) {
+            uint32_t start = can_seqlock_read_begin(&entry_lock[i]);
+            id = e->id;
+            memcpy(bit_flips, e->bit_flips, sizeof(bit_flips));
+            ok = !can_seqlock_read_retry(&entry_lock[i], start);
+        }
+        if (!ok) continue;
+
+        for (int bit = 0; bit < 64; bit++) {
+            uint32_t flips = bit_flips[bit];
+            if (flips == 0) continue;
+            if (n == max && flips <= out[n - 1].flips) continue;
+
+            // Insert into the sorted top-max list
+            size_t pos = (n < max) ? n++ : n - 1;
+            while (pos > 0 && out[pos - 1].flips < flips) {
+                out[pos] = out[pos - 1];
+                pos--;
+            }
+            out[pos].id = id;
+            out[pos].bit = (uint8_t)bit;
+            out[pos].flips = flips;
+        }
+    }
+    return n;
+}
+
+void can_sniffer_get_timing(const sniffer_entry_t *entry, sniffer_timing_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (entry == NULL) return;
+    out->min_us = entry->period_min_us;
+    out->max_us = entry->period_max_us;
+    out->samples = entry->period_samples;
+    out->missed_cycles = entry->missed_cycles;
+    out->mean_us = (uint32_t)((entry->period_mean_q8 + 128) >> 8);
+    if (entry->period_samples > 1) {
+        // sqrt of Q8 variance is Q4
+        out->jitter_us = (isqrt64(entry->period_m2_q8 / (entry->period_samples - 1)) + 8) >> 4;
+    }
+}
+
 void can_sniffer_reset(void) {
+    // Must run in the writer's context (CAN processing task or before it starts)
+    can_seqlock_write_begin(&state_lock);
+    for (int i = 0; i < SNIFFER_MAX_IDS; i++) can_seqlock_write_begin(&entry_lock[i]);
     memset(&state, 0, sizeof(state));
+    clear_indexes();
+    for (int i = 0; i < SNIFFER_MAX_IDS; i++) can_seqlock_write_end(&entry_lock[i]);
+    can_seqlock_write_end(&state_lock);
 }
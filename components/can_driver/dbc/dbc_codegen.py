@@ -0,0 +1,381 @@
+#!/usr/bin/env python3
+"""Generate C signal tables (see include/can_signal.h) from one DBC file per vehicle profile.
+
+Next to the tables, every message gets a decode function that does what
+can_signal_decode() does with the table, with each shift, mask and scale as a
+constant. The per-frame path calls that instead of walking the table.
+
+Each DBC signal is stored into the field of the decoded-data struct whose name
+is the lower-cased signal name; field widths are read from the struct
+declaration in --struct-header. The stored value is:
+  - raw * factor + offset  when both are integers,
+  - phys / FieldScale      when the signal has a FieldScale attribute,
+  - the raw value          otherwise (scaling stays in the table for display).
+
+The GenMsgCycleTime message attribute (ms) becomes the message's nominal
+period; 0 or absent marks an event-driven message.
+
+Every profile gets its own signal layouts, message IDs and ID index, but all
+profiles share one channel (signal) and message numbering: signals and
+messages are matched by name across the DBC files. A signal must belong to the
+same message name in every file. Signals or messages a profile lacks keep
+their number and are never decoded (signals store 0, messages have no ID).
+
+Usage:
+  dbc_codegen.py --profile W218=w218.dbc --profile W212=w212.dbc --prefix mb \
+                 --struct mercedes_data_t --struct-header include/mercedes_decode.h \
+                 --out-c mb_signals.c --out-h mb_signals.h
+"""
+
+import argparse
+import os
+import re
+import sys
+
+STD_ID_SPACE = 2048
+
+RE_BO = re.compile(r'^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+\w+')
+RE_SG = re.compile(r'^SG_\s+(\w+)\s*(\w*)\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*'
+                   r'\(([^,]+),([^)]+)\)\s*\[([^|]*)\|([^\]]*)\]\s*"([^"]*)"')
+RE_BA_SG = re.compile(r'^BA_\s+"(\w+)"\s+SG_\s+(\d+)\s+(\w+)\s+([^;]+);')
+RE_BA_BO = re.compile(r'^BA_\s+"(\w+)"\s+BO_\s+(\d+)\s+([^;]+);')
+
+
+class DbcError(Exception):
+    pass
+
+
+def parse_dbc(path):
+    messages = []
+    attrs = {}
+    current = None
+    with open(path, encoding='latin-1') as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            m = RE_BO.match(line)
+            if m:
+                can_id = int(m.group(1))
+                if can_id & 0x80000000 or can_id >= STD_ID_SPACE:
+                    raise DbcError(f'{path}:{lineno}: only 11-bit IDs are supported')
+                current = {'id': can_id, 'name': m.group(2), 'dlc': int(m.group(3)), 'signals': []}
+                messages.append(current)
+                continue
+            if line.startswith('SG_'):
+                m = RE_SG.match(line)
+                if not m or current is None:
+                    raise DbcError(f'{path}:{lineno}: cannot parse signal: {line}')
+                if m.group(2):
+                    raise DbcError(f'{path}:{lineno}: multiplexed signals are not supported')
+                current['signals'].append({
+                    'name': m.group(1),
+                    'start': int(m.group(3)),
+                    'length': int(m.group(4)),
+                    'intel': m.group(5) == '1',
+                    'signed': m.group(6) == '-',
+                    'factor': float(m.group(7)),
+                    'offset': float(m.group(8)),
+                    'unit': m.group(11),
+                })
+                continue
+            m = RE_BA_SG.match(line)
+            if m:
+                attrs[(int(m.group(2)), m.group(3), m.group(1))] = float(m.group(4))
+                continue
+            m = RE_BA_BO.match(line)
+            if m:
+                attrs[(int(m.group(2)), None, m.group(1))] = float(m.group(3))
+    return messages, attrs
+
+
+RE_FIELD = re.compile(r'^\s*(u?int(8|16|32)_t)\s+(\w+)\s*;')
+
+
+def parse_struct_fields(path, struct):
+    """Map field name -> (size in bytes, signed) for the integer fields of a typedef'd struct."""
+    with open(path) as f:
+        text = f.read()
+    m = re.search(r'typedef\s+struct\s*\{(.*?)\}\s*' + re.escape(struct) + r'\s*;', text, re.S)
+    if not m:
+        raise DbcError(f'{path}: struct {struct} not found')
+    fields = {}
+    for line in m.group(1).splitlines():
+        fm = RE_FIELD.match(line)
+        if fm:
+            fields[fm.group(3)] = (int(fm.group(2)) // 8, not fm.group(1).startswith('u'))
+    return fields
+
+
+def signal_shift(sig):
+    """LSB position of the signal in the big-endian frame word (or the swapped word for Intel)."""
+    start, length = sig['start'], sig['length']
+    if sig['intel']:
+        lsb = start
+    else:
+        # Motorola: start bit is the MSB, numbered byte * 8 + bit
+        msb = 8 * (7 - start // 8) + start % 8
+        lsb = msb - length + 1
+    if lsb < 0 or lsb + length > 64:
+        raise DbcError(f"signal {sig['name']} does not fit in 8 bytes")
+    return lsb
+
+
+def store_transform(msg, sig, attrs):
+    def integral(v):
+        return abs(v - round(v)) < 1e-9
+
+    scale = attrs.get((msg['id'], sig['name'], 'FieldScale'), 0.0)
+    if scale:
+        mul, add = sig['factor'] / scale, sig['offset'] / scale
+        if not (integral(mul) and integral(add)):
+            raise DbcError(f"{sig['name']}: FieldScale {scale} does not give integer scaling")
+        return int(round(mul)), int(round(add))
+    if integral(sig['factor']) and integral(sig['offset']):
+        return int(round(sig['factor'])), int(round(sig['offset']))
+    return 1, 0
+
+
+C_TYPES = {(1, False): 'uint8_t', (1, True): 'int8_t', (2, False): 'uint16_t', (2, True): 'int16_t',
+           (4, False): 'uint32_t', (4, True): 'int32_t'}
+
+
+def decode_function(name, struct, shared, msg, attrs):
+    """Straight-line decoder for one message: can_signal_decode() with every
+    shift, mask and scale a constant, so byte-aligned fields become plain loads."""
+    sigs = {s['name']: s for s in msg['signals']}
+    intel = any(s['intel'] for s in msg['signals'])
+    lines = [f'static uint32_t {name}(uint64_t be, void *dest) {{',
+             f'    {struct} *d = ({struct} *)dest;']
+    if intel:
+        lines.append('    uint64_t le = __builtin_bswap64(be);')
+    lines.append('    uint32_t changed = 0;')
+    for bit, ref in enumerate(shared['signals']):
+        field = ref['name'].lower()
+        ctype = C_TYPES[(ref['size'], ref['field_signed'])]
+        sig = sigs.get(ref['name'])
+        if sig is None:
+            expr = '0'
+        else:
+            shift = signal_shift(sig)
+            word = 'le' if sig['intel'] else 'be'
+            raw = f'({word} >> {shift})' if shift else word
+            if shift + sig['length'] < 64:
+                raw = f'((uint32_t){raw} & 0x{(1 << sig["length"]) - 1:X}u)'
+            else:
+                raw = f'(uint32_t){raw}'
+            if sig['signed'] and sig['length'] < 32:
+                sext = 32 - sig['length']
+                raw = f'((int32_t)({raw} << {sext}) >> {sext})'
+            elif sig['signed']:
+                raw = f'(int32_t){raw}'
+            mul, add = store_transform(msg, sig, attrs)
+            if mul != 1:
+                raw = f'{raw} * {mul}'
+            if add:
+                raw = f'{raw} + ({add})' if add < 0 else f'{raw} + {add}'
+            expr = raw
+        lines += [f'    {ctype} v{bit} = ({ctype})({expr});',
+                  f'    changed |= (uint32_t)(d->{field} != v{bit}) << {bit};',
+                  f'    d->{field} = v{bit};']
+    lines += ['    return changed;', '}']
+    return lines
+
+
+def c_float(v):
+    s = repr(float(v))
+    return s + 'f' if ('.' in s or 'e' in s) else s + '.0f'
+
+
+def merge_profiles(profiles, fields, struct):
+    """Shared message/signal numbering over all profiles, matched by name in first-seen order."""
+    merged = []
+    by_name = {}
+    owner = {}
+    for prof in profiles:
+        seen = set()
+        for msg in sorted(prof['messages'], key=lambda m: m['id']):
+            if len(msg['signals']) > 32:
+                raise DbcError(f"{prof['name']}: {msg['name']}: more than 32 signals in one message")
+            shared = by_name.get(msg['name'])
+            if shared is None:
+                shared = {'name': msg['name'], 'signals': []}
+                by_name[msg['name']] = shared
+                merged.append(shared)
+            names = {s['name'] for s in shared['signals']}
+            for sig in msg['signals']:
+                field = sig['name'].lower()
+                if field in seen:
+                    raise DbcError(f"{prof['name']}: {sig['name']}: field {field} is written by more than one signal")
+                seen.add(field)
+                if field not in fields:
+                    raise DbcError(f"{sig['name']}: no integer field {field} in {struct}")
+                sig['size'], sig['field_signed'] = fields[field]
+                first = owner.setdefault(sig['name'], msg['name'])
+                if first != msg['name']:
+                    raise DbcError(f"{prof['name']}: {sig['name']} is in {msg['name']}, "
+                                   f"but in {first} in another profile")
+                if sig['name'] not in names:
+                    shared['signals'].append(sig)  # first profile's definition names the channel
+    if len(merged) > 254:
+        raise DbcError('too many messages for the 8-bit message index')
+    for shared in merged:
+        if len(shared['signals']) > 32:
+            raise DbcError(f"{shared['name']}: more than 32 signals over all profiles")
+        # Decoder stores 1-byte fields first, then 2-byte, then 4-byte (stable within a width)
+        shared['signals'].sort(key=lambda s: s['size'])
+    return merged
+
+
+def generate(profiles, fields, args):
+    prefix = args.prefix.lower()
+    upper = prefix.upper()
+    guard = os.path.basename(args.out_h).upper().replace('.', '_')
+    srcs = ', '.join(os.path.basename(p['dbc']) for p in profiles)
+
+    merged = merge_profiles(profiles, fields, args.struct)
+
+    h = [f'// Generated by dbc_codegen.py from {srcs}. Do not edit.',
+         f'#ifndef {guard}', f'#define {guard}', '',
+         '#include "can_signal.h"', '',
+         '#ifdef __cplusplus', 'extern "C" {', '#endif', '',
+         'typedef enum {']
+    for msg in merged:
+        h.append(f"    {upper}_MSG_{msg['name'].upper()},")
+    h += [f'    {upper}_MSG_COUNT', f'}} {prefix}_msg_t;', '', 'typedef enum {']
+    for msg in merged:
+        for sig in msg['signals']:
+            h.append(f"    {upper}_SIG_{sig['name']},")
+    h += [f'    {upper}_SIG_COUNT', f'}} {prefix}_sig_t;', '', 'typedef enum {']
+    for prof in profiles:
+        h.append(f"    {upper}_PROFILE_{prof['name'].upper()},")
+    h += [f'    {upper}_PROFILE_COUNT', f'}} {prefix}_profile_id_t;', '',
+          f'extern const can_signal_info_t {prefix}_signal_info[{upper}_SIG_COUNT];',
+          f'extern const can_profile_t {prefix}_profiles[{upper}_PROFILE_COUNT];', '',
+          '#ifdef __cplusplus', '}', '#endif', '', f'#endif // {guard}', '']
+
+    c = [f'// Generated by dbc_codegen.py from {srcs}. Do not edit.',
+         f'#include "{os.path.basename(args.out_h)}"',
+         f'#include "{os.path.basename(args.struct_header)}"', '',
+         f'const can_signal_info_t {prefix}_signal_info[{upper}_SIG_COUNT] = {{']
+    for msg in merged:
+        for sig in msg['signals']:
+            c.append(f"    [{upper}_SIG_{sig['name']}] = {{ \"{sig['name']}\", \"{sig['unit']}\", "
+                     f"{c_float(sig['factor'])}, {c_float(sig['offset'])}, {sig['length']}, "
+                     f"{upper}_MSG_{msg['name'].upper()} }},")
+    c.append('};')
+
+    for prof in profiles:
+        var = f"{prefix}_{prof['name'].lower()}"
+        own = {msg['name']: msg for msg in prof['messages']}
+        c += ['', f"// === {prof['name']} ({os.path.basename(prof['dbc'])}) ===",
+              f'static const can_signal_t {var}_signals[{upper}_SIG_COUNT] = {{']
+        for shared in merged:
+            msg = own.get(shared['name'])
+            sigs = {s['name']: s for s in msg['signals']} if msg else {}
+            for ref in shared['signals']:
+                field = ref['name'].lower()
+                sig = sigs.get(ref['name'])
+                if sig is None:
+                    # Not sent by this vehicle: mask 0 stores a constant 0
+                    flags = 'CAN_SIG_FIELD_SIGNED' if ref['field_signed'] else '0'
+                    c.append(f"    [{upper}_SIG_{ref['name']}] = {{ 0x0u, 0, 0, "
+                             f"offsetof({args.struct}, {field}), 0, 0, {flags}, {ref['size']} }},")
+                    continue
+                if sig['length'] > 32:
+                    raise DbcError(f"{sig['name']}: signals wider than 32 bits are not supported")
+                flags = []
+                if sig['signed']:
+                    flags.append('CAN_SIG_SIGNED')
+                if sig['intel']:
+                    flags.append('CAN_SIG_INTEL')
+                if sig['field_signed']:
+                    flags.append('CAN_SIG_FIELD_SIGNED')
+                mul, add = store_transform(msg, sig, prof['attrs'])
+                mask = (1 << sig['length']) - 1
+                sext = 32 - sig['length'] if sig['signed'] else 0
+                c.append(f"    [{upper}_SIG_{sig['name']}] = {{ 0x{mask:X}u, {add}, {mul}, "
+                         f"offsetof({args.struct}, {field}), {signal_shift(sig)}, {sext}, "
+                         f"{' | '.join(flags) or '0'}, {sig['size']} }},")
+        c.append('};')
+        for shared in merged:
+            msg = own.get(shared['name'])
+            if msg is not None:
+                c.append('')
+                c += decode_function(f"{var}_decode_{msg['name'].lower()}", args.struct, shared, msg,
+                                     prof['attrs'])
+        c += ['', f'static const can_message_def_t {var}_messages[{upper}_MSG_COUNT] = {{']
+        first = 0
+        for shared in merged:
+            msg = own.get(shared['name'])
+            if msg is not None:
+                cycle = int(prof['attrs'].get((msg['id'], None, 'GenMsgCycleTime'), 0))
+                flags = 'CAN_SIG_INTEL' if any(s['intel'] for s in msg['signals']) else '0'
+                n8 = sum(1 for s in shared['signals'] if s['size'] == 1)
+                n16 = sum(1 for s in shared['signals'] if s['size'] == 2)
+                c.append(f"    [{upper}_MSG_{msg['name'].upper()}] = {{ 0x{msg['id']:03X}, {msg['dlc']}, {flags}, "
+                         f"{len(shared['signals'])}, {n8}, {n16}, {first}, {cycle}, \"{msg['name']}\", "
+                         f"{var}_decode_{msg['name'].lower()} }},")
+            first += len(shared['signals'])
+        c += ['};', '', f'static const uint8_t {var}_message_index[CAN_PROFILE_ID_SPACE] = {{']
+        for msg in sorted(prof['messages'], key=lambda m: m['id']):
+            c.append(f"    [0x{msg['id']:03X}] = {upper}_MSG_{msg['name'].upper()} + 1,")
+        c.append('};')
+
+    c += ['', f'const can_profile_t {prefix}_profiles[{upper}_PROFILE_COUNT] = {{']
+    for prof in profiles:
+        var = f"{prefix}_{prof['name'].lower()}"
+        c.append(f"    [{upper}_PROFILE_{prof['name'].upper()}] = {{ \"{prof['name']}\", {var}_signals, "
+                 f"{var}_messages, {var}_message_index, {len(prof['messages'])} }},")
+    c += ['};', '', '// Field widths the table ordering was generated for']
+    for msg in merged:
+        for sig in msg['signals']:
+            field = sig['name'].lower()
+            c.append(f"_Static_assert(sizeof((({args.struct} *)0)->{field}) == {sig['size']}, "
+                     f"\"{field} width changed, regenerate\");")
+    c.append('')
+    return '\n'.join(h), '\n'.join(c)
+
+
+def write_if_changed(path, text):
+    try:
+        with open(path) as f:
+            if f.read() == text:
+                return
+    except FileNotFoundError:
+        pass
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('--profile', action='append', required=True, metavar='NAME=DBC',
+                    help='vehicle profile and its DBC file (repeat; the first is the default)')
+    ap.add_argument('--prefix', required=True, help='C identifier prefix for the tables')
+    ap.add_argument('--struct', required=True, help='decoded-data struct type')
+    ap.add_argument('--struct-header', required=True, help='path of the header declaring the struct')
+    ap.add_argument('--out-c', required=True)
+    ap.add_argument('--out-h', required=True)
+    args = ap.parse_args()
+
+    try:
+        profiles = []
+        for spec in args.profile:
+            name, sep, path = spec.partition('=')
+            if not sep or not re.fullmatch(r'[A-Za-z]\w*', name):
+                raise DbcError(f'bad --profile {spec!r}, expected NAME=path.dbc')
+            if any(p['name'].upper() == name.upper() for p in profiles):
+                raise DbcError(f'profile {name} given twice')
+            messages, attrs = parse_dbc(path)
+            profiles.append({'name': name, 'dbc': path, 'messages': messages, 'attrs': attrs})
+        fields = parse_struct_fields(args.struct_header, args.struct)
+        h, c = generate(profiles, fields, args)
+    except DbcError as e:
+        print(f'dbc_codegen: {e}', file=sys.stderr)
+        return 1
+    write_if_changed(args.out_h, h)
+    write_if_changed(args.out_c, c)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -21,12 +21,42 @@
 // CAN Baudrate (OBD-II standard is 500 kbps)
 #define CAN_BAUDRATE 500000             // 500 kbps
 
-// CAN message queue depth
-#define CAN_RX_QUEUE_SIZE 32            // Number of messages to buffer
+// Diagnostic response IDs (OBD-II / UDS, 11-bit) routed at ingest to the
+// response mailbox read by can_receive_message(); other frames never reach it
+#define CAN_RESPONSE_ID_FIRST 0x7E8
+#define CAN_RESPONSE_ID_LAST 0x7EF
 
-// CAN RX task configuration
+// Response frames buffered for the requester (power of two)
+#define CAN_RESPONSE_MAILBOX_SIZE 16
+
+// Max frames drained from the TWAI RX queue per RX task wakeup (1 = per-frame)
+#define CAN_RX_BATCH_MAX 16
+
+// CAN RX (ingest) task configuration: receives and timestamps frames only
 #define CAN_RX_TASK_STACK_SIZE 4096     // Stack size in bytes
 #define CAN_RX_TASK_PRIORITY 10         // FreeRTOS task priority
+#define CAN_RX_TASK_CORE 0              // Core the ingest task is pinned to
+
+// CAN processing task configuration: sniffer, decoder, SD logger
+#define CAN_PROC_TASK_STACK_SIZE 4096   // Stack size in bytes
+#define CAN_PROC_TASK_PRIORITY 9        // FreeRTOS task priority
+#define CAN_PROC_TASK_CORE 1            // Core the processing task is pinned to
+
+// Frames buffered between the ingest and processing tasks (power of two)
+#define CAN_INGEST_RING_SIZE 128
+
+// ============================================================================
+// Acceptance Filter Configuration
+// ============================================================================
+
+// Decode-only mode: program the TWAI acceptance filter from the decoder ID set
+// (the vehicle profile's IDs, all profiles' with "auto") plus CAN_FILTER_EXTRA_IDS.
+// Frames rejected by the hardware never reach the sniffer or the SD logger.
+#define CAN_FILTER_DECODE_ONLY 0        // 1 = enabled, 0 = accept all IDs
+
+// IDs accepted in addition to the decoder set (OBD-II responses, logging whitelist)
+#define CAN_FILTER_EXTRA_IDS \
+    0x7E8, 0x7E9, 0x7EA, 0x7EB, 0x7EC, 0x7ED, 0x7EE, 0x7EF
 
 // ============================================================================
 // OBD-II Configuration
@@ -35,11 +65,63 @@
 // OBD-II request timeout (milliseconds)
 #define OBD2_REQUEST_TIMEOUT_MS 500     // Wait up to 500ms for response
 
-// Number of priority PIDs to cycle through
-#define OBD2_NUM_PRIORITY_PIDS 10       // Request these PIDs in order
+// Polled PIDs and their target periods (milliseconds)
+// The next request goes to the PIDs whose deadline is earliest; a PID
+// nobody answers is retried at its period doubled per miss.
+#define OBD2_PID_SCHEDULE(X) \
+    X(PID_ENGINE_RPM,             100)    /* 10 Hz */ \
+    X(PID_VEHICLE_SPEED,          100)    \
+    X(PID_THROTTLE_POSITION,      100)    \
+    X(PID_ENGINE_LOAD,            200)    /* 5 Hz */ \
+    X(PID_O2_SENSOR_1_B1,         500)    \
+    X(PID_FUEL_PRESSURE,          1000)   /* 1 Hz */ \
+    X(PID_CONTROL_MODULE_VOLTAGE, 1000)   \
+    X(PID_INTAKE_AIR_TEMP,        2000)   \
+    X(PID_ENGINE_COOLANT_TEMP,    5000)   /* 0.2 Hz */ \
+    X(PID_FUEL_LEVEL,             10000)
+
+// Back-off cap for unanswered PIDs: period << misses, misses <= this
+#define OBD2_BACKOFF_MAX_SHIFT 5        // 32x period at most
+
+// Supported-PID discovery: retry interval while no ECU answers it, and the run
+// of unanswered requests after which the ECUs are probed again (vehicle off or swapped)
+#define OBD2_DISCOVERY_RETRY_MS 5000
+#define OBD2_REDISCOVER_MISSES 10
+
+// PIDs packed into one Mode 01 request (1 = one PID per request, at most 6)
+#define OBD2_PIDS_PER_REQUEST 6
+
+// ISO-TP flow control sent to ECUs answering in several frames: consecutive
+// frames per block (0 = whole message in one block) and separation time
+// (ISO encoding: 0-127 ms, 0xF1-0xF9 = 100-900 us)
+#define ISOTP_BLOCK_SIZE 0
+#define ISOTP_ST_MIN 0
+
+// Stored (03), pending (07) and permanent (0A) DTCs kept from the last read
+#define CAN_MANAGER_MAX_DTCS 64
+
+// ============================================================================
+// UDS Polling Configuration
+// ============================================================================
 
-// Delay between PID requests (milliseconds)
-#define OBD2_REQUEST_DELAY_MS 50        // 50ms between requests = ~20 Hz
+// Read ECU values over UDS ReadDataByIdentifier (DID table in uds_poller.c).
+// Off until the placeholder DIDs and scalings there are confirmed from a
+// diagnostic trace: it sends requests to the ECUs and shows their answers as values
+// (the host tests turn it on from the build)
+#ifndef ENABLE_UDS_POLLING
+#define ENABLE_UDS_POLLING 0            // 1 = enabled, 0 = disabled
+#endif
+
+// DIDs per 0x22 request (3 fit one frame; more, up to 8, need a multi-frame request)
+#define UDS_DIDS_PER_REQUEST 3
+
+// Bus load the poller may add (requests, answers, flow control), in 0.1 % of CAN_BAUDRATE
+#ifndef UDS_BUS_LOAD_PERMILLE
+#define UDS_BUS_LOAD_PERMILLE 20        // 2 %
+#endif
+
+// Unused budget the poller may bank for a burst (milliseconds of budget)
+#define UDS_BURST_MS 200
 
 // ============================================================================
 // CAN Manager Configuration
@@ -52,6 +134,32 @@
 // Statistics logging interval (number of requests)
 #define CAN_MANAGER_STATS_INTERVAL 100      // Log stats every 100 requests
 
+// ============================================================================
+// Decoder Staleness Configuration
+// ============================================================================
+
+// A periodic message is stale once this many nominal cycles pass without it
+#define CAN_STALE_CYCLES 3
+
+// Lower bound on the stale timeout, covers tick granularity and task wakeups
+#define CAN_STALE_MIN_MS 100
+
+// ============================================================================
+// SD Log Summary Configuration
+// ============================================================================
+
+// Decoder channels summarised per minute next to each SD session (.sum, see
+// sd_logger.h): channel, decimals, and mul/add taking the decoder value to the
+// physical value × 10^decimals. Channels are sampled while not stale.
+#define CAN_LOG_SUMMARY_SIGNALS(X) \
+    X(MB_SIG_OIL_TEMP_C,        1, 10,    0) \
+    X(MB_SIG_COOLANT_TEMP_C,    1, 10,    0) \
+    X(MB_SIG_TRANS_OIL_TEMP_C,  1, 10,    0) \
+    X(MB_SIG_AMBIENT_TEMP_RAW,  1,  5, -400)    /* raw × 0.5 - 40 */
+
+// Time between summary samples
+#define CAN_LOG_SUMMARY_SAMPLE_MS 1000
+
 // ============================================================================
 // Vehicle Data Configuration
 // ============================================================================
@@ -83,11 +191,19 @@
 #define ENABLE_ML_INFERENCE 0           // 1 = enabled, 0 = disabled
 
 // ============================================================================
-// Mercedes-Specific Configuration
+// Vehicle Profile Configuration
 // ============================================================================
 
-// Mercedes CLS400 specific settings
-#define MERCEDES_CLS400_2015 1          // Enable Mercedes-specific PIDs
+// Broadcast decode profile at boot: "W218" (CLS400), "W212" (E350), or "auto"
+// to pick the one whose IDs are on the bus (profiles: dbc/, CMakeLists.txt)
+#define CAN_VEHICLE_PROFILE "auto"
+
+// Traffic observed before auto-detection decides (covers a few 100 ms cycles)
+#define CAN_PROFILE_DETECT_MS 1000
+
+// ============================================================================
+// Mercedes-Specific Configuration
+// ============================================================================
 
 // Support manufacturer-specific PIDs
 #define ENABLE_MANUFACTURER_PIDS 1      // 1 = enabled, 0 = disabled
@@ -115,8 +231,40 @@
 #error "CAN_BAUDRATE must be between 100 kbps and 1000 kbps"
 #endif
 
+#if CAN_RX_BATCH_MAX < 1 || CAN_RX_BATCH_MAX > CAN_INGEST_RING_SIZE
+#error "CAN_RX_BATCH_MAX must be between 1 and CAN_INGEST_RING_SIZE"
+#endif
+
+#if (CAN_INGEST_RING_SIZE & (CAN_INGEST_RING_SIZE - 1)) != 0 || (CAN_RESPONSE_MAILBOX_SIZE & (CAN_RESPONSE_MAILBOX_SIZE - 1)) != 0
+#error "CAN_INGEST_RING_SIZE and CAN_RESPONSE_MAILBOX_SIZE must be powers of two"
+#endif
+
+#if CAN_RX_TASK_CORE > 1 || CAN_PROC_TASK_CORE > 1
+#error "CAN_RX_TASK_CORE and CAN_PROC_TASK_CORE must be 0 or 1"
+#endif
+
+#if CAN_PROFILE_DETECT_MS < 300
+#error "CAN_PROFILE_DETECT_MS must cover at least a few 100 ms message cycles"
+#endif
+
+#if CAN_STALE_CYCLES < 1
+#error "CAN_STALE_CYCLES must be at least 1"
+#endif
+
+#if OBD2_PIDS_PER_REQUEST < 1 || OBD2_PIDS_PER_REQUEST > 6
+#error "OBD2_PIDS_PER_REQUEST must be between 1 and 6 (SAE J1979)"
+#endif
+
 #if OBD2_REQUEST_TIMEOUT_MS < 100 || OBD2_REQUEST_TIMEOUT_MS > 5000
 #error "OBD2_REQUEST_TIMEOUT_MS must be between 100ms and 5000ms"
 #endif
 
+#if UDS_DIDS_PER_REQUEST < 1 || UDS_DIDS_PER_REQUEST > 8
+#error "UDS_DIDS_PER_REQUEST must be between 1 and 8"
+#endif
+
+#if UDS_BUS_LOAD_PERMILLE < 1 || UDS_BUS_LOAD_PERMILLE > 200
+#error "UDS_BUS_LOAD_PERMILLE must be between 1 (0.1 %) and 200 (20 %)"
+#endif
+
 #endif // CAN_CONFIG_H
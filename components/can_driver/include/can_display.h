@@ -0,0 +1,99 @@
+#ifndef CAN_DISPLAY_H
+#define CAN_DISPLAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "can_signal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Display model for decoded values
+ *
+ * A descriptor names an integer field of a decoded-data struct and how to show
+ * it. Numbers are kept as scaled integers: the shown value is
+ * (field * mul + add) / div in units of 10^-decimals, so 0.25 rpm/bit with no
+ * decimals is mul 1, div 4 and 0.01 g/bit with two decimals is mul 1, div 1.
+ * field * mul + add must fit in 32 bits (no 64-bit division on the target).
+ * Formatting is plain integer-to-decimal, no printf.
+ */
+
+typedef enum {
+    CAN_DISP_NUMBER,            // scaled fixed-point number + unit
+    CAN_DISP_TEXT,              // field value indexes texts[]
+} can_display_kind_t;
+
+typedef struct {
+    int32_t mul;
+    int32_t add;
+    int32_t div;                // > 0, division truncates toward zero
+    const char *unit;           // NUMBER: appended verbatim (include any leading space)
+    const char *const *texts;   // TEXT: one string per field value, "?" past num_texts
+    uint16_t field_offset;
+    uint8_t field_size;         // 1, 2 or 4 bytes
+    uint8_t flags;              // CAN_SIG_SIGNED
+    uint8_t kind;               // can_display_kind_t
+    uint8_t decimals;           // NUMBER: digits after the point
+    uint8_t num_texts;
+} can_display_t;
+
+// Largest formatted number: sign, 10 digits, point, NUL
+#define CAN_FORMAT_INT_MAX 13
+
+#define CAN_DISPLAY_FIELD_(type, field) \
+    .field_offset = offsetof(type, field), \
+    .field_size = sizeof(((type *)0)->field), \
+    .flags = ((__typeof__(((type *)0)->field))-1 < (__typeof__(((type *)0)->field))1) ? CAN_SIG_SIGNED : 0
+
+/**
+ * Numeric descriptor for type.field
+ */
+#define CAN_DISPLAY_NUM(type, field, m, a, d, dec, u) { \
+    CAN_DISPLAY_FIELD_(type, field), .kind = CAN_DISP_NUMBER, \
+    .mul = (m), .add = (a), .div = (d), .decimals = (dec), .unit = (u) }
+
+/**
+ * Text descriptor for type.field (strs must be an array, not a pointer)
+ */
+#define CAN_DISPLAY_TEXT(type, field, strs) { \
+    CAN_DISPLAY_FIELD_(type, field), .kind = CAN_DISP_TEXT, \
+    .texts = (strs), .num_texts = sizeof(strs) / sizeof((strs)[0]) }
+
+/**
+ * Format a scaled integer as decimal
+ * @param buf Output, at least CAN_FORMAT_INT_MAX bytes
+ * @param value Value in units of 10^-decimals
+ * @param decimals Digits after the point (0..9)
+ * @return Length written, excluding the NUL
+ */
+size_t can_format_int(char *buf, int32_t value, uint8_t decimals);
+
+/**
+ * Format an unsigned integer as decimal
+ * @param buf Output, at least CAN_FORMAT_INT_MAX bytes
+ * @return Length written, excluding the NUL
+ */
+size_t can_format_uint(char *buf, uint32_t value);
+
+/**
+ * Read the descriptor's field (sign-extended if CAN_SIG_SIGNED)
+ */
+int32_t can_display_field(const can_display_t *d, const void *base);
+
+/**
+ * Format the displayed value
+ * @param d Descriptor
+ * @param base Decoded-data struct
+ * @param buf Output buffer
+ * @param size Buffer size; the text is truncated to fit
+ * @return Length written, excluding the NUL
+ */
+size_t can_display_format(const can_display_t *d, const void *base, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAN_DISPLAY_H
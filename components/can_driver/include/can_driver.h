@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -32,7 +33,7 @@ typedef struct {
     uint32_t identifier;
     uint8_t data_length_code;
     uint8_t data[8];
-    uint32_t timestamp;
+    uint32_t timestamp;     // ingest time in µs (esp_timer, wraps every ~71 min)
 } can_message_t;
 
 /**
@@ -55,7 +56,9 @@ esp_err_t can_driver_deinit(void);
 esp_err_t can_send_message(const can_message_t *msg);
 
 /**
- * Receive CAN message (blocking with timeout)
+ * Receive a diagnostic response frame (blocking with timeout)
+ * Only frames from CAN_RESPONSE_ID_FIRST..CAN_RESPONSE_ID_LAST are delivered;
+ * the ingest task routes them here as they arrive and wakes the caller.
  * @param msg Pointer to receive buffer
  * @param timeout_ms Timeout in milliseconds
  * @return ESP_OK on success, ESP_ERR_TIMEOUT if no message received
@@ -63,7 +66,23 @@ esp_err_t can_send_message(const can_message_t *msg);
 esp_err_t can_receive_message(can_message_t *msg, uint32_t timeout_ms);
 
 /**
- * Check if CAN message is available
+ * Borrow received diagnostic response frames in place (zero copy, non-blocking)
+ * Only one task may consume received messages, via either this API or
+ * can_receive_message().
+ * @param msgs Output: first available message
+ * @param max Maximum number of messages wanted
+ * @return Number of contiguous messages at *msgs (0 if none)
+ */
+size_t can_receive_claim(const can_message_t **msgs, size_t max);
+
+/**
+ * Release messages obtained with can_receive_claim()
+ * @param count Number of messages to release
+ */
+void can_receive_release(size_t count);
+
+/**
+ * Check if a diagnostic response frame is available
  * @return true if message available, false otherwise
  */
 bool can_message_available(void);
@@ -84,10 +103,37 @@ typedef struct {
     uint32_t bus_error_count;
     uint32_t arb_lost_count;
     uint32_t msgs_to_rx;
+    uint32_t rx_ring_dropped;     // responses lost because the response mailbox was full
+    uint32_t rx_ring_high_water;  // max response mailbox fill level
+    uint32_t rx_batch_max;        // configured burst size (CAN_RX_BATCH_MAX)
+    uint32_t rx_burst_count;      // RX task wakeups that delivered frames
+    uint32_t rx_burst_frames;     // frames delivered across all bursts
+    uint32_t rx_burst_largest;    // largest burst seen
+    uint32_t rx_burst_full;       // bursts that hit rx_batch_max (more may be pending)
 } can_debug_info_t;
 
 esp_err_t can_driver_get_debug_info(can_debug_info_t *info);
 
+// RX pipeline statistics: ingest stage (can_rx) -> processing stage (can_proc); responses -> mailbox -> requester
+// The busy counters wrap every ~71 minutes: take a stage's load from two reads as
+// (uint32_t)(b.proc_busy_us - a.proc_busy_us) / (b.uptime_us - a.uptime_us)
+typedef struct {
+    uint64_t uptime_us;          // time since can_driver_init()
+    uint32_t ingest_busy_us;     // CPU time spent receiving/timestamping frames (wraps)
+    uint32_t proc_busy_us;       // CPU time spent in sniffer/decoder/logger (wraps)
+    uint32_t ingest_depth;       // frames waiting for the processing stage
+    uint32_t ingest_high_water;  // max ingest ring fill level
+    uint32_t ingest_dropped;     // frames lost because the ingest ring was full
+    uint32_t rx_depth;           // responses waiting for can_receive_message()
+    uint32_t rx_high_water;      // max response mailbox fill level
+    uint32_t rx_dropped;         // responses lost because the response mailbox was full
+    uint32_t rx_routed;          // responses routed to the mailbox at ingest
+    int ingest_core;             // core the ingest task is pinned to
+    int proc_core;               // core the processing task is pinned to
+} can_pipeline_stats_t;
+
+esp_err_t can_driver_get_pipeline_stats(can_pipeline_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
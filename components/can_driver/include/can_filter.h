@@ -0,0 +1,76 @@
+#ifndef CAN_FILTER_H
+#define CAN_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * TWAI acceptance-filter planner (11-bit identifiers)
+ *
+ * Given the set of IDs the firmware actually consumes, computes the single or
+ * dual code/mask pair that accepts all of them while letting through as few
+ * other IDs as possible. Pure functions, no driver dependency.
+ *
+ * Mask convention follows TWAI: a 1 bit is "don't care".
+ */
+
+#define CAN_FILTER_STD_ID_MASK 0x7FF
+
+typedef struct {
+    bool dual;                  // true = two filters (TWAI dual filter mode)
+    uint16_t code[2];           // 11-bit acceptance code per filter
+    uint16_t mask[2];           // 11-bit don't-care mask per filter
+    uint32_t wanted_ids;        // distinct IDs requested
+    uint32_t accepted_ids;      // distinct 11-bit IDs the hardware will pass
+    uint32_t false_accepts;     // accepted_ids - wanted_ids (software filter residue)
+} can_filter_plan_t;
+
+/**
+ * Compute the tightest single or dual filter covering a set of IDs
+ * Duplicate and extended (> 0x7FF) IDs are ignored.
+ * @param ids IDs that must be accepted
+ * @param count Number of IDs
+ * @param plan Output plan
+ * @return true on success, false if no standard ID was given
+ */
+bool can_filter_plan(const uint32_t *ids, size_t count, can_filter_plan_t *plan);
+
+/**
+ * Check whether a plan lets an 11-bit ID through the hardware
+ */
+bool can_filter_accepts(const can_filter_plan_t *plan, uint32_t id);
+
+/**
+ * Count frames of a recorded ID stream that pass the hardware but are not wanted
+ * @param plan Filter plan
+ * @param wanted IDs the firmware consumes
+ * @param wanted_count Number of wanted IDs
+ * @param traffic Recorded frame IDs (one entry per frame)
+ * @param traffic_count Number of recorded frames
+ * @return Number of falsely accepted frames
+ */
+uint32_t can_filter_count_false_accepts(const can_filter_plan_t *plan,
+                                        const uint32_t *wanted, size_t wanted_count,
+                                        const uint32_t *traffic, size_t traffic_count);
+
+/**
+ * Pack a plan into TWAI acceptance code/mask registers (standard frames)
+ * RTR and data-byte bits are left as don't care.
+ * @param plan Filter plan
+ * @param acceptance_code Output register value
+ * @param acceptance_mask Output register value
+ * @param single_filter Output: true for single filter mode
+ */
+void can_filter_to_registers(const can_filter_plan_t *plan, uint32_t *acceptance_code,
+                             uint32_t *acceptance_mask, bool *single_filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAN_FILTER_H
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -10,13 +11,40 @@ extern "C" {
 #endif
 
 typedef struct {
-    uint32_t request_count;
-    uint32_t response_count;
-    uint32_t error_count;
+    uint32_t request_count;     // requests sent (one per batch of PIDs)
+    uint32_t response_count;    // ECU responses decoded
+    uint32_t error_count;       // requests nobody answered
+    uint32_t pid_count;         // PID values decoded
+    uint32_t multi_frame_count; // responses reassembled from several frames
+    float pids_per_second;      // PID values decoded per second over the last stats interval
+    uint32_t response_latency_us; // smoothed request-to-first-answer time
+    uint32_t ecu_mask;          // ECUs found by supported-PID discovery (bit n = 0x7E8 + n)
+    uint32_t discovery_count;   // discovery runs (startup, vehicle changes, retries)
     uint8_t last_response_pid;
     float last_response_value;
 } can_manager_stats_t;
 
+// Most PIDs OBD2_PID_SCHEDULE may list
+#define CAN_MANAGER_MAX_PIDS 32
+
+// Scheduling result for one polled PID (updated every CAN_MANAGER_STATS_INTERVAL requests)
+typedef struct {
+    uint8_t pid;
+    uint8_t backoff;            // consecutive misses, period is scaled by 2^backoff
+    bool supported;             // false if no discovered ECU lists the PID (not polled)
+    float target_hz;            // from the configured period
+    float achieved_hz;          // answers per second over the last stats interval
+    uint32_t requests;
+    uint32_t responses;
+} can_manager_pid_stats_t;
+
+// One DTC from the last read
+typedef struct {
+    uint16_t code;              // SAE J2012 two-byte form, see obd2_format_dtc()
+    uint8_t ecu;                // responding ECU (0 = 0x7E8)
+    uint8_t service;            // OBD2_SERVICE_DTC, _PENDING_DTC or _PERMANENT_DTC
+} can_manager_dtc_t;
+
 esp_err_t can_manager_init(void);
 esp_err_t can_manager_deinit(void);
 esp_err_t can_manager_start(void);
@@ -24,6 +52,30 @@ esp_err_t can_manager_stop(void);
 bool can_manager_is_running(void);
 const can_manager_stats_t* can_manager_get_stats(void);
 
+/**
+ * Achieved vs target rate per scheduled PID
+ * @param out Output array
+ * @param max Capacity of out
+ * @return Number of entries written
+ */
+size_t can_manager_get_pid_stats(can_manager_pid_stats_t *out, size_t max);
+
+/**
+ * Ask the manager task to read stored, pending and permanent DTCs from every
+ * ECU before its next PID request (also done after each discovery)
+ * @return ESP_ERR_NOT_SUPPORTED if ENABLE_DTC_READING is off
+ */
+esp_err_t can_manager_read_dtcs(void);
+
+/**
+ * DTCs from the last completed read
+ * @param out Output array
+ * @param max Capacity of out
+ * @param generation Output (optional): completed reads so far, 0 = none yet
+ * @return Number of entries written
+ */
+size_t can_manager_get_dtcs(can_manager_dtc_t *out, size_t max, uint32_t *generation);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,115 @@
+#ifndef CAN_RING_H
+#define CAN_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "can_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Lock-free single-producer / single-consumer ring of CAN frame slots.
+ *
+ * The producer writes frames directly into ring slots (reserve/commit) and the
+ * consumer reads them in place (peek/release), so a frame is never copied
+ * between the RX path and its reader. Exactly one task may produce and exactly
+ * one task may consume; no locks or critical sections are taken on either side.
+ *
+ * head is only written by the producer, tail only by the consumer. Both are
+ * free-running counters; the slot index is (counter & mask), so the capacity
+ * must be a power of two.
+ */
+typedef struct {
+    can_message_t *slots;
+    uint32_t mask;
+    atomic_uint_fast32_t head;      // next slot the producer will fill
+    atomic_uint_fast32_t tail;      // next slot the consumer will read
+    atomic_uint_fast32_t dropped;   // frames rejected because the ring was full
+    uint32_t high_water;            // max fill level seen by the producer
+} can_ring_t;
+
+/**
+ * Initialize a ring over caller-provided storage
+ * @param ring Ring to initialize
+ * @param storage Slot array (must stay valid for the lifetime of the ring)
+ * @param capacity Number of slots, power of two
+ * @return true on success, false if capacity is not a power of two
+ */
+bool can_ring_init(can_ring_t *ring, can_message_t *storage, uint32_t capacity);
+
+/**
+ * Discard all pending frames and clear statistics (no concurrent access allowed)
+ */
+void can_ring_reset(can_ring_t *ring);
+
+/**
+ * Number of frames currently readable
+ */
+uint32_t can_ring_count(const can_ring_t *ring);
+
+/**
+ * Slot capacity of the ring
+ */
+uint32_t can_ring_capacity(const can_ring_t *ring);
+
+// ---------------------------------------------------------------------------
+// Producer side
+// ---------------------------------------------------------------------------
+
+/**
+ * Claim up to max contiguous free slots for writing
+ * @param ring Ring
+ * @param slots Output: first claimed slot
+ * @param max Maximum number of slots wanted
+ * @return Number of slots claimed (0 if the ring is full)
+ */
+uint32_t can_ring_reserve(can_ring_t *ring, can_message_t **slots, uint32_t max);
+
+/**
+ * Publish n slots previously claimed with can_ring_reserve()
+ */
+void can_ring_commit(can_ring_t *ring, uint32_t n);
+
+/**
+ * Copy one frame into the ring
+ * @return true if queued, false if the ring was full (counted as dropped)
+ */
+bool can_ring_push(can_ring_t *ring, const can_message_t *msg);
+
+/**
+ * Record frames that could not be queued
+ */
+void can_ring_note_dropped(can_ring_t *ring, uint32_t n);
+
+// ---------------------------------------------------------------------------
+// Consumer side
+// ---------------------------------------------------------------------------
+
+/**
+ * Get up to max contiguous readable frames without copying them
+ * @param ring Ring
+ * @param msgs Output: first readable frame (valid until released)
+ * @param max Maximum number of frames wanted
+ * @return Number of frames available at *msgs
+ */
+uint32_t can_ring_peek(can_ring_t *ring, const can_message_t **msgs, uint32_t max);
+
+/**
+ * Return n frames obtained with can_ring_peek() to the producer
+ */
+void can_ring_release(can_ring_t *ring, uint32_t n);
+
+/**
+ * Copy the oldest frame out of the ring
+ * @return true if a frame was read
+ */
+bool can_ring_pop(can_ring_t *ring, can_message_t *msg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAN_RING_H
@@ -0,0 +1,73 @@
+#ifndef CAN_SEQLOCK_H
+#define CAN_SEQLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Single-writer sequence lock for publishing structs from the CAN task.
+ *
+ * The writer bumps the sequence to an odd value, updates the data in place and
+ * bumps it back to even; it never waits. A reader copies the data and retries
+ * if the sequence was odd or changed while it was copying, so it always ends
+ * up with a copy that matches one point between two writes.
+ */
+typedef struct {
+    atomic_uint_fast32_t seq;
+} can_seqlock_t;
+
+// Copy attempts before a reader gives up (writer is rarely mid-update)
+#define CAN_SEQLOCK_READ_TRIES 8
+
+static inline void can_seqlock_write_begin(can_seqlock_t *lock) {
+    uint32_t s = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+    atomic_store_explicit(&lock->seq, s + 1, memory_order_relaxed);
+    // Odd sequence must be visible before any data store
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void can_seqlock_write_end(can_seqlock_t *lock) {
+    uint32_t s = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+    // Release: data stores become visible before the even sequence
+    atomic_store_explicit(&lock->seq, s + 1, memory_order_release);
+}
+
+static inline uint32_t can_seqlock_read_begin(can_seqlock_t *lock) {
+    return atomic_load_explicit(&lock->seq, memory_order_acquire);
+}
+
+/**
+ * @return true if the data read since can_seqlock_read_begin() may be torn
+ */
+static inline bool can_seqlock_read_retry(can_seqlock_t *lock, uint32_t start) {
+    // Data loads must complete before the sequence is re-checked
+    atomic_thread_fence(memory_order_acquire);
+    return (start & 1) || atomic_load_explicit(&lock->seq, memory_order_relaxed) != start;
+}
+
+/**
+ * Copy len bytes guarded by lock into dst
+ * @return true if a consistent copy was taken within CAN_SEQLOCK_READ_TRIES
+ */
+static inline bool can_seqlock_read(can_seqlock_t *lock, void *dst, const void *src, size_t len) {
+    for (int i = 0; i < CAN_SEQLOCK_READ_TRIES; i++) {
+        uint32_t start = can_seqlock_read_begin(lock);
+        if (start & 1) continue;
+        memcpy(dst, src, len);
+        if (!can_seqlock_read_retry(lock, start)) return true;
+    }
+    return false;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAN_SEQLOCK_H
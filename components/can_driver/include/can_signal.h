@@ -0,0 +1,169 @@
+#ifndef CAN_SIGNAL_H
+#define CAN_SIGNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Table-driven CAN signal extraction
+ *
+ * Signal and message tables are generated at build time from DBC files by
+ * dbc/dbc_codegen.py. Every position is precomputed against one 64-bit word
+ * per frame, so extracting a signal is a shift, a mask and an optional sign
+ * extension. The generator also emits one decode function per message: the
+ * same extraction as can_signal_decode() with the table entries as constants,
+ * so the per-frame path has no loop and byte-aligned fields are plain loads.
+ */
+
+#define CAN_SIG_SIGNED  0x01    // two's complement value
+#define CAN_SIG_INTEL   0x02    // little-endian (@1) signal, read from the byte-swapped word
+#define CAN_SIG_FIELD_SIGNED 0x04 // destination field is a signed integer type
+
+// Per-frame extraction parameters (kept to 16 bytes so a message's signals share cache lines)
+typedef struct {
+    uint32_t mask;              // (1 << length) - 1
+    int32_t store_add;          // field = raw * store_mul + store_add
+    int16_t store_mul;
+    uint16_t field_offset;      // destination field in the decoded-data struct
+    uint8_t shift;              // position of the signal's LSB in the frame word
+    uint8_t sext;               // 32 - length for signed signals, 0 otherwise
+    uint8_t flags;              // CAN_SIG_*
+    uint8_t field_size;         // 1, 2 or 4 bytes (must match the table's ordering)
+} can_signal_t;
+
+// Descriptive data, same index as the can_signal_t table
+typedef struct {
+    const char *name;
+    const char *unit;
+    float factor;               // DBC physical scaling: phys = raw * factor + offset
+    float offset;
+    uint8_t length;             // bits, 1..32
+    uint8_t message;            // index of the owning message in the message table
+} can_signal_info_t;
+
+/**
+ * Generated decoder of one message (same result as can_signal_decode())
+ * @param word Frame word from can_signal_load()
+ * @param dest Decoded-data struct
+ * @return Bit i set if signal first_signal + i changed value
+ */
+typedef uint32_t (*can_message_decode_t)(uint64_t word, void *dest);
+
+typedef struct {
+    uint32_t id;
+    uint8_t min_dlc;            // shorter frames are counted but not decoded
+    uint8_t flags;              // CAN_SIG_INTEL if any signal is little-endian
+    uint8_t num_signals;
+    uint8_t num_8;              // signals are ordered 1-byte fields first,
+    uint8_t num_16;             // then 2-byte, then 4-byte
+    uint16_t first_signal;      // index into the signal table
+    uint16_t cycle_ms;          // nominal period (DBC GenMsgCycleTime), 0 = event-driven
+    const char *name;
+    can_message_decode_t decode;
+} can_message_def_t;
+
+// 11-bit identifiers, looked up through a direct index
+#define CAN_PROFILE_ID_SPACE 2048
+
+/**
+ * One vehicle's tables
+ * All profiles generated together share the signal (channel) and message
+ * numbering; only the layouts and IDs differ.
+ */
+typedef struct {
+    const char *name;
+    const can_signal_t *signals;        // per signal; signals this vehicle lacks have mask 0 (store 0)
+    const can_message_def_t *messages;  // per message; messages this vehicle lacks are all zero
+    const uint8_t *message_index;       // 11-bit ID -> message index + 1 (0 = not decoded)
+    uint16_t num_messages;              // messages this vehicle sends
+} can_profile_t;
+
+/**
+ * Message decoded from an ID in a profile (one table load, no search)
+ * @return Message, or NULL if the profile does not decode the ID
+ */
+static inline const can_message_def_t *can_profile_find(const can_profile_t *profile, uint32_t id) {
+    if (id >= CAN_PROFILE_ID_SPACE) return NULL;
+    uint8_t m = profile->message_index[id];
+    return m ? &profile->messages[m - 1] : NULL;
+}
+
+/**
+ * Load a frame payload as one big-endian 64-bit word (data[0] in the top byte)
+ * @param data 8-byte payload buffer (bytes past the DLC are ignored by the tables)
+ */
+static inline uint64_t can_signal_load(const uint8_t *data) {
+    uint64_t v;
+    memcpy(&v, data, sizeof(v));
+    return __builtin_bswap64(v);  // little-endian target
+}
+
+/**
+ * Extract the raw (sign-extended) value of a signal
+ * @param sig Signal
+ * @param be Frame word from can_signal_load()
+ * @param le Byte-swapped frame word (only read for CAN_SIG_INTEL signals)
+ */
+static inline int32_t can_signal_raw(const can_signal_t *sig, uint64_t be, uint64_t le) {
+    uint64_t word = (sig->flags & CAN_SIG_INTEL) ? le : be;
+    uint32_t v = (uint32_t)(word >> sig->shift) & sig->mask;
+    // Shift the sign bit to bit 31 and back; sext is 0 for unsigned signals
+    return (int32_t)(v << sig->sext) >> sig->sext;
+}
+
+/**
+ * Decode every signal of a message into the destination struct from the table
+ * (the generated msg->decode does the same; this is the reference it is tested against)
+ * @return Bit i set if signal first_signal + i changed value (at most 32 signals per message)
+ */
+static inline uint32_t can_signal_decode(const can_message_def_t *msg, const can_signal_t *signals,
+                                         uint64_t word, void *dest) {
+    uint64_t le = (msg->flags & CAN_SIG_INTEL) ? __builtin_bswap64(word) : 0;
+    const can_signal_t *sig = &signals[msg->first_signal];
+    const can_signal_t *end8 = sig + msg->num_8;
+    const can_signal_t *end16 = end8 + msg->num_16;
+    const can_signal_t *end = sig + msg->num_signals;
+    uint8_t *base = (uint8_t *)dest;
+    uint32_t changed = 0;
+    uint32_t bit = 0;
+
+    // One loop per field width keeps the store free of a per-signal branch
+    for (; sig < end8; sig++, bit++) {
+        uint8_t *p = base + sig->field_offset;
+        uint8_t v = (uint8_t)(can_signal_raw(sig, word, le) * sig->store_mul + sig->store_add);
+        changed |= (uint32_t)(*p != v) << bit;
+        *p = v;
+    }
+    for (; sig < end16; sig++, bit++) {
+        uint16_t *p = (uint16_t *)(base + sig->field_offset);
+        uint16_t v = (uint16_t)(can_signal_raw(sig, word, le) * sig->store_mul + sig->store_add);
+        changed |= (uint32_t)(*p != v) << bit;
+        *p = v;
+    }
+    for (; sig < end; sig++, bit++) {
+        uint32_t *p = (uint32_t *)(base + sig->field_offset);
+        uint32_t v = (uint32_t)(can_signal_raw(sig, word, le) * sig->store_mul + sig->store_add);
+        changed |= (uint32_t)(*p != v) << bit;
+        *p = v;
+    }
+    return changed;
+}
+
+/**
+ * Physical value of a signal (for display and logging, not the per-frame path)
+ */
+static inline float can_signal_physical(const can_signal_info_t *info, int32_t raw) {
+    return (float)raw * info->factor + info->offset;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAN_SIGNAL_H
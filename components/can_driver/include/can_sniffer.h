@@ -3,12 +3,42 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define SNIFFER_MAX_IDS 64
+// Dense entry capacity shared by standard and extended IDs
+#define SNIFFER_MAX_IDS 256
+
+// 11-bit IDs are looked up through a direct 2048-entry index
+#define SNIFFER_STD_ID_SPACE 2048
+
+// 29-bit IDs are looked up through a small open-addressing hash (power of two).
+// It is filled to at most 3/4 so a miss (an ID not tracked) ends in a few probes.
+#define SNIFFER_EXT_HASH_SIZE 256
+#define SNIFFER_EXT_MAX_IDS (SNIFFER_EXT_HASH_SIZE * 3 / 4)
+
+// Periods needed before gap detection starts (mean and jitter must settle first;
+// with fewer, an event-driven ID can pass for a periodic one)
+#define SNIFFER_TIMING_WARMUP 16
+
+// A period outside mean * (1 ± 1/2) is off-rate: kept out of mean and variance,
+// and if longer, counted as missed cycles
+#define SNIFFER_GAP_SHIFT 1
+
+// This many off-rate periods in a row mean the ID changed rate: its statistics
+// restart from the new period and the cycles counted missed in the run are taken back
+#define SNIFFER_REBASE_RUN 4
+
+// IDs whose jitter exceeds mean / 2^SNIFFER_APERIODIC_SHIFT are event-driven:
+// every period is folded in and nothing counts as missed
+#define SNIFFER_APERIODIC_SHIFT 2
+
+// Deviations from the mean period count at most this much in the variance
+// (2^27 us, about 134 s): a long pause cannot overflow the squared deviation
+#define SNIFFER_MAX_DEVIATION_US (1u << 27)
 
 typedef struct {
     uint32_t id;
@@ -16,19 +46,101 @@ typedef struct {
     uint8_t last_data[8];
     uint8_t last_dlc;
     uint32_t last_tick;
+
+    // Change statistics for signal reverse-engineering (updated on every frame)
+    uint32_t bit_flips[64];     // toggles per bit, index = byte * 8 + bit (bit 0 = LSB), saturating
+    uint32_t flip_total;        // toggles over all bits
+    uint8_t changed_mask;       // bit n set once byte n has changed
+    uint8_t byte_min[8];
+    uint8_t byte_max[8];
+
+    // Inter-arrival timing from the ingest timestamp (integer only)
+    uint32_t last_us;
+    uint32_t period_min_us;
+    uint32_t period_max_us;
+    uint32_t period_samples;    // periods folded into mean/variance (off-rate ones excluded)
+    int64_t period_mean_q8;     // Welford running mean, us * 256
+    uint64_t period_m2_q8;      // Welford sum of squared deviations, us^2 * 256, saturating
+    uint32_t missed_cycles;     // estimated frames missing from detected gaps
+    uint32_t run_missed;        // of those, counted during the current off-rate run
+    uint8_t off_rate_run;       // consecutive off-rate periods
 } sniffer_entry_t;
 
 typedef struct {
-    sniffer_entry_t entries[SNIFFER_MAX_IDS];
+    uint32_t mean_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t jitter_us;         // standard deviation of the period
+    uint32_t samples;
+    uint32_t missed_cycles;
+} sniffer_timing_t;
+
+typedef struct {
+    uint32_t id;
+    uint8_t bit;                // byte * 8 + bit, as in bit_flips[]
+    uint32_t flips;
+} sniffer_bit_rank_t;
+
+typedef struct {
+    sniffer_entry_t entries[SNIFFER_MAX_IDS];   // densely packed, first-seen order
     int num_ids;
     uint32_t total_msgs;
+    uint32_t untracked_msgs;    // frames whose ID did not fit in the table
+    uint32_t missed_cycles;     // sum of missed_cycles over all entries
 } sniffer_state_t;
 
+// Table-wide counters from sniffer_state_t
+typedef struct {
+    int num_ids;
+    uint32_t total_msgs;
+    uint32_t untracked_msgs;
+    uint32_t missed_cycles;
+} sniffer_summary_t;
+
 void can_sniffer_init(void);
-void can_sniffer_record(uint32_t id, const uint8_t *data, uint8_t dlc);
-const sniffer_state_t *can_sniffer_get_state(void);
+/**
+ * Record one received frame
+ * @param id CAN identifier
+ * @param data Payload
+ * @param dlc Payload length
+ * @param ts_us Ingest timestamp in microseconds (can_message_t.timestamp)
+ */
+void can_sniffer_record(uint32_t id, const uint8_t *data, uint8_t dlc, uint32_t ts_us);
 void can_sniffer_reset(void);
 
+// Live table and entries; only safe to read from the CAN processing task
+const sniffer_state_t *can_sniffer_get_state(void);
+
+// Entry for an ID, or NULL if it has not been seen (constant time)
+const sniffer_entry_t *can_sniffer_find(uint32_t id);
+
+/**
+ * Consistent copy of the table-wide counters, safe from any task (lock-free)
+ * @return false if the sniffer kept updating (out is then untouched)
+ */
+bool can_sniffer_snapshot_summary(sniffer_summary_t *out);
+
+/**
+ * Consistent copy of one ID's entry, safe from any task (lock-free)
+ * @return false if the ID has not been seen or the entry kept updating
+ */
+bool can_sniffer_snapshot_entry(uint32_t id, sniffer_entry_t *out);
+
+/**
+ * Rank the most frequently toggling bits across all IDs
+ * Safe from any task; each entry's counters are read as a consistent snapshot.
+ * @param out Output array, sorted by flips, descending
+ * @param max Capacity of out
+ * @return Number of entries written (bits that never toggled are skipped)
+ */
+size_t can_sniffer_top_bits(sniffer_bit_rank_t *out, size_t max);
+
+/**
+ * Convert an entry's running timing statistics to microseconds
+ * Uses an integer square root; meant for the UI, not the per-frame path.
+ */
+void can_sniffer_get_timing(const sniffer_entry_t *entry, sniffer_timing_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,145 @@
+#ifndef ISOTP_H
+#define ISOTP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * ISO 15765-2 (ISO-TP) transport, classic CAN, normal 11-bit addressing
+ *
+ * A link is one session with one peer: frames go out on tx_id and come in on
+ * rx_id. Links never block and own no memory. Received payload is copied from
+ * each frame straight into the caller's buffer, and a message being sent is
+ * read in place from the caller's buffer. The caller feeds every frame from
+ * rx_id to isotp_on_frame() and calls isotp_poll() to pace consecutive frames
+ * and expire timers. Keep one link per ECU to run sessions concurrently.
+ */
+
+// Protocol control information, high nibble of the first byte
+#define ISOTP_PCI_SINGLE        0x0
+#define ISOTP_PCI_FIRST         0x1
+#define ISOTP_PCI_CONSECUTIVE   0x2
+#define ISOTP_PCI_FLOW_CONTROL  0x3
+
+// Flow status, low nibble of a flow control frame
+#define ISOTP_FC_CONTINUE       0x0
+#define ISOTP_FC_WAIT           0x1
+#define ISOTP_FC_OVERFLOW       0x2
+
+// Longest message with a 12-bit first frame length
+#define ISOTP_MAX_LEN           4095
+
+// N_Bs (flow control after a first frame or block) and N_Cr (next consecutive frame)
+#define ISOTP_N_BS_MS           1000
+#define ISOTP_N_CR_MS           1000
+
+typedef enum {
+    ISOTP_IDLE,
+    ISOTP_RX_BUSY,              // first frame received, consecutive frames pending
+    ISOTP_RX_DONE,              // rx_len bytes in the buffer
+    ISOTP_TX_WAIT_FC,           // waiting for the peer's flow control
+    ISOTP_TX_BUSY,              // sending consecutive frames
+    ISOTP_TX_DONE,
+    ISOTP_ERROR,                // bad sequence, overflow or timeout; restart the direction
+} isotp_state_t;
+
+// What our flow control frames ask of a sending peer
+typedef struct {
+    uint8_t block_size;         // consecutive frames between flow controls, 0 = no limit
+    uint8_t st_min;             // separation time, ISO encoding (0-127 ms, 0xF1-0xF9 = 100-900 us)
+} isotp_config_t;
+
+typedef struct {
+    uint32_t tx_id;
+    uint32_t rx_id;
+    isotp_config_t config;
+    int64_t deadline_us;        // N_Bs / N_Cr expiry of the direction in progress
+
+    // Receive
+    uint8_t *rx_buf;
+    uint16_t rx_size;
+    uint16_t rx_len;            // message length (announced by the first frame)
+    uint16_t rx_received;
+    uint8_t rx_seq;             // expected consecutive frame sequence number
+    uint8_t rx_block;           // consecutive frames since our last flow control
+    uint8_t rx_state;           // isotp_state_t
+    bool rx_multi_frame;        // completed message came in several frames
+
+    // Transmit
+    const uint8_t *tx_buf;
+    uint16_t tx_len;
+    uint16_t tx_sent;
+    uint8_t tx_seq;
+    uint8_t tx_block_left;      // frames left in the peer's block, 0 = no limit
+    uint8_t tx_state;           // isotp_state_t
+    uint32_t tx_st_us;          // peer's separation time
+    int64_t tx_next_us;         // earliest time for the next consecutive frame
+} isotp_link_t;
+
+/**
+ * Set up a link
+ * @param config Flow control parameters for receiving, NULL for no block limit and no gap
+ */
+void isotp_link_init(isotp_link_t *link, uint32_t tx_id, uint32_t rx_id, const isotp_config_t *config);
+
+/**
+ * Arm the receive side with a buffer for the next message
+ * @param buf Caller buffer, written by isotp_on_frame() until the message completes
+ * @param size Buffer size; a longer message is refused with an overflow flow control
+ */
+void isotp_rx_start(isotp_link_t *link, uint8_t *buf, size_t size);
+
+/**
+ * Start sending a message
+ * Up to 7 bytes go out at once as a single frame; longer messages send a
+ * first frame and continue from isotp_on_frame() / isotp_poll().
+ * @param data Message, read in place until tx_state leaves ISOTP_TX_WAIT_FC / ISOTP_TX_BUSY
+ * @return ESP_OK once the first frame is sent, ESP_ERR_INVALID_SIZE past
+ *         ISOTP_MAX_LEN, ESP_ERR_INVALID_STATE while a send is in progress
+ */
+esp_err_t isotp_send(isotp_link_t *link, const uint8_t *data, size_t len, int64_t now_us);
+
+/**
+ * Process one frame received on rx_id
+ * Sends our flow control frames and, on a peer's flow control, the next
+ * consecutive frames that are due.
+ * @return ESP_OK when a received message completed (rx_len bytes in the buffer),
+ *         ESP_ERR_NOT_FINISHED while a transfer is in progress,
+ *         ESP_ERR_INVALID_SIZE if the message does not fit (or the peer refused ours),
+ *         ESP_ERR_INVALID_RESPONSE for a malformed or unexpected frame
+ */
+esp_err_t isotp_on_frame(isotp_link_t *link, const uint8_t *data, uint8_t dlc, int64_t now_us);
+
+/**
+ * Send consecutive frames that are due and expire timers
+ * @return ESP_ERR_TIMEOUT if N_Bs or N_Cr ran out (that direction is now
+ *         ISOTP_ERROR), the CAN error if a frame could not be sent, else ESP_OK
+ */
+esp_err_t isotp_poll(isotp_link_t *link, int64_t now_us);
+
+/**
+ * Drop any transfer in progress in both directions (the caller gave up on the exchange)
+ */
+void isotp_abort(isotp_link_t *link);
+
+/**
+ * When the link next needs isotp_poll() (INT64_MAX if nothing is pending)
+ */
+int64_t isotp_next_poll_us(const isotp_link_t *link);
+
+/**
+ * Separation time in microseconds from its ISO encoding (reserved values mean 127 ms)
+ */
+uint32_t isotp_st_min_us(uint8_t st_min);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ISOTP_H
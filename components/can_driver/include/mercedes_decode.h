@@ -2,7 +2,13 @@
 #define MERCEDES_DECODE_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include "vehicle_data.h"
+#include "mb_signals.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -123,7 +129,7 @@ typedef struct {
     // === From CAN C Bus (Xentry DAT verified) ===
     // From ENGINE_MAIN (0x0308)
     uint16_t nmot_rpm_raw;      // raw 16-bit, multiply by 0.25 for RPM
-    int8_t oil_temp_c;          // byte5 - 40
+    int16_t oil_temp_c;         // byte5 - 40 (-40..215, wider than int8_t)
     uint8_t oil_level;          // byte6
     uint8_t oil_quality;        // byte7
     uint8_t oil_overheat;       // UEHITZ
@@ -132,12 +138,12 @@ typedef struct {
     uint8_t mil_lamp;           // DIAG_KL (check engine)
 
     // From COOLANT_TEMP (0x0608)
-    int8_t coolant_temp_c;      // byte0 - 40
+    int16_t coolant_temp_c;     // byte0 - 40
 
     // From TRANS_STATUS (0x0418)
     uint8_t gear_fsc;           // FSC: 0=P,1=R,2=N,3=D,4-7=manual
     uint8_t drive_program;      // FPC: driving program C/S/M
-    int8_t trans_oil_temp_c;    // byte2 - 40
+    int16_t trans_oil_temp_c;   // byte2 - 40
 
     // From TRANS_SPEEDS (0x0338)
     uint16_t trans_output_raw;  // NAB: ×0.25 RPM
@@ -182,15 +188,219 @@ typedef struct {
     uint8_t style_lateral;      // FTK_LMI
     uint8_t style_braking;      // FTK_VMI
 
+    // === Derived channels (MB_CH_*), computed by the decoder ===
+    uint16_t speed_kmh_x100;        // mean of the four RDU wheel speeds, 0.01 km/h
+    uint16_t fuel_l100km_x10;       // instantaneous, 0.1 L/100 km (0 below 3 km/h)
+    int16_t wheel_slip_pm;          // rear axle vs front axle speed, 0.1 %
+    int16_t converter_slip_pm;      // engine vs turbine speed, 0.1 % (0 below 400 rpm)
+    uint16_t gear_ratio_x1000;      // turbine / transmission output speed (0 = unknown)
+    uint32_t trip_distance_m;
+    uint32_t trip_fuel_ml;
+    uint32_t trip_time_s;           // time with RDU wheel speeds on the bus
+    uint16_t trip_avg_l100km_x10;   // 0.1 L/100 km (0 below 100 m)
+    uint16_t trip_avg_speed_x10;    // 0.1 km/h
+
+    // === UDS channels (MB_CH_*), read from ECUs by uds_poller ===
+    // (first UDS field stays first: a profile switch clears everything before it)
+    uint16_t boost_pressure_hpa;    // charge air pressure, absolute
+    uint16_t boost_target_hpa;
+    uint16_t injection_qty_x100;    // 0.01 mg/stroke
+    uint8_t airmatic_valves;        // valve block outputs, bit 0-3 = FL/FR/RL/RR, bit 4 = vent
+    uint8_t airmatic_compressor;    // 0 = off, 1 = running
+
     // Stats
     uint32_t decode_count;
     uint32_t last_decode_tick;
 } mercedes_data_t;
 
+/**
+ * Decoder channels: every DBC signal (MB_SIG_*) followed by values the decoder
+ * derives from several signals, then values read over UDS rather than
+ * broadcast (from MB_CH_UDS_FIRST). Dirty bits, watches, staleness and
+ * mercedes_decode_get_signal() use these numbers.
+ */
+enum {
+    MB_CH_VEHICLE_SPEED_KMH = MB_SIG_COUNT,  // average of the four WHEEL_SPEEDS signals
+    MB_CH_SPEED_KMH_X100,
+    MB_CH_FUEL_L100KM_X10,
+    MB_CH_WHEEL_SLIP_PM,
+    MB_CH_CONVERTER_SLIP_PM,
+    MB_CH_GEAR_RATIO_X1000,
+    MB_CH_TRIP_DISTANCE_M,
+    MB_CH_TRIP_FUEL_ML,
+    MB_CH_TRIP_TIME_S,
+    MB_CH_TRIP_AVG_L100KM_X10,
+    MB_CH_TRIP_AVG_SPEED_X10,
+    MB_CH_UDS_FIRST,
+    MB_CH_BOOST_PRESSURE_HPA = MB_CH_UDS_FIRST,
+    MB_CH_BOOST_TARGET_HPA,
+    MB_CH_INJECTION_QTY_X100,
+    MB_CH_AIRMATIC_VALVES,
+    MB_CH_AIRMATIC_COMPRESSOR,
+    MB_CH_COUNT
+};
+
+#define MB_DIRTY_WORDS ((MB_CH_COUNT + 31) / 32)
+
+#define MB_DIRTY_TEST(words, ch) (((words)[(ch) / 32] >> ((ch) % 32)) & 1u)
+
+// Stale bitmap words, one bit per message (MB_MSG_*)
+#define MB_STALE_WORDS ((MB_MSG_COUNT + 31) / 32)
+
+// Called from the CAN processing task for every watched channel that changed; keep it short
+typedef void (*mercedes_watch_cb_t)(uint16_t channel, void *arg);
+
 void mercedes_decode_init(void);
-void mercedes_decode_message(uint32_t id, const uint8_t *data, uint8_t dlc);
+
+/**
+ * Decode one frame with the active vehicle profile's tables (generated from
+ * dbc/mercedes_*.dbc), then recompute the derived channels whose inputs changed
+ * The ID is looked up in the profile's direct 2048-entry index.
+ * @param id CAN identifier
+ * @param data 8-byte payload buffer (as in can_message_t)
+ * @param dlc Payload length
+ * @param ts_us Arrival time in microseconds (can_message_t.timestamp), clocks the trip integrators
+ */
+void mercedes_decode_message(uint32_t id, const uint8_t *data, uint8_t dlc, uint32_t ts_us);
+
+// Live decoder state; only safe to read from the CAN processing task
 const mercedes_data_t *mercedes_decode_get_data(void);
 
+/**
+ * Take a consistent copy of the decoded data from any task (lock-free, never
+ * blocks the CAN task)
+ * @param out Destination
+ * @return true on success, false if the decoder kept updating (out is then untouched)
+ */
+bool mercedes_decode_snapshot(mercedes_data_t *out);
+
+/**
+ * Fetch and clear the channels whose value changed since the last call
+ * Bits are only set when a decoded value differs from the previous one; a
+ * repeated frame with the same content sets nothing.
+ * @param out MB_DIRTY_WORDS words, bit (ch % 32) of word (ch / 32) per channel
+ */
+void mercedes_decode_fetch_dirty(uint32_t *out);
+
+/**
+ * Get told as soon as one of the given channels changes
+ * Replaces any previous watch. Call before the CAN driver starts.
+ * @param channels Channels to watch (MB_SIG_* / MB_CH_*)
+ * @param count Number of channels
+ * @param task Task to wake with xTaskNotifyGive() once per frame with a watched change, or NULL
+ * @param cb Callback per changed watched channel (runs in the CAN task), or NULL
+ * @param arg Passed to cb
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for an unknown channel
+ */
+esp_err_t mercedes_decode_watch(const uint16_t *channels, size_t count, TaskHandle_t task,
+                                mercedes_watch_cb_t cb, void *arg);
+
+/**
+ * Check whether the message carrying a channel has gone quiet
+ * O(1), safe from any task. A message is stale until first received and again
+ * once it misses CAN_STALE_CYCLES nominal periods; event-driven messages
+ * (period 0) never go stale after the first frame. A UDS channel follows the
+ * same rule with its polling period.
+ * @param channel MB_SIG_* / MB_CH_*
+ */
+bool mercedes_decode_is_stale(uint16_t channel);
+
+/**
+ * Copy the stale-message bitmap (bit m of word m / 32 per MB_MSG_* index)
+ * @param out MB_STALE_WORDS words
+ * @return Number of stale messages
+ */
+uint32_t mercedes_decode_get_stale(uint32_t *out);
+
+/**
+ * Milliseconds since the message carrying a channel was last received (or a UDS value applied)
+ * @return Age in ms, or UINT32_MAX if it was never received
+ */
+uint32_t mercedes_decode_age_ms(uint16_t channel);
+
+/**
+ * Override the expected period of a message (defaults come from the DBC)
+ * Takes effect from the next received frame.
+ * @param id CAN ID
+ * @param period_ms Nominal period, 0 = event-driven
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if the ID is not decoded
+ */
+esp_err_t mercedes_decode_set_period(uint32_t id, uint16_t period_ms);
+
+/**
+ * Expire messages whose deadline has passed (CAN processing task only)
+ * Advances a timing wheel, so the cost is the elapsed ticks plus the messages
+ * due in them, not the number of messages.
+ */
+void mercedes_decode_check_stale(void);
+
+/**
+ * Hand a UDS channel value to the decoder from any task
+ * The latest value per channel is kept until the CAN processing task applies
+ * it with mercedes_decode_apply_posted(), so the store keeps a single writer.
+ * @param channel MB_CH_UDS_FIRST .. MB_CH_COUNT - 1
+ * @param value Field value (clamped to the field's type)
+ * @param period_ms Polling period, for staleness (CAN_STALE_CYCLES periods)
+ * @return ESP_ERR_INVALID_ARG if the channel is not a UDS channel
+ */
+esp_err_t mercedes_decode_post(uint16_t channel, int32_t value, uint16_t period_ms);
+
+/**
+ * Store posted UDS values and publish the changes (CAN processing task only)
+ */
+void mercedes_decode_apply_posted(void);
+
+/**
+ * Read a decoded or derived channel from a decoder snapshot
+ * Returns the integer stored in the channel's mercedes_data_t field.
+ * @param data Snapshot from mercedes_decode_snapshot()
+ * @param channel MB_SIG_* / MB_CH_*
+ * @param value Output
+ * @return false for an unknown channel
+ */
+bool mercedes_decode_get_signal(const mercedes_data_t *data, uint16_t channel, int32_t *value);
+
+// Name of a channel (DBC signal name, or derived / UDS channel name), NULL if unknown
+const char *mercedes_decode_channel_name(uint16_t channel);
+
+// Index (MB_MSG_*) of the message a channel is decoded from, -1 if unknown or read over UDS
+int mercedes_decode_channel_message(uint16_t channel);
+
+// Zero the trip integrators; applied by the CAN task on its next frame
+void mercedes_decode_trip_reset(void);
+
+/**
+ * Choose the vehicle profile applied by the next mercedes_decode_init()
+ * Defaults to CAN_VEHICLE_PROFILE. Call before the CAN driver starts.
+ * @param name Profile name (MB_PROFILE_*, e.g. "W218"), or "auto" to detect it
+ *             from the IDs on the bus
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND for an unknown name
+ */
+esp_err_t mercedes_decode_select_profile(const char *name);
+
+/**
+ * Active vehicle profile (name, message count)
+ * @param detecting Set while auto-detection has not decided yet (the first
+ *                  profile decodes meanwhile); may be NULL
+ */
+const can_profile_t *mercedes_decode_get_profile(bool *detecting);
+
+/**
+ * Settle auto-detection once CAN_PROFILE_DETECT_MS of traffic has been seen
+ * (CAN processing task only, after the sniffer has recorded the frames)
+ * Each profile scores its IDs present in the sniffer minus those absent; the
+ * best positive, unambiguous score wins. Switching clears the decoded data.
+ * Returns at once when the profile is fixed or already detected.
+ */
+void mercedes_decode_detect_profile(void);
+
+/**
+ * Copy the CAN IDs the active profile decodes into ids (up to max), ascending
+ * While detection is pending this is every profile's IDs, each once.
+ * @return Total count
+ */
+size_t mercedes_decode_get_ids(uint32_t *ids, size_t max);
+
 #ifdef __cplusplus
 }
 #endif
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -20,6 +21,8 @@ extern "C" {
 #define OBD2_SERVICE_DTC                0x03
 #define OBD2_SERVICE_CLEAR_DTC          0x04
 #define OBD2_SERVICE_O2_SENSOR_DATA     0x05
+#define OBD2_SERVICE_PENDING_DTC        0x07
+#define OBD2_SERVICE_PERMANENT_DTC      0x0A
 #define OBD2_SERVICE_SUPPORTED_PIDS     0x00
 
 // Standard OBD-II PIDs (Mode 01)
@@ -103,6 +106,24 @@ extern "C" {
 // CAN IDs for OBD-II communication
 #define OBD2_REQUEST_CAN_ID             0x7DF  // Broadcast request
 #define OBD2_RESPONSE_CAN_ID_BASE       0x7E8  // Response from ECU (0x7E8 - 0x7EF)
+#define OBD2_PHYSICAL_ID_OFFSET         8      // ECU request ID = response ID - 8 (0x7E0 - 0x7E7)
+#define OBD2_NUM_ECUS                   8
+
+// SAE J1979 P2CAN: longest an ECU may take to answer a request
+#define OBD2_P2_MAX_MS                  50
+
+// SAE J1979: at most six PIDs in one Mode 01 request on CAN
+#define OBD2_MAX_PIDS_PER_REQUEST       6
+
+// Largest Mode 01 response (0x41 + six PIDs of up to 4 data bytes, with margin)
+#define OBD2_MAX_RESPONSE_LEN           64
+
+// Largest Mode 03/07/0A response read (0x43, DTC count, two bytes per DTC)
+#define OBD2_MAX_DTC_RESPONSE_LEN       256
+
+// Mode 01 support PIDs 0x00, 0x20, ... 0xE0, each answering a bitmap of the next 32 PIDs
+#define OBD2_SUPPORT_RANGE              0x20
+#define OBD2_NUM_SUPPORT_RANGES         8
 
 // PID Data structure
 typedef struct {
@@ -113,6 +134,17 @@ typedef struct {
     float (*decode_func)(const uint8_t *data);
 } obd2_pid_t;
 
+// One decoded PID from a (multi-PID) response
+typedef struct {
+    uint8_t pid;
+    float value;
+} obd2_pid_value_t;
+
+// Mode 01 PIDs one ECU supports (bit p of word p / 32 = PID p)
+typedef struct {
+    uint32_t bits[256 / 32];
+} obd2_supported_t;
+
 /**
  * Initialize OBD-II PID library
  * @return ESP_OK on success
@@ -126,6 +158,44 @@ esp_err_t obd2_init(void);
  */
 esp_err_t obd2_request_pid(uint8_t pid);
 
+/**
+ * Send a functional (broadcast) request: the service byte followed by its parameters
+ * @param service OBD-II service (mode)
+ * @param params Parameter bytes (PIDs), may be NULL when count is 0
+ * @param count Number of parameter bytes (0..6, the request must fit one frame)
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a bad count
+ */
+esp_err_t obd2_request_service(uint8_t service, const uint8_t *params, size_t count);
+
+/**
+ * Decode every PID of a reassembled Mode 01 response
+ * Parsing stops at the first PID not in the database (its length is unknown).
+ * @param msg Response starting at the 0x41 byte (the reassembled ISO-TP message)
+ * @param len Response length
+ * @param out Decoded values
+ * @param max Capacity of out
+ * @return Number of values written
+ */
+size_t obd2_parse_multi_response(const uint8_t *msg, size_t len, obd2_pid_value_t *out, size_t max);
+
+/**
+ * Record the support bitmaps of a reassembled Mode 01 response to support PIDs
+ * Bit 7 of the first data byte after support PID n is PID n + 1, so PID
+ * n + 0x20 being set means the ECU answers the next range too.
+ * @param msg Response starting at the 0x41 byte (the reassembled ISO-TP message)
+ * @param len Response length
+ * @param supported Updated with every bitmap in the response
+ * @return Number of support PIDs parsed (parsing stops at any other PID)
+ */
+size_t obd2_parse_supported_pids(const uint8_t *msg, size_t len, obd2_supported_t *supported);
+
+/**
+ * Whether a support bitmap lists a PID (PID 0x00 is always supported)
+ */
+static inline bool obd2_pid_supported(const obd2_supported_t *supported, uint8_t pid) {
+    return pid == PID_SUPPORTED_PIDS_01_20 || (supported->bits[pid / 32] >> (pid % 32)) & 1u;
+}
+
 /**
  * Parse OBD-II response
  * @param data CAN data (8 bytes)
@@ -182,6 +252,24 @@ esp_err_t obd2_clear_dtc(void);
  */
 esp_err_t obd2_read_dtc(void);
 
+/**
+ * Decode the DTCs of a reassembled Mode 03/07/0A response
+ * On CAN the response is the service byte + 0x40, a DTC count and two bytes
+ * per DTC; 0x0000 entries are padding.
+ * @param msg Response starting at the service byte (0x43, 0x47 or 0x4A)
+ * @param len Response length
+ * @param codes Output: two-byte DTCs as sent (see obd2_format_dtc())
+ * @param max Capacity of codes
+ * @return Number of DTCs written
+ */
+size_t obd2_parse_dtcs(const uint8_t *msg, size_t len, uint16_t *codes, size_t max);
+
+/**
+ * Format a two-byte DTC as its SAE J2012 code, e.g. 0x0133 -> "P0133"
+ * @param buf Output, at least 6 bytes
+ */
+void obd2_format_dtc(uint16_t code, char *buf);
+
 #ifdef __cplusplus
 }
 #endif
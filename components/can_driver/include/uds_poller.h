@@ -0,0 +1,91 @@
+#ifndef UDS_POLLER_H
+#define UDS_POLLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * UDS ReadDataByIdentifier (0x22) polling
+ *
+ * Values the broadcast frames do not carry (boost, injection, AIRMATIC valves)
+ * are read from ECUs by data identifier. DIDs due on the same ECU share one
+ * 0x22 request; each positive answer is decoded through the DID table in
+ * uds_poller.c and posted to the decoder's MB_CH_* UDS channels. A token
+ * bucket keeps the poller's frames within UDS_BUS_LOAD_PERMILLE of the bus.
+ *
+ * The poller only builds requests and decodes answers. The CAN manager task
+ * sends each request on the ECU's ISO-TP link and hands back the answer, so
+ * the poller never blocks and runs on the host as is.
+ */
+
+// Service and negative response codes the poller uses
+#define UDS_SERVICE_READ_DID            0x22
+#define UDS_POSITIVE_RESPONSE(service)  ((service) + 0x40)
+#define UDS_NEGATIVE_RESPONSE           0x7F
+#define UDS_NRC_INCORRECT_LENGTH        0x13
+#define UDS_NRC_RESPONSE_TOO_LONG       0x14
+#define UDS_NRC_REQUEST_OUT_OF_RANGE    0x31
+#define UDS_NRC_RESPONSE_PENDING        0x78
+
+// ISO 14229-2 default server timing: P2 to start answering, P2* after response pending
+#define UDS_P2_MS                       50
+#define UDS_P2_EXT_MS                   5000
+
+// Request and answer size limits
+#define UDS_MAX_DIDS_PER_REQUEST        8
+#define UDS_MAX_REQUEST_LEN             (1 + 2 * UDS_MAX_DIDS_PER_REQUEST)
+#define UDS_MAX_RESPONSE_LEN            64
+
+// Bits on the wire per padded 8-byte frame, worst-case stuffing and interframe space
+#define UDS_FRAME_BITS                  135
+
+typedef struct {
+    uint32_t requests;
+    uint32_t responses;         // positive answers
+    uint32_t negative;          // negative answers (response pending not counted)
+    uint32_t timeouts;          // requests nobody answered
+    uint32_t values;            // values posted to the decoder
+    uint32_t unsupported;       // DIDs dropped after requestOutOfRange
+    uint32_t throttled;         // times a due request waited for bus budget
+    uint32_t response_latency_us; // smoothed request-to-answer time
+    float bus_load_pct;         // poller frames as % of CAN_BAUDRATE since the last reset
+} uds_poller_stats_t;
+
+/**
+ * Make every DID due now and forget unsupported DIDs and batch limits
+ * (startup and vehicle changes)
+ */
+void uds_poller_reset(int64_t now_us);
+
+/**
+ * Build the next request if a DID is due and the bus budget allows it
+ * @param ecu Output: ECU to send to (0 = 0x7E0, answering on 0x7E8)
+ * @param req Output: request, UDS_MAX_REQUEST_LEN bytes
+ * @param wait_us Output when nothing is sent: time until a request may be
+ * @return Request length, 0 if nothing is to be sent yet
+ */
+size_t uds_poller_next(int64_t now_us, uint32_t *ecu, uint8_t *req, int64_t *wait_us);
+
+/**
+ * Hand back the answer to the last request from uds_poller_next()
+ * @param msg Reassembled answer, or NULL if none came in time
+ * @param len Answer length
+ */
+void uds_poller_response(int64_t now_us, const uint8_t *msg, size_t len);
+
+// Frames an ISO-TP message of len bytes puts on the bus, flow control included
+uint32_t uds_poller_frames(size_t len);
+
+const uds_poller_stats_t *uds_poller_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UDS_POLLER_H
@@ -0,0 +1,233 @@
+#include "isotp.h"
+#include "can_driver.h"
+#include <string.h>
+
+static esp_err_t send_frame(const isotp_link_t *link, const uint8_t *data, size_t len) {
+    can_message_t msg = {
+        .identifier = link->tx_id,
+        .data_length_code = 8,      // padded to a full frame, as ISO 15765-4 requires
+    };
+    memcpy(msg.data, data, len);
+    return can_send_message(&msg);
+}
+
+static esp_err_t send_flow_control(const isotp_link_t *link, uint8_t status) {
+    uint8_t fc[3] = {(ISOTP_PCI_FLOW_CONTROL << 4) | status, link->config.block_size, link->config.st_min};
+    return send_frame(link, fc, sizeof(fc));
+}
+
+uint32_t isotp_st_min_us(uint8_t st_min) {
+    if (st_min <= 0x7F) return st_min * 1000u;
+    if (st_min >= 0xF1 && st_min <= 0xF9) return (st_min - 0xF0) * 100u;
+    return 127000;
+}
+
+void isotp_link_init(isotp_link_t *link, uint32_t tx_id, uint32_t rx_id, const isotp_config_t *config) {
+    memset(link, 0, sizeof(*link));
+    link->tx_id = tx_id;
+    link->rx_id = rx_id;
+    if (config != NULL) {
+        link->config = *config;
+    }
+}
+
+void isotp_rx_start(isotp_link_t *link, uint8_t *buf, size_t size) {
+    link->rx_buf = buf;
+    link->rx_size = size > ISOTP_MAX_LEN ? ISOTP_MAX_LEN : (uint16_t)size;
+    link->rx_len = 0;
+    link->rx_received = 0;
+    link->rx_multi_frame = false;
+    link->rx_state = ISOTP_IDLE;
+}
+
+esp_err_t isotp_send(isotp_link_t *link, const uint8_t *data, size_t len, int64_t now_us) {
+    if (link->tx_state == ISOTP_TX_WAIT_FC || link->tx_state == ISOTP_TX_BUSY) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len == 0 || len > ISOTP_MAX_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t frame[8];
+    if (len <= 7) {
+        frame[0] = (ISOTP_PCI_SINGLE << 4) | (uint8_t)len;
+        memcpy(&frame[1], data, len);
+        esp_err_t ret = send_frame(link, frame, len + 1);
+        link->tx_state = ret == ESP_OK ? ISOTP_TX_DONE : ISOTP_ERROR;
+        return ret;
+    }
+
+    frame[0] = (ISOTP_PCI_FIRST << 4) | (uint8_t)(len >> 8);
+    frame[1] = (uint8_t)len;
+    memcpy(&frame[2], data, 6);
+    esp_err_t ret = send_frame(link, frame, 8);
+    if (ret != ESP_OK) {
+        link->tx_state = ISOTP_ERROR;
+        return ret;
+    }
+    link->tx_buf = data;
+    link->tx_len = (uint16_t)len;
+    link->tx_sent = 6;
+    link->tx_seq = 1;
+    link->tx_state = ISOTP_TX_WAIT_FC;
+    link->deadline_us = now_us + ISOTP_N_BS_MS * 1000LL;
+    return ESP_OK;
+}
+
+// Consecutive frame: sequence number in the low nibble, up to 7 bytes
+static esp_err_t rx_consecutive(isotp_link_t *link, const uint8_t *data, uint8_t dlc, int64_t now_us) {
+    if (link->rx_state != ISOTP_RX_BUSY) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if ((data[0] & 0x0F) != link->rx_seq) {
+        link->rx_state = ISOTP_ERROR;
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    uint16_t n = link->rx_len - link->rx_received;
+    if (n > 7) n = 7;
+    if (n + 1 > dlc) {
+        link->rx_state = ISOTP_ERROR;
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    memcpy(&link->rx_buf[link->rx_received], &data[1], n);
+    link->rx_received += n;
+    link->rx_seq = (link->rx_seq + 1) & 0x0F;
+
+    if (link->rx_received == link->rx_len) {
+        link->rx_state = ISOTP_RX_DONE;
+        link->rx_multi_frame = true;
+        return ESP_OK;
+    }
+    link->deadline_us = now_us + ISOTP_N_CR_MS * 1000LL;
+    if (link->config.block_size != 0 && ++link->rx_block == link->config.block_size) {
+        link->rx_block = 0;
+        send_flow_control(link, ISOTP_FC_CONTINUE);
+    }
+    return ESP_ERR_NOT_FINISHED;
+}
+
+// Peer's flow control for the message we are sending
+static esp_err_t rx_flow_control(isotp_link_t *link, const uint8_t *data, uint8_t dlc, int64_t now_us) {
+    if (link->tx_state != ISOTP_TX_WAIT_FC || dlc < 3) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    switch (data[0] & 0x0F) {
+        case ISOTP_FC_CONTINUE:
+            link->tx_block_left = data[1];
+            link->tx_st_us = isotp_st_min_us(data[2]);
+            link->tx_state = ISOTP_TX_BUSY;
+            link->tx_next_us = now_us;
+            isotp_poll(link, now_us);
+            return ESP_ERR_NOT_FINISHED;
+        case ISOTP_FC_WAIT:
+            link->deadline_us = now_us + ISOTP_N_BS_MS * 1000LL;
+            return ESP_ERR_NOT_FINISHED;
+        case ISOTP_FC_OVERFLOW:
+            link->tx_state = ISOTP_ERROR;
+            return ESP_ERR_INVALID_SIZE;
+        default:
+            link->tx_state = ISOTP_ERROR;
+            return ESP_ERR_INVALID_RESPONSE;
+    }
+}
+
+esp_err_t isotp_on_frame(isotp_link_t *link, const uint8_t *data, uint8_t dlc, int64_t now_us) {
+    if (dlc < 1) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    switch (data[0] >> 4) {
+        case ISOTP_PCI_SINGLE: {  // length in the low nibble
+            uint8_t len = data[0] & 0x0F;
+            if (len == 0 || len > 7 || len + 1 > dlc || link->rx_buf == NULL) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            if (len > link->rx_size) {
+                link->rx_state = ISOTP_ERROR;
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(link->rx_buf, &data[1], len);
+            link->rx_len = len;
+            link->rx_received = len;
+            link->rx_multi_frame = false;
+            link->rx_state = ISOTP_RX_DONE;
+            return ESP_OK;
+        }
+        case ISOTP_PCI_FIRST: {  // 12-bit length, first 6 bytes
+            uint16_t len = (uint16_t)(((data[0] & 0x0F) << 8) | data[1]);
+            if (dlc < 8 || len < 8 || link->rx_buf == NULL) {
+                link->rx_state = ISOTP_ERROR;
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            if (len > link->rx_size) {
+                link->rx_state = ISOTP_ERROR;
+                send_flow_control(link, ISOTP_FC_OVERFLOW);
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(link->rx_buf, &data[2], 6);
+            link->rx_len = len;
+            link->rx_received = 6;
+            link->rx_seq = 1;
+            link->rx_block = 0;
+            link->rx_state = ISOTP_RX_BUSY;
+            link->deadline_us = now_us + ISOTP_N_CR_MS * 1000LL;
+            send_flow_control(link, ISOTP_FC_CONTINUE);
+            return ESP_ERR_NOT_FINISHED;
+        }
+        case ISOTP_PCI_CONSECUTIVE:
+            return rx_consecutive(link, data, dlc, now_us);
+        case ISOTP_PCI_FLOW_CONTROL:
+            return rx_flow_control(link, data, dlc, now_us);
+        default:
+            return ESP_ERR_INVALID_RESPONSE;
+    }
+}
+
+esp_err_t isotp_poll(isotp_link_t *link, int64_t now_us) {
+    if ((link->tx_state == ISOTP_TX_WAIT_FC || link->rx_state == ISOTP_RX_BUSY) &&
+        now_us >= link->deadline_us) {
+        if (link->tx_state == ISOTP_TX_WAIT_FC) link->tx_state = ISOTP_ERROR;
+        if (link->rx_state == ISOTP_RX_BUSY) link->rx_state = ISOTP_ERROR;
+        return ESP_ERR_TIMEOUT;
+    }
+
+    while (link->tx_state == ISOTP_TX_BUSY && now_us >= link->tx_next_us) {
+        uint8_t frame[8];
+        uint16_t n = link->tx_len - link->tx_sent;
+        if (n > 7) n = 7;
+        frame[0] = (ISOTP_PCI_CONSECUTIVE << 4) | link->tx_seq;
+        memcpy(&frame[1], &link->tx_buf[link->tx_sent], n);
+        esp_err_t ret = send_frame(link, frame, n + 1);
+        if (ret != ESP_OK) {
+            return ret;  // retried on the next poll
+        }
+        link->tx_sent += n;
+        link->tx_seq = (link->tx_seq + 1) & 0x0F;
+
+        if (link->tx_sent == link->tx_len) {
+            link->tx_state = ISOTP_TX_DONE;
+        } else if (link->tx_block_left != 0 && --link->tx_block_left == 0) {
+            link->tx_state = ISOTP_TX_WAIT_FC;
+            link->deadline_us = now_us + ISOTP_N_BS_MS * 1000LL;
+        } else {
+            link->tx_next_us = now_us + link->tx_st_us;
+        }
+    }
+    return ESP_OK;
+}
+
+void isotp_abort(isotp_link_t *link) {
+    link->rx_state = ISOTP_IDLE;
+    link->tx_state = ISOTP_IDLE;
+}
+
+int64_t isotp_next_poll_us(const isotp_link_t *link) {
+    int64_t next = INT64_MAX;
+    if (link->tx_state == ISOTP_TX_BUSY) {
+        next = link->tx_next_us;
+    }
+    if ((link->tx_state == ISOTP_TX_WAIT_FC || link->rx_state == ISOTP_RX_BUSY) && link->deadline_us < next) {
+        next = link->deadline_us;
+    }
+    return next;
+}
@@ -1,273 +1,796 @@
 #include "mercedes_decode.h"
+#include "can_seqlock.h"
+#include "mb_signals.h"
+#include "can_config.h"
+#include "can_sniffer.h"
+#include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <limits.h>
+#include <stdatomic.h>
 #include <string.h>
-#include <stdlib.h>
+#include <strings.h>
+
+static const char *TAG = "MB_DECODE";
 
 static mercedes_data_t mb_data;
+static can_seqlock_t mb_lock;
+
+// Active vehicle profile; only switched by the CAN processing task (or before it starts)
+static const can_profile_t *volatile profile = &mb_profiles[0];
+static uint32_t profile_msgs[MB_STALE_WORDS];   // messages the active profile decodes
+static const char *profile_request = CAN_VEHICLE_PROFILE;
+static volatile bool profile_detecting;
+static TickType_t detect_start;                 // first tick with traffic, 0 = none yet
+
+// Last decoded payload per message; most broadcast frames repeat it unchanged
+static uint64_t last_word[MB_MSG_COUNT];
+static bool last_valid[MB_MSG_COUNT];
+
+// Changed channels, set by the decoder and fetched/cleared by consumers
+static atomic_uint_fast32_t dirty[MB_DIRTY_WORDS];
+
+// Single watcher, set up before decoding starts
+static uint32_t watch_mask[MB_DIRTY_WORDS];
+static TaskHandle_t watch_task;
+static mercedes_watch_cb_t watch_cb;
+static void *watch_arg;
+
+// === Staleness ===
+// Each periodic message sits in the timing-wheel slot of its deadline (one RTOS
+// tick per slot). A frame moves it to a new slot; mercedes_decode_check_stale()
+// only visits the slots whose tick has passed. Deadlines further out than one
+// revolution stay put until their own tick comes round.
+#define STALE_WHEEL_SLOTS 64            // power of two
+#define STALE_NONE 0xFF
+
+static volatile TickType_t last_seen[MB_MSG_COUNT];
+static volatile TickType_t stale_timeout[MB_MSG_COUNT];    // ticks, 0 = event-driven
+static TickType_t stale_deadline[MB_MSG_COUNT];
+static uint8_t wheel_head[STALE_WHEEL_SLOTS];
+static uint8_t wheel_next[MB_MSG_COUNT];
+static uint8_t wheel_prev[MB_MSG_COUNT];
+static uint8_t wheel_slot[MB_MSG_COUNT];                    // STALE_NONE when not scheduled
+static TickType_t wheel_tick;                               // last tick already expired
+static atomic_uint_fast32_t stale[MB_STALE_WORDS];
+
+static TickType_t stale_ticks(uint16_t period_ms) {
+    if (period_ms == 0) return 0;
+    uint32_t ms = (uint32_t)period_ms * CAN_STALE_CYCLES;
+    if (ms < CAN_STALE_MIN_MS) ms = CAN_STALE_MIN_MS;
+    TickType_t t = pdMS_TO_TICKS(ms);
+    return t ? t : 1;
+}
 
-void mercedes_decode_init(void) {
-    memset(&mb_data, 0, sizeof(mb_data));
+static void wheel_unlink(uint8_t m) {
+    uint8_t slot = wheel_slot[m];
+    if (slot == STALE_NONE) return;
+    if (wheel_prev[m] != STALE_NONE) {
+        wheel_next[wheel_prev[m]] = wheel_next[m];
+    } else {
+        wheel_head[slot] = wheel_next[m];
+    }
+    if (wheel_next[m] != STALE_NONE) {
+        wheel_prev[wheel_next[m]] = wheel_prev[m];
+    }
+    wheel_slot[m] = STALE_NONE;
 }
 
-void mercedes_decode_message(uint32_t id, const uint8_t *data, uint8_t dlc) {
-    switch (id) {
+static void wheel_insert(uint8_t m, TickType_t deadline) {
+    uint8_t slot = (uint8_t)(deadline & (STALE_WHEEL_SLOTS - 1));
+    stale_deadline[m] = deadline;
+    wheel_slot[m] = slot;
+    wheel_prev[m] = STALE_NONE;
+    wheel_next[m] = wheel_head[slot];
+    if (wheel_head[slot] != STALE_NONE) {
+        wheel_prev[wheel_head[slot]] = m;
+    }
+    wheel_head[slot] = m;
+}
 
-        // ================================================================
-        // OpenDBC signals (tested on real car via OBD port)
-        // ================================================================
+static void stale_init(void) {
+    TickType_t now = xTaskGetTickCount();
+    memset(wheel_head, STALE_NONE, sizeof(wheel_head));
+    memset(wheel_slot, STALE_NONE, sizeof(wheel_slot));
+    wheel_tick = now;
+    for (int m = 0; m < MB_MSG_COUNT; m++) {
+        last_seen[m] = 0;
+        stale_timeout[m] = stale_ticks(profile->messages[m].cycle_ms);
+    }
+    // Nothing has been received yet
+    for (int w = 0; w < MB_STALE_WORDS; w++) {
+        uint32_t bits = (w + 1) * 32 <= MB_MSG_COUNT ? 0xFFFFFFFFu
+                                                     : (1u << (MB_MSG_COUNT % 32)) - 1;
+        atomic_store_explicit(&stale[w], bits, memory_order_relaxed);
+    }
+}
 
-        case MB_ID_GAS_PEDAL:  // 0x105
-            if (dlc >= 5) {
-                mb_data.engine_rpm = ((uint16_t)data[0] << 8) | data[1];
-                mb_data.gas_pedal = data[4];
-                mb_data.combined_gas = data[3];
-            }
-            break;
-
-        case MB_ID_WHEEL_SPEEDS:  // 0x203
-            if (dlc >= 8) {
-                mb_data.wheel_speed_fl = ((uint16_t)(data[0] & 0x07) << 8) | data[1];
-                mb_data.wheel_speed_fr = ((uint16_t)(data[2] & 0x07) << 8) | data[3];
-                mb_data.wheel_speed_rl = ((uint16_t)(data[4] & 0x07) << 8) | data[5];
-                mb_data.wheel_speed_rr = ((uint16_t)(data[6] & 0x07) << 8) | data[7];
-                uint32_t avg_raw = ((uint32_t)mb_data.wheel_speed_fl +
-                                    mb_data.wheel_speed_fr +
-                                    mb_data.wheel_speed_rl +
-                                    mb_data.wheel_speed_rr) / 4;
-                mb_data.vehicle_speed_kmh = (uint8_t)(avg_raw * 603 / 10000);
-                mb_data.wheel_moving_fl = (data[0] >> 6) & 0x01;
-                mb_data.wheel_moving_fr = (data[2] >> 6) & 0x01;
-                mb_data.wheel_moving_rl = (data[4] >> 6) & 0x01;
-                mb_data.wheel_moving_rr = (data[6] >> 6) & 0x01;
-            }
-            break;
-
-        case MB_ID_STEER_SENSOR:  // 0x003
-            if (dlc >= 5) {
-                int16_t raw_angle = (int16_t)(((data[0] & 0x0F) << 8) | data[1]);
-                if (raw_angle & 0x800) raw_angle |= (int16_t)0xF000;
-                mb_data.steering_angle = -raw_angle;
-                int16_t raw_rate = (int16_t)(((data[2] & 0x0F) << 8) | data[3]);
-                if (raw_rate & 0x800) raw_rate |= (int16_t)0xF000;
-                mb_data.steering_rate = raw_rate;
-                mb_data.steer_direction = (data[0] >> 4) & 0x01;
-            }
-            break;
+// Frame received: clear the stale bit and push the deadline out
+static void stale_touch(size_t m, TickType_t now) {
+    last_seen[m] = now ? now : 1;  // 0 means never seen
+    uint32_t bit = 1u << (m % 32);
+    if (atomic_load_explicit(&stale[m / 32], memory_order_relaxed) & bit) {
+        atomic_fetch_and_explicit(&stale[m / 32], ~bit, memory_order_relaxed);
+    }
+    TickType_t timeout = stale_timeout[m];
+    wheel_unlink((uint8_t)m);
+    if (timeout != 0) {
+        wheel_insert((uint8_t)m, now + timeout);
+    }
+}
 
-        case MB_ID_BRAKE_MODULE:  // 0x005
-            if (dlc >= 4) {
-                mb_data.brake_pressed = data[0] & 0x01;
-                mb_data.brake_position = ((uint16_t)(data[2] & 0x03) << 8) | data[3];
-            }
-            break;
+// === Derived channels ===
+// Each MB_CH_* channel lists the channels it is computed from and is only
+// recomputed by a frame that changed one of them. Integrators (DERIVED_TIMED)
+// instead run on every frame of their input message, because time advances
+// even when the inputs hold still; they keep a remainder so a step costs O(1).
+#define DERIVED_COUNT (MB_CH_UDS_FIRST - MB_SIG_COUNT)
+#define DERIVED_MAX_INPUTS 4
+#define DERIVED_TIMED 0x01
+#define DERIVED_MAX_GAP_US 500000       // longer gaps (bus asleep) are not integrated
+
+_Static_assert(DERIVED_COUNT <= 32, "derived channel sets are 32-bit masks");
+
+// Integrator units: 1 m = 360e6 (0.01 km/h * us), 1 ml = 250e6 (ul/250ms * us)
+#define TRIP_UNIT_M  360000000ULL
+#define TRIP_UNIT_ML 250000000ULL
+#define TRIP_UNIT_S  1000000ULL
+
+typedef struct {
+    const char *name;
+    bool (*update)(uint32_t dt_us);     // returns true if the output field changed
+    uint16_t inputs[DERIVED_MAX_INPUTS];
+    uint8_t num_inputs;
+    uint8_t flags;
+    uint16_t field_offset;
+    uint8_t field_size;
+    uint8_t field_signed;
+} derived_def_t;
+
+static struct {
+    uint64_t dist_acc;
+    uint64_t fuel_acc;
+    uint64_t time_acc;
+    uint16_t speed_held;                // speed over the interval being integrated
+    uint16_t fuel_held;
+} trip;
+
+static atomic_bool trip_reset_pending;
+
+// Derived channels that depend (directly or through other derived channels) on each message
+static uint32_t derived_by_msg[MB_MSG_COUNT];
+static uint32_t derived_last_us[DERIVED_COUNT];
+static uint32_t derived_clocked;        // bit d set once channel d has a time base
+
+static bool set_u8(uint8_t *f, uint32_t v) {
+    uint8_t n = v > UINT8_MAX ? UINT8_MAX : (uint8_t)v;
+    bool changed = *f != n;
+    *f = n;
+    return changed;
+}
 
-        case MB_ID_STEER_TORQUE:  // 0x00E
-            if (dlc >= 2) {
-                mb_data.steering_torque = data[1];
-            }
-            break;
-
-        case MB_ID_DRIVER_CTRL:  // 0x045
-            if (dlc >= 3) {
-                mb_data.left_blinker = (data[2] >> 0) & 0x01;
-                mb_data.right_blinker = (data[2] >> 1) & 0x01;
-                mb_data.highbeam_toggle = (data[2] >> 2) & 0x01;
-                mb_data.highbeam_momentary = (data[2] >> 3) & 0x01;
-                mb_data.cruise_cancel = (data[0] >> 0) & 0x01;
-                mb_data.cruise_resume = (data[0] >> 1) & 0x01;
-                mb_data.cruise_accel_high = (data[0] >> 2) & 0x01;
-                mb_data.cruise_decel_high = (data[0] >> 3) & 0x01;
-                mb_data.cruise_accel_low = (data[0] >> 4) & 0x01;
-                mb_data.cruise_decel_low = (data[0] >> 5) & 0x01;
-            }
-            break;
-
-        case MB_ID_GEAR_LEVER:  // 0x06D
-            if (dlc >= 2) {
-                mb_data.gear_lever_reverse = (data[1] >> 0) & 0x01;
-                mb_data.gear_lever_neutral_up = (data[1] >> 1) & 0x01;
-                mb_data.gear_lever_neutral_down = (data[1] >> 2) & 0x01;
-                mb_data.gear_lever_drive = (data[1] >> 3) & 0x01;
-                mb_data.gear_lever_park = (data[1] >> 4) & 0x01;
-            }
-            break;
+static bool set_u16(uint16_t *f, uint32_t v) {
+    uint16_t n = v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+    bool changed = *f != n;
+    *f = n;
+    return changed;
+}
 
-        case MB_ID_GEAR_PACKET:  // 0x073
-            if (dlc >= 1) {
-                mb_data.gear = data[0] & 0x0F;
-            }
-            break;
-
-        case MB_ID_DOOR_SENSORS:  // 0x283
-            if (dlc >= 4) {
-                mb_data.doors_open = data[0];
-                mb_data.door_open_fl = (data[0] >> 1) & 0x01;
-                mb_data.door_open_fr = (data[0] >> 3) & 0x01;
-                mb_data.door_open_rl = (data[0] >> 5) & 0x01;
-                mb_data.door_open_rr = (data[0] >> 7) & 0x01;
-                mb_data.brake_pressed_2 = (data[3] >> 3) & 0x01;
-            }
-            break;
+static bool set_i16(int16_t *f, int32_t v) {
+    int16_t n = v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : (int16_t)v;
+    bool changed = *f != n;
+    *f = n;
+    return changed;
+}
 
-        case MB_ID_SEATBELT:  // 0x375
-            if (dlc >= 3) {
-                mb_data.seatbelt_driver = (data[2] >> 0) & 0x01;
-                mb_data.seatbelt_passenger = (data[2] >> 2) & 0x01;
-            }
-            break;
+// Adds whole units from an integrator, keeping the remainder
+static bool step_u32(uint32_t *f, uint64_t *acc, uint64_t unit) {
+    if (*acc < unit) return false;
+    uint64_t whole = *acc / unit;
+    *acc -= whole * unit;
+    *f += (uint32_t)whole;
+    return true;
+}
 
-        case MB_ID_IGNITION:  // 0x245
-            if (dlc >= 1) {
-                mb_data.ignition_raw = data[0];
-            }
-            break;
-
-        case MB_ID_WHEEL_ENC:  // 0x201
-            if (dlc >= 4) {
-                mb_data.wheel_enc_1 = data[0];
-                mb_data.wheel_enc_2 = data[1];
-                mb_data.wheel_enc_3 = data[2];
-                mb_data.wheel_enc_4 = data[3];
-            }
-            break;
+static bool upd_vehicle_speed(uint32_t dt_us) {
+    uint32_t avg_raw = ((uint32_t)mb_data.wheel_speed_fl + mb_data.wheel_speed_fr +
+                        mb_data.wheel_speed_rl + mb_data.wheel_speed_rr) / 4;
+    return set_u8(&mb_data.vehicle_speed_kmh, avg_raw * 603 / 10000);
+}
 
-        case MB_ID_CRUISE_CTRL3:  // 0x378
-            if (dlc >= 5) {
-                mb_data.cruise_set_speed = data[1];
-                mb_data.cruise_enabled = (data[4] >> 2) & 0x01;
-                mb_data.cruise_disabled = (data[4] >> 4) & 0x01;
-            }
-            break;
-
-        // ================================================================
-        // CAN C Bus signals (Xentry DAT verified — direct bus tap)
-        // ================================================================
-
-        case MB_ID_ENGINE_MAIN:  // 0x0308 — MS_308h
-            // NMOT: bits 8-23, factor 0.25
-            // T_OEL: byte 5, offset -40
-            // OEL_FS: byte 6, OEL_QUAL: byte 7
-            // UEHITZ: bit 32, TEMP_KL: bit 39, OEL_KL: bit 29, DIAG_KL: bit 30
-            if (dlc >= 8) {
-                mb_data.nmot_rpm_raw = ((uint16_t)data[1] << 8) | data[2];
-                mb_data.oil_temp_c = (int8_t)(data[5] - 40);
-                mb_data.oil_level = data[6];
-                mb_data.oil_quality = data[7];
-                mb_data.oil_overheat = (data[4] >> 0) & 0x01;   // bit 32
-                mb_data.coolant_overheat = (data[4] >> 7) & 0x01; // bit 39
-                mb_data.oil_warning = (data[3] >> 5) & 0x01;    // bit 29
-                mb_data.mil_lamp = (data[3] >> 6) & 0x01;       // bit 30
-            }
-            break;
+static bool upd_speed_rdu(uint32_t dt_us) {
+    return set_u16(&mb_data.speed_kmh_x100, ((uint32_t)mb_data.ws_fl_rdu + mb_data.ws_fr_rdu +
+                                             mb_data.ws_rl_rdu + mb_data.ws_rr_rdu) / 4);
+}
 
-        case MB_ID_COOLANT_TEMP:  // 0x0608 — MS_608h
-            // T_MOT: byte 0, offset -40
-            if (dlc >= 1) {
-                mb_data.coolant_temp_c = (int8_t)(data[0] - 40);
-            }
-            break;
-
-        case MB_ID_TRANS_STATUS:  // 0x0418 — GS_418h
-            // FSC: byte 0 (gear: 0=P,1=R,2=N,3=D)
-            // FPC: byte 1 (driving program)
-            // T_GET: byte 2, offset -40
-            if (dlc >= 3) {
-                mb_data.gear_fsc = data[0];
-                mb_data.drive_program = data[1];
-                mb_data.trans_oil_temp_c = (int8_t)(data[2] - 40);
-            }
-            break;
-
-        case MB_ID_TRANS_SPEEDS:  // 0x0338 — GS_338h
-            // NAB: bytes 0-1, factor 0.25 RPM (0xFFFF = N/A)
-            // NTURBINE: bytes 6-7, factor 0.25 RPM
-            if (dlc >= 8) {
-                mb_data.trans_output_raw = ((uint16_t)data[0] << 8) | data[1];
-                mb_data.turbine_speed_raw = ((uint16_t)data[6] << 8) | data[7];
-            }
-            break;
-
-        case MB_ID_FUEL_DATA:  // 0x0320 — GW_C_B9
-            // VB: bytes 0-1 (µl/250ms)
-            // TANK_FS: byte 2 (liters)
-            if (dlc >= 3) {
-                mb_data.fuel_consumption = ((uint16_t)data[0] << 8) | data[1];
-                mb_data.tank_level = data[2];
-            }
-            break;
+// L/100 km = (fuel * 0.0144 L/h) / (speed * 0.01 km/h) * 100 = fuel * 144 / speed
+static bool upd_fuel_l100km(uint32_t dt_us) {
+    uint32_t speed = mb_data.speed_kmh_x100;
+    uint32_t v = speed < 300 ? 0 : (uint32_t)mb_data.fuel_consumption * 1440 / speed;
+    return set_u16(&mb_data.fuel_l100km_x10, v);
+}
 
-        case MB_ID_INST_CLUSTER:  // 0x03F0 — KOMBI_3F0h
-            // T_AUSSEN: byte 2, factor 0.5, offset -40
-            if (dlc >= 3) {
-                mb_data.ambient_temp_raw = data[2];
-            }
-            break;
-
-        case MB_ID_DYNAMICS:  // 0x0224 — RDU_A2
-            // AY_S: byte 0, factor 0.01 g (signed)
-            // GIER_ROH: bytes 1-2, factor 0.005 °/s (signed)
-            // LRW: bits 26-39 (14 bits), factor 0.1 °
-            if (dlc >= 5) {
-                mb_data.lateral_g_raw = (int8_t)data[0];
-                mb_data.yaw_rate_raw = (int16_t)(((uint16_t)data[1] << 8) | data[2]);
-                // LRW: bits 26..39 = byte3[1:0] << 12 | byte4 << 4 | ... complex
-                // Simpler: bytes 3-4, mask 14 bits
-                mb_data.steer_angle_rdu = (((uint16_t)(data[3] & 0x3F) << 8) | data[4]);
+static bool upd_wheel_slip(uint32_t dt_us) {
+    int32_t front = (int32_t)mb_data.ws_fl_rdu + mb_data.ws_fr_rdu;
+    int32_t rear = (int32_t)mb_data.ws_rl_rdu + mb_data.ws_rr_rdu;
+    return set_i16(&mb_data.wheel_slip_pm, front < 600 ? 0 : (rear - front) * 1000 / front);
+}
+
+static bool upd_converter_slip(uint32_t dt_us) {
+    int32_t engine = mb_data.nmot_rpm_raw;
+    int32_t turbine = mb_data.turbine_speed_raw;
+    bool valid = engine >= 1600 && turbine != 0xFFFF;
+    return set_i16(&mb_data.converter_slip_pm, valid ? (engine - turbine) * 1000 / engine : 0);
+}
+
+static bool upd_gear_ratio(uint32_t dt_us) {
+    uint32_t out = mb_data.trans_output_raw;
+    uint32_t turbine = mb_data.turbine_speed_raw;
+    bool valid = out >= 40 && out != 0xFFFF && turbine != 0xFFFF;
+    return set_u16(&mb_data.gear_ratio_x1000, valid ? turbine * 1000 / out : 0);
+}
+
+static bool upd_trip_distance(uint32_t dt_us) {
+    trip.dist_acc += (uint64_t)trip.speed_held * dt_us;
+    trip.speed_held = mb_data.speed_kmh_x100;
+    return step_u32(&mb_data.trip_distance_m, &trip.dist_acc, TRIP_UNIT_M);
+}
+
+static bool upd_trip_fuel(uint32_t dt_us) {
+    trip.fuel_acc += (uint64_t)trip.fuel_held * dt_us;
+    trip.fuel_held = mb_data.fuel_consumption;
+    return step_u32(&mb_data.trip_fuel_ml, &trip.fuel_acc, TRIP_UNIT_ML);
+}
+
+static bool upd_trip_time(uint32_t dt_us) {
+    trip.time_acc += dt_us;
+    return step_u32(&mb_data.trip_time_s, &trip.time_acc, TRIP_UNIT_S);
+}
+
+// ml * 100 / m = L/100 km
+static bool upd_trip_avg_l100km(uint32_t dt_us) {
+    uint32_t m = mb_data.trip_distance_m;
+    uint64_t v = m < 100 ? 0 : (uint64_t)mb_data.trip_fuel_ml * 1000 / m;
+    return set_u16(&mb_data.trip_avg_l100km_x10, v > UINT16_MAX ? UINT16_MAX : (uint32_t)v);
+}
+
+// Uses the integrator's sub-second remainder so short trips are not skewed by whole seconds
+static bool upd_trip_avg_speed(uint32_t dt_us) {
+    uint64_t us = (uint64_t)mb_data.trip_time_s * TRIP_UNIT_S + trip.time_acc;
+    uint64_t v = us == 0 ? 0 : (uint64_t)mb_data.trip_distance_m * 36000000ULL / us;
+    return set_u16(&mb_data.trip_avg_speed_x10, v > UINT16_MAX ? UINT16_MAX : (uint32_t)v);
+}
+
+// Name is the enum name without "MB_CH_"; inputs are the trailing arguments
+#define DERIVED(ch, fn, fl, field, ...) \
+    [ch - MB_SIG_COUNT] = { #ch + 6, fn, { __VA_ARGS__ }, \
+        sizeof((uint16_t[]){ __VA_ARGS__ }) / sizeof(uint16_t), fl, \
+        offsetof(mercedes_data_t, field), sizeof(mb_data.field), \
+        ((__typeof__(mb_data.field))-1 < (__typeof__(mb_data.field))1) }
+
+// Inputs must precede the channel (channels are evaluated in MB_CH_* order)
+static const derived_def_t derived_defs[DERIVED_COUNT] = {
+    DERIVED(MB_CH_VEHICLE_SPEED_KMH, upd_vehicle_speed, 0, vehicle_speed_kmh,
+            MB_SIG_WHEEL_SPEED_FL, MB_SIG_WHEEL_SPEED_FR, MB_SIG_WHEEL_SPEED_RL, MB_SIG_WHEEL_SPEED_RR),
+    DERIVED(MB_CH_SPEED_KMH_X100, upd_speed_rdu, 0, speed_kmh_x100,
+            MB_SIG_WS_FL_RDU, MB_SIG_WS_FR_RDU, MB_SIG_WS_RL_RDU, MB_SIG_WS_RR_RDU),
+    DERIVED(MB_CH_FUEL_L100KM_X10, upd_fuel_l100km, 0, fuel_l100km_x10,
+            MB_SIG_FUEL_CONSUMPTION, MB_CH_SPEED_KMH_X100),
+    DERIVED(MB_CH_WHEEL_SLIP_PM, upd_wheel_slip, 0, wheel_slip_pm,
+            MB_SIG_WS_FL_RDU, MB_SIG_WS_FR_RDU, MB_SIG_WS_RL_RDU, MB_SIG_WS_RR_RDU),
+    DERIVED(MB_CH_CONVERTER_SLIP_PM, upd_converter_slip, 0, converter_slip_pm,
+            MB_SIG_NMOT_RPM_RAW, MB_SIG_TURBINE_SPEED_RAW),
+    DERIVED(MB_CH_GEAR_RATIO_X1000, upd_gear_ratio, 0, gear_ratio_x1000,
+            MB_SIG_TURBINE_SPEED_RAW, MB_SIG_TRANS_OUTPUT_RAW),
+    DERIVED(MB_CH_TRIP_DISTANCE_M, upd_trip_distance, DERIVED_TIMED, trip_distance_m,
+            MB_CH_SPEED_KMH_X100),
+    DERIVED(MB_CH_TRIP_FUEL_ML, upd_trip_fuel, DERIVED_TIMED, trip_fuel_ml,
+            MB_SIG_FUEL_CONSUMPTION),
+    DERIVED(MB_CH_TRIP_TIME_S, upd_trip_time, DERIVED_TIMED, trip_time_s,
+            MB_CH_SPEED_KMH_X100),
+    DERIVED(MB_CH_TRIP_AVG_L100KM_X10, upd_trip_avg_l100km, 0, trip_avg_l100km_x10,
+            MB_CH_TRIP_DISTANCE_M, MB_CH_TRIP_FUEL_ML),
+    DERIVED(MB_CH_TRIP_AVG_SPEED_X10, upd_trip_avg_speed, 0, trip_avg_speed_x10,
+            MB_CH_TRIP_DISTANCE_M, MB_CH_TRIP_TIME_S),
+};
+
+// === UDS channels ===
+// Values polled from ECUs arrive from another task through one slot per
+// channel: the poster stores the value and sets the channel's pending bit, and
+// the CAN processing task takes the bits and writes the fields, so mb_data
+// keeps a single writer. Only the latest value per channel is kept.
+#define UDS_COUNT (MB_CH_COUNT - MB_CH_UDS_FIRST)
+
+_Static_assert(UDS_COUNT <= 32, "UDS channel sets are 32-bit masks");
+
+typedef struct {
+    const char *name;
+    uint16_t field_offset;
+    uint8_t field_size;
+    uint8_t field_signed;
+} uds_def_t;
+
+#define UDS_CHANNEL(ch, field) \
+    [ch - MB_CH_UDS_FIRST] = { #ch + 6, offsetof(mercedes_data_t, field), sizeof(mb_data.field), \
+        ((__typeof__(mb_data.field))-1 < (__typeof__(mb_data.field))1) }
+
+static const uds_def_t uds_defs[UDS_COUNT] = {
+    UDS_CHANNEL(MB_CH_BOOST_PRESSURE_HPA, boost_pressure_hpa),
+    UDS_CHANNEL(MB_CH_BOOST_TARGET_HPA, boost_target_hpa),
+    UDS_CHANNEL(MB_CH_INJECTION_QTY_X100, injection_qty_x100),
+    UDS_CHANNEL(MB_CH_AIRMATIC_VALVES, airmatic_valves),
+    UDS_CHANNEL(MB_CH_AIRMATIC_COMPRESSOR, airmatic_compressor),
+};
+
+static atomic_int_fast32_t uds_value[UDS_COUNT];
+static atomic_uint_fast32_t uds_pending;                    // bit u: uds_value[u] not applied yet
+static volatile TickType_t uds_seen[UDS_COUNT];             // 0 = never
+static volatile TickType_t uds_timeout[UDS_COUNT];          // ticks, 0 = never stale once seen
+
+static void derived_init(void) {
+    memset(derived_by_msg, 0, sizeof(derived_by_msg));
+    memset(&trip, 0, sizeof(trip));
+    derived_clocked = 0;
+    atomic_store_explicit(&trip_reset_pending, false, memory_order_relaxed);
+
+    for (int d = 0; d < DERIVED_COUNT; d++) {
+        const derived_def_t *def = &derived_defs[d];
+        for (int i = 0; i < def->num_inputs; i++) {
+            uint16_t in = def->inputs[i];
+            if (in < MB_SIG_COUNT) {
+                derived_by_msg[mb_signal_info[in].message] |= 1u << d;
+                continue;
             }
-            break;
-
-        case MB_ID_WHEEL_SPD_RDU:  // 0x0228 — RDU_A3
-            // Each wheel: 2-bit direction + 14-bit speed (×0.01 km/h)
-            if (dlc >= 8) {
-                mb_data.ws_dir_fl = (data[0] >> 6) & 0x03;
-                mb_data.ws_fl_rdu = ((uint16_t)(data[0] & 0x3F) << 8) | data[1];
-                mb_data.ws_dir_fr = (data[2] >> 6) & 0x03;
-                mb_data.ws_fr_rdu = ((uint16_t)(data[2] & 0x3F) << 8) | data[3];
-                mb_data.ws_dir_rl = (data[4] >> 6) & 0x03;
-                mb_data.ws_rl_rdu = ((uint16_t)(data[4] & 0x3F) << 8) | data[5];
-                mb_data.ws_dir_rr = (data[6] >> 6) & 0x03;
-                mb_data.ws_rr_rdu = ((uint16_t)(data[6] & 0x3F) << 8) | data[7];
+            uint32_t src = 1u << (in - MB_SIG_COUNT);
+            for (int m = 0; m < MB_MSG_COUNT; m++) {
+                if (derived_by_msg[m] & src) derived_by_msg[m] |= 1u << d;
             }
-            break;
-
-        case MB_ID_ESP_STATUS:  // 0x0200 — RDU_A1
-            // BLS: bit 2, ESP_LAMP: bit 8, ABS_LAMP: bit 9, HAS_KL: bit 14
-            if (dlc >= 2) {
-                mb_data.brake_light = (data[0] >> 2) & 0x01;
-                mb_data.esp_lamp = (data[1] >> 0) & 0x01;
-                mb_data.abs_lamp = (data[1] >> 1) & 0x01;
-                mb_data.handbrake = (data[1] >> 6) & 0x01;
+        }
+    }
+}
+
+static void set_changed(uint32_t *changed, uint32_t ch) {
+    changed[ch / 32] |= 1u << (ch % 32);
+}
+
+static void trip_clear(uint32_t *changed) {
+    trip.dist_acc = 0;
+    trip.fuel_acc = 0;
+    trip.time_acc = 0;
+    mb_data.trip_distance_m = 0;
+    mb_data.trip_fuel_ml = 0;
+    mb_data.trip_time_s = 0;
+    mb_data.trip_avg_l100km_x10 = 0;
+    mb_data.trip_avg_speed_x10 = 0;
+    for (uint32_t ch = MB_CH_TRIP_DISTANCE_M; ch <= MB_CH_TRIP_AVG_SPEED_X10; ch++) {
+        set_changed(changed, ch);
+    }
+}
+
+// Recompute the derived channels fed by message m
+static void derived_run(size_t m, uint32_t *changed, uint32_t ts_us) {
+    uint32_t pending = derived_by_msg[m];
+    while (pending) {
+        int d = __builtin_ctz(pending);
+        pending &= pending - 1;
+        const derived_def_t *def = &derived_defs[d];
+        uint32_t dt_us = 0;
+
+        if (def->flags & DERIVED_TIMED) {
+            if (derived_clocked & (1u << d)) {
+                dt_us = ts_us - derived_last_us[d];
+                if (dt_us > DERIVED_MAX_GAP_US) dt_us = 0;
             }
-            break;
-
-        case MB_ID_AIRMATIC:  // 0x0340 — FS_340h
-            // FZGN_VL: byte 2, VR: byte 3, HL: byte 4, HR: byte 5
-            if (dlc >= 6) {
-                mb_data.level_fl = data[2];
-                mb_data.level_fr = data[3];
-                mb_data.level_rl = data[4];
-                mb_data.level_rr = data[5];
+            derived_last_us[d] = ts_us;
+            derived_clocked |= 1u << d;
+        } else {
+            bool any = false;
+            for (int i = 0; i < def->num_inputs; i++) {
+                any |= MB_DIRTY_TEST(changed, def->inputs[i]);
             }
-            break;
-
-        case MB_ID_DRIVING_STYLE:  // 0x0580 — AAD_580h
-            // FTK_BMI: byte 0, FTK_LMI: byte 1, FTK_VMI: byte 2
-            if (dlc >= 3) {
-                mb_data.style_accel = data[0];
-                mb_data.style_lateral = data[1];
-                mb_data.style_braking = data[2];
+            if (!any) continue;
+        }
+
+        if (def->update(dt_us)) {
+            set_changed(changed, MB_SIG_COUNT + d);
+        }
+    }
+}
+
+// === Vehicle profiles ===
+static int profile_lookup(const char *name) {
+    for (int p = 0; p < MB_PROFILE_COUNT; p++) {
+        if (strcasecmp(name, mb_profiles[p].name) == 0) return p;
+    }
+    return -1;
+}
+
+// Switch tables; decode state from the previous profile is dropped
+static void profile_apply(const can_profile_t *p) {
+    profile = p;
+    memset(profile_msgs, 0, sizeof(profile_msgs));
+    for (uint32_t id = 0; id < CAN_PROFILE_ID_SPACE; id++) {
+        uint8_t m = p->message_index[id];
+        if (m) profile_msgs[(m - 1) / 32] |= 1u << ((m - 1) % 32);
+    }
+    memset(last_valid, 0, sizeof(last_valid));
+    stale_init();
+    derived_init();
+}
+
+// IDs of the profile seen on the bus minus those missing
+static int profile_score(const can_profile_t *p) {
+    int score = 0;
+    for (int m = 0; m < MB_MSG_COUNT; m++) {
+        uint32_t id = p->messages[m].id;
+        if (p->message_index[id] != m + 1) continue;  // not sent by this vehicle
+        score += can_sniffer_find(id) != NULL ? 1 : -1;
+    }
+    return score;
+}
+
+void mercedes_decode_init(void) {
+    memset(&mb_data, 0, sizeof(mb_data));
+    for (int i = 0; i < MB_DIRTY_WORDS; i++) {
+        atomic_store_explicit(&dirty[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&uds_pending, 0, memory_order_relaxed);
+    for (int u = 0; u < UDS_COUNT; u++) {
+        uds_seen[u] = 0;
+    }
+    int p = profile_lookup(profile_request);
+    if (p < 0 && strcasecmp(profile_request, "auto") != 0) {
+        ESP_LOGW(TAG, "Unknown vehicle profile %s, detecting", profile_request);
+    }
+    // Until detection settles, decode with the first (default) profile
+    profile_detecting = p < 0;
+    detect_start = 0;
+    profile_apply(&mb_profiles[p < 0 ? 0 : p]);
+}
+
+// Publish the channels changed by one frame
+static void publish_changes(const uint32_t *changed) {
+    bool watched = false;
+    for (int w = 0; w < MB_DIRTY_WORDS; w++) {
+        if (changed[w] == 0) continue;
+        atomic_fetch_or_explicit(&dirty[w], changed[w], memory_order_release);
+        watched |= (watch_mask[w] & changed[w]) != 0;
+    }
+    if (!watched) return;
+
+    if (watch_task != NULL) {
+        xTaskNotifyGive(watch_task);
+    }
+    if (watch_cb != NULL) {
+        for (int w = 0; w < MB_DIRTY_WORDS; w++) {
+            uint32_t bits = changed[w] & watch_mask[w];
+            while (bits) {
+                watch_cb((uint16_t)(w * 32 + __builtin_ctz(bits)), watch_arg);
+                bits &= bits - 1;
             }
-            break;
+        }
+    }
+}
+
+void mercedes_decode_message(uint32_t id, const uint8_t *data, uint8_t dlc, uint32_t ts_us) {
+    const can_profile_t *p = profile;
+    const can_message_def_t *msg = can_profile_find(p, id);
+    if (msg == NULL) {
+        return;  // Unknown ID, don't update stats
+    }
 
-        default:
-            return;  // Unknown ID, don't update stats
+    size_t idx = (size_t)(msg - p->messages);
+    uint32_t changed[MB_DIRTY_WORDS] = {0};
+
+    can_seqlock_write_begin(&mb_lock);
+
+    if (dlc >= msg->min_dlc) {
+        uint64_t word = can_signal_load(data);
+        // Fields are only written by their own message, so an unchanged payload decodes to the same values
+        if (!last_valid[idx] || word != last_word[idx]) {
+            uint64_t mask = (uint64_t)msg->decode(word, &mb_data) << (msg->first_signal % 32);
+            changed[msg->first_signal / 32] |= (uint32_t)mask;
+            if (mask >> 32) changed[msg->first_signal / 32 + 1] |= (uint32_t)(mask >> 32);
+            last_word[idx] = word;
+            last_valid[idx] = true;
+        }
     }
 
+    if (atomic_load_explicit(&trip_reset_pending, memory_order_relaxed) &&
+        atomic_exchange_explicit(&trip_reset_pending, false, memory_order_relaxed)) {
+        trip_clear(changed);
+    }
+    if (derived_by_msg[idx]) {
+        derived_run(idx, changed, ts_us);
+    }
+
+    TickType_t now = xTaskGetTickCount();
     mb_data.decode_count++;
-    mb_data.last_decode_tick = xTaskGetTickCount();
+    mb_data.last_decode_tick = now;
+
+    can_seqlock_write_end(&mb_lock);
+
+    stale_touch(idx, now);
+
+    // After the seqlock so a woken consumer's snapshot already holds the new values
+    publish_changes(changed);
+}
+
+void mercedes_decode_fetch_dirty(uint32_t *out) {
+    for (int i = 0; i < MB_DIRTY_WORDS; i++) {
+        out[i] = (uint32_t)atomic_exchange_explicit(&dirty[i], 0, memory_order_acquire);
+    }
+}
+
+esp_err_t mercedes_decode_watch(const uint16_t *channels, size_t count, TaskHandle_t task,
+                                mercedes_watch_cb_t cb, void *arg) {
+    uint32_t mask[MB_DIRTY_WORDS] = {0};
+    for (size_t i = 0; i < count; i++) {
+        if (channels[i] >= MB_CH_COUNT) return ESP_ERR_INVALID_ARG;
+        mask[channels[i] / 32] |= 1u << (channels[i] % 32);
+    }
+    memcpy(watch_mask, mask, sizeof(watch_mask));
+    watch_task = task;
+    watch_cb = cb;
+    watch_arg = arg;
+    return ESP_OK;
+}
+
+// Message carrying a channel; a derived channel follows its first input, UDS channels have none
+static int channel_message(uint16_t channel) {
+    while (channel >= MB_SIG_COUNT) {
+        if (channel >= MB_CH_UDS_FIRST) return -1;
+        channel = derived_defs[channel - MB_SIG_COUNT].inputs[0];
+    }
+    return mb_signal_info[channel].message;
+}
+
+int mercedes_decode_channel_message(uint16_t channel) {
+    return channel_message(channel);
+}
+
+static int32_t read_field(const void *base, uint16_t offset, uint8_t size, bool is_signed) {
+    const uint8_t *p = (const uint8_t *)base + offset;
+    switch (size) {
+        case 1: return is_signed ? (int32_t)*(const int8_t *)p : (int32_t)*p;
+        case 2: return is_signed ? (int32_t)*(const int16_t *)p : (int32_t)*(const uint16_t *)p;
+        default: return (int32_t)*(const uint32_t *)p;
+    }
+}
+
+// Clamp to the field's type and store; true if the field changed
+static bool write_field(void *base, uint16_t offset, uint8_t size, bool is_signed, int32_t v) {
+    if (size < 4) {
+        int32_t bits = size * 8;
+        int32_t lo = is_signed ? -(1 << (bits - 1)) : 0;
+        int32_t hi = is_signed ? (1 << (bits - 1)) - 1 : (1 << bits) - 1;
+        v = v < lo ? lo : v > hi ? hi : v;
+    }
+    if (read_field(base, offset, size, is_signed) == v) return false;
+    uint8_t *p = (uint8_t *)base + offset;
+    switch (size) {
+        case 1: *p = (uint8_t)v; break;
+        case 2: *(uint16_t *)p = (uint16_t)v; break;
+        default: *(uint32_t *)p = (uint32_t)v; break;
+    }
+    return true;
+}
+
+esp_err_t mercedes_decode_post(uint16_t channel, int32_t value, uint16_t period_ms) {
+    if (channel < MB_CH_UDS_FIRST || channel >= MB_CH_COUNT) return ESP_ERR_INVALID_ARG;
+    uint32_t u = channel - MB_CH_UDS_FIRST;
+    uds_timeout[u] = stale_ticks(period_ms);
+    atomic_store_explicit(&uds_value[u], value, memory_order_relaxed);
+    // Release: the value is visible before the pending bit
+    atomic_fetch_or_explicit(&uds_pending, 1u << u, memory_order_release);
+    return ESP_OK;
+}
+
+void mercedes_decode_apply_posted(void) {
+    uint32_t pending = (uint32_t)atomic_exchange_explicit(&uds_pending, 0, memory_order_acquire);
+    if (pending == 0) return;
+
+    uint32_t changed[MB_DIRTY_WORDS] = {0};
+    TickType_t now = xTaskGetTickCount();
+
+    can_seqlock_write_begin(&mb_lock);
+    for (uint32_t bits = pending; bits; bits &= bits - 1) {
+        int u = __builtin_ctz(bits);
+        const uds_def_t *def = &uds_defs[u];
+        int32_t v = (int32_t)atomic_load_explicit(&uds_value[u], memory_order_relaxed);
+        if (write_field(&mb_data, def->field_offset, def->field_size, def->field_signed, v)) {
+            set_changed(changed, MB_CH_UDS_FIRST + u);
+        }
+        uds_seen[u] = now ? now : 1;
+    }
+    can_seqlock_write_end(&mb_lock);
+
+    publish_changes(changed);
+}
+
+// UDS channel u: no value yet, or none for CAN_STALE_CYCLES polling periods
+static bool uds_stale(uint32_t u) {
+    TickType_t seen = uds_seen[u];
+    if (seen == 0) return true;
+    TickType_t timeout = uds_timeout[u];
+    return timeout != 0 && xTaskGetTickCount() - seen > timeout;
+}
+
+bool mercedes_decode_get_signal(const mercedes_data_t *data, uint16_t channel, int32_t *value) {
+    if (channel < MB_SIG_COUNT) {
+        const can_signal_t *sig = &profile->signals[channel];
+        *value = read_field(data, sig->field_offset, sig->field_size,
+                            sig->flags & CAN_SIG_FIELD_SIGNED);
+        return true;
+    }
+    if (channel < MB_CH_UDS_FIRST) {
+        const derived_def_t *def = &derived_defs[channel - MB_SIG_COUNT];
+        *value = read_field(data, def->field_offset, def->field_size, def->field_signed);
+        return true;
+    }
+    if (channel < MB_CH_COUNT) {
+        const uds_def_t *def = &uds_defs[channel - MB_CH_UDS_FIRST];
+        *value = read_field(data, def->field_offset, def->field_size, def->field_signed);
+        return true;
+    }
+    return false;
+}
+
+const char *mercedes_decode_channel_name(uint16_t channel) {
+    if (channel < MB_SIG_COUNT) return mb_signal_info[channel].name;
+    if (channel < MB_CH_UDS_FIRST) return derived_defs[channel - MB_SIG_COUNT].name;
+    if (channel < MB_CH_COUNT) return uds_defs[channel - MB_CH_UDS_FIRST].name;
+    return NULL;
+}
+
+void mercedes_decode_trip_reset(void) {
+    atomic_store_explicit(&trip_reset_pending, true, memory_order_relaxed);
+}
+
+bool mercedes_decode_is_stale(uint16_t channel) {
+    if (channel >= MB_CH_UDS_FIRST && channel < MB_CH_COUNT) return uds_stale(channel - MB_CH_UDS_FIRST);
+    int m = channel_message(channel);
+    if (m < 0) return true;
+    return (atomic_load_explicit(&stale[m / 32], memory_order_relaxed) >> (m % 32)) & 1u;
+}
+
+uint32_t mercedes_decode_get_stale(uint32_t *out) {
+    uint32_t count = 0;
+    for (int w = 0; w < MB_STALE_WORDS; w++) {
+        out[w] = (uint32_t)atomic_load_explicit(&stale[w], memory_order_relaxed);
+        count += (uint32_t)__builtin_popcount(out[w] & profile_msgs[w]);
+    }
+    return count;
+}
+
+uint32_t mercedes_decode_age_ms(uint16_t channel) {
+    TickType_t seen;
+    if (channel >= MB_CH_UDS_FIRST && channel < MB_CH_COUNT) {
+        seen = uds_seen[channel - MB_CH_UDS_FIRST];
+    } else {
+        int m = channel_message(channel);
+        if (m < 0) return UINT32_MAX;
+        seen = last_seen[m];
+    }
+    if (seen == 0) return UINT32_MAX;
+    return (uint32_t)(xTaskGetTickCount() - seen) * portTICK_PERIOD_MS;
+}
+
+esp_err_t mercedes_decode_set_period(uint32_t id, uint16_t period_ms) {
+    const can_profile_t *p = profile;
+    const can_message_def_t *msg = can_profile_find(p, id);
+    if (msg == NULL) return ESP_ERR_NOT_FOUND;
+    stale_timeout[msg - p->messages] = stale_ticks(period_ms);
+    return ESP_OK;
+}
+
+void mercedes_decode_check_stale(void) {
+    TickType_t now = xTaskGetTickCount();
+    TickType_t elapsed = now - wheel_tick;
+    // After a long gap every slot is due once; one pass over the wheel covers it
+    if (elapsed > STALE_WHEEL_SLOTS) {
+        wheel_tick = now - STALE_WHEEL_SLOTS;
+    }
+
+    while (wheel_tick != now) {
+        wheel_tick++;
+        uint8_t m = wheel_head[wheel_tick & (STALE_WHEEL_SLOTS - 1)];
+        while (m != STALE_NONE) {
+            uint8_t next = wheel_next[m];
+            if ((int32_t)(now - stale_deadline[m]) >= 0) {
+                wheel_unlink(m);
+                atomic_fetch_or_explicit(&stale[m / 32], 1u << (m % 32), memory_order_relaxed);
+            }
+            m = next;
+        }
+    }
 }
 
 const mercedes_data_t *mercedes_decode_get_data(void) {
     return &mb_data;
 }
+
+bool mercedes_decode_snapshot(mercedes_data_t *out) {
+    mercedes_data_t tmp;
+    if (!can_seqlock_read(&mb_lock, &tmp, &mb_data, sizeof(tmp))) {
+        return false;
+    }
+    *out = tmp;
+    return true;
+}
+
+esp_err_t mercedes_decode_select_profile(const char *name) {
+    if (strcasecmp(name, "auto") == 0) {
+        profile_request = "auto";
+        return ESP_OK;
+    }
+    int p = profile_lookup(name);
+    if (p < 0) return ESP_ERR_NOT_FOUND;
+    profile_request = mb_profiles[p].name;
+    return ESP_OK;
+}
+
+const can_profile_t *mercedes_decode_get_profile(bool *detecting) {
+    if (detecting != NULL) *detecting = profile_detecting;
+    return profile;
+}
+
+void mercedes_decode_detect_profile(void) {
+    if (!profile_detecting) return;
+    TickType_t now = xTaskGetTickCount();
+    if (detect_start == 0) {
+        if (can_sniffer_get_state()->total_msgs == 0) return;
+        detect_start = now ? now : 1;
+        return;
+    }
+    if (now - detect_start < pdMS_TO_TICKS(CAN_PROFILE_DETECT_MS)) return;
+
+    int best = 0, best_score = INT_MIN, runner_up = INT_MIN;
+    for (int p = 0; p < MB_PROFILE_COUNT; p++) {
+        int score = profile_score(&mb_profiles[p]);
+        if (score > best_score) {
+            runner_up = best_score;
+            best = p;
+            best_score = score;
+        } else if (score > runner_up) {
+            runner_up = score;
+        }
+    }
+    // Keep listening while nothing matches or two profiles fit equally well
+    if (best_score <= 0 || runner_up == best_score) return;
+
+    profile_detecting = false;
+    ESP_LOGI(TAG, "Vehicle profile %s detected (score %d of %d)",
+             mb_profiles[best].name, best_score, mb_profiles[best].num_messages);
+    if (&mb_profiles[best] == profile) return;
+
+    // Fields of messages the new profile lacks must not keep the old values.
+    // UDS values come from the ECUs, not the profile, and are kept (UDS
+    // fields follow all broadcast and derived fields in mercedes_data_t)
+    can_seqlock_write_begin(&mb_lock);
+    memset(&mb_data, 0, offsetof(mercedes_data_t, boost_pressure_hpa));
+    can_seqlock_write_end(&mb_lock);
+    profile_apply(&mb_profiles[best]);
+
+    uint32_t changed[MB_DIRTY_WORDS];
+    memset(changed, 0xFF, sizeof(changed));
+    if (MB_CH_COUNT % 32) changed[MB_DIRTY_WORDS - 1] = (1u << (MB_CH_COUNT % 32)) - 1;
+    publish_changes(changed);
+}
+
+size_t mercedes_decode_get_ids(uint32_t *ids, size_t max) {
+    // While detecting, every profile's IDs (each once) so fingerprinting sees them all
+    bool all = profile_detecting;
+    const can_profile_t *active = profile;
+    size_t n = 0;
+    for (uint32_t id = 0; id < CAN_PROFILE_ID_SPACE; id++) {
+        bool used = active->message_index[id] != 0;
+        for (int p = 0; all && !used && p < MB_PROFILE_COUNT; p++) {
+            used = mb_profiles[p].message_index[id] != 0;
+        }
+        if (!used) continue;
+        if (n < max) ids[n] = id;
+        n++;
+    }
+    return n;
+}
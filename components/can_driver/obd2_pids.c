@@ -140,6 +140,68 @@ esp_err_t obd2_request_pid(uint8_t pid) {
     return can_send_message(&msg);
 }
 
+esp_err_t obd2_request_service(uint8_t service, const uint8_t *params, size_t count) {
+    if (count > 6 || (count > 0 && params == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    can_message_t msg = {
+        .identifier = OBD2_REQUEST_CAN_ID,
+        .data_length_code = 8,
+        .data = {(uint8_t)(count + 1), service}
+    };
+    if (count > 0) {
+        memcpy(&msg.data[2], params, count);
+    }
+
+    return can_send_message(&msg);
+}
+
+size_t obd2_parse_multi_response(const uint8_t *msg, size_t len, obd2_pid_value_t *out, size_t max) {
+    if (msg == NULL || len < 1 || msg[0] != (OBD2_SERVICE_CURRENT_DATA + 0x40)) {
+        return 0;
+    }
+
+    size_t count = 0;
+    size_t pos = 1;
+    while (pos < len && count < max) {
+        const obd2_pid_t *info = obd2_get_pid_info(msg[pos]);
+        if (info == NULL || info->decode_func == NULL || pos + 1 + info->num_bytes > len) {
+            break;
+        }
+        out[count].pid = msg[pos];
+        out[count].value = info->decode_func(&msg[pos + 1]);
+        count++;
+        pos += 1 + info->num_bytes;
+    }
+    return count;
+}
+
+size_t obd2_parse_supported_pids(const uint8_t *msg, size_t len, obd2_supported_t *supported) {
+    if (msg == NULL || len < 1 || msg[0] != (OBD2_SERVICE_CURRENT_DATA + 0x40)) {
+        return 0;
+    }
+
+    size_t count = 0;
+    size_t pos = 1;
+    while (pos + 5 <= len && msg[pos] % OBD2_SUPPORT_RANGE == 0) {
+        uint32_t map = ((uint32_t)msg[pos + 1] << 24) | ((uint32_t)msg[pos + 2] << 16) |
+                       ((uint32_t)msg[pos + 3] << 8) | msg[pos + 4];
+        // Bit 31 of the map is PID base + 1, bit 0 is PID base + 0x20
+        for (uint32_t i = 0; i < OBD2_SUPPORT_RANGE; i++) {
+            if (map & (0x80000000u >> i)) {
+                uint32_t pid = msg[pos] + 1 + i;
+                if (pid < 256) {
+                    supported->bits[pid / 32] |= 1u << (pid % 32);
+                }
+            }
+        }
+        count++;
+        pos += 5;
+    }
+    return count;
+}
+
 esp_err_t obd2_parse_response(const uint8_t *data, uint8_t *pid, float *value) {
     if (data == NULL || pid == NULL || value == NULL) {
         return ESP_ERR_INVALID_ARG;
@@ -205,11 +267,36 @@ esp_err_t obd2_clear_dtc(void) {
 }
 
 esp_err_t obd2_read_dtc(void) {
-    can_message_t msg = {
-        .identifier = OBD2_REQUEST_CAN_ID,
-        .data_length_code = 8,
-        .data = {0x01, OBD2_SERVICE_DTC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
-    };
-    
-    return can_send_message(&msg);
+    return obd2_request_service(OBD2_SERVICE_DTC, NULL, 0);
+}
+
+size_t obd2_parse_dtcs(const uint8_t *msg, size_t len, uint16_t *codes, size_t max) {
+    if (msg == NULL || len < 2) {
+        return 0;
+    }
+    uint8_t service = msg[0] - 0x40;
+    if (service != OBD2_SERVICE_DTC && service != OBD2_SERVICE_PENDING_DTC &&
+        service != OBD2_SERVICE_PERMANENT_DTC) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (size_t pos = 2; pos + 2 <= len && count < max; pos += 2) {
+        uint16_t code = (uint16_t)((msg[pos] << 8) | msg[pos + 1]);
+        if (code != 0) {
+            codes[count++] = code;
+        }
+    }
+    return count;
+}
+
+void obd2_format_dtc(uint16_t code, char *buf) {
+    static const char system[] = "PCBU";
+    static const char hex[] = "0123456789ABCDEF";
+    buf[0] = system[code >> 14];
+    buf[1] = hex[(code >> 12) & 0x3];
+    buf[2] = hex[(code >> 8) & 0xF];
+    buf[3] = hex[(code >> 4) & 0xF];
+    buf[4] = hex[code & 0xF];
+    buf[5] = '\0';
 }
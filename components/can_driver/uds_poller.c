@@ -0,0 +1,345 @@
+#include "uds_poller.h"
+#include "can_config.h"
+#include "mercedes_decode.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "UDS_POLLER";
+
+// ECU n takes requests on 0x7E0 + n and answers on 0x7E8 + n (inside the
+// response mailbox range, CAN_RESPONSE_ID_FIRST..LAST)
+#define ECU_ENGINE      0
+#define ECU_AIRMATIC    4
+#define NUM_ECUS        8
+
+/*
+ * PLACEHOLDER identifiers: the DIDs, the AIRMATIC address, the record layouts
+ * and the scalings below are not confirmed on a W218 or W212. They exercise
+ * the poller end to end; take the real ones from a diagnostic trace before
+ * trusting the readings.
+ */
+typedef struct {
+    uint8_t ecu;
+    uint16_t did;
+    uint8_t length;             // data record bytes
+    uint16_t period_ms;
+} uds_did_t;
+
+static const uds_did_t dids[] = {
+    { ECU_ENGINE,   0x2001, 4, 100 },    // PLACEHOLDER: charge air pressure actual, target
+    { ECU_ENGINE,   0x2002, 2, 200 },    // PLACEHOLDER: injection quantity
+    { ECU_AIRMATIC, 0x2101, 1, 500 },    // PLACEHOLDER: valve block outputs
+    { ECU_AIRMATIC, 0x2102, 1, 1000 },   // PLACEHOLDER: compressor relay
+};
+
+#define NUM_DIDS (sizeof(dids) / sizeof(dids[0]))
+
+// One value inside a DID record: field = raw * mul / div + add
+typedef struct {
+    uint8_t did;                // index into dids[]
+    uint8_t offset;             // first byte of the big-endian value in the record
+    uint8_t size;               // 1, 2 or 4 bytes
+    bool is_signed;
+    int16_t mul;
+    uint16_t div;
+    int32_t add;
+    uint16_t channel;           // MB_CH_* UDS channel
+} uds_value_t;
+
+static const uds_value_t values[] = {
+    { 0, 0, 2, false, 1, 1,   0, MB_CH_BOOST_PRESSURE_HPA },
+    { 0, 2, 2, false, 1, 1,   0, MB_CH_BOOST_TARGET_HPA },
+    { 1, 0, 2, false, 1, 1,   0, MB_CH_INJECTION_QTY_X100 },
+    { 2, 0, 1, false, 1, 1,   0, MB_CH_AIRMATIC_VALVES },
+    { 3, 0, 1, false, 1, 1,   0, MB_CH_AIRMATIC_COMPRESSOR },
+};
+
+#define NUM_VALUES (sizeof(values) / sizeof(values[0]))
+
+_Static_assert(NUM_DIDS <= 32, "in-flight DID sets are 32-bit masks");
+
+// Scheduling state per dids[] entry
+typedef struct {
+    int64_t deadline_us;        // when the next value is due
+    uint8_t misses;             // consecutive unanswered requests (back-off exponent)
+    bool unsupported;           // ECU refused the DID on its own; not polled until reset
+    bool suspect;               // a batch containing it was refused; next asked alone
+} did_sched_t;
+
+static did_sched_t sched[NUM_DIDS];
+
+// DIDs per request each ECU accepts (halved when it answers a batch with a length error)
+static uint8_t ecu_batch[NUM_ECUS];
+
+// Request in flight
+static uint8_t inflight[UDS_MAX_DIDS_PER_REQUEST];
+static size_t inflight_count;
+static size_t inflight_req_len;
+static int64_t inflight_cost;
+static int64_t inflight_sent_us;
+
+// Token bucket in bit-microseconds: refilled at the budget rate (bits/s) per us,
+// a request is charged its frames' bits times one million
+static const int64_t budget_bps = (int64_t)CAN_BAUDRATE * UDS_BUS_LOAD_PERMILLE / 1000;
+static int64_t tokens;
+static int64_t tokens_us;
+
+static int64_t start_us;
+static uint64_t bus_bits;
+static uds_poller_stats_t stats;
+
+uint32_t uds_poller_frames(size_t len) {
+    if (len <= 7) return 1;
+    // First frame carries 6 bytes, each consecutive frame 7
+    uint32_t cf = (uint32_t)(len - 6 + 7 - 1) / 7;
+    // A block size asks for a flow control before each block
+    uint32_t fc = ISOTP_BLOCK_SIZE ? (cf + ISOTP_BLOCK_SIZE - 1) / ISOTP_BLOCK_SIZE : 1;
+    return 1 + cf + fc;
+}
+
+static size_t response_len(const uint8_t *batch, size_t n) {
+    size_t len = 1;
+    for (size_t k = 0; k < n; k++) {
+        len += 2 + dids[batch[k]].length;
+    }
+    return len;
+}
+
+// Bits a request and its full answer put on the bus
+static uint32_t transaction_bits(size_t req_len, size_t resp_len) {
+    return (uds_poller_frames(req_len) + (resp_len ? uds_poller_frames(resp_len) : 0)) * UDS_FRAME_BITS;
+}
+
+static int64_t bucket_cap(void) {
+    int64_t cap = budget_bps * UDS_BURST_MS * 1000;
+    // Always room for the largest request, however small the burst setting
+    int64_t min_cap = (int64_t)transaction_bits(UDS_MAX_REQUEST_LEN, UDS_MAX_RESPONSE_LEN) * 1000000;
+    return cap < min_cap ? min_cap : cap;
+}
+
+static void bucket_refill(int64_t now_us) {
+    if (now_us > tokens_us) {
+        tokens += (now_us - tokens_us) * budget_bps;
+        tokens_us = now_us;
+    }
+    int64_t cap = bucket_cap();
+    if (tokens > cap) tokens = cap;
+}
+
+static void charge(int64_t cost) {
+    tokens -= cost;
+    bus_bits += (uint64_t)(cost / 1000000);
+}
+
+void uds_poller_reset(int64_t now_us) {
+    memset(sched, 0, sizeof(sched));
+    for (size_t i = 0; i < NUM_DIDS; i++) {
+        sched[i].deadline_us = now_us;
+    }
+    memset(ecu_batch, UDS_DIDS_PER_REQUEST, sizeof(ecu_batch));
+    memset(&stats, 0, sizeof(stats));
+    inflight_count = 0;
+    tokens = bucket_cap();
+    tokens_us = now_us;
+    start_us = now_us;
+    bus_bits = 0;
+}
+
+size_t uds_poller_next(int64_t now_us, uint32_t *ecu, uint8_t *req, int64_t *wait_us) {
+    *wait_us = INT64_MAX;
+
+    // Earliest deadline among the DIDs still polled
+    int first = -1;
+    for (size_t i = 0; i < NUM_DIDS; i++) {
+        if (sched[i].unsupported) continue;
+        if (first < 0 || sched[i].deadline_us < sched[first].deadline_us) first = (int)i;
+    }
+    if (first < 0) {
+        return 0;
+    }
+    // Due once less than one response latency away, so the answer lands around the deadline
+    int64_t horizon = now_us + stats.response_latency_us;
+    if (sched[first].deadline_us > horizon) {
+        *wait_us = sched[first].deadline_us - horizon;
+        return 0;
+    }
+
+    // Batch the due DIDs of the same ECU, earliest first; a suspect DID goes alone.
+    // A DID due within half its period rides along early, which keeps the DIDs of
+    // one ECU in phase and costs no extra requests since its deadline still
+    // advances from where it was.
+    uint8_t batch[UDS_MAX_DIDS_PER_REQUEST];
+    size_t n = 0;
+    uint8_t target = dids[first].ecu;
+    batch[n++] = (uint8_t)first;
+    while (!sched[first].suspect && n < ecu_batch[target]) {
+        int next = -1;
+        for (size_t i = 0; i < NUM_DIDS; i++) {
+            const did_sched_t *s = &sched[i];
+            int64_t early_us = (int64_t)dids[i].period_ms * 500;
+            if (dids[i].ecu != target || s->unsupported || s->suspect || s->deadline_us > horizon + early_us) continue;
+            if (memchr(batch, (int)i, n) != NULL) continue;
+            if (next < 0 || s->deadline_us < sched[next].deadline_us) next = (int)i;
+        }
+        if (next < 0) break;
+        batch[n] = (uint8_t)next;
+        if (response_len(batch, n + 1) > UDS_MAX_RESPONSE_LEN) break;
+        n++;
+    }
+
+    size_t req_len = 1 + 2 * n;
+    int64_t cost = (int64_t)transaction_bits(req_len, response_len(batch, n)) * 1000000;
+    bucket_refill(now_us);
+    if (tokens < cost) {
+        *wait_us = (cost - tokens + budget_bps - 1) / budget_bps;
+        stats.throttled++;
+        return 0;
+    }
+    charge(cost);
+
+    req[0] = UDS_SERVICE_READ_DID;
+    for (size_t k = 0; k < n; k++) {
+        req[1 + 2 * k] = (uint8_t)(dids[batch[k]].did >> 8);
+        req[2 + 2 * k] = (uint8_t)dids[batch[k]].did;
+    }
+    memcpy(inflight, batch, n);
+    inflight_count = n;
+    inflight_req_len = req_len;
+    inflight_cost = cost;
+    inflight_sent_us = now_us;
+    stats.requests++;
+    *ecu = target;
+    return req_len;
+}
+
+// Next deadline: one period on when answered, doubling per consecutive miss
+static void did_advance(size_t i, bool answered, int64_t now_us) {
+    did_sched_t *s = &sched[i];
+    int64_t period_us = (int64_t)dids[i].period_ms * 1000;
+
+    if (answered) {
+        s->misses = 0;
+        s->suspect = false;
+        s->deadline_us += period_us;
+        // Overloaded or throttled: restart the phase instead of bursting to catch up
+        if (s->deadline_us < now_us - period_us) s->deadline_us = now_us;
+    } else {
+        if (s->misses < OBD2_BACKOFF_MAX_SHIFT) s->misses++;
+        s->deadline_us = now_us + (period_us << s->misses);
+    }
+}
+
+static void decode_record(size_t d, const uint8_t *record) {
+    for (size_t v = 0; v < NUM_VALUES; v++) {
+        const uds_value_t *def = &values[v];
+        if (def->did != d) continue;
+        uint32_t raw = 0;
+        for (uint8_t b = 0; b < def->size; b++) {
+            raw = (raw << 8) | record[def->offset + b];
+        }
+        int32_t x = (int32_t)raw;
+        if (def->is_signed && def->size < 4) {
+            uint32_t sext = 32 - 8 * def->size;
+            x = (int32_t)(raw << sext) >> sext;
+        }
+        int32_t field = (int32_t)((int64_t)x * def->mul / def->div) + def->add;
+        mercedes_decode_post(def->channel, field, dids[d].period_ms);
+        stats.values++;
+    }
+}
+
+// Positive answer: records in any order, each DID followed by its record
+static uint32_t parse_positive(const uint8_t *msg, size_t len) {
+    uint32_t answered = 0;
+    size_t pos = 1;
+    while (pos + 2 <= len) {
+        uint16_t did = (uint16_t)((msg[pos] << 8) | msg[pos + 1]);
+        size_t k = 0;
+        while (k < inflight_count && dids[inflight[k]].did != did) k++;
+        if (k == inflight_count) break;                      // not asked: layout unknown, stop
+        size_t d = inflight[k];
+        if (pos + 2 + dids[d].length > len) break;
+        decode_record(d, &msg[pos + 2]);
+        answered |= 1u << k;
+        pos += 2 + dids[d].length;
+    }
+    return answered;
+}
+
+// Negative answer: shrink the batch, isolate an unsupported DID, or count a miss
+static void handle_negative(uint8_t nrc, int64_t now_us) {
+    uint8_t target = dids[inflight[0]].ecu;
+    stats.negative++;
+
+    if ((nrc == UDS_NRC_INCORRECT_LENGTH || nrc == UDS_NRC_RESPONSE_TOO_LONG) && inflight_count > 1) {
+        ecu_batch[target] = (uint8_t)(inflight_count / 2);
+        ESP_LOGW(TAG, "ECU 0x%03X refused %d DIDs per request, now %d", 0x7E0 + target,
+                 (int)inflight_count, ecu_batch[target]);
+        return;                                 // still due, asked again in smaller batches
+    }
+    if (nrc == UDS_NRC_REQUEST_OUT_OF_RANGE) {
+        if (inflight_count > 1) {
+            for (size_t k = 0; k < inflight_count; k++) sched[inflight[k]].suspect = true;
+            return;                             // still due, each asked alone next
+        }
+        sched[inflight[0]].unsupported = true;
+        stats.unsupported++;
+        ESP_LOGW(TAG, "ECU 0x%03X does not support DID 0x%04X", 0x7E0 + target, dids[inflight[0]].did);
+        return;
+    }
+    for (size_t k = 0; k < inflight_count; k++) {
+        did_advance(inflight[k], false, now_us);
+    }
+}
+
+void uds_poller_response(int64_t now_us, const uint8_t *msg, size_t len) {
+    if (inflight_count == 0) {
+        return;
+    }
+
+    // Refund the estimate, charge what the answer actually took
+    int64_t actual = (int64_t)transaction_bits(inflight_req_len, msg ? len : 0) * 1000000;
+    tokens += inflight_cost;
+    bus_bits -= (uint64_t)(inflight_cost / 1000000);
+    charge(actual);
+
+    if (msg == NULL || len == 0) {
+        stats.timeouts++;
+        for (size_t k = 0; k < inflight_count; k++) {
+            did_advance(inflight[k], false, now_us);
+        }
+    } else {
+        uint32_t sample = (uint32_t)(now_us - inflight_sent_us);
+        stats.response_latency_us = stats.response_latency_us == 0 ? sample
+            : stats.response_latency_us - stats.response_latency_us / 8 + sample / 8;
+
+        if (msg[0] == UDS_NEGATIVE_RESPONSE && len >= 3) {
+            handle_negative(msg[2], now_us);
+        } else if (msg[0] == UDS_POSITIVE_RESPONSE(UDS_SERVICE_READ_DID)) {
+            stats.responses++;
+            uint32_t answered = parse_positive(msg, len);
+            for (size_t k = 0; k < inflight_count; k++) {
+                bool got = (answered >> k) & 1u;
+                // Left out of a batch answer: the ECU skips DIDs it does not support
+                if (!got && inflight_count > 1) {
+                    sched[inflight[k]].suspect = true;
+                    continue;
+                }
+                did_advance(inflight[k], got, now_us);
+            }
+        } else {
+            for (size_t k = 0; k < inflight_count; k++) {
+                did_advance(inflight[k], false, now_us);
+            }
+        }
+    }
+    inflight_count = 0;
+
+    if (now_us > start_us) {
+        stats.bus_load_pct = (float)bus_bits * 100.0f * 1e6f / ((float)(now_us - start_us) * CAN_BAUDRATE);
+    }
+}
+
+const uds_poller_stats_t *uds_poller_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,367 @@
+#include "canlog.h"
+#include <string.h>
+
+static size_t put_u32(uint8_t *out, uint32_t v)
+{
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+    return 4;
+}
+
+static size_t put_varint(uint8_t *out, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+void canlog_begin(canlog_encoder_t *enc, canlog_header_t *hdr, uint32_t flags,
+                  uint64_t start_us, int64_t wall_time, uint32_t bitrate)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, CANLOG_MAGIC, sizeof(hdr->magic));
+    hdr->version = CANLOG_VERSION;
+    hdr->header_len = sizeof(*hdr);
+    hdr->flags = flags;
+    hdr->start_us = start_us;
+    hdr->wall_time = wall_time;
+    hdr->bitrate = bitrate;
+    hdr->sync_interval_ms = CANLOG_SYNC_INTERVAL_MS;
+
+    memset(enc, 0, sizeof(*enc));
+    enc->sync_interval_us = CANLOG_SYNC_INTERVAL_MS * 1000u;
+    enc->xor_payloads = (flags & CANLOG_FLAG_COMPRESSED) != 0;
+    canlog_begin_chunk(enc);
+}
+
+void canlog_begin_chunk(canlog_encoder_t *enc)
+{
+    enc->synced = 0;
+    for (size_t i = 0; i < CANLOG_XOR_CACHE_SIZE; i++) {
+        enc->cache[i].id = CANLOG_NO_ID;
+    }
+}
+
+static size_t encode_sync(canlog_encoder_t *enc, uint8_t *out, uint64_t time_us)
+{
+    out[0] = CANLOG_SYNC_TAG;
+    out[1] = 'S';
+    out[2] = 'Y';
+    out[3] = 'N';
+    put_u32(&out[4], (uint32_t)time_us);
+    put_u32(&out[8], (uint32_t)(time_us >> 32));
+    put_u32(&out[12], enc->frames);
+
+    enc->last_us = time_us;
+    enc->last_sync_us = time_us;
+    enc->synced = 1;
+    return CANLOG_SYNC_LEN;
+}
+
+size_t canlog_encode_frame(canlog_encoder_t *enc, uint8_t *out, uint64_t time_us,
+                           uint32_t can_id, const uint8_t *data, uint8_t dlc)
+{
+    size_t n = 0;
+    if (dlc > 8) dlc = 8;
+
+    // A sync is due on schedule and if time went backwards, which also keeps
+    // every delta below the sync interval
+    if (!enc->synced || time_us < enc->last_us ||
+        time_us - enc->last_sync_us >= enc->sync_interval_us) {
+        n += encode_sync(enc, out, time_us);
+    }
+
+    uint8_t extended = can_id > 0x7FF;
+    uint8_t tag = (uint8_t)((extended ? CANLOG_FRAME_EXTENDED : 0) | dlc);
+    canlog_payload_t *prev = NULL;
+    if (enc->xor_payloads) {
+        // Unchanged bytes become zeros; a slot taken by another ID is replaced
+        prev = &enc->cache[(can_id ^ (can_id >> 8)) % CANLOG_XOR_CACHE_SIZE];
+        if (prev->id == can_id) {
+            tag |= CANLOG_FRAME_XOR;
+        }
+    }
+    out[n++] = tag;
+    n += put_varint(&out[n], (uint32_t)(time_us - enc->last_us));
+    if (extended) {
+        n += put_u32(&out[n], can_id & 0x1FFFFFFF);
+    } else {
+        out[n++] = (uint8_t)can_id;
+        out[n++] = (uint8_t)(can_id >> 8);
+    }
+    if (tag & CANLOG_FRAME_XOR) {
+        for (uint8_t i = 0; i < dlc; i++) {
+            out[n + i] = data[i] ^ prev->data[i];
+        }
+    } else {
+        memcpy(&out[n], data, dlc);
+    }
+    n += dlc;
+    if (prev) {
+        prev->id = can_id;
+        memset(prev->data, 0, sizeof(prev->data));
+        memcpy(prev->data, data, dlc);
+    }
+
+    enc->last_us = time_us;
+    enc->frames++;
+    return n;
+}
+
+// LZ4 block format: sequences of [token][literal length][literals][offset][match length].
+// Greedy single-probe matcher, hash of the next 4 bytes. The format's end rules
+// hold: the last 5 bytes are literals and no match starts in the last 12.
+#define LZ_MIN_MATCH        4
+#define LZ_LAST_LITERALS    5
+#define LZ_MATCH_LIMIT      12
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - CANLOG_LZ_HASH_BITS);
+}
+
+static uint8_t *lz_length(uint8_t *op, size_t len)
+{
+    for (; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// Returns the compressed length, 0 if it would not fit in limit bytes
+static size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t limit, uint16_t *table)
+{
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + len;
+    const uint8_t *match_end = end - LZ_LAST_LITERALS;
+    uint8_t *op = dst;
+    uint8_t *op_limit = dst + limit;
+
+    memset(table, 0, sizeof(uint16_t) << CANLOG_LZ_HASH_BITS);
+    while (len > LZ_MATCH_LIMIT && ip < end - LZ_MATCH_LIMIT) {
+        uint32_t seq = read32(ip);
+        uint32_t h = lz_hash(seq);
+        const uint8_t *ref = src + table[h];
+        table[h] = (uint16_t)(ip - src);
+        if (ref >= ip || read32(ref) != seq) {
+            ip++;
+            continue;
+        }
+
+        while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+            ip--;
+            ref--;
+        }
+        const uint8_t *mp = ip + LZ_MIN_MATCH;
+        const uint8_t *rp = ref + LZ_MIN_MATCH;
+        while (mp < match_end && *mp == *rp) {
+            mp++;
+            rp++;
+        }
+
+        size_t lit = (size_t)(ip - anchor);
+        size_t mlen = (size_t)(mp - ip) - LZ_MIN_MATCH;
+        if (op + 1 + lit + lit / 255 + 1 + 2 + mlen / 255 + 1 > op_limit) {
+            return 0;
+        }
+        uint8_t *token = op++;
+        *token = (uint8_t)(((lit >= 15 ? 15 : lit) << 4) | (mlen >= 15 ? 15 : mlen));
+        if (lit >= 15) op = lz_length(op, lit - 15);
+        memcpy(op, anchor, lit);
+        op += lit;
+        uint16_t offset = (uint16_t)(ip - ref);
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        if (mlen >= 15) op = lz_length(op, mlen - 15);
+
+        ip = mp;
+        anchor = ip;
+    }
+
+    size_t lit = (size_t)(end - anchor);
+    if (op + 1 + lit + lit / 255 + 1 > op_limit) {
+        return 0;
+    }
+    *op++ = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+    if (lit >= 15) op = lz_length(op, lit - 15);
+    memcpy(op, anchor, lit);
+    op += lit;
+    return (size_t)(op - dst);
+}
+
+size_t canlog_compress_chunk(const uint8_t *chunk, size_t len, uint8_t *out, uint16_t *table)
+{
+    uint8_t *data = &out[CANLOG_BLOCK_HEADER_LEN];
+    size_t n = lz_compress(chunk, len, data, len, table);
+    uint8_t flags = 0;
+    if (n == 0) {
+        memcpy(data, chunk, len);
+        n = len;
+        flags = CANLOG_BLOCK_STORED;
+    }
+
+    out[0] = CANLOG_BLOCK_TAG;
+    out[1] = 'C';
+    out[2] = 'B';
+    out[3] = flags;
+    out[4] = (uint8_t)len;
+    out[5] = (uint8_t)(len >> 8);
+    out[6] = (uint8_t)n;
+    out[7] = (uint8_t)(n >> 8);
+    return CANLOG_BLOCK_HEADER_LEN + n;
+}
+
+void canlog_decoder_init(canlog_decoder_t *dec, uint32_t flags)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->xor_payloads = (flags & CANLOG_FLAG_COMPRESSED) != 0;
+    canlog_decoder_begin_chunk(dec);
+}
+
+void canlog_decoder_begin_chunk(canlog_decoder_t *dec)
+{
+    dec->synced = 0;
+    for (size_t i = 0; i < CANLOG_XOR_CACHE_SIZE; i++) {
+        dec->cache[i].id = CANLOG_NO_ID;
+    }
+}
+
+int canlog_decode_record(canlog_decoder_t *dec, const uint8_t *buf, size_t len,
+                         canlog_frame_t *frame, bool *is_frame)
+{
+    *is_frame = false;
+    if (len == 0) return 0;
+
+    uint8_t tag = buf[0];
+    if (tag == CANLOG_SYNC_TAG) {
+        if (len < CANLOG_SYNC_LEN) return 0;
+        if (buf[1] != 'S' || buf[2] != 'Y' || buf[3] != 'N') return -1;
+        dec->time_us = (uint64_t)read32(&buf[4]) | (uint64_t)read32(&buf[8]) << 32;
+        dec->frames = read32(&buf[12]);
+        dec->synced = 1;
+        return CANLOG_SYNC_LEN;
+    }
+
+    // Without a sync there is no time to add deltas to
+    uint8_t dlc = tag & CANLOG_FRAME_DLC_MASK;
+    uint8_t bad_bits = dec->xor_payloads ? 0xC0 : 0xC0 | CANLOG_FRAME_XOR;
+    if ((tag & bad_bits) || dlc > 8 || !dec->synced) return -1;
+
+    // An all-zero stretch is preallocated space the writer never reached
+    if (tag == 0 && len >= CANLOG_SYNC_LEN) {
+        size_t i = 1;
+        while (i < CANLOG_SYNC_LEN && buf[i] == 0) i++;
+        if (i == CANLOG_SYNC_LEN) return -1;
+    }
+
+    size_t n = 1;
+    uint32_t delta = 0;
+    for (int shift = 0;; shift += 7) {
+        if (n >= len) return 0;
+        if (shift > 28) return -1;
+        uint8_t b = buf[n++];
+        delta |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+    }
+
+    size_t id_len = (tag & CANLOG_FRAME_EXTENDED) ? 4 : 2;
+    if (n + id_len + dlc > len) return 0;
+    frame->can_id = id_len == 4 ? read32(&buf[n]) : (uint32_t)(buf[n] | buf[n + 1] << 8);
+    n += id_len;
+    frame->dlc = dlc;
+    memset(frame->data, 0, sizeof(frame->data));
+    memcpy(frame->data, &buf[n], dlc);
+    n += dlc;
+
+    if (dec->xor_payloads) {
+        canlog_payload_t *prev = &dec->cache[(frame->can_id ^ (frame->can_id >> 8)) % CANLOG_XOR_CACHE_SIZE];
+        if (tag & CANLOG_FRAME_XOR) {
+            if (prev->id != frame->can_id) return -1;
+            for (uint8_t i = 0; i < dlc; i++) {
+                frame->data[i] ^= prev->data[i];
+            }
+        }
+        prev->id = frame->can_id;
+        memcpy(prev->data, frame->data, sizeof(prev->data));
+    }
+
+    dec->time_us += delta;
+    dec->frames++;
+    frame->time_us = dec->time_us;
+    *is_frame = true;
+    return (int)n;
+}
+
+// Bounds-checked LZ4 block decoder for the blocks canlog_compress_chunk() writes
+static size_t lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t raw_len)
+{
+    const uint8_t *ip = src;
+    const uint8_t *end = src + len;
+    uint8_t *op = dst;
+    uint8_t *op_end = dst + raw_len;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= end) return 0;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (size_t)(end - ip) || lit > (size_t)(op_end - op)) return 0;
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == end) break;   // the last sequence has literals only
+
+        if (end - ip < 2) return 0;
+        size_t offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        size_t mlen = (token & 0x0F) + LZ_MIN_MATCH;
+        if ((token & 0x0F) == 15) {
+            uint8_t b;
+            do {
+                if (ip >= end) return 0;
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        if (offset == 0 || offset > (size_t)(op - dst) || mlen > (size_t)(op_end - op)) return 0;
+        // Byte by byte: a match may overlap its own output
+        const uint8_t *ref = op - offset;
+        for (size_t i = 0; i < mlen; i++) {
+            op[i] = ref[i];
+        }
+        op += mlen;
+    }
+    return (size_t)(op - dst);
+}
+
+size_t canlog_decompress_block(const uint8_t *data, size_t len, uint8_t flags,
+                               uint8_t *out, size_t raw_len)
+{
+    if (flags & CANLOG_BLOCK_STORED) {
+        if (len != raw_len) return 0;
+        memcpy(out, data, len);
+        return raw_len;
+    }
+    return lz_decompress(data, len, out, raw_len) == raw_len ? raw_len : 0;
+}
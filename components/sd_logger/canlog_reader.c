@@ -0,0 +1,227 @@
+#include "canlog_reader.h"
+#include <string.h>
+
+static bool is_compressed(const canlog_reader_t *r)
+{
+    return (r->header.flags & CANLOG_FLAG_COMPRESSED) != 0;
+}
+
+static bool read_at(FILE *f, uint32_t offset, void *buf, size_t len)
+{
+    return fseek(f, offset, SEEK_SET) == 0 && fread(buf, 1, len, f) == len;
+}
+
+static bool read_entry(canlog_reader_t *r, uint32_t i, canlog_index_entry_t *e)
+{
+    return read_at(r->index, sizeof(canlog_index_header_t) + i * sizeof(*e), e, sizeof(*e));
+}
+
+// Use the sidecar only if it belongs to this log
+static void open_index(canlog_reader_t *r, const char *path)
+{
+    char idx_path[160];
+    const char *dot = strrchr(path, '.');
+    size_t base = dot && !strchr(dot, '/') ? (size_t)(dot - path) : strlen(path);
+    if (base + sizeof(CANLOG_INDEX_EXTENSION) > sizeof(idx_path)) return;
+    memcpy(idx_path, path, base);
+    memcpy(&idx_path[base], CANLOG_INDEX_EXTENSION, sizeof(CANLOG_INDEX_EXTENSION));
+
+    r->index = fopen(idx_path, "rb");
+    if (!r->index) return;
+
+    canlog_index_header_t hdr;
+    long size = -1;
+    if (read_at(r->index, 0, &hdr, sizeof(hdr)) && fseek(r->index, 0, SEEK_END) == 0) {
+        size = ftell(r->index);
+    }
+    if (size < (long)sizeof(hdr) || memcmp(hdr.magic, CANLOG_INDEX_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != CANLOG_INDEX_VERSION || hdr.entry_size != sizeof(canlog_index_entry_t) ||
+        hdr.start_us != r->header.start_us) {
+        fclose(r->index);
+        r->index = NULL;
+        return;
+    }
+    // A batch cut off mid-entry leaves a partial entry at the end, which is not counted
+    r->index_count = (uint32_t)((size - sizeof(hdr)) / sizeof(canlog_index_entry_t));
+}
+
+// Decode the block at next_offset into buf
+static bool load_block(canlog_reader_t *r)
+{
+    uint8_t *h = r->block;
+    if (r->next_offset + CANLOG_BLOCK_HEADER_LEN > r->log_size ||
+        !read_at(r->log, r->next_offset, h, CANLOG_BLOCK_HEADER_LEN)) {
+        return false;
+    }
+    uint32_t raw_len = h[4] | h[5] << 8;
+    uint32_t data_len = h[6] | h[7] << 8;
+    if (h[0] != CANLOG_BLOCK_TAG || h[1] != 'C' || h[2] != 'B' || (h[3] & ~CANLOG_BLOCK_STORED) ||
+        raw_len == 0 || raw_len > CANLOG_CHUNK_SIZE || data_len > CANLOG_CHUNK_SIZE ||
+        fread(&h[CANLOG_BLOCK_HEADER_LEN], 1, data_len, r->log) != data_len ||
+        canlog_decompress_block(&h[CANLOG_BLOCK_HEADER_LEN], data_len, h[3], r->buf, raw_len) != raw_len) {
+        return false;
+    }
+    r->buf_len = raw_len;
+    r->buf_pos = 0;
+    r->next_offset += CANLOG_BLOCK_HEADER_LEN + data_len;
+    canlog_decoder_begin_chunk(&r->dec);
+    return true;
+}
+
+// Slide the window of a plain file up to the unread bytes and fill it
+static void refill_window(canlog_reader_t *r)
+{
+    uint32_t left = r->buf_len - r->buf_pos;
+    memmove(r->buf, &r->buf[r->buf_pos], left);
+    r->buf_len = left;
+    r->buf_pos = 0;
+
+    uint32_t n = sizeof(r->buf) - left;
+    if (n > r->log_size - r->next_offset) n = r->log_size - r->next_offset;
+    if (n > 0 && fseek(r->log, r->next_offset, SEEK_SET) == 0) {
+        size_t got = fread(&r->buf[left], 1, n, r->log);
+        r->buf_len += got;
+        r->next_offset += got;
+    }
+}
+
+// Start decoding at a keyframe: a sync record, or a block in a compressed file
+static bool start_at(canlog_reader_t *r, uint32_t offset)
+{
+    r->next_offset = offset;
+    r->buf_len = 0;
+    r->buf_pos = 0;
+    r->counted = false;
+    r->ended = false;
+    r->pending = false;
+    canlog_decoder_begin_chunk(&r->dec);
+    if (offset >= r->log_size) {
+        r->ended = true;
+        return false;
+    }
+    if (is_compressed(r)) {
+        r->ended = !load_block(r);
+    } else {
+        refill_window(r);
+    }
+    return !r->ended;
+}
+
+// Decode the next record: 1 for a frame, 0 for a sync record, -1 at the end
+static int step(canlog_reader_t *r, canlog_frame_t *frame)
+{
+    while (!r->ended) {
+        if (!is_compressed(r) && r->buf_len - r->buf_pos < CANLOG_MAX_RECORD_LEN) {
+            refill_window(r);
+        }
+        uint32_t left = r->buf_len - r->buf_pos;
+        if (left == 0) {
+            if (is_compressed(r) && load_block(r)) continue;
+            break;
+        }
+
+        // Damage, space never written, or a record cut off by the end of the file
+        uint32_t expected = r->dec.frames;
+        bool is_frame;
+        int n = canlog_decode_record(&r->dec, &r->buf[r->buf_pos], left, frame, &is_frame);
+        if (n <= 0) break;
+        r->buf_pos += n;
+        if (is_frame) return 1;
+
+        // A sync whose count does not follow on is left over from an older file on the card
+        if (r->counted && r->dec.frames != expected) break;
+        r->counted = true;
+        return 0;
+    }
+    r->ended = true;
+    return -1;
+}
+
+esp_err_t canlog_reader_open(canlog_reader_t *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+    r->log = fopen(path, "rb");
+    if (!r->log) return ESP_ERR_NOT_FOUND;
+
+    long size = -1;
+    if (read_at(r->log, 0, &r->header, sizeof(r->header)) && fseek(r->log, 0, SEEK_END) == 0) {
+        size = ftell(r->log);
+    }
+    if (size < (long)sizeof(r->header) || memcmp(r->header.magic, CANLOG_MAGIC, sizeof(r->header.magic)) != 0 ||
+        r->header.version != CANLOG_VERSION || r->header.header_len < sizeof(r->header) ||
+        (r->header.flags & ~CANLOG_FLAG_COMPRESSED)) {
+        fclose(r->log);
+        r->log = NULL;
+        return ESP_ERR_INVALID_VERSION;
+    }
+    r->log_size = (uint32_t)size;
+
+    canlog_decoder_init(&r->dec, r->header.flags);
+    open_index(r, path);
+    start_at(r, r->header.header_len);
+    return ESP_OK;
+}
+
+void canlog_reader_close(canlog_reader_t *r)
+{
+    if (r->log) fclose(r->log);
+    if (r->index) fclose(r->index);
+    r->log = NULL;
+    r->index = NULL;
+}
+
+esp_err_t canlog_reader_seek(canlog_reader_t *r, uint64_t time_us)
+{
+    canlog_frame_t frame;
+    bool positioned = false;
+
+    while (r->index_count > 0) {
+        // Last keyframe at or before time_us
+        uint32_t lo = 0;
+        uint32_t hi = r->index_count;
+        canlog_index_entry_t e;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (read_entry(r, mid, &e) && e.time_us <= time_us) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == 0) break;
+
+        if (read_entry(r, lo - 1, &e) && e.offset >= r->header.header_len && start_at(r, e.offset) &&
+            step(r, &frame) == 0 && r->dec.time_us == e.time_us && r->dec.frames == e.frames) {
+            positioned = true;
+            break;
+        }
+        // The sidecar ran ahead of what reached the card; drop this entry and those after it
+        r->index_count = lo - 1;
+    }
+    if (!positioned) {
+        start_at(r, r->header.header_len);
+    }
+
+    int k;
+    while ((k = step(r, &frame)) >= 0) {
+        if (k == 1 && frame.time_us >= time_us) {
+            r->next = frame;
+            r->pending = true;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t canlog_reader_next(canlog_reader_t *r, canlog_frame_t *frame)
+{
+    if (r->pending) {
+        *frame = r->next;
+        r->pending = false;
+        return ESP_OK;
+    }
+    int k;
+    while ((k = step(r, frame)) == 0) {
+    }
+    return k == 1 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
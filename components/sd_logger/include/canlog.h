@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Binary CAN session log (.cbl)
+//
+// File:   header (canlog_header_t) followed by records, little-endian throughout.
+// Frame:  tag, time delta, ID, payload
+//           tag    bit 7 = 0, bit 5 = payload XORed with the previous payload of
+//                  the same ID, bit 4 = 29-bit ID, bits 0-3 = DLC (0-8)
+//           delta  µs since the previous record, unsigned LEB128 (1-3 bytes in practice)
+//           ID     2 bytes (11-bit) or 4 bytes (29-bit)
+//           data   DLC bytes
+// Sync:   CANLOG_SYNC_TAG, "SYN", absolute time u64 µs, frames so far u32 (16 bytes)
+//         Written first and then every sync_interval_ms of log time; deltas restart
+//         from it, so a reader can pick up at any sync after a damaged stretch.
+// Compressed files (CANLOG_FLAG_COMPRESSED):
+//         the records after the header are cut into chunks of at most
+//         CANLOG_CHUNK_SIZE bytes, each stored as a block: CANLOG_BLOCK_TAG, "CB",
+//         flags, raw length u16, data length u16, then the chunk in LZ4 block
+//         format (or as is with CANLOG_BLOCK_STORED). Every chunk starts with a
+//         sync record and XOR references never cross chunks, so each block
+//         decodes on its own and a truncated file decodes up to its last whole block.
+//         XORed payloads only appear in compressed files, where the many zero
+//         bytes of unchanged signals are what the LZ stage removes.
+// Index:  a sidecar (.idx) next to the log: canlog_index_header_t, then one
+//         canlog_index_entry_t per keyframe, at least SD_LOG_INDEX_INTERVAL_MS
+//         apart. A keyframe is a sync record (plain) or a block (compressed),
+//         where decoding can start. Entries are written in batches, so after a
+//         power cut the last ones may be missing; readers (canlog_reader.h)
+//         scan on from the last entry that checks out.
+// Tools:  tools/canlog2csv.py converts a file to the CSV layout of the text logs.
+
+#define CANLOG_MAGIC            "MBCANLOG"
+#define CANLOG_VERSION          1
+#define CANLOG_EXTENSION        ".cbl"
+
+#define CANLOG_INDEX_MAGIC      "MBCANIDX"
+#define CANLOG_INDEX_VERSION    1
+#define CANLOG_INDEX_EXTENSION  ".idx"
+
+// canlog_header_t flags
+#define CANLOG_FLAG_COMPRESSED  0x01
+
+#define CANLOG_FRAME_XOR        0x20
+#define CANLOG_FRAME_EXTENDED   0x10
+#define CANLOG_FRAME_DLC_MASK   0x0F
+#define CANLOG_SYNC_TAG         0x80
+#define CANLOG_SYNC_LEN         16
+
+#define CANLOG_BLOCK_TAG        0x81
+#define CANLOG_BLOCK_HEADER_LEN 8
+#define CANLOG_BLOCK_STORED     0x01    // block flag: chunk not compressed
+
+// Default time between sync records
+#define CANLOG_SYNC_INTERVAL_MS 1000
+
+// Longest output of one canlog_encode_frame() call: sync + tag + 5-byte delta + 29-bit ID + data
+#define CANLOG_MAX_RECORD_LEN   (CANLOG_SYNC_LEN + 1 + 5 + 4 + 8)
+
+// Compression: raw chunk size (also the LZ window), payload cache slots, match hash size
+#define CANLOG_CHUNK_SIZE       4096
+#define CANLOG_XOR_CACHE_SIZE   256
+#define CANLOG_LZ_HASH_BITS     11
+
+// Largest block canlog_compress_chunk() produces for a chunk of n bytes
+#define CANLOG_BLOCK_BOUND(n)   (CANLOG_BLOCK_HEADER_LEN + (n))
+
+typedef struct __attribute__((packed)) {
+    char magic[8];              // CANLOG_MAGIC, not terminated
+    uint16_t version;           // CANLOG_VERSION
+    uint16_t header_len;        // sizeof(canlog_header_t); records start here
+    uint32_t flags;             // CANLOG_FLAG_*
+    uint64_t start_us;          // esp_timer time of the session start
+    int64_t wall_time;          // UNIX time of the session start, 0 if the clock was not set
+    uint32_t bitrate;           // CAN bit rate
+    uint32_t sync_interval_ms;
+} canlog_header_t;
+
+typedef struct __attribute__((packed)) {
+    char magic[8];              // CANLOG_INDEX_MAGIC
+    uint16_t version;           // CANLOG_INDEX_VERSION
+    uint16_t entry_size;        // sizeof(canlog_index_entry_t)
+    uint32_t interval_ms;       // least time between entries
+    uint64_t start_us;          // start_us of the log it indexes
+} canlog_index_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t time_us;           // time of the keyframe's sync record
+    uint32_t offset;            // file offset of the sync record or block
+    uint32_t frames;            // frames before it
+} canlog_index_entry_t;
+
+typedef struct {
+    uint32_t id;                // CANLOG_NO_ID when free
+    uint8_t data[8];            // last payload, zero-padded
+} canlog_payload_t;
+
+#define CANLOG_NO_ID            0xFFFFFFFFu
+
+typedef struct {
+    uint64_t last_us;           // time of the previous record
+    uint64_t last_sync_us;
+    uint32_t frames;
+    uint32_t sync_interval_us;
+    uint8_t synced;             // 0 until the first sync record of the file or chunk
+    uint8_t xor_payloads;       // compressed file: XOR payloads against the cache
+    canlog_payload_t cache[CANLOG_XOR_CACHE_SIZE];  // direct-mapped by ID
+} canlog_encoder_t;
+
+typedef struct {
+    uint64_t time_us;           // time of the last record
+    uint32_t frames;            // frames decoded, set from each sync record
+    uint8_t synced;             // 0 until a sync record of the current chunk
+    uint8_t xor_payloads;
+    canlog_payload_t cache[CANLOG_XOR_CACHE_SIZE];
+} canlog_decoder_t;
+
+typedef struct {
+    uint64_t time_us;
+    uint32_t can_id;
+    uint8_t dlc;
+    uint8_t data[8];
+} canlog_frame_t;
+
+// Fill in a header and reset the encoder for a new file
+// flags: CANLOG_FLAG_COMPRESSED to write XORed payloads for canlog_compress_chunk()
+void canlog_begin(canlog_encoder_t *enc, canlog_header_t *hdr, uint32_t flags,
+                  uint64_t start_us, int64_t wall_time, uint32_t bitrate);
+
+// Encode one frame, preceded by a sync record when one is due
+// out must hold CANLOG_MAX_RECORD_LEN bytes; returns the bytes written
+size_t canlog_encode_frame(canlog_encoder_t *enc, uint8_t *out, uint64_t time_us,
+                           uint32_t can_id, const uint8_t *data, uint8_t dlc);
+
+// Start a new chunk: the next frame opens with a sync record and no payload
+// refers back to the previous chunk
+void canlog_begin_chunk(canlog_encoder_t *enc);
+
+// Pack a chunk of records into a block (header + LZ4 data, or stored if that is smaller)
+// out must hold CANLOG_BLOCK_BOUND(len) bytes; table is scratch of 1 << CANLOG_LZ_HASH_BITS entries
+// Returns the block length
+size_t canlog_compress_chunk(const uint8_t *chunk, size_t len, uint8_t *out, uint16_t *table);
+
+// Reset a decoder for a file with this header (flags from canlog_header_t)
+void canlog_decoder_init(canlog_decoder_t *dec, uint32_t flags);
+
+// Forget chunk state before decoding the records of a new block
+void canlog_decoder_begin_chunk(canlog_decoder_t *dec);
+
+// Decode one record from buf
+// Returns the bytes used (with *is_frame set and frame filled for a frame
+// record), 0 if buf ends inside the record, -1 if buf does not start with a
+// valid record (damage, or space the writer never reached)
+int canlog_decode_record(canlog_decoder_t *dec, const uint8_t *buf, size_t len,
+                         canlog_frame_t *frame, bool *is_frame);
+
+// Unpack the data of a block (after its header) into out, which holds raw_len bytes
+// Returns raw_len, 0 if the data is damaged
+size_t canlog_decompress_block(const uint8_t *data, size_t len, uint8_t flags,
+                               uint8_t *out, size_t raw_len);
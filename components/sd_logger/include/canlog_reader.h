@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "canlog.h"
+
+// Reads a binary session log (.cbl) frame by frame from any point in time.
+//
+// Seeking binary-searches the log's index sidecar (.idx, see canlog.h) for the
+// last keyframe at or before the target, so it costs O(log n) small reads plus
+// decoding up to SD_LOG_INDEX_INTERVAL_MS of frames. Index entries are checked
+// against the log before use; past the last one that checks out (a sidecar cut
+// short by a power loss, or none at all) the reader scans on from there.
+// Reading stops at the first record that does not decode, which is where a file
+// cut short ends.
+
+// Plain files are read through a window of this size
+#define CANLOG_READER_WINDOW    4096
+
+typedef struct {
+    FILE *log;
+    FILE *index;                // NULL when there is no usable sidecar
+    canlog_header_t header;
+    uint32_t log_size;
+    uint32_t index_count;       // entries in the sidecar that may be used
+    canlog_decoder_t dec;
+
+    // Decoded input: a window of a plain file, or the chunk of the current block
+    uint8_t buf[CANLOG_READER_WINDOW > CANLOG_CHUNK_SIZE ? CANLOG_READER_WINDOW : CANLOG_CHUNK_SIZE];
+    uint32_t buf_len;
+    uint32_t buf_pos;
+    uint32_t next_offset;       // file offset of the next window or block
+    uint8_t block[CANLOG_BLOCK_BOUND(CANLOG_CHUNK_SIZE)];
+
+    bool counted;               // dec.frames follows on from a sync record
+    bool ended;
+    bool pending;               // frame found by canlog_reader_seek(), returned next
+    canlog_frame_t next;
+} canlog_reader_t;
+
+// Open a log and its index sidecar (same name, CANLOG_INDEX_EXTENSION), if it has one
+// Reading starts at the first frame
+// Returns ESP_ERR_NOT_FOUND if the file cannot be opened, ESP_ERR_INVALID_VERSION
+// if it is not a binary log this reader understands
+esp_err_t canlog_reader_open(canlog_reader_t *r, const char *path);
+
+void canlog_reader_close(canlog_reader_t *r);
+
+// Position the reader at the first frame at or after time_us (esp_timer time, as
+// in canlog_frame_t; the session started at header.start_us)
+// Returns ESP_ERR_NOT_FOUND if the log ends before time_us
+esp_err_t canlog_reader_seek(canlog_reader_t *r, uint64_t time_us);
+
+// Read the next frame
+// Returns ESP_ERR_NOT_FOUND at the end of the log
+esp_err_t canlog_reader_next(canlog_reader_t *r, canlog_frame_t *frame);
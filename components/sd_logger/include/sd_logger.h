@@ -10,12 +10,94 @@
 #define SD_PIN_SCLK  18
 #define SD_PIN_CS     5
 
-// Mount point
+// Mount point (the host tests point it at a directory of their build tree)
+#ifndef SD_MOUNT_POINT
 #define SD_MOUNT_POINT "/sdcard"
+#endif
 
 // Minimum session duration (seconds) to keep log file
 #define MIN_SESSION_SECONDS 300  // 5 minutes
 
+// FAT allocation unit used when the card is formatted; session files are written
+// in blocks of this size, so full-block writes start on a cluster boundary
+#define SD_ALLOCATION_UNIT   (16 * 1024)
+#define SD_LOG_BLOCK_SIZE    SD_ALLOCATION_UNIT   // two of these are allocated from DMA RAM
+
+// Session files grow in steps of this size and are trimmed to their length when closed
+#define SD_LOG_PREALLOC_SIZE (4 * 1024 * 1024)
+
+// Longest time logged data stays in RAM before it is written and synced
+#define SD_LOG_FLUSH_MS      1000
+
+// Binary sessions get an index sidecar (.idx, see canlog.h) with a keyframe at
+// least this far apart in log time; sd_flush writes its entries in batches
+#define SD_LOG_INDEX_INTERVAL_MS 2000
+#define SD_LOG_INDEX_BATCH       32
+
+// Bus bit rate recorded in binary log headers (CAN_BAUDRATE of the CAN driver)
+#define SD_LOG_CAN_BITRATE 500000
+
+// Session file format, chosen at runtime with sd_logger_set_format()
+typedef enum {
+    SD_LOG_FORMAT_CSV,      // text, one line per frame (.csv)
+    SD_LOG_FORMAT_BINARY,   // packed records, see canlog.h (.cbl)
+    SD_LOG_FORMAT_COMPRESSED,   // packed records, XOR + LZ4 per 4 KB chunk (.cbl)
+} sd_log_format_t;
+
+#define SD_LOG_DEFAULT_FORMAT SD_LOG_FORMAT_COMPRESSED
+
+typedef struct {
+    uint32_t frames;        // frames written in the current session
+    uint32_t bytes;         // bytes written in the current session
+    uint32_t raw_bytes;     // record bytes before compression (= bytes when not compressed)
+    uint32_t dropped;       // frames lost to a full queue since boot
+    uint32_t encode_us;     // time spent formatting and compressing the current session's frames
+    uint32_t blocks;        // full blocks written
+    uint32_t write_us;      // time spent in write, preallocation and fsync calls
+    uint32_t max_write_us;  // longest of those calls (worst write stall)
+    uint32_t buffer_wait_us;    // time the writer waited for the other block to be written
+    uint16_t queue_high_water;  // most frames waiting in the log queue
+    float write_mb_s;       // sustained card throughput: bytes written / write_us
+} sd_logger_stats_t;
+
+// Per-minute summary sidecar (.sum next to the session file): min, max and mean
+// of a few decoded signals for every minute of the session, so a session's
+// timeline loads from a few KB instead of the whole log. Signals are named with
+// sd_logger_summary_define() and fed with sd_logger_summary_add().
+// File: sd_log_summary_header_t, one sd_log_summary_signal_t per signal, then
+//       one row per minute that had samples: minute since the session start (u32)
+//       and one sd_log_summary_value_t per signal, written as each minute closes.
+// tools/logsummary.py rebuilds it from an older .cbl or .csv session.
+#define SD_LOG_SUMMARY_MAGIC       "MBCANSUM"
+#define SD_LOG_SUMMARY_VERSION     1
+#define SD_LOG_SUMMARY_EXTENSION   ".sum"
+#define SD_LOG_SUMMARY_MAX_SIGNALS 8
+#define SD_LOG_SUMMARY_PERIOD_S    60
+
+typedef struct __attribute__((packed)) {
+    char magic[8];          // SD_LOG_SUMMARY_MAGIC
+    uint16_t version;       // SD_LOG_SUMMARY_VERSION
+    uint16_t header_len;    // this header and the signal table; rows start here
+    uint16_t signals;
+    uint16_t period_s;      // SD_LOG_SUMMARY_PERIOD_S
+    uint64_t start_us;      // esp_timer time of the session start
+    int64_t wall_time;      // UNIX time of the session start, 0 if the clock was not set
+} sd_log_summary_header_t;
+
+typedef struct __attribute__((packed)) {
+    char name[23];          // decoder channel name, zero-padded (not terminated at full length)
+    uint8_t decimals;       // values are the physical value × 10^decimals
+} sd_log_summary_signal_t;
+
+typedef struct __attribute__((packed)) {
+    int32_t min;
+    int32_t max;
+    int32_t mean;           // rounded
+    uint32_t samples;       // 0 if the signal had no value that minute (the rest is 0 too)
+} sd_log_summary_value_t;
+
+#define SD_LOG_SUMMARY_ROW_LEN(signals) (sizeof(uint32_t) + (signals) * sizeof(sd_log_summary_value_t))
+
 // Initialize SD card (mount FATFS via SPI)
 // Returns ESP_OK if card mounted, ESP_FAIL if no card
 esp_err_t sd_logger_init(void);
@@ -23,19 +105,35 @@ esp_err_t sd_logger_init(void);
 // Check if SD card is mounted
 bool sd_logger_is_mounted(void);
 
-// Start a new logging session (creates new CSV file)
+// Select the file format of sessions started from now on
+void sd_logger_set_format(sd_log_format_t format);
+sd_log_format_t sd_logger_get_format(void);
+
+// Start a new logging session (creates a new file in the selected format)
 // Call when CAN data starts flowing
 void sd_logger_start_session(void);
 
 // Write a CAN message to the current log file
+// timestamp_us: ingest time from can_message_t (esp_timer, 32-bit wrapping)
 // Safe to call even if no session is active (will be ignored)
-void sd_logger_write(uint32_t can_id, const uint8_t *data, uint8_t dlc);
+void sd_logger_write(uint32_t can_id, const uint8_t *data, uint8_t dlc, uint32_t timestamp_us);
+
+// Name the summary signals of sessions started from now on
+// count 0 (the default) writes no summary; more than SD_LOG_SUMMARY_MAX_SIGNALS are ignored
+void sd_logger_summary_define(const sd_log_summary_signal_t *signals, uint8_t count);
+
+// Add a sample of summary signal `signal` (index into the defined signals), taken now
+// Queued with the frames, so call it from the task that calls sd_logger_write()
+void sd_logger_summary_add(uint8_t signal, int32_t value);
 
 // End the current session
-// If session was shorter than 5 minutes, deletes the file
+// If session was shorter than 5 minutes, deletes the file (and its index and summary)
 void sd_logger_end_session(void);
 
-// List log files on SD card
+// Counters of the current session (written by the SD writer task, read without locking)
+const sd_logger_stats_t *sd_logger_get_stats(void);
+
+// List log files on SD card (.csv and .cbl)
 // Returns number of files found, fills names array (caller provides buffer)
 // Files are sorted newest first
 typedef struct {
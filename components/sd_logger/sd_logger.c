@@ -1,12 +1,16 @@
 #include "sd_logger.h"
+#include "canlog.h"
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <sys/time.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "esp_vfs_fat.h"
 #include "sdmmc_cmd.h"
 #include "driver/sdspi_host.h"
@@ -14,6 +18,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "sd_log";
 
@@ -21,24 +26,86 @@ static bool sd_mounted = false;
 static sdmmc_card_t *sd_card = NULL;
 
 // Current session state
-static FILE *session_file = NULL;
+// Sessions are opened, written and closed only by the writer and flush tasks;
+// start/end hand over to them through the log queue, in order with the frames.
+static bool session_active = false;
 static char session_filename[128] = {0};
+static char session_index_filename[128] = {0};  // empty for CSV sessions
+static char session_summary_filename[128] = {0};    // empty without summary signals
+static uint64_t session_start_us = 0;
 static uint32_t session_start_tick = 0;
-static uint32_t session_msg_count = 0;
+static bool session_time_synced = false;
+static int64_t session_wall_time = 0;
+static sd_log_format_t log_format = SD_LOG_DEFAULT_FORMAT;    // for the next session
+static sd_log_format_t session_format = SD_LOG_DEFAULT_FORMAT;
+static canlog_encoder_t session_encoder;
+static sd_logger_stats_t stats;
+
+// Summary signals for the next session, and those of the current one
+static sd_log_summary_signal_t summary_signals[SD_LOG_SUMMARY_MAX_SIGNALS];
+static uint8_t summary_count = 0;
+static sd_log_summary_signal_t session_summary_signals[SD_LOG_SUMMARY_MAX_SIGNALS];
+static uint8_t session_summary_count = 0;
+
+// Compression stage: records collect in a chunk, which goes out as one block
+static uint8_t chunk[CANLOG_CHUNK_SIZE];
+static uint32_t chunk_len = 0;
+static uint8_t chunk_block[CANLOG_BLOCK_BOUND(CANLOG_CHUNK_SIZE)];
+static uint16_t lz_table[1 << CANLOG_LZ_HASH_BITS];
 
 // Ring buffer for non-blocking writes
+typedef enum {
+    LOG_ENTRY_FRAME,
+    LOG_ENTRY_START,        // open session_filename and write its header
+    LOG_ENTRY_END,          // write what is left, close, then give session_closed
+    LOG_ENTRY_SAMPLE,       // summary sample: signal in can_id, int32 value in data
+} log_entry_type_t;
+
 typedef struct {
-    uint32_t timestamp_ms;
+    uint32_t timestamp_us;
     uint32_t can_id;
+    uint8_t type;           // log_entry_type_t
     uint8_t dlc;
     uint8_t data[8];
 } can_log_entry_t;
 
 #define LOG_QUEUE_SIZE 256
+#define CSV_MAX_LINE   64
+
+// Double-buffered block writer: sd_writer fills one block while sd_flush writes
+// the other. A full block is written at its block-aligned offset in one call. The
+// new bytes of a partly filled block are written every SD_LOG_FLUSH_MS, and the
+// whole block again once it is full.
+typedef enum {
+    WRITE_OPEN,             // new file: reset and preallocate
+    WRITE_FULL,             // full block, frees it for the writer afterwards
+    WRITE_PARTIAL,          // new bytes of the block being filled, then fsync
+    WRITE_INDEX,            // one index entry, written with the next batch
+    WRITE_SUMMARY,          // append a summary row and sync it
+    WRITE_CLOSE,            // trim the preallocation to len, close, write the last index batch
+} write_op_t;
+
+typedef struct {
+    uint8_t op;             // write_op_t
+    int fd;
+    const uint8_t *buf;
+    uint32_t offset;        // file offset of buf
+    uint32_t len;           // bytes of buf, or the final file length for WRITE_CLOSE
+    int index_fd;           // index sidecar, -1 if none
+    canlog_index_entry_t entry;     // WRITE_INDEX
+} write_req_t;
+
 static QueueHandle_t log_queue = NULL;
+static QueueHandle_t write_queue = NULL;
+static SemaphoreHandle_t block_free = NULL;      // the block not being filled may be reused
+static SemaphoreHandle_t file_closed = NULL;     // sd_flush finished WRITE_CLOSE
+static SemaphoreHandle_t session_closed = NULL;  // sd_writer finished LOG_ENTRY_END
 static TaskHandle_t writer_task_handle = NULL;
+static TaskHandle_t flush_task_handle = NULL;
+static uint8_t *blocks[2];
 
 static void sd_writer_task(void *arg);
+static void sd_flush_task(void *arg);
 
 esp_err_t sd_logger_init(void)
 {
@@ -63,7 +130,7 @@ esp_err_t sd_logger_init(void)
     esp_vfs_fat_sdmmc_mount_config_t mount_cfg = {
         .format_if_mount_failed = false,
         .max_files = 5,
-        .allocation_unit_size = 16 * 1024,
+        .allocation_unit_size = SD_ALLOCATION_UNIT,
     };
 
     sdspi_device_config_t slot_cfg = SDSPI_DEVICE_CONFIG_DEFAULT();
@@ -79,13 +146,31 @@ esp_err_t sd_logger_init(void)
         return ret;
     }
 
+    // Block buffers in DMA-capable RAM so full-sector writes go to the card without a bounce copy
+    for (int i = 0; i < 2; i++) {
+        blocks[i] = heap_caps_malloc(SD_LOG_BLOCK_SIZE, MALLOC_CAP_DMA);
+        if (!blocks[i]) {
+            ESP_LOGE(TAG, "No memory for %d-byte log blocks", SD_LOG_BLOCK_SIZE);
+            heap_caps_free(blocks[0]);
+            esp_vfs_fat_sdcard_unmount(SD_MOUNT_POINT, sd_card);
+            spi_bus_free(SPI3_HOST);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
     sd_mounted = true;
     sdmmc_card_print_info(stdout, sd_card);
     ESP_LOGI(TAG, "SD card mounted at %s", SD_MOUNT_POINT);
 
-    // Create log queue and writer task
+    // Create log queue, writer and flush tasks
     log_queue = xQueueCreate(LOG_QUEUE_SIZE, sizeof(can_log_entry_t));
+    write_queue = xQueueCreate(8, sizeof(write_req_t));
+    block_free = xSemaphoreCreateBinary();
+    file_closed = xSemaphoreCreateBinary();
+    session_closed = xSemaphoreCreateBinary();
+    xSemaphoreGive(block_free);
     xTaskCreatePinnedToCore(sd_writer_task, "sd_writer", 4096, NULL, 2, &writer_task_handle, 0);
+    xTaskCreatePinnedToCore(sd_flush_task, "sd_flush", 4096, NULL, 2, &flush_task_handle, 0);
 
     return ESP_OK;
 }
@@ -95,109 +180,616 @@ bool sd_logger_is_mounted(void)
     return sd_mounted;
 }
 
+void sd_logger_set_format(sd_log_format_t format)
+{
+    log_format = format;
+}
+
+sd_log_format_t sd_logger_get_format(void)
+{
+    return log_format;
+}
+
 void sd_logger_start_session(void)
 {
-    if (!sd_mounted || session_file) return;
+    if (!sd_mounted || session_active) return;
 
     time_t now = time(NULL);
     struct tm *t = localtime(&now);
+    bool time_synced = t->tm_year > (2024 - 1900);
+    sd_log_format_t format = log_format;
+    const char *ext = format == SD_LOG_FORMAT_CSV ? ".csv" : CANLOG_EXTENSION;
 
-    if (t->tm_year > (2024 - 1900)) {
+    if (time_synced) {
         // Time is synced — use date/time filename
         snprintf(session_filename, sizeof(session_filename),
-                 SD_MOUNT_POINT "/%04d-%02d-%02d_%02d%02d%02d.csv",
+                 SD_MOUNT_POINT "/%04d-%02d-%02d_%02d%02d%02d%s",
                  t->tm_year + 1900, t->tm_mon + 1, t->tm_mday,
-                 t->tm_hour, t->tm_min, t->tm_sec);
+                 t->tm_hour, t->tm_min, t->tm_sec, ext);
     } else {
         // No time sync — use boot tick
         snprintf(session_filename, sizeof(session_filename),
-                 SD_MOUNT_POINT "/session_%lu.csv",
-                 (unsigned long)(xTaskGetTickCount() / configTICK_RATE_HZ));
+                 SD_MOUNT_POINT "/session_%lu%s",
+                 (unsigned long)(xTaskGetTickCount() / configTICK_RATE_HZ), ext);
     }
 
-    session_file = fopen(session_filename, "w");
-    if (!session_file) {
-        ESP_LOGE(TAG, "Failed to create %s", session_filename);
-        return;
+    // Sidecars have the session's name with their own extension
+    int base = (int)(strlen(session_filename) - strlen(ext));
+    session_index_filename[0] = 0;
+    if (format != SD_LOG_FORMAT_CSV) {
+        snprintf(session_index_filename, sizeof(session_index_filename), "%.*s%s",
+                 base, session_filename, CANLOG_INDEX_EXTENSION);
+    }
+    session_summary_filename[0] = 0;
+    session_summary_count = summary_count;
+    memcpy(session_summary_signals, summary_signals, sizeof(summary_signals));
+    if (session_summary_count > 0) {
+        snprintf(session_summary_filename, sizeof(session_summary_filename), "%.*s%s",
+                 base, session_filename, SD_LOG_SUMMARY_EXTENSION);
     }
 
-    // Write CSV header
-    fprintf(session_file, "timestamp_ms,can_id,dlc,d0,d1,d2,d3,d4,d5,d6,d7\n");
-    fflush(session_file);
-
+    session_format = format;
+    session_time_synced = time_synced;
+    session_wall_time = (int64_t)now;
     session_start_tick = xTaskGetTickCount();
-    session_msg_count = 0;
+    session_start_us = (uint64_t)esp_timer_get_time();
+
+    // The writer task creates the file when it gets here, ahead of the first frame
+    can_log_entry_t entry = {.type = LOG_ENTRY_START};
+    if (xQueueSend(log_queue, &entry, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGE(TAG, "Log queue full, session not started");
+        return;
+    }
+    session_active = true;
     ESP_LOGI(TAG, "Logging session started: %s", session_filename);
 }
 
-void sd_logger_write(uint32_t can_id, const uint8_t *data, uint8_t dlc)
+void sd_logger_write(uint32_t can_id, const uint8_t *data, uint8_t dlc, uint32_t timestamp_us)
 {
-    if (!sd_mounted || !log_queue) return;
+    if (!sd_mounted || !log_queue || !session_active) return;
 
     can_log_entry_t entry;
-    entry.timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    entry.type = LOG_ENTRY_FRAME;
+    entry.timestamp_us = timestamp_us;
     entry.can_id = can_id;
     entry.dlc = dlc > 8 ? 8 : dlc;
     memcpy(entry.data, data, entry.dlc);
     if (entry.dlc < 8) memset(entry.data + entry.dlc, 0, 8 - entry.dlc);
 
     // Non-blocking push — drop message if queue full
+    if (xQueueSend(log_queue, &entry, 0) != pdTRUE) {
+        stats.dropped++;
+    }
+}
+
+void sd_logger_summary_define(const sd_log_summary_signal_t *signals, uint8_t count)
+{
+    if (count > SD_LOG_SUMMARY_MAX_SIGNALS) count = SD_LOG_SUMMARY_MAX_SIGNALS;
+    memset(summary_signals, 0, sizeof(summary_signals));
+    memcpy(summary_signals, signals, count * sizeof(signals[0]));
+    summary_count = count;
+}
+
+void sd_logger_summary_add(uint8_t signal, int32_t value)
+{
+    if (!sd_mounted || !log_queue || !session_active || signal >= session_summary_count) return;
+
+    can_log_entry_t entry = {
+        .type = LOG_ENTRY_SAMPLE,
+        .timestamp_us = (uint32_t)esp_timer_get_time(),
+        .can_id = signal,
+    };
+    memcpy(entry.data, &value, sizeof(value));
     xQueueSend(log_queue, &entry, 0);
 }
 
-void sd_logger_end_session(void)
+const sd_logger_stats_t *sd_logger_get_stats(void)
 {
-    if (!session_file) return;
+    return &stats;
+}
 
-    fflush(session_file);
-    fclose(session_file);
-    session_file = NULL;
+void sd_logger_end_session(void)
+{
+    if (!session_active) return;
+    session_active = false;
+
+    // Wait for the writer to write out the last block and close the file
+    can_log_entry_t entry = {.type = LOG_ENTRY_END};
+    if (xQueueSend(log_queue, &entry, pdMS_TO_TICKS(1000)) != pdTRUE ||
+        xSemaphoreTake(session_closed, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        ESP_LOGE(TAG, "Timed out closing %s", session_filename);
+    }
 
     uint32_t duration_sec = (xTaskGetTickCount() - session_start_tick) / configTICK_RATE_HZ;
 
     if (duration_sec < MIN_SESSION_SECONDS) {
         // Delete short sessions
         unlink(session_filename);
+        if (session_index_filename[0]) unlink(session_index_filename);
+        if (session_summary_filename[0]) unlink(session_summary_filename);
         ESP_LOGI(TAG, "Session too short (%lus < %ds), deleted %s",
                  (unsigned long)duration_sec, MIN_SESSION_SECONDS, session_filename);
     } else {
-        ESP_LOGI(TAG, "Session saved: %s (%lu msgs, %lus)",
-                 session_filename, (unsigned long)session_msg_count,
-                 (unsigned long)duration_sec);
+        ESP_LOGI(TAG, "Session saved: %s (%lu msgs, %lu bytes, %lus)",
+                 session_filename, (unsigned long)stats.frames,
+                 (unsigned long)stats.bytes, (unsigned long)duration_sec);
+        ESP_LOGI(TAG, "Encoding: %.2f bytes/frame, ratio %.2f, %lu us/1000 frames",
+                 stats.frames ? (float)stats.bytes / stats.frames : 0.0f,
+                 stats.bytes ? (float)stats.raw_bytes / stats.bytes : 0.0f,
+                 stats.frames ? (unsigned long)((uint64_t)stats.encode_us * 1000 / stats.frames) : 0);
+        ESP_LOGI(TAG, "Card: %.2f MB/s, longest write %lu us, queue high water %u/%d",
+                 stats.write_mb_s, (unsigned long)stats.max_write_us,
+                 stats.queue_high_water, LOG_QUEUE_SIZE);
     }
 
     session_filename[0] = 0;
-    session_msg_count = 0;
+    session_index_filename[0] = 0;
+    session_summary_filename[0] = 0;
+}
+
+// Full 64-bit esp_timer time of a queued 32-bit timestamp
+// Entries are written long before the 32-bit clock wraps (~71 min)
+static uint64_t entry_time_us(const can_log_entry_t *entry)
+{
+    uint64_t now = (uint64_t)esp_timer_get_time();
+    return now - (uint32_t)((uint32_t)now - entry->timestamp_us);
+}
+
+static size_t format_entry(uint8_t *out, const can_log_entry_t *entry)
+{
+    uint64_t time_us = entry_time_us(entry);
+
+    if (session_format != SD_LOG_FORMAT_CSV) {
+        return canlog_encode_frame(&session_encoder, out, time_us,
+                                   entry->can_id, entry->data, entry->dlc);
+    }
+    return (size_t)snprintf((char *)out, CSV_MAX_LINE,
+                            "%lu,0x%03lX,%d,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%02X\n",
+                            (unsigned long)(time_us / 1000),
+                            (unsigned long)entry->can_id, entry->dlc,
+                            entry->data[0], entry->data[1], entry->data[2], entry->data[3],
+                            entry->data[4], entry->data[5], entry->data[6], entry->data[7]);
+}
+
+// Writer task state: the block being filled and where it goes in the file
+static int writer_fd = -1;
+static int active = 0;              // index into blocks[]
+static uint32_t block_len = 0;      // bytes in the active block
+static uint32_t block_flushed = 0;  // of those, already written by WRITE_PARTIAL
+static uint32_t block_offset = 0;   // file offset of the active block
+static int index_fd = -1;
+static uint64_t index_next_us = 0;  // log time from which the next keyframe is indexed
+static uint64_t chunk_sync_us = 0;  // sync record opening the chunk being collected
+static uint32_t chunk_sync_frames = 0;
+
+static void submit(write_op_t op, const uint8_t *buf, uint32_t offset, uint32_t len)
+{
+    write_req_t req = {.op = op, .fd = writer_fd, .buf = buf, .offset = offset, .len = len, .index_fd = index_fd};
+    xQueueSend(write_queue, &req, portMAX_DELAY);
+}
+
+// Index the keyframe about to be appended, if it is SD_LOG_INDEX_INTERVAL_MS past the last one
+// Entries only move forward in time, so the index stays sorted when the clock steps back
+static void index_keyframe(uint64_t time_us, uint32_t frames)
+{
+    if (index_fd < 0 || time_us < index_next_us) return;
+
+    write_req_t req = {.op = WRITE_INDEX, .fd = index_fd, .index_fd = index_fd};
+    req.entry.time_us = time_us;
+    req.entry.offset = block_offset + block_len;
+    req.entry.frames = frames;
+    xQueueSend(write_queue, &req, portMAX_DELAY);
+    index_next_us = time_us + SD_LOG_INDEX_INTERVAL_MS * 1000ULL;
+}
+
+// Append to the active block, handing each full block to sd_flush
+static void append(const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        size_t n = SD_LOG_BLOCK_SIZE - block_len;
+        if (n > len) n = len;
+        memcpy(&blocks[active][block_len], data, n);
+        block_len += n;
+        data += n;
+        len -= n;
+
+        if (block_len == SD_LOG_BLOCK_SIZE) {
+            // The other block is reused once its own full write is done
+            int64_t t0 = esp_timer_get_time();
+            xSemaphoreTake(block_free, portMAX_DELAY);
+            stats.buffer_wait_us += (uint32_t)(esp_timer_get_time() - t0);
+
+            submit(WRITE_FULL, blocks[active], block_offset, SD_LOG_BLOCK_SIZE);
+            active ^= 1;
+            block_offset += SD_LOG_BLOCK_SIZE;
+            block_len = 0;
+            block_flushed = 0;
+        }
+    }
+}
+
+// Compress the collected records into a block and start the next chunk
+static void emit_chunk(void)
+{
+    if (chunk_len == 0) return;
+
+    int64_t t0 = esp_timer_get_time();
+    size_t n = canlog_compress_chunk(chunk, chunk_len, chunk_block, lz_table);
+    canlog_begin_chunk(&session_encoder);
+    chunk_len = 0;
+    stats.encode_us += (uint32_t)(esp_timer_get_time() - t0);
+
+    index_keyframe(chunk_sync_us, chunk_sync_frames);
+    append(chunk_block, n);
+    stats.bytes += n;
+}
+
+// Summary of the minute being collected; finished rows go to sd_flush from two
+// alternating buffers, each written out long before it is filled again
+static int summary_fd = -1;
+static uint32_t summary_minute = 0;
+static bool summary_pending = false;    // summary_acc holds samples of summary_minute
+static struct {
+    int32_t min;
+    int32_t max;
+    int64_t sum;
+    uint32_t samples;
+} summary_acc[SD_LOG_SUMMARY_MAX_SIGNALS];
+static uint8_t summary_rows[2][SD_LOG_SUMMARY_ROW_LEN(SD_LOG_SUMMARY_MAX_SIGNALS)];
+static int summary_row = 0;
+
+static void emit_summary_row(void)
+{
+    if (!summary_pending) return;
+    summary_pending = false;
+
+    uint8_t *row = summary_rows[summary_row];
+    summary_row ^= 1;
+    memcpy(row, &summary_minute, sizeof(summary_minute));
+    sd_log_summary_value_t *values = (sd_log_summary_value_t *)&row[sizeof(summary_minute)];
+    for (int i = 0; i < session_summary_count; i++) {
+        sd_log_summary_value_t v = {0};
+        if (summary_acc[i].samples > 0) {
+            int64_t n = summary_acc[i].samples;
+            int64_t sum = summary_acc[i].sum;
+            v.min = summary_acc[i].min;
+            v.max = summary_acc[i].max;
+            v.mean = (int32_t)((sum + (sum >= 0 ? n / 2 : -n / 2)) / n);
+            v.samples = summary_acc[i].samples;
+        }
+        memcpy(&values[i], &v, sizeof(v));
+    }
+    memset(summary_acc, 0, sizeof(summary_acc));
+
+    write_req_t req = {.op = WRITE_SUMMARY, .fd = summary_fd, .buf = row,
+                       .len = SD_LOG_SUMMARY_ROW_LEN(session_summary_count), .index_fd = -1};
+    xQueueSend(write_queue, &req, portMAX_DELAY);
+}
+
+static void add_summary_sample(const can_log_entry_t *entry)
+{
+    if (summary_fd < 0 || entry->can_id >= session_summary_count) return;
+
+    uint64_t time_us = entry_time_us(entry);
+    uint32_t minute = time_us > session_start_us ?
+                      (uint32_t)((time_us - session_start_us) / (SD_LOG_SUMMARY_PERIOD_S * 1000000ULL)) : 0;
+    if (summary_pending && minute != summary_minute) {
+        emit_summary_row();
+    }
+    summary_minute = minute;
+    summary_pending = true;
+
+    int32_t value;
+    memcpy(&value, entry->data, sizeof(value));
+    if (summary_acc[entry->can_id].samples == 0 || value < summary_acc[entry->can_id].min) {
+        summary_acc[entry->can_id].min = value;
+    }
+    if (summary_acc[entry->can_id].samples == 0 || value > summary_acc[entry->can_id].max) {
+        summary_acc[entry->can_id].max = value;
+    }
+    summary_acc[entry->can_id].sum += value;
+    summary_acc[entry->can_id].samples++;
+}
+
+static void flush_partial(void)
+{
+    if (writer_fd >= 0 && block_len > block_flushed) {
+        submit(WRITE_PARTIAL, &blocks[active][block_flushed], block_offset + block_flushed,
+               block_len - block_flushed);
+        block_flushed = block_len;
+    }
+}
+
+static void open_session(void)
+{
+    writer_fd = open(session_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer_fd < 0) {
+        ESP_LOGE(TAG, "Failed to create %s", session_filename);
+        return;
+    }
+    if (session_index_filename[0]) {
+        index_fd = open(session_index_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (index_fd < 0) {
+            ESP_LOGW(TAG, "Failed to create %s, session not indexed", session_index_filename);
+        }
+    }
+    index_next_us = 0;
+
+    summary_pending = false;
+    memset(summary_acc, 0, sizeof(summary_acc));
+    if (session_summary_filename[0]) {
+        summary_fd = open(session_summary_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        sd_log_summary_header_t sum = {
+            .version = SD_LOG_SUMMARY_VERSION,
+            .header_len = sizeof(sum) + session_summary_count * sizeof(sd_log_summary_signal_t),
+            .signals = session_summary_count,
+            .period_s = SD_LOG_SUMMARY_PERIOD_S,
+            .start_us = session_start_us,
+            .wall_time = session_time_synced ? session_wall_time : 0,
+        };
+        memcpy(sum.magic, SD_LOG_SUMMARY_MAGIC, sizeof(sum.magic));
+        size_t table = session_summary_count * sizeof(sd_log_summary_signal_t);
+        if (summary_fd >= 0 && (write(summary_fd, &sum, sizeof(sum)) != sizeof(sum) ||
+                                write(summary_fd, session_summary_signals, table) != (ssize_t)table)) {
+            close(summary_fd);
+            summary_fd = -1;
+        }
+        if (summary_fd < 0) {
+            ESP_LOGW(TAG, "Failed to create %s, session not summarised", session_summary_filename);
+        }
+    }
+    block_len = 0;
+    block_flushed = 0;
+    block_offset = 0;
+    chunk_len = 0;
+    stats.frames = 0;
+    stats.bytes = 0;
+    stats.raw_bytes = 0;
+    stats.encode_us = 0;
+    stats.blocks = 0;
+    stats.write_us = 0;
+    stats.max_write_us = 0;
+    stats.buffer_wait_us = 0;
+    stats.queue_high_water = 0;
+    stats.write_mb_s = 0;
+    submit(WRITE_OPEN, NULL, 0, 0);
+
+    // Write file header
+    if (session_format != SD_LOG_FORMAT_CSV) {
+        canlog_header_t hdr;
+        uint32_t flags = session_format == SD_LOG_FORMAT_COMPRESSED ? CANLOG_FLAG_COMPRESSED : 0;
+        canlog_begin(&session_encoder, &hdr, flags, session_start_us,
+                     session_time_synced ? session_wall_time : 0, SD_LOG_CAN_BITRATE);
+        append((const uint8_t *)&hdr, sizeof(hdr));
+
+        if (index_fd >= 0) {
+            canlog_index_header_t idx = {
+                .version = CANLOG_INDEX_VERSION,
+                .entry_size = sizeof(canlog_index_entry_t),
+                .interval_ms = SD_LOG_INDEX_INTERVAL_MS,
+                .start_us = hdr.start_us,
+            };
+            memcpy(idx.magic, CANLOG_INDEX_MAGIC, sizeof(idx.magic));
+            if (write(index_fd, &idx, sizeof(idx)) != sizeof(idx)) {
+                ESP_LOGW(TAG, "Failed to write %s, session not indexed", session_index_filename);
+                close(index_fd);
+                index_fd = -1;
+            }
+        }
+    } else {
+        static const char csv_header[] = "timestamp_ms,can_id,dlc,d0,d1,d2,d3,d4,d5,d6,d7\n";
+        append((const uint8_t *)csv_header, sizeof(csv_header) - 1);
+    }
+    flush_partial();
+}
+
+static void close_session(void)
+{
+    if (writer_fd >= 0) {
+        emit_chunk();
+        flush_partial();
+        if (summary_fd >= 0) emit_summary_row();
+        submit(WRITE_CLOSE, NULL, 0, block_offset + block_len);
+        xSemaphoreTake(file_closed, portMAX_DELAY);
+        writer_fd = -1;
+        index_fd = -1;
+        // sd_flush is done with the summary too: its rows were queued before the close
+        if (summary_fd >= 0) {
+            close(summary_fd);
+            summary_fd = -1;
+        }
+        block_len = 0;
+        block_flushed = 0;
+    }
+    xSemaphoreGive(session_closed);
 }
 
 static void sd_writer_task(void *arg)
 {
+    uint8_t record[CSV_MAX_LINE > CANLOG_MAX_RECORD_LEN ? CSV_MAX_LINE : CANLOG_MAX_RECORD_LEN];
     can_log_entry_t entry;
-    int flush_counter = 0;
+    TickType_t last_flush = xTaskGetTickCount();
 
     while (1) {
-        if (xQueueReceive(log_queue, &entry, pdMS_TO_TICKS(1000)) == pdTRUE) {
-            if (session_file) {
-                fprintf(session_file, "%lu,0x%03lX,%d,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%02X\n",
-                        (unsigned long)entry.timestamp_ms,
-                        (unsigned long)entry.can_id, entry.dlc,
-                        entry.data[0], entry.data[1], entry.data[2], entry.data[3],
-                        entry.data[4], entry.data[5], entry.data[6], entry.data[7]);
-                session_msg_count++;
-                flush_counter++;
-
-                // Flush every 100 messages or ~5 seconds worth
-                if (flush_counter >= 100) {
-                    fflush(session_file);
-                    flush_counter = 0;
+        TickType_t since = xTaskGetTickCount() - last_flush;
+        TickType_t period = pdMS_TO_TICKS(SD_LOG_FLUSH_MS);
+        TickType_t wait = since >= period ? 0 : period - since;
+
+        if (xQueueReceive(log_queue, &entry, wait) == pdTRUE) {
+            UBaseType_t waiting = uxQueueMessagesWaiting(log_queue) + 1;
+            if (waiting > stats.queue_high_water) stats.queue_high_water = waiting;
+
+            if (entry.type == LOG_ENTRY_START) {
+                open_session();
+                last_flush = xTaskGetTickCount();
+            } else if (entry.type == LOG_ENTRY_END) {
+                close_session();
+            } else if (entry.type == LOG_ENTRY_SAMPLE) {
+                add_summary_sample(&entry);
+            } else if (writer_fd >= 0 && session_format == SD_LOG_FORMAT_COMPRESSED) {
+                if (chunk_len + CANLOG_MAX_RECORD_LEN > sizeof(chunk)) {
+                    emit_chunk();
+                }
+                int64_t t0 = esp_timer_get_time();
+                size_t n = format_entry(&chunk[chunk_len], &entry);
+                stats.encode_us += (uint32_t)(esp_timer_get_time() - t0);
+                if (chunk_len == 0) {
+                    // Every chunk opens with a sync record; its block is the keyframe
+                    chunk_sync_us = session_encoder.last_sync_us;
+                    chunk_sync_frames = session_encoder.frames - 1;
+                }
+                chunk_len += n;
+                stats.frames++;
+                stats.raw_bytes += n;
+            } else if (writer_fd >= 0) {
+                int64_t t0 = esp_timer_get_time();
+                size_t n = format_entry(record, &entry);
+                stats.encode_us += (uint32_t)(esp_timer_get_time() - t0);
+                if (session_format == SD_LOG_FORMAT_BINARY && record[0] == CANLOG_SYNC_TAG) {
+                    index_keyframe(session_encoder.last_sync_us, session_encoder.frames - 1);
                 }
+                append(record, n);
+                stats.frames++;
+                stats.bytes += n;
+                stats.raw_bytes += n;
             }
-        } else {
-            // Timeout — flush if we have pending data
-            if (session_file && flush_counter > 0) {
-                fflush(session_file);
-                flush_counter = 0;
+        }
+
+        // Put a partly filled block on the card at least every SD_LOG_FLUSH_MS
+        if (xTaskGetTickCount() - last_flush >= pdMS_TO_TICKS(SD_LOG_FLUSH_MS)) {
+            if (writer_fd >= 0) emit_chunk();
+            flush_partial();
+            last_flush = xTaskGetTickCount();
+        }
+    }
+}
+
+// Timed file operation for the stall statistics
+static void account_write(int64_t t0)
+{
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    stats.write_us += us;
+    if (us > stats.max_write_us) stats.max_write_us = us;
+}
+
+static bool write_at(int fd, const uint8_t *buf, uint32_t offset, uint32_t len)
+{
+    int64_t t0 = esp_timer_get_time();
+    bool ok = lseek(fd, offset, SEEK_SET) == (off_t)offset && write(fd, buf, len) == (ssize_t)len;
+    account_write(t0);
+    if (!ok) {
+        ESP_LOGE(TAG, "Write of %lu bytes at %lu failed", (unsigned long)len, (unsigned long)offset);
+    }
+    return ok;
+}
+
+// Index entries collected by sd_flush; a batch goes out in one write
+static canlog_index_entry_t index_batch[SD_LOG_INDEX_BATCH];
+static uint32_t index_batch_len = 0;
+
+static void write_index_batch(int fd)
+{
+    if (fd >= 0 && index_batch_len > 0) {
+        int64_t t0 = esp_timer_get_time();
+        size_t len = index_batch_len * sizeof(index_batch[0]);
+        if (write(fd, index_batch, len) != (ssize_t)len) {
+            ESP_LOGW(TAG, "Index write failed");
+        }
+        fsync(fd);
+        account_write(t0);
+    }
+    index_batch_len = 0;
+}
+
+// Extend a file to size bytes. FAT ftruncate() only shrinks (IDF 5.1), but
+// writing past the end makes FatFs allocate the clusters up to there
+static bool grow_file(int fd, uint32_t size)
+{
+    static const uint8_t zero = 0;
+    return lseek(fd, size - 1, SEEK_SET) == (off_t)(size - 1) && write(fd, &zero, 1) == 1;
+}
+
+static void sd_flush_task(void *arg)
+{
+    write_req_t req;
+    uint32_t allocated = 0;         // preallocated length of the open file
+    bool can_grow = true;           // cleared when preallocation fails, until the next file
+    uint64_t written = 0;           // bytes written in this session
+
+    while (1) {
+        if (xQueueReceive(write_queue, &req, portMAX_DELAY) != pdTRUE) continue;
+
+        switch (req.op) {
+            case WRITE_OPEN:
+                allocated = 0;
+                can_grow = true;
+                written = 0;
+                index_batch_len = 0;
+                break;
+
+            case WRITE_FULL:
+            case WRITE_PARTIAL: {
+                // Grow the file in big steps so full blocks land in clusters that are
+                // already allocated and the FAT is not touched block by block
+                uint32_t end = req.offset + req.len;
+                if (end > allocated && can_grow) {
+                    uint32_t size = (end + SD_LOG_PREALLOC_SIZE - 1) / SD_LOG_PREALLOC_SIZE * SD_LOG_PREALLOC_SIZE;
+                    int64_t t0 = esp_timer_get_time();
+                    if (grow_file(req.fd, size)) {
+                        allocated = size;
+                        fsync(req.fd);
+                    } else {
+                        // Card full or no seek past the end: the file grows as it is written
+                        ESP_LOGW(TAG, "Could not preallocate %lu bytes, writing without", (unsigned long)size);
+                        can_grow = false;
+                    }
+                    account_write(t0);
+                }
+
+                if (write_at(req.fd, req.buf, req.offset, req.len)) {
+                    written += req.len;
+                }
+                if (req.op == WRITE_FULL) {
+                    stats.blocks++;
+                    xSemaphoreGive(block_free);
+                } else {
+                    int64_t t0 = esp_timer_get_time();
+                    fsync(req.fd);
+                    account_write(t0);
+                }
+                if (stats.write_us > 0) {
+                    stats.write_mb_s = (float)written / (float)stats.write_us;
+                }
+                break;
+            }
+
+            case WRITE_INDEX:
+                index_batch[index_batch_len++] = req.entry;
+                if (index_batch_len == SD_LOG_INDEX_BATCH) {
+                    write_index_batch(req.fd);
+                }
+                break;
+
+            case WRITE_SUMMARY: {
+                int64_t t0 = esp_timer_get_time();
+                if (write(req.fd, req.buf, req.len) != (ssize_t)req.len) {
+                    ESP_LOGW(TAG, "Summary write failed");
+                }
+                fsync(req.fd);
+                account_write(t0);
+                break;
             }
+
+            case WRITE_CLOSE:
+                // Drop the unused preallocation
+                ftruncate(req.fd, req.len);
+                close(req.fd);
+                if (req.index_fd >= 0) {
+                    write_index_batch(req.index_fd);
+                    close(req.index_fd);
+                }
+                xSemaphoreGive(file_closed);
+                break;
         }
     }
 }
@@ -212,10 +804,11 @@ int sd_logger_list_files(sd_file_info_t *files, int max_files)
     int count = 0;
     struct dirent *de;
     while ((de = readdir(dir)) != NULL && count < max_files) {
-        // Only list .csv files
+        // Only list session logs
         size_t nlen = strlen(de->d_name);
         if (nlen < 5) continue;
-        if (strcmp(de->d_name + nlen - 4, ".csv") != 0) continue;
+        if (strcmp(de->d_name + nlen - 4, ".csv") != 0 &&
+            strcmp(de->d_name + nlen - 4, CANLOG_EXTENSION) != 0) continue;
 
         strncpy(files[count].name, de->d_name, sizeof(files[count].name) - 1);
         files[count].name[sizeof(files[count].name) - 1] = 0;
@@ -20,6 +20,7 @@
 #include "can_driver.h"
 #include "can_sniffer.h"
 #include "mercedes_decode.h"
+#include "can_display.h"
 #include "vehicle_data.h"
 #include "obd2_pids.h"
 #include "sd_logger.h"
@@ -50,8 +51,8 @@ static const char *TAG = "CYD_35";
 #define CONTENT_TOP 18
 #define CONTENT_H (SCREEN_H - 40 - CONTENT_TOP)
 
-// 6 screens: Params, Log Files, Temps chart, Speeds chart, Dynamics chart, Suspension chart
-#define NUM_SCREENS 6
+// 7 screens: Params, Log Files, Temps chart, Speeds chart, Dynamics chart, Suspension chart, Sniffer
+#define NUM_SCREENS 7
 static int current_screen = 0;
 static lv_obj_t *screens[NUM_SCREENS];
 static bool screen_built[NUM_SCREENS] = {false};
@@ -63,54 +64,178 @@ static lv_obj_t *status_time_label = NULL;
 // ============================================================================
 // Screen 1: Parameters list
 // ============================================================================
-#define NUM_PARAMS 40
+#define PARAM_CH_NONE 0xFFFF
 
-static lv_obj_t *param_value_labels[NUM_PARAMS] = {NULL};
-static lv_obj_t *param_raw_labels[NUM_PARAMS] = {NULL};
+// Writes a row's text when the descriptor alone cannot express it
+typedef void (*param_text_fn)(const mercedes_data_t *mb, char *buf, size_t size);
+
+typedef struct {
+    const char *name;
+    can_display_t disp;         // value column (and the field shown as raw)
+    uint16_t channel;           // decoder channel the row follows (PARAM_CH_NONE = every refresh)
+    uint8_t span;               // consecutive channels from channel that also refresh it
+    uint16_t extra;             // one more channel, or PARAM_CH_NONE
+    int8_t raw_add;             // added to the field for the raw column
+    bool alert;                 // value shown red while the field is non-zero
+    param_text_fn value_fn;     // overrides the descriptor's value text
+    param_text_fn raw_fn;       // overrides the raw column
+} param_row_t;
+
+// a/b as plain integers
+static void fmt_pair(char *buf, int32_t a, char sep, int32_t b) {
+    size_t n = can_format_int(buf, a, 0);
+    buf[n++] = sep;
+    can_format_int(buf + n, b, 0);
+}
+
+static void param_brake_raw(const mercedes_data_t *mb, char *buf, size_t size) {
+    fmt_pair(buf, mb->brake_pressed, '/', mb->brake_position);
+}
+
+static void param_gear_raw(const mercedes_data_t *mb, char *buf, size_t size) {
+    fmt_pair(buf, mb->gear_fsc, '/', mb->gear);
+}
+
+static void param_highbeam(const mercedes_data_t *mb, char *buf, size_t size) {
+    lv_snprintf(buf, size, "%s", (mb->highbeam_toggle || mb->highbeam_momentary) ? "ON" : "OFF");
+}
+
+static void param_highbeam_raw(const mercedes_data_t *mb, char *buf, size_t size) {
+    size_t n = 0;
+    buf[n++] = 'T';
+    n += can_format_int(buf + n, mb->highbeam_toggle, 0);
+    buf[n++] = ' ';
+    buf[n++] = 'M';
+    can_format_int(buf + n, mb->highbeam_momentary, 0);
+}
+
+static void param_doors(const mercedes_data_t *mb, char *buf, size_t size) {
+    if (mb->door_open_fl || mb->door_open_fr || mb->door_open_rl || mb->door_open_rr) {
+        lv_snprintf(buf, size, "%s%s%s%s",
+            mb->door_open_fl ? "FL " : "", mb->door_open_fr ? "FR " : "",
+            mb->door_open_rl ? "RL " : "", mb->door_open_rr ? "RR " : "");
+    } else {
+        lv_snprintf(buf, size, "Closed");
+    }
+}
 
-static const char *param_names[NUM_PARAMS] = {
-    "Engine RPM",       // 0
-    "RPM (0x308)",      // 1
-    "Speed",            // 2
-    "Gas Pedal",        // 3
-    "Steer Angle",      // 4
-    "Brake",            // 5
-    "Gear (FSC)",       // 6
-    "Drive Prog",       // 7
-    "Oil Temp",         // 8
-    "Coolant Temp",     // 9
-    "Trans Temp",       // 10
-    "Ambient Temp",     // 11
-    "Fuel L/h",         // 12
-    "Tank Level",       // 13
-    "Turbine RPM",      // 14
-    "Lateral G",        // 15
-    "Yaw Rate",         // 16
-    "L Blinker",        // 17
-    "R Blinker",        // 18
-    "Highbeam",         // 19
-    "Doors",            // 20
-    "Seatbelt Drv",     // 21
-    "Seatbelt Pass",    // 22
-    "Handbrake",        // 23
-    "ESP Lamp",         // 24
-    "ABS Lamp",         // 25
-    "MIL Lamp",         // 26
-    "Oil Warning",      // 27
-    "Oil Level",        // 28
-    "WS FL",            // 29
-    "WS FR",            // 30
-    "WS RL",            // 31
-    "WS RR",            // 32
-    "AIRMATIC FL",      // 33
-    "AIRMATIC FR",      // 34
-    "AIRMATIC RL",      // 35
-    "AIRMATIC RR",      // 36
-    "Style Accel",      // 37
-    "Style Brake",      // 38
-    "Decoded",          // 39
+static void param_doors_raw(const mercedes_data_t *mb, char *buf, size_t size) {
+    static const char hex[] = "0123456789ABCDEF";
+    buf[0] = '0';
+    buf[1] = 'x';
+    buf[2] = hex[mb->doors_open >> 4];
+    buf[3] = hex[mb->doors_open & 0xF];
+    buf[4] = '\0';
+}
+
+static void param_decoded(const mercedes_data_t *mb, char *buf, size_t size) {
+    can_format_uint(buf, mb->decode_count);
+}
+
+static void param_empty(const mercedes_data_t *mb, char *buf, size_t size) {
+    buf[0] = '\0';
+}
+
+static const char *const txt_on_off[] = {"OFF", "ON"};
+static const char *const txt_yes_no[] = {"No", "Yes"};
+static const char *const txt_ok_warn[] = {"OK", "WARN"};
+static const char *const txt_gear_fsc[] = {"P", "R", "N", "D", "4", "3", "2", "1"};
+
+#define P_NUM(label, f, m, a, d, dec, unit, ch) \
+    { .name = label, .disp = CAN_DISPLAY_NUM(mercedes_data_t, f, m, a, d, dec, unit), \
+      .channel = ch, .span = 1, .extra = PARAM_CH_NONE }
+#define P_TEXT(label, f, strs, ch) \
+    { .name = label, .disp = CAN_DISPLAY_TEXT(mercedes_data_t, f, strs), \
+      .channel = ch, .span = 1, .extra = PARAM_CH_NONE }
+
+// One entry per row; scaling lives here and nowhere else
+static const param_row_t param_rows[] = {
+    P_NUM("Engine RPM",   engine_rpm,        1, 0, 1, 0, "",      MB_SIG_ENGINE_RPM),
+    P_NUM("RPM (0x308)",  nmot_rpm_raw,      1, 0, 4, 0, "",      MB_SIG_NMOT_RPM_RAW),       // ×0.25
+    P_NUM("Speed",        speed_kmh_x100,    1, 0, 10, 1, " km/h", MB_CH_SPEED_KMH_X100),    // RDU mean
+    P_NUM("Gas Pedal",    gas_pedal,         1, 0, 1, 0, "%",     MB_SIG_GAS_PEDAL),
+    P_NUM("Steer Angle",  steering_angle,    5, 0, 1, 1, "",      MB_SIG_STEERING_ANGLE),     // 0.5 deg
+    { .name = "Brake", .disp = CAN_DISPLAY_TEXT(mercedes_data_t, brake_pressed, txt_on_off),
+      .channel = MB_SIG_BRAKE_PRESSED, .span = 2, .extra = PARAM_CH_NONE,
+      .alert = true, .raw_fn = param_brake_raw },
+    { .name = "Gear (FSC)", .disp = CAN_DISPLAY_TEXT(mercedes_data_t, gear_fsc, txt_gear_fsc),
+      .channel = MB_SIG_GEAR_FSC, .span = 1, .extra = MB_SIG_GEAR,
+      .raw_fn = param_gear_raw },
+    P_NUM("Drive Prog",   drive_program,     1, 0, 1, 0, "",      MB_SIG_DRIVE_PROGRAM),
+    { .name = "Oil Temp", .disp = CAN_DISPLAY_NUM(mercedes_data_t, oil_temp_c, 1, 0, 1, 0, " C"),
+      .channel = MB_SIG_OIL_TEMP_C, .span = 1, .extra = PARAM_CH_NONE, .raw_add = 40 },
+    { .name = "Coolant Temp", .disp = CAN_DISPLAY_NUM(mercedes_data_t, coolant_temp_c, 1, 0, 1, 0, " C"),
+      .channel = MB_SIG_COOLANT_TEMP_C, .span = 1, .extra = PARAM_CH_NONE, .raw_add = 40 },
+    { .name = "Trans Temp", .disp = CAN_DISPLAY_NUM(mercedes_data_t, trans_oil_temp_c, 1, 0, 1, 0, " C"),
+      .channel = MB_SIG_TRANS_OIL_TEMP_C, .span = 1, .extra = PARAM_CH_NONE, .raw_add = 40 },
+    P_NUM("Ambient Temp", ambient_temp_raw,  5, -400, 1, 1, " C", MB_SIG_AMBIENT_TEMP_RAW),   // ×0.5 - 40
+    P_NUM("Fuel L/h",     fuel_consumption,  144, 0, 100, 2, "",  MB_SIG_FUEL_CONSUMPTION),   // µl/250ms
+    P_NUM("Tank Level",   tank_level,        1, 0, 1, 0, " L",    MB_SIG_TANK_LEVEL),
+    P_NUM("Turbine RPM",  turbine_speed_raw, 1, 0, 4, 0, "",      MB_SIG_TURBINE_SPEED_RAW),  // ×0.25
+    P_NUM("Lateral G",    lateral_g_raw,     1, 0, 1, 2, " g",    MB_SIG_LATERAL_G_RAW),      // ×0.01
+    P_NUM("Yaw Rate",     yaw_rate_raw,      1, 0, 2, 2, " d/s",  MB_SIG_YAW_RATE_RAW),       // ×0.005
+    P_TEXT("L Blinker",   left_blinker,      txt_on_off,          MB_SIG_LEFT_BLINKER),
+    P_TEXT("R Blinker",   right_blinker,     txt_on_off,          MB_SIG_RIGHT_BLINKER),
+    { .name = "Highbeam", .disp = CAN_DISPLAY_NUM(mercedes_data_t, highbeam_toggle, 1, 0, 1, 0, ""),
+      .channel = MB_SIG_HIGHBEAM_TOGGLE, .span = 2, .extra = PARAM_CH_NONE,
+      .value_fn = param_highbeam, .raw_fn = param_highbeam_raw },
+    { .name = "Doors", .disp = CAN_DISPLAY_NUM(mercedes_data_t, doors_open, 1, 0, 1, 0, ""),
+      .channel = MB_SIG_DOORS_OPEN, .span = 5, .extra = PARAM_CH_NONE,
+      .value_fn = param_doors, .raw_fn = param_doors_raw },
+    P_TEXT("Seatbelt Drv",  seatbelt_driver,    txt_yes_no,       MB_SIG_SEATBELT_DRIVER),
+    P_TEXT("Seatbelt Pass", seatbelt_passenger, txt_yes_no,       MB_SIG_SEATBELT_PASSENGER),
+    P_TEXT("Handbrake",   handbrake,         txt_on_off,          MB_SIG_HANDBRAKE),
+    P_TEXT("ESP Lamp",    esp_lamp,          txt_on_off,          MB_SIG_ESP_LAMP),
+    P_TEXT("ABS Lamp",    abs_lamp,          txt_on_off,          MB_SIG_ABS_LAMP),
+    P_TEXT("MIL Lamp",    mil_lamp,          txt_on_off,          MB_SIG_MIL_LAMP),
+    P_TEXT("Oil Warning", oil_warning,       txt_ok_warn,         MB_SIG_OIL_WARNING),
+    P_NUM("Oil Level",    oil_level,         1, 0, 1, 0, "",      MB_SIG_OIL_LEVEL),
+    P_NUM("WS FL",        ws_fl_rdu,         1, 0, 10, 1, " km/h", MB_SIG_WS_FL_RDU),         // ×0.01
+    P_NUM("WS FR",        ws_fr_rdu,         1, 0, 10, 1, " km/h", MB_SIG_WS_FR_RDU),
+    P_NUM("WS RL",        ws_rl_rdu,         1, 0, 10, 1, " km/h", MB_SIG_WS_RL_RDU),
+    P_NUM("WS RR",        ws_rr_rdu,         1, 0, 10, 1, " km/h", MB_SIG_WS_RR_RDU),
+    P_NUM("AIRMATIC FL",  level_fl,          1, 0, 1, 0, "",      MB_SIG_LEVEL_FL),
+    P_NUM("AIRMATIC FR",  level_fr,          1, 0, 1, 0, "",      MB_SIG_LEVEL_FR),
+    P_NUM("AIRMATIC RL",  level_rl,          1, 0, 1, 0, "",      MB_SIG_LEVEL_RL),
+    P_NUM("AIRMATIC RR",  level_rr,          1, 0, 1, 0, "",      MB_SIG_LEVEL_RR),
+    P_NUM("Style Accel",  style_accel,       1, 0, 1, 0, "",      MB_SIG_STYLE_ACCEL),
+    P_NUM("Style Brake",  style_braking,     1, 0, 1, 0, "",      MB_SIG_STYLE_BRAKING),
+    P_NUM("L/100km",      fuel_l100km_x10,   1, 0, 1, 1, "",      MB_CH_FUEL_L100KM_X10),
+    P_NUM("Wheel Slip",   wheel_slip_pm,     1, 0, 1, 1, " %",    MB_CH_WHEEL_SLIP_PM),
+    P_NUM("Conv. Slip",   converter_slip_pm, 1, 0, 1, 1, " %",    MB_CH_CONVERTER_SLIP_PM),
+    P_NUM("Gear Ratio",   gear_ratio_x1000,  1, 0, 1, 3, "",      MB_CH_GEAR_RATIO_X1000),
+    P_NUM("Trip Dist",    trip_distance_m,   1, 0, 100, 1, " km", MB_CH_TRIP_DISTANCE_M),
+    P_NUM("Trip Fuel",    trip_fuel_ml,      1, 0, 10, 2, " L",   MB_CH_TRIP_FUEL_ML),
+    P_NUM("Trip L/100km", trip_avg_l100km_x10, 1, 0, 1, 1, "",    MB_CH_TRIP_AVG_L100KM_X10),
+    P_NUM("Trip Speed",   trip_avg_speed_x10, 1, 0, 1, 1, " km/h", MB_CH_TRIP_AVG_SPEED_X10),
+    P_NUM("Boost",        boost_pressure_hpa, 1, 0, 10, 2, " bar", MB_CH_BOOST_PRESSURE_HPA), // UDS, absolute
+    P_NUM("Boost Target", boost_target_hpa,  1, 0, 10, 2, " bar", MB_CH_BOOST_TARGET_HPA),
+    P_NUM("Injection",    injection_qty_x100, 1, 0, 1, 2, " mg",  MB_CH_INJECTION_QTY_X100),
+    P_NUM("AIRMATIC Vlv", airmatic_valves,   1, 0, 1, 0, "",      MB_CH_AIRMATIC_VALVES),
+    P_TEXT("AIRMATIC Comp", airmatic_compressor, txt_on_off,      MB_CH_AIRMATIC_COMPRESSOR),
+    { .name = "Decoded", .disp = CAN_DISPLAY_NUM(mercedes_data_t, decode_count, 1, 0, 1, 0, ""),
+      .channel = PARAM_CH_NONE, .span = 0, .extra = PARAM_CH_NONE,
+      .value_fn = param_decoded, .raw_fn = param_empty },
 };
 
+#undef P_NUM
+#undef P_TEXT
+
+#define NUM_PARAMS ((int)(sizeof(param_rows) / sizeof(param_rows[0])))
+
+// True if any channel the row follows changed (rows without a channel always refresh)
+static bool param_row_dirty(const param_row_t *row, const uint32_t *dirty) {
+    if (row->channel == PARAM_CH_NONE) return true;
+    if (row->extra != PARAM_CH_NONE && MB_DIRTY_TEST(dirty, row->extra)) return true;
+    for (int k = 0; k < row->span; k++) {
+        if (MB_DIRTY_TEST(dirty, row->channel + k)) return true;
+    }
+    return false;
+}
+
+static lv_obj_t *param_value_labels[NUM_PARAMS] = {NULL};
+static lv_obj_t *param_raw_labels[NUM_PARAMS] = {NULL};
+
 // ============================================================================
 // Chart common
 // ============================================================================
@@ -123,7 +248,7 @@ static lv_chart_series_t *ser_coolant = NULL;
 static lv_chart_series_t *ser_trans = NULL;
 static lv_chart_series_t *ser_ambient = NULL;
 
-// Timeline data (emulated 2 hours, 1 sample/min)
+// Timeline data: a session's length spread over TIMELINE_POINTS (emulated: 2 hours, 1 sample/min)
 #define TIMELINE_POINTS 120
 static int32_t tl_oil[TIMELINE_POINTS];
 static int32_t tl_coolant[TIMELINE_POINTS];
@@ -158,25 +283,29 @@ static int temp_chart_x = 0; // stored for label positioning
 #define LOG_ROW_Y (RANGE_SLIDER_Y + RANGE_SLIDER_H + 20)
 
 // ============================================================================
-// Emulated log files
+// Log files: SD sessions with a summary (.sum), or emulated ones without a card
 // ============================================================================
-#define NUM_LOG_FILES 3
+#define LOG_LIST_MAX 10
+#define NUM_EMULATED_LOGS 3
 
 typedef struct {
-    const char *name;
+    char name[64];
     int start_hour, start_min;
+    int minutes;                // session length, spread over the timeline
 } log_file_meta_t;
 
-static const log_file_meta_t log_files[NUM_LOG_FILES] = {
-    { "2026-03-08_0800.log", 8, 0 },
-    { "2026-03-07_1430.log", 14, 30 },
-    { "2026-03-06_0615.log", 6, 15 },
+static const log_file_meta_t emulated_log_files[NUM_EMULATED_LOGS] = {
+    { "2026-03-08_0800.log", 8, 0, TIMELINE_POINTS },
+    { "2026-03-07_1430.log", 14, 30, TIMELINE_POINTS },
+    { "2026-03-06_0615.log", 6, 15, TIMELINE_POINTS },
 };
+static log_file_meta_t log_files[LOG_LIST_MAX];
+static int num_log_files = 0;
+static bool log_files_on_sd = false;
 static int current_log = 0;
 static lv_obj_t *log_name_label = NULL;
 
 // Screen 1: Log file selector
-#define LOG_LIST_MAX 10
 static lv_obj_t *log_list_btns[LOG_LIST_MAX] = {NULL};
 static lv_obj_t *log_list_labels[LOG_LIST_MAX] = {NULL};
 
@@ -247,6 +376,12 @@ static int32_t data_lev_rr[CHART_POINTS] = {
     129, 128, 129, 130, 130
 };
 
+// Screen 6: Sniffer — most active bits (for mapping unknown signals)
+#define SNIFF_ROWS 13
+#define SNIFF_COLS 6
+static lv_obj_t *sniff_summary_label = NULL;
+static lv_obj_t *sniff_cells[SNIFF_ROWS][SNIFF_COLS] = {{NULL}};
+
 // Navigation
 static lv_obj_t *nav_dots[NUM_SCREENS] = {NULL};
 static lv_obj_t *btn_prev = NULL;
@@ -271,7 +406,7 @@ void blink_task(void *arg) {
 // Navigation
 // ============================================================================
 static const char *screen_titles[] = {
-    "PARAMETERS", "LOG FILES", "TEMPERATURES", "SPEED / RPM", "DYNAMICS", "SUSPENSION"
+    "PARAMETERS", "LOG FILES", "TEMPERATURES", "SPEED / RPM", "DYNAMICS", "SUSPENSION", "SNIFFER"
 };
 
 static void update_nav_ui(void) {
@@ -340,7 +475,7 @@ static void build_params_screen(lv_obj_t *parent) {
 
         // Labels placed directly on parent — no row container
         lv_obj_t *name_lbl = lv_label_create(parent);
-        lv_label_set_text(name_lbl, param_names[i]);
+        lv_label_set_text(name_lbl, param_rows[i].name);
         lv_obj_set_style_text_color(name_lbl, lv_color_make(180, 180, 200), 0);
         lv_obj_set_style_text_font(name_lbl, &lv_font_montserrat_12, 0);
         lv_obj_set_pos(name_lbl, 7, y);
@@ -359,6 +494,72 @@ static void build_params_screen(lv_obj_t *parent) {
     }
 }
 
+// ============================================================================
+// Screen 6: Sniffer bit activity
+// ============================================================================
+static void build_sniffer_screen(lv_obj_t *parent) {
+    lv_obj_set_style_pad_all(parent, 0, 0);
+    lv_obj_clear_flag(parent, LV_OBJ_FLAG_SCROLLABLE);
+
+    sniff_summary_label = lv_label_create(parent);
+    lv_label_set_text(sniff_summary_label, "No frames yet");
+    lv_obj_set_style_text_color(sniff_summary_label, lv_color_make(180, 180, 200), 0);
+    lv_obj_set_style_text_font(sniff_summary_label, &lv_font_montserrat_12, 0);
+    lv_obj_set_pos(sniff_summary_label, 7, 2);
+
+    static const char *headers[SNIFF_COLS] = {"ID", "Bit", "Flips", "Rate", "Byte min/max", "Bytes chg"};
+    static const int col_x[SNIFF_COLS] = {7, 70, 130, 200, 270, 380};
+    for (int c = 0; c < SNIFF_COLS; c++) {
+        lv_obj_t *h = lv_label_create(parent);
+        lv_label_set_text(h, headers[c]);
+        lv_obj_set_style_text_color(h, lv_palette_main(LV_PALETTE_CYAN), 0);
+        lv_obj_set_style_text_font(h, &lv_font_montserrat_12, 0);
+        lv_obj_set_pos(h, col_x[c], 20);
+    }
+
+    for (int i = 0; i < SNIFF_ROWS; i++) {
+        for (int c = 0; c < SNIFF_COLS; c++) {
+            lv_obj_t *lbl = lv_label_create(parent);
+            lv_label_set_text(lbl, "");
+            lv_obj_set_style_text_color(lbl, c == 0 ? lv_color_make(180, 180, 200) : lv_color_white(), 0);
+            lv_obj_set_style_text_font(lbl, &lv_font_montserrat_12, 0);
+            lv_obj_set_pos(lbl, col_x[c], 38 + i * 16);
+            sniff_cells[i][c] = lbl;
+        }
+    }
+}
+
+static void update_sniffer_screen(void) {
+    sniffer_summary_t sniff;
+    sniffer_bit_rank_t top[SNIFF_ROWS];
+    size_t n = can_sniffer_top_bits(top, SNIFF_ROWS);
+
+    if (can_sniffer_snapshot_summary(&sniff)) {
+        lv_label_set_text_fmt(sniff_summary_label,
+            "IDs: %d   Frames: %"PRIu32"   Untracked: %"PRIu32"   Missed cycles: %"PRIu32,
+            sniff.num_ids, sniff.total_msgs, sniff.untracked_msgs, sniff.missed_cycles);
+    }
+
+    for (size_t i = 0; i < SNIFF_ROWS; i++) {
+        if (i >= n) {
+            for (int c = 0; c < SNIFF_COLS; c++) lv_label_set_text(sniff_cells[i][c], "");
+            continue;
+        }
+        sniffer_entry_t entry;
+        if (!can_sniffer_snapshot_entry(top[i].id, &entry)) continue;  // keep last row
+        const sniffer_entry_t *e = &entry;
+        int byte = top[i].bit / 8;
+        // Toggles per 100 frames of this ID
+        uint32_t rate = e->count ? (uint32_t)((uint64_t)top[i].flips * 100 / e->count) : 0;
+        lv_label_set_text_fmt(sniff_cells[i][0], "0x%03"PRIX32, top[i].id);
+        lv_label_set_text_fmt(sniff_cells[i][1], "B%d.%d", byte, top[i].bit % 8);
+        lv_label_set_text_fmt(sniff_cells[i][2], "%"PRIu32, top[i].flips);
+        lv_label_set_text_fmt(sniff_cells[i][3], "%"PRIu32"%%", rate);
+        lv_label_set_text_fmt(sniff_cells[i][4], "%02X / %02X", e->byte_min[byte], e->byte_max[byte]);
+        lv_label_set_text_fmt(sniff_cells[i][5], "%02X", e->changed_mask);
+    }
+}
+
 // ============================================================================
 // Generic chart builder with inline labels (touch disabled for debug)
 // ============================================================================
@@ -480,9 +681,10 @@ static void chart_screen_touch_cb(lv_event_t *e) {
             int t0m, t1m;
             if (current_screen == 2) {
                 // Use range slider time from current log file
-                int base = log_files[current_log].start_hour * 60 + log_files[current_log].start_min;
-                t0m = base + range_start;
-                t1m = base + range_end;
+                const log_file_meta_t *f = &log_files[current_log];
+                int base = f->start_hour * 60 + f->start_min;
+                t0m = base + range_start * f->minutes / TIMELINE_POINTS;
+                t1m = base + range_end * f->minutes / TIMELINE_POINTS;
             } else {
                 int sh = 0, sm = 0, eh = 0, em = 0;
                 sscanf(info->x_labels[0], "%d:%d", &sh, &sm);
@@ -548,6 +750,150 @@ static void generate_log_data(int idx) {
     }
 }
 
+// Summary sidecar of an SD session (sd_logger.h) from its file name
+static void log_summary_path(const char *name, char *path, size_t size) {
+    const char *dot = strrchr(name, '.');
+    int base = dot ? (int)(dot - name) : (int)strlen(name);
+    snprintf(path, size, SD_MOUNT_POINT "/%.*s%s", base, name, SD_LOG_SUMMARY_EXTENSION);
+}
+
+// Open a summary and read its header and signal table; rows follow at the file position
+static FILE *open_log_summary(const char *name, sd_log_summary_header_t *hdr, sd_log_summary_signal_t *sigs) {
+    char path[96];
+    log_summary_path(name, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    if (fread(hdr, 1, sizeof(*hdr), fp) != sizeof(*hdr) ||
+        memcmp(hdr->magic, SD_LOG_SUMMARY_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != SD_LOG_SUMMARY_VERSION || hdr->period_s != SD_LOG_SUMMARY_PERIOD_S ||
+        hdr->signals > SD_LOG_SUMMARY_MAX_SIGNALS ||
+        fread(sigs, sizeof(*sigs), hdr->signals, fp) != hdr->signals ||
+        fseek(fp, hdr->header_len, SEEK_SET) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// List the card's sessions that have a summary, newest first; emulated files without a card
+static void scan_log_files(void) {
+    num_log_files = 0;
+    if (sd_logger_is_mounted()) {
+        static sd_file_info_t files[LOG_LIST_MAX];
+        int n = sd_logger_list_files(files, LOG_LIST_MAX);
+        for (int i = 0; i < n; i++) {
+            sd_log_summary_header_t hdr;
+            sd_log_summary_signal_t sigs[SD_LOG_SUMMARY_MAX_SIGNALS];
+            FILE *fp = open_log_summary(files[i].name, &hdr, sigs);
+            if (!fp) {
+                ESP_LOGI(TAG, "%s has no summary (rebuild with tools/logsummary.py)", files[i].name);
+                continue;
+            }
+
+            // Length from the last row's minute
+            long row_len = (long)SD_LOG_SUMMARY_ROW_LEN(hdr.signals);
+            uint32_t last = 0;
+            if (fseek(fp, 0, SEEK_END) == 0) {
+                long rows = (ftell(fp) - hdr.header_len) / row_len;
+                if (rows > 0) {
+                    fseek(fp, hdr.header_len + (rows - 1) * row_len, SEEK_SET);
+                    if (fread(&last, sizeof(last), 1, fp) != 1) last = 0;
+                }
+            }
+            fclose(fp);
+
+            log_file_meta_t *f = &log_files[num_log_files++];
+            snprintf(f->name, sizeof(f->name), "%s", files[i].name);
+            f->minutes = (int)last + 1;
+            f->start_hour = 0;
+            f->start_min = 0;
+            if (hdr.wall_time != 0) {
+                time_t t = (time_t)hdr.wall_time;
+                struct tm tm;
+                localtime_r(&t, &tm);
+                f->start_hour = tm.tm_hour;
+                f->start_min = tm.tm_min;
+            }
+        }
+    }
+
+    log_files_on_sd = num_log_files > 0;
+    if (!log_files_on_sd) {
+        memcpy(log_files, emulated_log_files, sizeof(emulated_log_files));
+        num_log_files = NUM_EMULATED_LOGS;
+    }
+    if (current_log >= num_log_files) current_log = 0;
+}
+
+static int32_t div_round(int64_t v, int64_t d) {
+    return (int32_t)((v + (v >= 0 ? d / 2 : -d / 2)) / d);
+}
+
+// Fill the tl_ arrays from a session's per-minute summary: a few KB instead of the whole log
+static bool load_log_summary(const log_file_meta_t *f) {
+    sd_log_summary_header_t hdr;
+    sd_log_summary_signal_t sigs[SD_LOG_SUMMARY_MAX_SIGNALS];
+    FILE *fp = open_log_summary(f->name, &hdr, sigs);
+    if (!fp) return false;
+
+    // Timeline series by decoder channel name
+    static const uint16_t channels[4] = {
+        MB_SIG_OIL_TEMP_C, MB_SIG_COOLANT_TEMP_C, MB_SIG_TRANS_OIL_TEMP_C, MB_SIG_AMBIENT_TEMP_RAW,
+    };
+    int32_t *series[4] = {tl_oil, tl_coolant, tl_trans, tl_ambient};
+    int col[4];
+    int32_t scale[4];
+    for (int s = 0; s < 4; s++) {
+        const char *name = mercedes_decode_channel_name(channels[s]);
+        col[s] = -1;
+        scale[s] = 1;
+        for (int i = 0; i < hdr.signals && name; i++) {
+            if (strncmp(sigs[i].name, name, sizeof(sigs[i].name)) == 0) {
+                col[s] = i;
+                for (int d = 0; d < sigs[i].decimals; d++) scale[s] *= 10;
+            }
+        }
+    }
+
+    // Means of the minutes in each point, weighted by their samples
+    static int64_t sum[4][TIMELINE_POINTS];
+    static uint32_t count[4][TIMELINE_POINTS];
+    memset(sum, 0, sizeof(sum));
+    memset(count, 0, sizeof(count));
+    uint8_t row[SD_LOG_SUMMARY_ROW_LEN(SD_LOG_SUMMARY_MAX_SIGNALS)];
+    size_t row_len = SD_LOG_SUMMARY_ROW_LEN(hdr.signals);
+    while (fread(row, 1, row_len, fp) == row_len) {
+        uint32_t minute;
+        memcpy(&minute, row, sizeof(minute));
+        if (minute >= (uint32_t)f->minutes) continue;
+        int pt = (int)((uint64_t)minute * TIMELINE_POINTS / f->minutes);
+        for (int s = 0; s < 4; s++) {
+            if (col[s] < 0) continue;
+            sd_log_summary_value_t v;
+            memcpy(&v, &row[sizeof(minute) + col[s] * sizeof(v)], sizeof(v));
+            sum[s][pt] += (int64_t)v.mean * v.samples;
+            count[s][pt] += v.samples;
+        }
+    }
+    fclose(fp);
+
+    // Points without samples repeat the one before (the first value, at the start)
+    for (int s = 0; s < 4; s++) {
+        int32_t last = 0;
+        for (int i = 0; i < TIMELINE_POINTS; i++) {
+            if (count[s][i]) {
+                last = div_round(div_round(sum[s][i], count[s][i]), scale[s]);
+                break;
+            }
+        }
+        for (int i = 0; i < TIMELINE_POINTS; i++) {
+            if (count[s][i]) last = div_round(div_round(sum[s][i], count[s][i]), scale[s]);
+            series[s][i] = last;
+        }
+    }
+    return true;
+}
+
 static void downsample_range(int32_t *src, int32_t *dst, int start, int end) {
     int rlen = end - start + 1;
     if (rlen < 1) rlen = 1;
@@ -668,10 +1014,11 @@ static void update_range_visuals(void) {
     // Handles
     lv_obj_set_pos(range_hl, lx - 4, RANGE_SLIDER_Y - 2);
     lv_obj_set_pos(range_hr, rx - 4, RANGE_SLIDER_Y - 2);
-    // Time labels: use log file start time, 1 point = 1 min
-    int base = log_files[current_log].start_hour * 60 + log_files[current_log].start_min;
-    int t0 = base + range_start;
-    int t1 = base + range_end;
+    // Time labels: log file start time, the session's minutes spread over the timeline
+    const log_file_meta_t *f = &log_files[current_log];
+    int base = f->start_hour * 60 + f->start_min;
+    int t0 = base + range_start * f->minutes / TIMELINE_POINTS;
+    int t1 = base + range_end * f->minutes / TIMELINE_POINTS;
     char buf[8];
     lv_snprintf(buf, sizeof(buf), "%d:%02d", t0 / 60, t0 % 60);
     lv_label_set_text(range_ll, buf);
@@ -740,9 +1087,17 @@ static void range_touch_cb(lv_event_t *e) {
 // Log file loading & switching
 // ============================================================================
 static void load_log_file(int idx) {
-    if (idx < 0 || idx >= NUM_LOG_FILES) return;
+    if (idx < 0 || idx >= num_log_files) return;
     current_log = idx;
-    generate_log_data(idx);
+    if (!log_files_on_sd) {
+        generate_log_data(idx);
+    } else if (!load_log_summary(&log_files[idx])) {
+        ESP_LOGW(TAG, "Could not read the summary of %s", log_files[idx].name);
+        memset(tl_oil, 0, sizeof(tl_oil));
+        memset(tl_coolant, 0, sizeof(tl_coolant));
+        memset(tl_trans, 0, sizeof(tl_trans));
+        memset(tl_ambient, 0, sizeof(tl_ambient));
+    }
     range_start = 0;
     range_end = TIMELINE_POINTS - 1;
     update_chart_from_range();
@@ -754,7 +1109,7 @@ static void log_list_select_cb(lv_event_t *e) {
     int idx = (int)(intptr_t)lv_event_get_user_data(e);
     load_log_file(idx);
     // Update selected highlight on log list
-    for (int i = 0; i < NUM_LOG_FILES; i++) {
+    for (int i = 0; i < num_log_files; i++) {
         if (log_list_btns[i]) {
             lv_obj_set_style_bg_color(log_list_btns[i],
                 i == idx ? lv_color_make(30, 60, 90) : lv_color_make(35, 35, 50), 0);
@@ -1281,7 +1636,7 @@ static void build_screen_content(int idx) {
         lv_obj_set_scrollbar_mode(screens[1], LV_SCROLLBAR_MODE_AUTO);
         lv_obj_clear_flag(screens[1], LV_OBJ_FLAG_SCROLL_ELASTIC);
         lv_obj_add_flag(screens[1], LV_OBJ_FLAG_SCROLLABLE);
-        for (int i = 0; i < NUM_LOG_FILES && i < LOG_LIST_MAX; i++) {
+        for (int i = 0; i < num_log_files && i < LOG_LIST_MAX; i++) {
             lv_obj_t *btn = lv_obj_create(screens[1]);
             lv_obj_set_size(btn, SCREEN_W - 20, 44);
             lv_obj_set_pos(btn, 0, i * 50);
@@ -1296,7 +1651,7 @@ static void build_screen_content(int idx) {
             lv_obj_add_event_cb(btn, log_list_select_cb, LV_EVENT_CLICKED, (void *)(intptr_t)i);
             lv_obj_t *lbl = lv_label_create(btn);
             char info_buf[64];
-            int dur = TIMELINE_POINTS;
+            int dur = log_files[i].minutes;
             lv_snprintf(info_buf, sizeof(info_buf), "%s  (%dh%02dm)",
                 log_files[i].name, dur / 60, dur % 60);
             lv_label_set_text(lbl, info_buf);
@@ -1315,7 +1670,7 @@ static void build_screen_content(int idx) {
             {"Ambient", lv_palette_main(LV_PALETTE_BLUE),   disp_ambient, &ser_ambient, LV_CHART_AXIS_PRIMARY_Y},
         };
         chart_temp = build_chart_generic(screens[2],
-            "Temperatures (emulated)", -10, 120, "C",
+            log_files_on_sd ? "Temperatures" : "Temperatures (emulated)", -10, 120, "C",
             x_times, 11, temp_series, 4, 0, 0, RANGE_CHART_H, temp_ser_labels,
             temp_y_labels, &temp_y_label_count);
         temp_chart_x = chart_infos[0].chart_x;
@@ -1426,6 +1781,9 @@ static void build_screen_content(int idx) {
         lv_obj_add_event_cb(screens[5], chart_screen_touch_cb, LV_EVENT_RELEASED, NULL);
         break;
     }
+    case 6:
+        build_sniffer_screen(screens[6]);
+        break;
     }
 }
 
@@ -1529,16 +1887,40 @@ static void build_dashboard(void) {
 // Dashboard update timer
 // ============================================================================
 static void dashboard_timer_cb(lv_timer_t *timer) {
-    const mercedes_data_t *mb = mercedes_decode_get_data();
+    // Consistent copies of CAN task state; on contention keep the previous copy
+    static mercedes_data_t mb_snap;
+    static sniffer_summary_t sniff_snap;
+    // Channels changed since the params screen last rendered them
+    static uint32_t params_dirty[MB_DIRTY_WORDS];
+    static bool params_rendered;
+    uint32_t fresh[MB_DIRTY_WORDS];
+    // Fetch before the snapshot so a change between the two is rendered now or next tick, never lost
+    mercedes_decode_fetch_dirty(fresh);
+    for (int i = 0; i < MB_DIRTY_WORDS; i++) params_dirty[i] |= fresh[i];
+    bool mb_ok = mercedes_decode_snapshot(&mb_snap);
+    can_sniffer_snapshot_summary(&sniff_snap);
+    const mercedes_data_t *mb = &mb_snap;
+    uint32_t stale_now[MB_STALE_WORDS];
+    uint32_t stale_count = mercedes_decode_get_stale(stale_now);
+    bool detecting;
+    const can_profile_t *prof = mercedes_decode_get_profile(&detecting);
     char buf[48];
 
     // Always update status bar
     if (status_bar_label) {
         bool running = can_driver_is_running();
-        const sniffer_state_t *sniff = can_sniffer_get_state();
-        if (running && mb->decode_count > 0) {
-            lv_snprintf(buf, sizeof(buf), "CAN OK | IDs:%d | Dec:%"PRIu32,
-                sniff->num_ids, mb->decode_count);
+        if (running && mb->decode_count > 0 && stale_count == prof->num_messages) {
+            lv_label_set_text(status_bar_label, "CAN: All messages stale");
+            lv_obj_set_style_text_color(status_bar_label, lv_palette_main(LV_PALETTE_YELLOW), 0);
+            lv_obj_set_style_bg_color(lv_obj_get_parent(status_bar_label), lv_color_make(30, 30, 10), 0);
+        } else if (running && mb->decode_count > 0) {
+            if (stale_count > 0) {
+                lv_snprintf(buf, sizeof(buf), "CAN OK | %s%s | IDs:%d | Stale:%"PRIu32"/%d",
+                    prof->name, detecting ? "?" : "", sniff_snap.num_ids, stale_count, prof->num_messages);
+            } else {
+                lv_snprintf(buf, sizeof(buf), "CAN OK | %s%s | IDs:%d | Dec:%"PRIu32,
+                    prof->name, detecting ? "?" : "", sniff_snap.num_ids, mb->decode_count);
+            }
             lv_label_set_text(status_bar_label, buf);
             lv_obj_set_style_text_color(status_bar_label, lv_palette_main(LV_PALETTE_GREEN), 0);
             lv_obj_set_style_bg_color(lv_obj_get_parent(status_bar_label), lv_color_make(10, 30, 10), 0);
@@ -1567,230 +1949,52 @@ static void dashboard_timer_cb(lv_timer_t *timer) {
         }
     }
 
-    // Only update params when visible
-    if (!lv_obj_has_flag(screens[0], LV_OBJ_FLAG_HIDDEN)) {
-        #define SET_VAL(idx, fmt, ...) if(param_value_labels[idx]) lv_label_set_text_fmt(param_value_labels[idx], fmt, ##__VA_ARGS__)
-        #define SET_RAW(idx, fmt, ...) if(param_raw_labels[idx]) lv_label_set_text_fmt(param_raw_labels[idx], fmt, ##__VA_ARGS__)
-        #define SET_VAL_S(idx, s) if(param_value_labels[idx]) lv_label_set_text(param_value_labels[idx], s)
-
-        // 0: Engine RPM (0x105)
-        SET_VAL(0, "%u", mb->engine_rpm);
-        SET_RAW(0, "%u", mb->engine_rpm);
-
-        // 1: RPM from 0x308 (×0.25)
-        {
-            uint32_t rpm308 = (uint32_t)mb->nmot_rpm_raw / 4;
-            SET_VAL(1, "%"PRIu32, rpm308);
-            SET_RAW(1, "%u", mb->nmot_rpm_raw);
-        }
-
-        // 2: Speed (from RDU wheel speeds, 0.01 km/h)
-        {
-            uint32_t avg = ((uint32_t)mb->ws_fl_rdu + mb->ws_fr_rdu + mb->ws_rl_rdu + mb->ws_rr_rdu) / 4;
-            uint32_t kmh = avg / 100;
-            uint32_t frac = (avg % 100) / 10;
-            lv_snprintf(buf, sizeof(buf), "%"PRIu32".%"PRIu32" km/h", kmh, frac);
-            SET_VAL_S(2, buf);
-            SET_RAW(2, "%u", mb->vehicle_speed_kmh);
-        }
-
-        // 3: Gas Pedal
-        SET_VAL(3, "%u%%", mb->gas_pedal);
-        SET_RAW(3, "%u", mb->gas_pedal);
-
-        // 4: Steer Angle
-        {
-            int raw = mb->steering_angle;
-            int deg = raw / 2;
-            int frac = abs(raw % 2) * 5;
-            if (raw < 0 && deg == 0)
-                lv_snprintf(buf, sizeof(buf), "-%d.%d", 0, frac);
-            else
-                lv_snprintf(buf, sizeof(buf), "%d.%d", deg, frac);
-            SET_VAL_S(4, buf);
-            SET_RAW(4, "%d", mb->steering_angle);
-        }
-
-        // 5: Brake
-        SET_VAL_S(5, mb->brake_pressed ? "ON" : "OFF");
-        if (mb->brake_pressed)
-            lv_obj_set_style_text_color(param_value_labels[5], lv_palette_main(LV_PALETTE_RED), 0);
-        else
-            lv_obj_set_style_text_color(param_value_labels[5], lv_color_white(), 0);
-        SET_RAW(5, "%u/%u", mb->brake_pressed, mb->brake_position);
+    // Only update params when visible, and only rows whose channels changed
+    if (mb_ok && !lv_obj_has_flag(screens[0], LV_OBJ_FLAG_HIDDEN)) {
+        // Dim rows whose message has gone quiet; only when the stale set changes
+        static uint32_t stale_shown[MB_STALE_WORDS];
+        bool restyle = !params_rendered || memcmp(stale_shown, stale_now, sizeof(stale_now)) != 0;
+
+        for (int i = 0; i < NUM_PARAMS; i++) {
+            const param_row_t *row = &param_rows[i];
+            if (!param_value_labels[i]) continue;
+
+            if (!params_rendered || param_row_dirty(row, params_dirty)) {
+                int32_t field = can_display_field(&row->disp, mb);
+                if (row->value_fn) {
+                    row->value_fn(mb, buf, sizeof(buf));
+                } else {
+                    can_display_format(&row->disp, mb, buf, sizeof(buf));
+                }
+                lv_label_set_text(param_value_labels[i], buf);
+                if (row->alert) {
+                    lv_obj_set_style_text_color(param_value_labels[i],
+                        field ? lv_palette_main(LV_PALETTE_RED) : lv_color_white(), 0);
+                }
 
-        // 6: Gear (FSC from 0x418)
-        {
-            const char *g = "?";
-            switch (mb->gear_fsc) {
-                case 0: g = "P"; break;
-                case 1: g = "R"; break;
-                case 2: g = "N"; break;
-                case 3: g = "D"; break;
-                case 4: g = "4"; break;
-                case 5: g = "3"; break;
-                case 6: g = "2"; break;
-                case 7: g = "1"; break;
+                if (row->raw_fn) {
+                    row->raw_fn(mb, buf, sizeof(buf));
+                } else {
+                    can_format_int(buf, field + row->raw_add, 0);
+                }
+                if (param_raw_labels[i]) lv_label_set_text(param_raw_labels[i], buf);
             }
-            SET_VAL_S(6, g);
-            SET_RAW(6, "%u/%u", mb->gear_fsc, mb->gear);
-        }
-
-        // 7: Drive Program
-        SET_VAL(7, "%u", mb->drive_program);
-        SET_RAW(7, "%u", mb->drive_program);
-
-        // 8: Oil Temp
-        SET_VAL(8, "%d C", mb->oil_temp_c);
-        SET_RAW(8, "%d", mb->oil_temp_c + 40);
-
-        // 9: Coolant Temp
-        SET_VAL(9, "%d C", mb->coolant_temp_c);
-        SET_RAW(9, "%d", mb->coolant_temp_c + 40);
-
-        // 10: Trans Temp
-        SET_VAL(10, "%d C", mb->trans_oil_temp_c);
-        SET_RAW(10, "%d", mb->trans_oil_temp_c + 40);
-
-        // 11: Ambient Temp (raw × 0.5 - 40)
-        {
-            int temp_x2 = mb->ambient_temp_raw - 80;  // (raw*0.5 - 40)*2
-            int deg = temp_x2 / 2;
-            int frac = abs(temp_x2 % 2) * 5;
-            if (temp_x2 < 0 && deg == 0)
-                lv_snprintf(buf, sizeof(buf), "-%d.%d C", 0, frac);
-            else
-                lv_snprintf(buf, sizeof(buf), "%d.%d C", deg, frac);
-            SET_VAL_S(11, buf);
-            SET_RAW(11, "%u", mb->ambient_temp_raw);
-        }
-
-        // 12: Fuel L/h (raw µl/250ms → L/h: raw * 0.0144 ≈ raw * 144 / 10000)
-        {
-            uint32_t lph_x100 = (uint32_t)mb->fuel_consumption * 144 / 100;
-            lv_snprintf(buf, sizeof(buf), "%"PRIu32".%02"PRIu32, lph_x100 / 100, lph_x100 % 100);
-            SET_VAL_S(12, buf);
-            SET_RAW(12, "%u", mb->fuel_consumption);
-        }
 
-        // 13: Tank Level
-        SET_VAL(13, "%u L", mb->tank_level);
-        SET_RAW(13, "%u", mb->tank_level);
-
-        // 14: Turbine RPM (raw × 0.25)
-        {
-            uint32_t trpm = (uint32_t)mb->turbine_speed_raw / 4;
-            SET_VAL(14, "%"PRIu32, trpm);
-            SET_RAW(14, "%u", mb->turbine_speed_raw);
-        }
-
-        // 15: Lateral G (raw × 0.01)
-        {
-            int g_val = mb->lateral_g_raw;
-            int whole = g_val / 100;
-            int frac = abs(g_val) % 100;
-            lv_snprintf(buf, sizeof(buf), "%d.%02d g", whole, frac);
-            SET_VAL_S(15, buf);
-            SET_RAW(15, "%d", mb->lateral_g_raw);
-        }
-
-        // 16: Yaw Rate (raw × 0.005)
-        {
-            int yr = mb->yaw_rate_raw;
-            int whole = (yr * 5) / 1000;
-            int frac = abs((yr * 5) % 1000) / 10;
-            lv_snprintf(buf, sizeof(buf), "%d.%02d d/s", whole, frac);
-            SET_VAL_S(16, buf);
-            SET_RAW(16, "%d", mb->yaw_rate_raw);
-        }
-
-        // 17-18: Blinkers
-        SET_VAL_S(17, mb->left_blinker ? "ON" : "OFF");
-        SET_RAW(17, "%u", mb->left_blinker);
-        SET_VAL_S(18, mb->right_blinker ? "ON" : "OFF");
-        SET_RAW(18, "%u", mb->right_blinker);
-
-        // 19: Highbeam
-        SET_VAL_S(19, (mb->highbeam_toggle || mb->highbeam_momentary) ? "ON" : "OFF");
-        lv_snprintf(buf, sizeof(buf), "T%u M%u", mb->highbeam_toggle, mb->highbeam_momentary);
-        if (param_raw_labels[19]) lv_label_set_text(param_raw_labels[19], buf);
-
-        // 20: Doors
-        if (mb->door_open_fl || mb->door_open_fr || mb->door_open_rl || mb->door_open_rr) {
-            lv_snprintf(buf, sizeof(buf), "%s%s%s%s",
-                mb->door_open_fl ? "FL " : "", mb->door_open_fr ? "FR " : "",
-                mb->door_open_rl ? "RL " : "", mb->door_open_rr ? "RR " : "");
-            SET_VAL_S(20, buf);
-        } else {
-            SET_VAL_S(20, "Closed");
-        }
-        SET_RAW(20, "0x%02X", mb->doors_open);
-
-        // 21-22: Seatbelts
-        SET_VAL_S(21, mb->seatbelt_driver ? "Yes" : "No");
-        SET_RAW(21, "%u", mb->seatbelt_driver);
-        SET_VAL_S(22, mb->seatbelt_passenger ? "Yes" : "No");
-        SET_RAW(22, "%u", mb->seatbelt_passenger);
-
-        // 23: Handbrake
-        SET_VAL_S(23, mb->handbrake ? "ON" : "OFF");
-        SET_RAW(23, "%u", mb->handbrake);
-
-        // 24-26: Warning lamps
-        SET_VAL_S(24, mb->esp_lamp ? "ON" : "OFF");
-        SET_RAW(24, "%u", mb->esp_lamp);
-        SET_VAL_S(25, mb->abs_lamp ? "ON" : "OFF");
-        SET_RAW(25, "%u", mb->abs_lamp);
-        SET_VAL_S(26, mb->mil_lamp ? "ON" : "OFF");
-        SET_RAW(26, "%u", mb->mil_lamp);
-
-        // 27: Oil warning
-        SET_VAL_S(27, mb->oil_warning ? "WARN" : "OK");
-        SET_RAW(27, "%u", mb->oil_warning);
-
-        // 28: Oil Level
-        SET_VAL(28, "%u", mb->oil_level);
-        SET_RAW(28, "%u", mb->oil_level);
-
-        // 29-32: Wheel speeds (RDU, ×0.01 km/h)
-        for (int w = 0; w < 4; w++) {
-            uint16_t raw_ws;
-            switch (w) {
-                case 0: raw_ws = mb->ws_fl_rdu; break;
-                case 1: raw_ws = mb->ws_fr_rdu; break;
-                case 2: raw_ws = mb->ws_rl_rdu; break;
-                default: raw_ws = mb->ws_rr_rdu; break;
+            int m = row->channel != PARAM_CH_NONE ? mercedes_decode_channel_message(row->channel) : -1;
+            if (restyle && m >= 0) {
+                lv_opa_t opa = ((stale_now[m / 32] >> (m % 32)) & 1u) ? LV_OPA_40 : LV_OPA_COVER;
+                lv_obj_set_style_opa(param_value_labels[i], opa, 0);
+                if (param_raw_labels[i]) lv_obj_set_style_opa(param_raw_labels[i], opa, 0);
             }
-            uint32_t kmh = raw_ws / 100;
-            uint32_t frac = (raw_ws % 100) / 10;
-            lv_snprintf(buf, sizeof(buf), "%"PRIu32".%"PRIu32" km/h", kmh, frac);
-            if (param_value_labels[29 + w]) lv_label_set_text(param_value_labels[29 + w], buf);
-            SET_RAW(29 + w, "%u", raw_ws);
         }
+        memcpy(stale_shown, stale_now, sizeof(stale_shown));
+
+        memset(params_dirty, 0, sizeof(params_dirty));
+        params_rendered = true;
+    }
 
-        // 33-36: AIRMATIC levels
-        SET_VAL(33, "%u", mb->level_fl);
-        SET_RAW(33, "%u", mb->level_fl);
-        SET_VAL(34, "%u", mb->level_fr);
-        SET_RAW(34, "%u", mb->level_fr);
-        SET_VAL(35, "%u", mb->level_rl);
-        SET_RAW(35, "%u", mb->level_rl);
-        SET_VAL(36, "%u", mb->level_rr);
-        SET_RAW(36, "%u", mb->level_rr);
-
-        // 37-38: Driving style
-        SET_VAL(37, "%u", mb->style_accel);
-        SET_RAW(37, "%u", mb->style_accel);
-        SET_VAL(38, "%u", mb->style_braking);
-        SET_RAW(38, "%u", mb->style_braking);
-
-        // 39: Decoded count
-        SET_VAL(39, "%"PRIu32, mb->decode_count);
-        if (param_raw_labels[39]) lv_label_set_text(param_raw_labels[39], "");
-
-        #undef SET_VAL
-        #undef SET_RAW
-        #undef SET_VAL_S
+    if (screen_built[6] && !lv_obj_has_flag(screens[6], LV_OBJ_FLAG_HIDDEN)) {
+        update_sniffer_screen();
     }
 }
 
@@ -1885,6 +2089,7 @@ void app_main(void) {
     lvgl_port_add_touch(&touch_cfg);
 
     // Pre-fill timeline + display buffers from first log file
+    scan_log_files();
     current_log = 0;
     generate_log_data(0);
     downsample_range(tl_oil, disp_oil, range_start, range_end);
@@ -1917,4 +2122,11 @@ void app_main(void) {
     // } else {
     //     ESP_LOGW(TAG, "SD card not available — logging disabled");
     // }
+
+    // Log screens list the card's sessions once it is mounted
+    if (sd_logger_is_mounted() && lvgl_port_lock(1000)) {
+        scan_log_files();
+        load_log_file(0);
+        lvgl_port_unlock();
+    }
 }
@@ -0,0 +1,116 @@
+// Parameter-list formatting: can_display_format() against snprintf (standing
+// in for lv_snprintf, which follows the same format rules) on rows shaped like
+// main.c's, over random field values. Both must give the same text.
+#include "can_display.h"
+#include "host_test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define VALUES 200000u
+#define REPEATS 5
+
+typedef struct {
+    uint16_t rpm_raw;
+    int16_t steering;
+    int8_t lateral_g;
+    int16_t yaw;
+    uint8_t ambient;
+    uint16_t fuel;
+    uint16_t wheel_speed;
+    uint8_t gear;
+    uint8_t blinker;
+    uint16_t boost_hpa;
+    int16_t slip_pm;
+    uint32_t trip_m;
+} values_t;
+
+static const char *const txt_gear[] = {"P", "R", "N", "D", "4", "3", "2", "1"};
+static const char *const txt_on_off[] = {"OFF", "ON"};
+
+static const can_display_t rows[] = {
+    CAN_DISPLAY_NUM(values_t, rpm_raw, 1, 0, 4, 0, ""),
+    CAN_DISPLAY_NUM(values_t, steering, 5, 0, 1, 1, ""),
+    CAN_DISPLAY_NUM(values_t, lateral_g, 1, 0, 1, 2, " g"),
+    CAN_DISPLAY_NUM(values_t, yaw, 1, 0, 2, 2, " d/s"),
+    CAN_DISPLAY_NUM(values_t, ambient, 5, -400, 1, 1, " C"),
+    CAN_DISPLAY_NUM(values_t, fuel, 144, 0, 100, 2, ""),
+    CAN_DISPLAY_NUM(values_t, wheel_speed, 1, 0, 10, 1, " km/h"),
+    CAN_DISPLAY_TEXT(values_t, gear, txt_gear),
+    CAN_DISPLAY_TEXT(values_t, blinker, txt_on_off),
+    CAN_DISPLAY_NUM(values_t, boost_hpa, 1, 0, 10, 2, " bar"),
+    CAN_DISPLAY_NUM(values_t, slip_pm, 1, 0, 1, 1, " %"),
+    CAN_DISPLAY_NUM(values_t, trip_m, 1, 0, 100, 1, " km"),
+};
+
+#define NUM_ROWS (sizeof(rows) / sizeof(rows[0]))
+
+static values_t values[VALUES / NUM_ROWS];
+
+// The row as snprintf would print it
+static size_t format_printf(const can_display_t *d, const void *base, char *buf, size_t size) {
+    int32_t field = can_display_field(d, base);
+    if (d->kind == CAN_DISP_TEXT) {
+        return (size_t)snprintf(buf, size, "%s", field >= 0 && field < d->num_texts ? d->texts[field] : "?");
+    }
+    int32_t value = (field * d->mul + d->add) / d->div;
+    if (d->decimals == 0) {
+        return (size_t)snprintf(buf, size, "%ld%s", (long)value, d->unit);
+    }
+    int32_t scale = 1;
+    for (uint8_t i = 0; i < d->decimals; i++) scale *= 10;
+    long mag = labs((long)value);
+    return (size_t)snprintf(buf, size, "%s%ld.%0*ld%s", value < 0 ? "-" : "", mag / scale,
+                            d->decimals, mag % scale, d->unit);
+}
+
+typedef size_t (*format_fn)(const can_display_t *, const void *, char *, size_t);
+
+// Best of REPEATS, ns per value
+static double run(format_fn fn) {
+    double best = 1e9;
+    char buf[32];
+    for (int r = 0; r < REPEATS; r++) {
+        size_t sink = 0;
+        uint64_t t0 = host_now_ns();
+        for (size_t v = 0; v < VALUES / NUM_ROWS; v++) {
+            for (size_t k = 0; k < NUM_ROWS; k++) sink += fn(&rows[k], &values[v], buf, sizeof(buf));
+        }
+        double ns = (double)(host_now_ns() - t0) / (VALUES / NUM_ROWS * NUM_ROWS);
+        __asm__ volatile("" : : "r"(sink));
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+int main(void) {
+    uint32_t seed = 5;
+    for (size_t v = 0; v < VALUES / NUM_ROWS; v++) {
+        uint8_t *p = (uint8_t *)&values[v];
+        for (size_t b = 0; b < sizeof(values[v]); b++) p[b] = (uint8_t)host_rand(&seed);
+        values[v].gear %= 9;                    // one past the table: "?"
+        values[v].blinker &= 1;
+        values[v].trip_m &= 0x0FFFFFFF;
+    }
+
+    // Same text as snprintf for every row and value
+    char a[32], b[32];
+    for (size_t v = 0; v < VALUES / NUM_ROWS; v++) {
+        for (size_t k = 0; k < NUM_ROWS; k++) {
+            size_t na = can_display_format(&rows[k], &values[v], a, sizeof(a));
+            size_t nb = format_printf(&rows[k], &values[v], b, sizeof(b));
+            if (na != nb || strcmp(a, b) != 0) {
+                fprintf(stderr, "row %zu: \"%s\", snprintf \"%s\"\n", k, a, b);
+                host_failures++;
+                v = VALUES;
+                break;
+            }
+        }
+    }
+
+    double table = run(can_display_format);
+    double printf_ns = run(format_printf);
+    printf("%zu rows x %zu values: can_display_format %5.1f ns/value, snprintf %5.1f ns/value (%.1fx)\n",
+           NUM_ROWS, (size_t)(VALUES / NUM_ROWS), table, printf_ns, printf_ns / table);
+    CHECK(table < printf_ns);
+    return host_test_done("bench_can_display");
+}
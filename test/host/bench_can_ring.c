@@ -0,0 +1,100 @@
+// Frame hand-off from the ingest side to one consumer thread: the FreeRTOS
+// queue path the ring replaced (xQueueSend / xQueueReceive of a copied
+// can_message_t) against can_ring push/pop and batched in-place reserve/peek.
+// On the host the queue is the mutex + condition variable of host_stubs.c.
+#include "can_config.h"
+#include "can_ring.h"
+#include "freertos/queue.h"
+#include "host_test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define FRAMES 1000000u
+
+typedef enum { PATH_QUEUE, PATH_RING_COPY, PATH_RING_BATCH } path_t;
+
+static const char *const path_names[] = {"queue (copy)", "ring push/pop", "ring batched, in place"};
+
+static QueueHandle_t queue;
+static can_ring_t ring;
+static can_message_t slots[CAN_INGEST_RING_SIZE];
+static path_t path;
+
+static void *producer(void *arg) {
+    (void)arg;
+    for (uint32_t seq = 0; seq < FRAMES;) {
+        if (path == PATH_QUEUE) {
+            can_message_t m = {.identifier = seq & 0x7FF, .data_length_code = 8, .timestamp = seq};
+            xQueueSend(queue, &m, portMAX_DELAY);
+            seq++;
+        } else if (path == PATH_RING_COPY) {
+            can_message_t m = {.identifier = seq & 0x7FF, .data_length_code = 8, .timestamp = seq};
+            if (can_ring_push(&ring, &m)) seq++;
+            else sched_yield();
+        } else {
+            can_message_t *s;
+            uint32_t n = can_ring_reserve(&ring, &s, CAN_RX_BATCH_MAX);
+            if (n > FRAMES - seq) n = FRAMES - seq;
+            if (n == 0) {
+                sched_yield();
+                continue;
+            }
+            for (uint32_t i = 0; i < n; i++, seq++) {
+                s[i].identifier = seq & 0x7FF;
+                s[i].data_length_code = 8;
+                s[i].timestamp = seq;
+            }
+            can_ring_commit(&ring, n);
+        }
+    }
+    return NULL;
+}
+
+// Returns the frames that arrived out of order (0 expected)
+static uint32_t consume(void) {
+    uint32_t bad = 0;
+    for (uint32_t seq = 0; seq < FRAMES;) {
+        if (path == PATH_QUEUE) {
+            can_message_t m;
+            xQueueReceive(queue, &m, portMAX_DELAY);
+            bad += m.timestamp != seq++;
+        } else if (path == PATH_RING_COPY) {
+            can_message_t m;
+            if (!can_ring_pop(&ring, &m)) {
+                sched_yield();
+                continue;
+            }
+            bad += m.timestamp != seq++;
+        } else {
+            const can_message_t *m;
+            uint32_t n = can_ring_peek(&ring, &m, CAN_RX_BATCH_MAX);
+            if (n == 0) {
+                sched_yield();
+                continue;
+            }
+            for (uint32_t i = 0; i < n; i++) bad += m[i].timestamp != seq++;
+            can_ring_release(&ring, n);
+        }
+    }
+    return bad;
+}
+
+int main(void) {
+    queue = xQueueCreate(CAN_INGEST_RING_SIZE, sizeof(can_message_t));
+    double ns[3];
+    for (int p = PATH_QUEUE; p <= PATH_RING_BATCH; p++) {
+        path = (path_t)p;
+        can_ring_init(&ring, slots, CAN_INGEST_RING_SIZE);
+        uint64_t t0 = host_now_ns();
+        pthread_t thread;
+        pthread_create(&thread, NULL, producer, NULL);
+        CHECK_EQ(consume(), 0);
+        pthread_join(thread, NULL);
+        ns[p] = (double)(host_now_ns() - t0) / FRAMES;
+        printf("%-24s %7.1f ns/frame  %6.2f Mframes/s\n", path_names[p], ns[p], 1000.0 / ns[p]);
+    }
+    printf("ring batched vs queue: %.1fx\n", ns[PATH_QUEUE] / ns[PATH_RING_BATCH]);
+    vQueueDelete(queue);
+    return host_test_done("bench_can_ring");
+}
@@ -0,0 +1,151 @@
+// can_sniffer: frames/s of can_sniffer_record() and of the ID lookup alone
+// (std_index for 11-bit IDs, the open-addressing hash for 29-bit IDs) against
+// the linear scan over a 64-entry table it replaced, with 40, 64 and 200
+// active IDs. The old table only ever held 64 IDs; every frame of an ID past
+// that scanned the whole table and was dropped. The new record also keeps the
+// change and timing statistics and the seqlocks. The tick count runs on the
+// manual host clock so a clock_gettime() per frame does not swamp either side.
+#include "can_sniffer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <string.h>
+
+#define FRAMES 1000000u
+#define REPEATS 5
+#define OLD_MAX_IDS 64
+
+// The implementation before the index: entries found by a linear scan
+typedef struct {
+    uint32_t id;
+    uint32_t count;
+    uint8_t last_data[8];
+    uint8_t last_dlc;
+    uint32_t last_tick;
+} old_entry_t;
+
+static struct {
+    old_entry_t entries[OLD_MAX_IDS];
+    int num_ids;
+    uint32_t total_msgs;
+} old_state;
+
+static void old_record(uint32_t id, const uint8_t *data, uint8_t dlc) {
+    old_state.total_msgs++;
+    for (int i = 0; i < old_state.num_ids; i++) {
+        if (old_state.entries[i].id == id) {
+            old_state.entries[i].count++;
+            old_state.entries[i].last_dlc = dlc;
+            old_state.entries[i].last_tick = xTaskGetTickCount();
+            memcpy(old_state.entries[i].last_data, data, dlc > 8 ? 8 : dlc);
+            return;
+        }
+    }
+    if (old_state.num_ids < OLD_MAX_IDS) {
+        old_entry_t *e = &old_state.entries[old_state.num_ids];
+        e->id = id;
+        e->count = 1;
+        e->last_dlc = dlc;
+        e->last_tick = xTaskGetTickCount();
+        memcpy(e->last_data, data, dlc > 8 ? 8 : dlc);
+        old_state.num_ids++;
+    }
+}
+
+static const old_entry_t *old_find(uint32_t id) {
+    for (int i = 0; i < old_state.num_ids; i++) {
+        if (old_state.entries[i].id == id) return &old_state.entries[i];
+    }
+    return NULL;
+}
+
+static uint32_t frame_id[FRAMES];
+static uint8_t frame_data[FRAMES][8];
+
+// Random order over `ids` distinct IDs; byte 0 counts, byte 1 wanders, the rest hold
+static void make_traffic(int ids, bool extended, uint32_t seed) {
+    uint32_t set[256];
+    for (int i = 0; i < ids; i++) {
+        set[i] = extended ? 0x18000000u | (host_rand(&seed) & 0xFFFFFF) : 0x010 + (uint32_t)i * 9;
+    }
+    uint8_t cur[256][8] = {{0}};
+    for (uint32_t f = 0; f < FRAMES; f++) {
+        int k = (int)(host_rand(&seed) % (uint32_t)ids);
+        cur[k][0]++;
+        if (host_rand(&seed) % 8 == 0) cur[k][1] ^= (uint8_t)(1u << (host_rand(&seed) % 8));
+        frame_id[f] = set[k];
+        memcpy(frame_data[f], cur[k], 8);
+    }
+}
+
+typedef enum { RUN_OLD_RECORD, RUN_NEW_RECORD, RUN_OLD_LOOKUP, RUN_NEW_LOOKUP } run_t;
+
+// Best of REPEATS, in frames per second
+static double run(run_t what) {
+    double best = 0;
+    for (int r = 0; r < REPEATS; r++) {
+        memset(&old_state, 0, sizeof(old_state));
+        can_sniffer_init();
+        if (what == RUN_OLD_LOOKUP || what == RUN_NEW_LOOKUP) {
+            for (uint32_t f = 0; f < FRAMES; f++) {
+                old_record(frame_id[f], frame_data[f], 8);
+                can_sniffer_record(frame_id[f], frame_data[f], 8, f * 250);
+            }
+        }
+
+        uintptr_t sink = 0;
+        uint64_t t0 = host_now_ns();
+        switch (what) {
+            case RUN_OLD_RECORD:
+                for (uint32_t f = 0; f < FRAMES; f++) old_record(frame_id[f], frame_data[f], 8);
+                break;
+            case RUN_NEW_RECORD:
+                for (uint32_t f = 0; f < FRAMES; f++) can_sniffer_record(frame_id[f], frame_data[f], 8, f * 250);
+                break;
+            case RUN_OLD_LOOKUP:
+                for (uint32_t f = 0; f < FRAMES; f++) sink += (uintptr_t)old_find(frame_id[f]);
+                break;
+            case RUN_NEW_LOOKUP:
+                for (uint32_t f = 0; f < FRAMES; f++) sink += (uintptr_t)can_sniffer_find(frame_id[f]);
+                break;
+        }
+        uint64_t ns = host_now_ns() - t0;
+        __asm__ volatile("" : : "r"(sink));
+        double fps = FRAMES * 1e9 / (double)ns;
+        if (fps > best) best = fps;
+    }
+    return best;
+}
+
+static void bench(int ids, bool extended) {
+    make_traffic(ids, extended, 11u + (uint32_t)ids);
+    double old_rec = run(RUN_OLD_RECORD);
+    double new_rec = run(RUN_NEW_RECORD);
+
+    // Every frame of a tracked ID is counted exactly once
+    const sniffer_state_t *s = can_sniffer_get_state();
+    CHECK_EQ(s->total_msgs, FRAMES);
+    uint32_t counted = 0;
+    for (int i = 0; i < s->num_ids; i++) counted += s->entries[i].count;
+    CHECK_EQ(counted + s->untracked_msgs, FRAMES);
+    CHECK_EQ(s->num_ids, extended && ids > SNIFFER_EXT_MAX_IDS ? SNIFFER_EXT_MAX_IDS : ids);
+    int tracked = s->num_ids;
+
+    double old_find_fps = run(RUN_OLD_LOOKUP);
+    double new_find_fps = run(RUN_NEW_LOOKUP);
+
+    printf("%3d %s IDs (%3d tracked, old %2d)  record: old %6.1f new %6.1f Mframes/s   "
+           "lookup: old %6.1f new %6.1f Mframes/s (%.1fx)\n",
+           ids, extended ? "29-bit" : "11-bit", tracked, ids < OLD_MAX_IDS ? ids : OLD_MAX_IDS,
+           old_rec / 1e6, new_rec / 1e6, old_find_fps / 1e6, new_find_fps / 1e6,
+           new_find_fps / old_find_fps);
+}
+
+int main(void) {
+    host_clock_manual(0);
+    static const int active[] = { 40, 64, 200 };
+    for (size_t i = 0; i < sizeof(active) / sizeof(active[0]); i++) bench(active[i], false);
+    for (size_t i = 0; i < sizeof(active) / sizeof(active[0]); i++) bench(active[i], true);
+    return host_test_done("bench_can_sniffer");
+}
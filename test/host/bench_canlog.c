@@ -0,0 +1,143 @@
+// Session log formats on bus-like traffic: records/s and bytes/frame of the
+// binary records (canlog_encode_frame), the compressed blocks (XORed records
+// cut into CANLOG_CHUNK_SIZE chunks for canlog_compress_chunk, as the SD writer
+// task does) and the CSV lines of the text logs (sd_logger.c format_entry).
+// File headers are left out; they are paid once per session. Binary and
+// compressed output is decoded back and compared frame by frame.
+#include "canlog.h"
+#include "mb_signals.h"
+#include "bus_traffic.h"
+#include "host_test.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FRAMES 200000u
+#define REPEATS 5
+#define CSV_MAX_LINE 64
+
+typedef enum { FMT_BINARY, FMT_COMPRESSED, FMT_CSV } format_t;
+
+static const char *const format_names[] = {"binary", "compressed", "csv"};
+
+static bus_frame_t frames[FRAMES];
+static uint8_t out[FRAMES * CSV_MAX_LINE];
+static size_t out_len;
+static uint8_t chunk[CANLOG_CHUNK_SIZE];
+static uint16_t lz_table[1 << CANLOG_LZ_HASH_BITS];
+static canlog_encoder_t enc;
+
+// The line sd_logger writes for a frame in CSV sessions
+static size_t csv_line(uint8_t *line, const bus_frame_t *f) {
+    return (size_t)snprintf((char *)line, CSV_MAX_LINE,
+                            "%lu,0x%03lX,%d,%02X,%02X,%02X,%02X,%02X,%02X,%02X,%02X\n",
+                            (unsigned long)(f->ts_us / 1000), (unsigned long)f->id, f->dlc,
+                            f->data[0], f->data[1], f->data[2], f->data[3],
+                            f->data[4], f->data[5], f->data[6], f->data[7]);
+}
+
+// Encode all frames in one format into out[]
+static void encode(format_t fmt) {
+    canlog_header_t hdr;
+    canlog_begin(&enc, &hdr, fmt == FMT_COMPRESSED ? CANLOG_FLAG_COMPRESSED : 0, 0, 0, 500000);
+    out_len = 0;
+    size_t chunk_len = 0;
+
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        const bus_frame_t *f = &frames[i];
+        if (fmt == FMT_CSV) {
+            out_len += csv_line(&out[out_len], f);
+        } else if (fmt == FMT_BINARY) {
+            out_len += canlog_encode_frame(&enc, &out[out_len], f->ts_us, f->id, f->data, f->dlc);
+        } else {
+            if (chunk_len + CANLOG_MAX_RECORD_LEN > sizeof(chunk)) {
+                out_len += canlog_compress_chunk(chunk, chunk_len, &out[out_len], lz_table);
+                canlog_begin_chunk(&enc);
+                chunk_len = 0;
+            }
+            chunk_len += canlog_encode_frame(&enc, &chunk[chunk_len], f->ts_us, f->id, f->data, f->dlc);
+        }
+    }
+    if (chunk_len > 0) out_len += canlog_compress_chunk(chunk, chunk_len, &out[out_len], lz_table);
+}
+
+// Decode records from buf, checking each frame against frames[*next]
+static bool check_records(canlog_decoder_t *dec, const uint8_t *buf, size_t len, uint32_t *next) {
+    size_t pos = 0;
+    while (pos < len) {
+        canlog_frame_t frame;
+        bool is_frame = false;
+        int n = canlog_decode_record(dec, &buf[pos], len - pos, &frame, &is_frame);
+        if (n <= 0) return false;
+        pos += (size_t)n;
+        if (!is_frame) continue;
+        if (*next == FRAMES) return false;
+        const bus_frame_t *f = &frames[(*next)++];
+        if (frame.time_us != f->ts_us || frame.can_id != f->id || frame.dlc != f->dlc ||
+            memcmp(frame.data, f->data, f->dlc) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The encoded output decodes back to the traffic
+static bool round_trip(format_t fmt) {
+    canlog_decoder_t dec;
+    canlog_decoder_init(&dec, fmt == FMT_COMPRESSED ? CANLOG_FLAG_COMPRESSED : 0);
+    uint32_t next = 0;
+
+    if (fmt == FMT_BINARY) {
+        return check_records(&dec, out, out_len, &next) && next == FRAMES;
+    }
+    size_t pos = 0;
+    while (pos < out_len) {
+        const uint8_t *h = &out[pos];
+        if (pos + CANLOG_BLOCK_HEADER_LEN > out_len || h[0] != CANLOG_BLOCK_TAG) return false;
+        size_t raw_len = h[4] | h[5] << 8;
+        size_t data_len = h[6] | h[7] << 8;
+        if (canlog_decompress_block(&h[CANLOG_BLOCK_HEADER_LEN], data_len, h[3], chunk, raw_len) != raw_len) {
+            return false;
+        }
+        canlog_decoder_begin_chunk(&dec);
+        if (!check_records(&dec, chunk, raw_len, &next)) return false;
+        pos += CANLOG_BLOCK_HEADER_LEN + data_len;
+    }
+    return next == FRAMES;
+}
+
+// Best of REPEATS, records per second
+static double run(format_t fmt) {
+    double best = 0;
+    for (int r = 0; r < REPEATS; r++) {
+        uint64_t t0 = host_now_ns();
+        encode(fmt);
+        double rate = FRAMES * 1e9 / (double)(host_now_ns() - t0);
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+int main(void) {
+    bus_traffic_generate(&mb_profiles[0], 40, 3, frames, FRAMES);
+    double seconds = frames[FRAMES - 1].ts_us / 1e6;
+    printf("%u frames, %.1f s of %s traffic (40 foreign IDs)\n", FRAMES, seconds, mb_profiles[0].name);
+
+    double csv_bytes = 0;
+    for (format_t fmt = FMT_BINARY; fmt <= FMT_CSV; fmt++) {
+        double rate = run(fmt);
+        double bytes = (double)out_len / FRAMES;
+        if (fmt == FMT_CSV) {
+            csv_bytes = bytes;
+        } else {
+            CHECK(round_trip(fmt));
+        }
+        printf("%-10s  %6.2f M records/s  %5.2f bytes/frame  %6.1f kB/s of log\n",
+               format_names[fmt], rate / 1e6, bytes, out_len / seconds / 1000);
+    }
+    // Both binary formats must beat the text they replace
+    encode(FMT_BINARY);
+    CHECK((double)out_len / FRAMES < csv_bytes);
+    encode(FMT_COMPRESSED);
+    CHECK((double)out_len / FRAMES < csv_bytes);
+    return host_test_done("bench_canlog");
+}
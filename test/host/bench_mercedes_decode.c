@@ -0,0 +1,104 @@
+// Decoder cost per frame: the hand-written switch (mercedes_switch_ref.c)
+// against the generated tables, on random payloads and on bus-like traffic
+// (bus_traffic.c: cycle times from the DBC, most bytes steady).
+//   switch   mercedes_switch_decode()
+//   tables   can_profile_find() + can_signal_decode(), the table walk
+//   generated can_profile_find() + msg->decode(), the generated per-message decoder
+//   full     mercedes_decode_message(): generated plus unchanged-payload skip,
+//            dirty bits, derived channels, staleness and the seqlock
+#include "mercedes_decode.h"
+#include "mercedes_switch_ref.h"
+#include "bus_traffic.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <string.h>
+
+#define FRAMES 1000000u
+#define REPEATS 7
+
+static bus_frame_t frames[FRAMES];
+
+typedef enum { DEC_SWITCH, DEC_TABLES, DEC_GENERATED, DEC_FULL } decoder_t;
+
+static mercedes_data_t bench_data;
+
+static inline void decode_tables(const bus_frame_t *f, bool generated) {
+    const can_profile_t *p = &mb_profiles[MB_PROFILE_W218];
+    const can_message_def_t *msg = can_profile_find(p, f->id);
+    if (msg == NULL) return;
+    if (f->dlc >= msg->min_dlc) {
+        uint64_t word = can_signal_load(f->data);
+        if (generated) {
+            msg->decode(word, &bench_data);
+        } else {
+            can_signal_decode(msg, p->signals, word, &bench_data);
+        }
+    }
+    bench_data.decode_count++;
+}
+
+// Best of REPEATS, ns per frame
+static double run(decoder_t dec) {
+    double best = 1e9;
+    for (int r = 0; r < REPEATS; r++) {
+        memset(&bench_data, 0, sizeof(bench_data));
+        mercedes_decode_init();
+        uint64_t t0 = host_now_ns();
+        switch (dec) {
+            case DEC_SWITCH:
+                for (uint32_t i = 0; i < FRAMES; i++) {
+                    mercedes_switch_decode(&bench_data, frames[i].id, frames[i].data, frames[i].dlc);
+                }
+                break;
+            case DEC_TABLES:
+                for (uint32_t i = 0; i < FRAMES; i++) decode_tables(&frames[i], false);
+                break;
+            case DEC_GENERATED:
+                for (uint32_t i = 0; i < FRAMES; i++) decode_tables(&frames[i], true);
+                break;
+            case DEC_FULL:
+                for (uint32_t i = 0; i < FRAMES; i++) {
+                    mercedes_decode_message(frames[i].id, frames[i].data, frames[i].dlc, frames[i].ts_us);
+                }
+                break;
+        }
+        double ns = (double)(host_now_ns() - t0) / FRAMES;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+static void bench(const char *label) {
+    double sw = run(DEC_SWITCH);
+    double tab = run(DEC_TABLES);
+    double gen = run(DEC_GENERATED);
+    double full = run(DEC_FULL);
+    printf("%-18s switch %5.1f  tables %5.1f  generated %5.1f  full %5.1f ns/frame\n",
+           label, sw, tab, gen, full);
+}
+
+int main(void) {
+    host_clock_manual(0);
+    uint32_t ids[64];
+    size_t n = 0;
+    for (uint32_t id = 0; id < CAN_PROFILE_ID_SPACE; id++) {
+        if (can_profile_find(&mb_profiles[MB_PROFILE_W218], id) != NULL) ids[n++] = id;
+    }
+    ids[n++] = 0x7E8;
+    ids[n++] = 0x123;
+    ids[n++] = 0x400;
+
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        bus_frame_t *f = &frames[i];
+        f->ts_us = i * 200;
+        f->id = ids[host_rand(&seed) % n];
+        for (int b = 0; b < 8; b++) f->data[b] = (uint8_t)host_rand(&seed);
+        f->dlc = host_rand(&seed) % 10 == 0 ? host_rand(&seed) % 9 : 8;
+    }
+    bench("random payloads");
+
+    bus_traffic_generate(&mb_profiles[MB_PROFILE_W218], 8, 1, frames, FRAMES);
+    bench("bus-like traffic");
+    return host_test_done("bench_mercedes_decode");
+}
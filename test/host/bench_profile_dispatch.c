@@ -0,0 +1,104 @@
+// Per-frame dispatch cost of the active profile: can_profile_find() (one load
+// from the profile's message_index) against a linear scan and a binary search
+// over the profile's sorted ID list, on each profile's bus-like traffic with
+// foreign IDs mixed in. "read" is the loop over the frames alone (memory
+// bound); mercedes_decode_message() is timed alongside for scale.
+#include "mercedes_decode.h"
+#include "bus_traffic.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <string.h>
+
+#define FRAMES 1000000u
+#define REPEATS 7
+
+static bus_frame_t frames[FRAMES];
+static uint32_t ids[CAN_PROFILE_ID_SPACE];
+static size_t num_ids;
+
+typedef enum { RUN_READ, RUN_INDEX, RUN_LINEAR, RUN_BINARY, RUN_DECODE } run_t;
+
+static const can_message_def_t *find_linear(const can_profile_t *p, uint32_t id) {
+    for (size_t k = 0; k < num_ids; k++) {
+        if (ids[k] == id) return &p->messages[p->message_index[id] - 1];
+    }
+    return NULL;
+}
+
+static const can_message_def_t *find_binary(const can_profile_t *p, uint32_t id) {
+    size_t lo = 0, hi = num_ids;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (ids[mid] < id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < num_ids && ids[lo] == id ? &p->messages[p->message_index[id] - 1] : NULL;
+}
+
+// Best of REPEATS, ns per frame
+static double run(const can_profile_t *p, run_t what) {
+    double best = 1e9;
+    for (int r = 0; r < REPEATS; r++) {
+        mercedes_decode_init();
+        uintptr_t sink = 0;
+        uint64_t t0 = host_now_ns();
+        switch (what) {
+            case RUN_READ:
+                for (uint32_t i = 0; i < FRAMES; i++) sink += frames[i].id;
+                break;
+            case RUN_INDEX:
+                for (uint32_t i = 0; i < FRAMES; i++) sink += (uintptr_t)can_profile_find(p, frames[i].id);
+                break;
+            case RUN_LINEAR:
+                for (uint32_t i = 0; i < FRAMES; i++) sink += (uintptr_t)find_linear(p, frames[i].id);
+                break;
+            case RUN_BINARY:
+                for (uint32_t i = 0; i < FRAMES; i++) sink += (uintptr_t)find_binary(p, frames[i].id);
+                break;
+            case RUN_DECODE:
+                for (uint32_t i = 0; i < FRAMES; i++) {
+                    mercedes_decode_message(frames[i].id, frames[i].data, frames[i].dlc, frames[i].ts_us);
+                }
+                break;
+        }
+        double ns = (double)(host_now_ns() - t0) / FRAMES;
+        __asm__ volatile("" : : "r"(sink));
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+static void bench(int profile) {
+    const can_profile_t *p = &mb_profiles[profile];
+    CHECK_EQ(mercedes_decode_select_profile(p->name), ESP_OK);
+    mercedes_decode_init();
+    CHECK(mercedes_decode_get_profile(NULL) == p);
+    num_ids = mercedes_decode_get_ids(ids, CAN_PROFILE_ID_SPACE);
+
+    bus_traffic_generate(p, 40, 3, frames, FRAMES);
+    // The three lookups agree on every frame
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        const can_message_def_t *m = can_profile_find(p, frames[i].id);
+        if (find_linear(p, frames[i].id) != m || find_binary(p, frames[i].id) != m) {
+            host_failures++;
+            break;
+        }
+    }
+
+    double read = run(p, RUN_READ);
+    double index = run(p, RUN_INDEX);
+    double linear = run(p, RUN_LINEAR);
+    double binary = run(p, RUN_BINARY);
+    double decode = run(p, RUN_DECODE);
+    printf("%s (%2zu IDs, 40 foreign)  read %5.2f  index %5.2f  linear %5.2f  binary %5.2f  "
+           "decode_message %5.1f ns/frame\n", p->name, num_ids, read, index, linear, binary, decode);
+}
+
+int main(void) {
+    host_clock_manual(0);
+    for (int p = 0; p < MB_PROFILE_COUNT; p++) bench(p);
+    return host_test_done("bench_profile_dispatch");
+}
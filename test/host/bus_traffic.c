@@ -0,0 +1,98 @@
+#include "bus_traffic.h"
+#include "host_test.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_SOURCES 128
+
+typedef struct {
+    uint32_t id;
+    uint32_t period_us;
+    uint32_t next_us;
+    uint8_t dlc;
+    uint8_t rate[8];        // chance in 256 that a byte changes per frame
+    uint8_t data[8];
+} source_t;
+
+// Cycle times of the IDs other ECUs send
+static const uint16_t foreign_periods_ms[] = { 10, 20, 50, 100, 200, 1000 };
+
+static void add_source(source_t *s, uint32_t id, uint32_t period_ms, uint8_t dlc, uint32_t *seed) {
+    memset(s, 0, sizeof(*s));
+    s->id = id;
+    s->period_us = period_ms * 1000;
+    s->next_us = host_rand(seed) % s->period_us;
+    s->dlc = dlc;
+    for (int b = 0; b < 8; b++) {
+        // Mostly steady bytes, some slow values, the odd counter
+        uint32_t r = host_rand(seed) % 8;
+        s->rate[b] = r < 4 ? 0 : r < 7 ? (uint8_t)(host_rand(seed) % 32) : 255;
+        s->data[b] = (uint8_t)host_rand(seed);
+    }
+}
+
+size_t bus_traffic_generate(const can_profile_t *p, unsigned foreign, uint32_t seed,
+                            bus_frame_t *out, size_t count) {
+    static source_t src[MAX_SOURCES];
+    size_t n = 0;
+    seed = seed ? seed : 1;
+
+    for (uint32_t id = 0; id < CAN_PROFILE_ID_SPACE && n < MAX_SOURCES; id++) {
+        const can_message_def_t *msg = can_profile_find(p, id);
+        if (msg == NULL) continue;
+        uint32_t period = msg->cycle_ms ? msg->cycle_ms : BUS_EVENT_PERIOD_MS;
+        add_source(&src[n++], id, period, 8, &seed);
+    }
+    // Spread the foreign IDs over the 11-bit space, skipping the profile's own
+    uint32_t id = 0x0A1;
+    for (unsigned f = 0; f < foreign && n < MAX_SOURCES; f++) {
+        do {
+            id = (id + 0x2B5) & 0x7FF;
+        } while (can_profile_find(p, id) != NULL);
+        uint32_t period = foreign_periods_ms[f % (sizeof(foreign_periods_ms) / sizeof(foreign_periods_ms[0]))];
+        add_source(&src[n++], id, period, (uint8_t)(4 + f % 5), &seed);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        source_t *s = &src[0];
+        for (size_t k = 1; k < n; k++) {
+            if (src[k].next_us < s->next_us) s = &src[k];
+        }
+        for (int b = 0; b < 8; b++) {
+            if (s->rate[b] && host_rand(&seed) % 256 < s->rate[b]) s->data[b] = (uint8_t)host_rand(&seed);
+        }
+        bus_frame_t *f = &out[i];
+        f->ts_us = s->next_us;
+        f->id = s->id;
+        f->dlc = s->dlc;
+        memset(f->data, 0, sizeof(f->data));
+        memcpy(f->data, s->data, s->dlc);
+
+        uint32_t jitter = s->period_us / 10;
+        s->next_us += s->period_us - jitter / 2 + (jitter ? host_rand(&seed) % jitter : 0);
+    }
+    return count;
+}
+
+size_t bus_traffic_load_csv(const char *path, bus_frame_t *out, size_t max) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return 0;
+
+    char line[128];
+    size_t n = 0;
+    while (n < max && fgets(line, sizeof(line), f)) {
+        unsigned long ms, id;
+        unsigned dlc, d[8] = {0};
+        int fields = sscanf(line, "%lu,%lx,%u,%x,%x,%x,%x,%x,%x,%x,%x", &ms, &id, &dlc,
+                            &d[0], &d[1], &d[2], &d[3], &d[4], &d[5], &d[6], &d[7]);
+        if (fields < 3) continue;  // header or a torn line
+        bus_frame_t *fr = &out[n++];
+        fr->ts_us = (uint32_t)(ms * 1000);
+        fr->id = (uint32_t)id;
+        fr->dlc = (uint8_t)(dlc > 8 ? 8 : dlc);
+        for (int b = 0; b < 8; b++) fr->data[b] = (uint8_t)d[b];
+    }
+    fclose(f);
+    return n;
+}
@@ -0,0 +1,26 @@
+#pragma once
+// Bus traffic for the host tests: a vehicle profile's messages replayed at their
+// DBC cycle times, or a session recorded by the SD logger (CSV format)
+#include "can_signal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t ts_us;
+    uint32_t id;
+    uint8_t dlc;
+    uint8_t data[8];
+} bus_frame_t;
+
+// Every message of profile p at its cycle time (event-driven ones every
+// BUS_EVENT_PERIOD_MS) with ±5 % jitter, plus `foreign` IDs the profile does not
+// decode, starting at time 0. Payload bytes change at a fixed per-byte rate, as
+// counters, sensor values and status bits do. Same seed, same traffic.
+// Returns the number of frames written (count).
+#define BUS_EVENT_PERIOD_MS 500
+size_t bus_traffic_generate(const can_profile_t *p, unsigned foreign, uint32_t seed,
+                            bus_frame_t *out, size_t count);
+
+// Read up to max frames of a CSV session (timestamp_ms,can_id,dlc,d0..d7)
+// Returns the number of frames read, 0 if the file cannot be read.
+size_t bus_traffic_load_csv(const char *path, bus_frame_t *out, size_t max);
@@ -0,0 +1,309 @@
+// Scripted OBD-II ECUs for the host tests, see ecu_sim.h
+#include "ecu_sim.h"
+#include "host_stubs.h"
+#include "obd2_pids.h"
+#include "esp_timer.h"
+#include <string.h>
+
+#define MAX_EVENTS 256
+#define MAX_ANSWER 64
+
+// A frame on its way to the tester
+typedef struct {
+    int64_t at_us;
+    can_message_t msg;
+} event_t;
+
+// Answer in progress on one ECU: consecutive frames wait for flow control
+typedef struct {
+    uint8_t data[MAX_ANSWER];
+    size_t len;
+    size_t sent;
+    uint8_t seq;
+    int64_t last_us;            // when the last frame goes out
+    bool uds;                   // answer to a 0x22 request
+} answer_t;
+
+static ecu_sim_ecu_t ecus[ECU_SIM_MAX_ECUS];
+static answer_t answers[ECU_SIM_MAX_ECUS];
+static size_t num_ecus;
+static event_t events[MAX_EVENTS];
+static size_t num_events;
+static uint8_t values[256][4];
+static ecu_sim_stats_t stats;
+
+void ecu_sim_init(int64_t start_us) {
+    host_clock_manual(start_us);
+    memset(ecus, 0, sizeof(ecus));
+    memset(answers, 0, sizeof(answers));
+    num_ecus = 0;
+    num_events = 0;
+    memset(&stats, 0, sizeof(stats));
+    for (int pid = 0; pid < 256; pid++) {
+        for (int b = 0; b < 4; b++) values[pid][b] = (uint8_t)(pid * 7 + b * 31 + 0x40);
+    }
+}
+
+ecu_sim_ecu_t *ecu_sim_add(uint32_t rx_id, const uint8_t *pids, size_t num_pids, uint32_t latency_us) {
+    if (num_ecus == ECU_SIM_MAX_ECUS) return NULL;
+    ecu_sim_ecu_t *e = &ecus[num_ecus++];
+    *e = (ecu_sim_ecu_t){.rx_id = rx_id, .pids = pids, .num_pids = num_pids,
+                         .latency_us = latency_us, .frame_gap_us = 250, .online = true};
+    return e;
+}
+
+void ecu_sim_set_value(uint8_t pid, const uint8_t *bytes, size_t len) {
+    memcpy(values[pid], bytes, len < 4 ? len : 4);
+}
+
+const ecu_sim_stats_t *ecu_sim_stats(void) {
+    return &stats;
+}
+
+static void push(int64_t at_us, uint32_t id, const uint8_t *data) {
+    if (num_events == MAX_EVENTS) return;
+    event_t *ev = &events[num_events++];
+    ev->at_us = at_us;
+    ev->msg = (can_message_t){.identifier = id, .data_length_code = 8};
+    memcpy(ev->msg.data, data, 8);
+}
+
+static bool supports(const ecu_sim_ecu_t *e, unsigned pid) {
+    for (size_t i = 0; i < e->num_pids; i++) {
+        if (e->pids[i] == pid) return true;
+    }
+    return false;
+}
+
+// Support PID base: answered if it is 0x00 or the ECU has PIDs past base
+static bool support_answer(const ecu_sim_ecu_t *e, unsigned base, uint8_t *out) {
+    bool beyond_base = false, beyond_range = false;
+    uint32_t map = 0;
+    for (size_t i = 0; i < e->num_pids; i++) {
+        unsigned pid = e->pids[i];
+        if (pid > base) beyond_base = true;
+        if (pid > base && pid <= base + 0x20) map |= 0x80000000u >> (pid - base - 1);
+        if (pid > base + 0x20) beyond_range = true;
+    }
+    if (base != 0 && !beyond_base) return false;
+    if (beyond_range) map |= 1;     // support PID base + 0x20
+    out[0] = (uint8_t)base;
+    out[1] = (uint8_t)(map >> 24);
+    out[2] = (uint8_t)(map >> 16);
+    out[3] = (uint8_t)(map >> 8);
+    out[4] = (uint8_t)map;
+    return true;
+}
+
+// Mode 01 answer of one ECU; 1 (just the 0x41) if it supports none of the PIDs
+static size_t mode01_answer(const ecu_sim_ecu_t *e, const uint8_t *pids, size_t count, uint8_t *out) {
+    size_t len = 0;
+    out[len++] = OBD2_SERVICE_CURRENT_DATA + 0x40;
+    for (size_t i = 0; i < count; i++) {
+        unsigned pid = pids[i];
+        if (pid % OBD2_SUPPORT_RANGE == 0) {
+            if (support_answer(e, pid, &out[len])) len += 5;
+            continue;
+        }
+        const obd2_pid_t *info = obd2_get_pid_info((uint8_t)pid);
+        if (!supports(e, pid) || info == NULL) continue;
+        out[len++] = (uint8_t)pid;
+        memcpy(&out[len], values[pid], info->num_bytes);
+        len += info->num_bytes;
+    }
+    return len;
+}
+
+// Single frame, or a first frame with the rest held for flow control
+static void send_answer(size_t k, const uint8_t *msg, size_t len, int64_t at_us) {
+    ecu_sim_ecu_t *e = &ecus[k];
+    answer_t *a = &answers[k];
+    uint8_t f[8] = {0};
+    stats.answers++;
+    stats.frames++;
+    if (len <= 7) {
+        f[0] = (uint8_t)len;
+        memcpy(&f[1], msg, len);
+        push(at_us, e->rx_id, f);
+        a->len = 0;
+        return;
+    }
+    stats.multi_frame++;
+    f[0] = (uint8_t)(0x10 | (len >> 8));
+    f[1] = (uint8_t)len;
+    memcpy(&f[2], msg, 6);
+    push(at_us, e->rx_id, f);
+    memcpy(a->data, msg, len);
+    a->len = len;
+    a->sent = 6;
+    a->seq = 1;
+    a->last_us = at_us;
+    a->uds = false;
+}
+
+static void functional_request(const can_message_t *m) {
+    size_t count = m->data[0] >= 1 && m->data[0] <= 7 ? m->data[0] - 1u : 0;
+    uint8_t service = m->data[1];
+    const uint8_t *pids = &m->data[2];
+    stats.requests++;
+
+    if (service == OBD2_SERVICE_CURRENT_DATA && count > 0) {
+        size_t support = 0;
+        for (size_t i = 0; i < count; i++) support += pids[i] % OBD2_SUPPORT_RANGE == 0;
+        if (support < count) {
+            stats.pid_requests++;
+            stats.pids_requested += count - support;
+        } else {
+            stats.support_requests++;
+        }
+        if (count > stats.max_pids) stats.max_pids = count;
+    }
+
+    int64_t now = esp_timer_get_time();
+    for (size_t k = 0; k < num_ecus; k++) {
+        const ecu_sim_ecu_t *e = &ecus[k];
+        if (!e->online) continue;
+        uint8_t msg[MAX_ANSWER];
+        size_t len;
+        if (service == OBD2_SERVICE_CURRENT_DATA) {
+            len = mode01_answer(e, pids, count, msg);
+            if (len == 1) continue;    // functional requests go unanswered when nothing applies
+        } else {
+            msg[0] = service + 0x40;
+            msg[1] = 0;                 // no DTCs
+            len = 2;
+        }
+        send_answer(k, msg, len, now + e->latency_us);
+    }
+}
+
+static ecu_sim_did_t *find_did(const ecu_sim_ecu_t *e, uint16_t did) {
+    for (size_t i = 0; i < e->num_dids; i++) {
+        if (e->dids[i].did == did) return &e->dids[i];
+    }
+    return NULL;
+}
+
+static void send_negative(size_t k, uint8_t nrc, int64_t at_us) {
+    const uint8_t f[8] = {3, 0x7F, 0x22, nrc};
+    push(at_us, ecus[k].rx_id, f);
+    stats.frames++;
+    stats.uds_negative++;
+    stats.uds_frames++;
+}
+
+// Single-frame ReadDataByIdentifier request to ECU k
+static void uds_request(size_t k, const can_message_t *m) {
+    ecu_sim_ecu_t *e = &ecus[k];
+    size_t len = m->data[0];
+    if (!e->online || len < 1 || len > 7 || m->data[1] != 0x22) return;
+    size_t count = (len - 1) / 2;
+    e->uds_requests++;
+    stats.uds_requests++;
+    stats.uds_frames++;
+    if (count > stats.uds_max_dids) stats.uds_max_dids = (uint32_t)count;
+
+    int64_t at = esp_timer_get_time() + e->latency_us;
+    if (count == 0 || len != 1 + 2 * count || (e->max_dids != 0 && count > e->max_dids)) {
+        send_negative(k, 0x13, at);
+        return;
+    }
+    for (unsigned p = 0; p < e->pending; p++) {
+        send_negative(k, 0x78, at);
+        at += e->pending_us;
+    }
+
+    uint8_t msg[MAX_ANSWER];
+    size_t n = 0;
+    msg[n++] = 0x62;
+    for (size_t i = 0; i < count; i++) {
+        uint16_t did = (uint16_t)(m->data[2 + 2 * i] << 8 | m->data[3 + 2 * i]);
+        ecu_sim_did_t *d = find_did(e, did);
+        if (d == NULL || n + 2 + d->len > MAX_ANSWER) continue;
+        msg[n++] = (uint8_t)(did >> 8);
+        msg[n++] = (uint8_t)did;
+        memcpy(&msg[n], d->record, d->len);
+        n += d->len;
+        d->reads++;
+    }
+    if (n == 1) {
+        send_negative(k, 0x31, at);
+        return;
+    }
+    send_answer(k, msg, n, at);
+    stats.uds_frames++;
+    answers[k].uds = n > 7;
+}
+
+// Flow control from the tester: the next block of consecutive frames
+static void flow_control(const can_message_t *m) {
+    stats.flow_controls++;
+    size_t k = 0;
+    while (k < num_ecus && ecus[k].rx_id - 8 != m->identifier) k++;
+    if (k == num_ecus || answers[k].len == 0 || (m->data[0] & 0xF0) != 0x30) {
+        stats.bad_flow_controls++;
+        return;
+    }
+    answer_t *a = &answers[k];
+    if (a->uds) stats.uds_frames++;
+    if (m->data[0] != 0x30) return;     // wait or overflow: send nothing
+    uint8_t bs = m->data[1], st = m->data[2];
+    int64_t st_us = st <= 0x7F ? st * 1000 : (st >= 0xF1 && st <= 0xF9 ? (st - 0xF0) * 100 : 127000);
+    int64_t gap = st_us > ecus[k].frame_gap_us ? st_us : ecus[k].frame_gap_us;
+    int64_t at = esp_timer_get_time();
+    if (at < a->last_us) at = a->last_us;
+    for (unsigned sent = 0; a->sent < a->len && (bs == 0 || sent < bs); sent++) {
+        uint8_t f[8] = {0};
+        size_t n = a->len - a->sent < 7 ? a->len - a->sent : 7;
+        f[0] = (uint8_t)(0x20 | (a->seq++ & 0x0F));
+        memcpy(&f[1], &a->data[a->sent], n);
+        a->sent += n;
+        at += gap;
+        push(at, ecus[k].rx_id, f);
+        stats.frames++;
+        if (a->uds) stats.uds_frames++;
+    }
+    a->last_us = at;
+    if (a->sent == a->len) a->len = 0;
+}
+
+esp_err_t can_driver_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t can_driver_deinit(void) {
+    return ESP_OK;
+}
+
+esp_err_t can_send_message(const can_message_t *msg) {
+    if (msg->identifier == OBD2_REQUEST_CAN_ID) {
+        functional_request(msg);
+    } else if ((msg->data[0] & 0xF0) == 0x30) {
+        flow_control(msg);
+    } else if ((msg->data[0] & 0xF0) == 0x00) {
+        for (size_t k = 0; k < num_ecus; k++) {
+            if (ecus[k].rx_id - 8 == msg->identifier) uds_request(k, msg);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t can_receive_message(can_message_t *msg, uint32_t timeout_ms) {
+    int64_t now = esp_timer_get_time();
+    size_t next = num_events;
+    for (size_t i = 0; i < num_events; i++) {
+        if (next == num_events || events[i].at_us < events[next].at_us) next = i;
+    }
+    int64_t limit = now + (int64_t)timeout_ms * 1000;
+    if (next == num_events || events[next].at_us > limit) {
+        host_clock_advance_us(limit - now);
+        return ESP_ERR_TIMEOUT;
+    }
+    if (events[next].at_us > now) host_clock_advance_us(events[next].at_us - now);
+    *msg = events[next].msg;
+    msg->timestamp = (uint32_t)esp_timer_get_time();
+    // Keep the order of frames due at the same time
+    memmove(&events[next], &events[next + 1], (num_events - next - 1) * sizeof(events[0]));
+    num_events--;
+    return ESP_OK;
+}
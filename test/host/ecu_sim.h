@@ -0,0 +1,71 @@
+#pragma once
+// Scripted OBD-II ECUs behind can_send_message() / can_receive_message(), on
+// the manual host clock (host_stubs.h): a stand-in for the vehicle in tests of
+// the request side (can_manager, isotp). Each online ECU answers functional
+// requests (0x7DF) for the Mode 01 PIDs it supports after its latency, in one
+// ISO-TP message: a single frame, or a first frame whose consecutive frames
+// follow the tester's flow control (block size, STmin). Support PIDs
+// (0x00, 0x20, ...) are answered from the PID list, chaining to the next range
+// as J1979 describes. DTC services are answered with no codes.
+// Physical UDS ReadDataByIdentifier (0x22) requests to rx_id - 8 are answered
+// from the ECU's DID list as ISO 14229 has it: the supported DIDs' records, or
+// requestOutOfRange when none is; optionally refused past a number of DIDs
+// (incorrectMessageLength) or preceded by responsePending answers.
+// can_receive_message() moves the clock to the next frame, or by the timeout.
+#include "can_driver.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ECU_SIM_MAX_ECUS 8
+
+// A data identifier an ECU answers to ReadDataByIdentifier
+typedef struct {
+    uint16_t did;
+    uint8_t len;                // record bytes
+    uint8_t record[8];
+    uint32_t reads;             // positive answers it was in
+} ecu_sim_did_t;
+
+typedef struct {
+    uint32_t rx_id;             // response ID (0x7E8 + n); requests to it are rx_id - 8
+    const uint8_t *pids;        // supported Mode 01 PIDs, ascending (support PIDs are implied)
+    size_t num_pids;
+    uint32_t latency_us;        // request to first frame of the answer
+    uint32_t frame_gap_us;      // least time between two frames (one frame at 500 kbit/s ~ 250 us)
+    bool online;
+    ecu_sim_did_t *dids;        // UDS data identifiers (none: every 0x22 is out of range)
+    size_t num_dids;
+    uint8_t max_dids;           // DIDs per 0x22 request before incorrectMessageLength (0 = any)
+    uint8_t pending;            // responsePending (0x78) answers before each 0x22 answer
+    uint32_t pending_us;        // time from one of them to the next, and to the answer
+    uint32_t uds_requests;      // 0x22 requests received while online
+} ecu_sim_ecu_t;
+
+typedef struct {
+    uint32_t requests;          // functional requests
+    uint32_t pid_requests;      // Mode 01 requests for value PIDs
+    uint32_t pids_requested;    // value PIDs in those requests
+    uint32_t max_pids;          // most PIDs in one request
+    uint32_t support_requests;  // Mode 01 requests for support PIDs
+    uint32_t answers;           // ECU responses (one ISO-TP message each)
+    uint32_t multi_frame;       // of which first frame + consecutive frames
+    uint32_t flow_controls;     // flow control frames received
+    uint32_t bad_flow_controls; // flow control with nothing pending, or not 0x30
+    uint32_t frames;            // frames sent by the ECUs
+    uint32_t uds_requests;      // 0x22 requests to online ECUs
+    uint32_t uds_max_dids;      // most DIDs in one
+    uint32_t uds_negative;      // negative 0x22 answers, response pending included
+    uint32_t uds_frames;        // frames of 0x22 transactions, both directions
+} ecu_sim_stats_t;
+
+// Clock on manual at start_us, no ECUs, nothing pending, stats cleared
+void ecu_sim_init(int64_t start_us);
+
+// Add an online ECU (pids must outlive the simulation)
+ecu_sim_ecu_t *ecu_sim_add(uint32_t rx_id, const uint8_t *pids, size_t num_pids, uint32_t latency_us);
+
+// Value bytes answered for a PID (all ECUs); defaults derive from the PID
+void ecu_sim_set_value(uint8_t pid, const uint8_t *bytes, size_t len);
+
+const ecu_sim_stats_t *ecu_sim_stats(void);
@@ -0,0 +1,262 @@
+// Host (Linux) stand-ins for the ESP-IDF and FreeRTOS calls the components make
+#define _GNU_SOURCE
+#include "host_stubs.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// Clock
+// ---------------------------------------------------------------------------
+
+static bool clock_manual = false;
+static int64_t clock_now_us = 0;
+static void (*clock_watch)(int64_t now_us);
+
+void host_clock_manual(int64_t start_us) {
+    clock_manual = true;
+    clock_now_us = start_us;
+}
+
+void host_clock_advance_us(int64_t us) {
+    clock_now_us += us;
+    if (clock_watch) clock_watch(clock_now_us);
+}
+
+void host_clock_watch(void (*fn)(int64_t now_us)) {
+    clock_watch = fn;
+}
+
+int64_t esp_timer_get_time(void) {
+    if (clock_manual) return clock_now_us;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / (1000000 / configTICK_RATE_HZ));
+}
+
+void vTaskDelay(TickType_t ticks) {
+    int64_t us = (int64_t)ticks * (1000000 / configTICK_RATE_HZ);
+    if (clock_manual) {
+        host_clock_advance_us(us);
+    } else {
+        usleep((useconds_t)us);
+    }
+}
+
+// Absolute CLOCK_REALTIME deadline ticks from now, for the timed waits below
+static struct timespec deadline(TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long long ns = ts.tv_nsec + (long long)ticks * (1000000000 / configTICK_RATE_HZ);
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    return ts;
+}
+
+// ---------------------------------------------------------------------------
+// Tasks and notifications
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    pthread_t thread;
+    sem_t notify;
+    void (*fn)(void *);
+    void *arg;
+} host_task_t;
+
+static __thread host_task_t *current_task = NULL;
+
+static host_task_t *task_new(void) {
+    host_task_t *t = calloc(1, sizeof(*t));
+    sem_init(&t->notify, 0, 0);
+    return t;
+}
+
+static void *task_main(void *p) {
+    current_task = p;
+    current_task->fn(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core) {
+    (void)name; (void)stack; (void)prio; (void)core;
+    host_task_t *t = task_new();
+    t->fn = fn;
+    t->arg = arg;
+    if (pthread_create(&t->thread, NULL, task_main, t) != 0) return pdFAIL;
+    pthread_detach(t->thread);
+    if (handle) *handle = t;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == current_task) pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (current_task == NULL) current_task = task_new();  // main thread or a plain pthread
+    return current_task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    host_task_t *t = xTaskGetCurrentTaskHandle();
+    int ok;
+    if (ticks == portMAX_DELAY) {
+        ok = sem_wait(&t->notify) == 0;
+    } else {
+        struct timespec ts = deadline(ticks);
+        ok = sem_timedwait(&t->notify, &ts) == 0;
+    }
+    if (!ok) return 0;
+    uint32_t n = 1;
+    while (clear && sem_trywait(&t->notify) == 0) n++;
+    return n;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    sem_post(&((host_task_t *)task)->notify);
+    return pdPASS;
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Queues
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t item_size, length, head, count;
+    uint8_t *items;
+} host_queue_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    host_queue_t *q = calloc(1, sizeof(*q));
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->item_size = item_size;
+    q->length = length;
+    q->items = malloc(length * (item_size ? item_size : 1));
+    return q;
+}
+
+// Wait with the lock held until q has space (or an item); false on timeout
+static bool queue_wait(host_queue_t *q, bool want_space, TickType_t ticks) {
+    struct timespec ts = deadline(ticks);
+    while (want_space ? q->count == q->length : q->count == 0) {
+        if (ticks == 0) return false;
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&q->changed, &q->lock);
+        } else if (pthread_cond_timedwait(&q->changed, &q->lock, &ts) == ETIMEDOUT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    host_queue_t *q = queue;
+    pthread_mutex_lock(&q->lock);
+    if (!queue_wait(q, true, ticks)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    if (q->item_size > 0) memcpy(q->items + ((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    host_queue_t *q = queue;
+    pthread_mutex_lock(&q->lock);
+    if (!queue_wait(q, false, ticks)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    if (q->item_size > 0) memcpy(item, q->items + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    host_queue_t *q = queue;
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = (UBaseType_t)q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    host_queue_t *q = queue;
+    free(q->items);
+    free(q);
+}
+
+// ---------------------------------------------------------------------------
+// Semaphores
+// ---------------------------------------------------------------------------
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    return xQueueReceive(sem, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return xQueueSend(sem, NULL, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    vQueueDelete(sem);
+}
+
+// ---------------------------------------------------------------------------
+// Misc
+// ---------------------------------------------------------------------------
+
+const char *esp_err_to_name(esp_err_t code) {
+    static __thread char buf[16];
+    snprintf(buf, sizeof(buf), "0x%x", code);
+    return buf;
+}
+
+int host_log_verbose(void) {
+    static int verbose = -1;
+    if (verbose < 0) {
+        const char *v = getenv("HOST_LOG");
+        verbose = v != NULL && v[0] == '1';
+    }
+    return verbose;
+}
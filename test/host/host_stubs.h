@@ -0,0 +1,12 @@
+#pragma once
+// Controls for the ESP-IDF / FreeRTOS stand-ins in host_stubs.c
+#include <stdint.h>
+
+// Switch esp_timer_get_time() and the tick count to a clock that only moves
+// with host_clock_advance_us() (and vTaskDelay()), starting at start_us
+void host_clock_manual(int64_t start_us);
+void host_clock_advance_us(int64_t us);
+
+// Called with the new time whenever the manual clock moves (a test stops the
+// task under test from here once its simulated run is over); NULL to remove
+void host_clock_watch(void (*fn)(int64_t now_us));
@@ -0,0 +1,44 @@
+#pragma once
+// Checks and timing shared by the host tests; each test is one executable
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static int host_failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        host_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+    long long a_ = (long long)(a), b_ = (long long)(b); \
+    if (a_ != b_) { \
+        fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", \
+                __FILE__, __LINE__, #a, #b, a_, b_); \
+        host_failures++; \
+    } \
+} while (0)
+
+// Exit status for main(): 0 when every check passed
+static inline int host_test_done(const char *name) {
+    printf("%s: %s\n", name, host_failures ? "FAILED" : "ok");
+    return host_failures ? 1 : 0;
+}
+
+static inline uint64_t host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Fixed-seed generator so every run replays the same traffic
+static inline uint32_t host_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
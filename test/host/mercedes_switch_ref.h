@@ -0,0 +1,8 @@
+#pragma once
+#include "mercedes_decode.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Decode one frame the way mercedes_decode_message() did before the tables
+// @return false for an ID the switch did not handle (nothing written)
+bool mercedes_switch_decode(mercedes_data_t *d, uint32_t id, const uint8_t *data, uint8_t dlc);
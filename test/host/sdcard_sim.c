@@ -0,0 +1,176 @@
+// SD card stand-in for the host tests, see sdcard_sim.h
+#define SDCARD_SIM_IMPL
+#include "sdcard_sim.h"
+#include "esp_heap_caps.h"
+#include "esp_vfs_fat.h"
+#include "sdmmc_cmd.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_FDS 64
+
+struct sdmmc_card_t {
+    int unused;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static card_log_t log_state;
+static uint32_t ops_capacity;
+static int fd_file[MAX_FDS];        // file number + 1 of each open fd
+static uint32_t capacity;
+static uint32_t write_delay_us;
+static struct sdmmc_card_t the_card;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *cfg, int dma_chan) {
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host) {
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char *base_path, const sdmmc_host_t *host,
+                                  const sdspi_device_config_t *slot, const esp_vfs_fat_sdmmc_mount_config_t *cfg,
+                                  sdmmc_card_t **card) {
+    mkdir(base_path, 0755);
+    *card = &the_card;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdcard_unmount(const char *base_path, sdmmc_card_t *card) {
+    return ESP_OK;
+}
+
+void sdmmc_card_print_info(FILE *stream, const sdmmc_card_t *card) {
+}
+
+void *heap_caps_malloc(size_t size, unsigned caps) {
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr) {
+    free(ptr);
+}
+
+uint32_t card_hash(const void *data, uint32_t len) {
+    const uint8_t *p = data;
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+static void record(card_op_kind_t kind, int fd, bool ok, uint32_t offset, uint32_t len, uint32_t hash) {
+    if (fd < 0 || fd >= MAX_FDS || fd_file[fd] == 0) return;
+    pthread_mutex_lock(&lock);
+    if (log_state.num_ops == ops_capacity) {
+        ops_capacity = ops_capacity ? ops_capacity * 2 : 4096;
+        log_state.ops = realloc(log_state.ops, ops_capacity * sizeof(card_op_t));
+    }
+    log_state.ops[log_state.num_ops++] = (card_op_t){
+        .kind = kind, .file = (uint8_t)(fd_file[fd] - 1), .ok = ok, .offset = offset, .len = len, .hash = hash,
+    };
+    pthread_mutex_unlock(&lock);
+}
+
+void card_reset(void) {
+    pthread_mutex_lock(&lock);
+    log_state.num_ops = 0;
+    log_state.torn = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+const card_log_t *card_log(void) {
+    return &log_state;
+}
+
+void card_set_capacity(uint32_t bytes) {
+    capacity = bytes;
+}
+
+void card_set_write_delay_us(uint32_t us) {
+    write_delay_us = us;
+}
+
+int card_file(const char *path) {
+    for (uint32_t i = 0; i < log_state.num_files; i++) {
+        if (strcmp(log_state.files[i].path, path) == 0) return (int)i;
+    }
+    return -1;
+}
+
+int card_open(const char *path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = (flags & O_CREAT) ? (mode_t)va_arg(ap, int) : 0;
+    va_end(ap);
+
+    int fd = open(path, flags, mode);
+    if (fd < 0 || fd >= MAX_FDS) return fd;
+    pthread_mutex_lock(&lock);
+    int file = card_file(path);
+    if (file < 0 && log_state.num_files < CARD_MAX_FILES) {
+        file = (int)log_state.num_files++;
+        strncpy(log_state.files[file].path, path, sizeof(log_state.files[file].path) - 1);
+    }
+    if (file >= 0) log_state.files[file].max_size = 0;
+    fd_file[fd] = file + 1;
+    pthread_mutex_unlock(&lock);
+    return fd;
+}
+
+static void note_size(int fd) {
+    struct stat st;
+    if (fd >= 0 && fd < MAX_FDS && fd_file[fd] != 0 && fstat(fd, &st) == 0) {
+        card_file_t *f = &log_state.files[fd_file[fd] - 1];
+        if ((uint32_t)st.st_size > f->max_size) f->max_size = (uint32_t)st.st_size;
+    }
+}
+
+ssize_t card_write(int fd, const void *buf, size_t len) {
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    uint32_t hash = card_hash(buf, (uint32_t)len);
+    if (capacity > 0 && (uint64_t)offset + len > capacity) {
+        record(CARD_WRITE, fd, false, (uint32_t)offset, (uint32_t)len, hash);
+        errno = ENOSPC;
+        return -1;
+    }
+    if (write_delay_us > 0 && len > 1) {
+        usleep(write_delay_us);
+        if (card_hash(buf, (uint32_t)len) != hash) {
+            pthread_mutex_lock(&lock);
+            log_state.torn++;
+            pthread_mutex_unlock(&lock);
+        }
+    }
+    ssize_t n = write(fd, buf, len);
+    record(CARD_WRITE, fd, n == (ssize_t)len, (uint32_t)offset, (uint32_t)len, hash);
+    note_size(fd);
+    return n;
+}
+
+off_t card_lseek(int fd, off_t offset, int whence) {
+    return lseek(fd, offset, whence);
+}
+
+int card_fsync(int fd) {
+    int r = fsync(fd);
+    record(CARD_FSYNC, fd, r == 0, 0, 0, 0);
+    return r;
+}
+
+int card_ftruncate(int fd, off_t len) {
+    int r = ftruncate(fd, len);
+    record(CARD_TRUNCATE, fd, r == 0, (uint32_t)len, 0, 0);
+    return r;
+}
+
+int card_close(int fd) {
+    if (fd >= 0 && fd < MAX_FDS) fd_file[fd] = 0;
+    return close(fd);
+}
@@ -0,0 +1,74 @@
+#pragma once
+// The SD card on the host: the SPI bus and FAT mount calls succeed, SD_MOUNT_POINT
+// is a directory of the build tree (test/host/CMakeLists.txt sets it) and
+// heap_caps_malloc() is malloc(). A test that compiles sd_logger.c into itself
+// includes this header first: the logger's open/write/lseek/fsync/ftruncate/close
+// then go through the card_* calls below, which record every write and can make
+// the card slow or full.
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef enum {
+    CARD_WRITE,
+    CARD_FSYNC,
+    CARD_TRUNCATE,
+} card_op_kind_t;
+
+typedef struct {
+    uint8_t kind;           // card_op_kind_t
+    uint8_t file;           // card_file_t in files[]
+    bool ok;
+    uint32_t offset;        // CARD_WRITE: file offset; CARD_TRUNCATE: new length
+    uint32_t len;
+    uint32_t hash;          // FNV-1a of the bytes written
+} card_op_t;
+
+#define CARD_MAX_FILES 16
+
+typedef struct {
+    char path[160];
+    uint32_t max_size;      // largest the file got while open
+} card_file_t;
+
+typedef struct {
+    card_op_t *ops;
+    uint32_t num_ops;
+    card_file_t files[CARD_MAX_FILES];
+    uint32_t num_files;
+    uint32_t torn;          // buffers that changed while the card was writing them
+} card_log_t;
+
+// Forget recorded operations (files opened before stay known)
+void card_reset(void);
+
+const card_log_t *card_log(void);
+
+// Writes ending past capacity bytes fail with ENOSPC, as on a full card; 0 = no limit
+void card_set_capacity(uint32_t capacity);
+
+// Each write of more than one byte takes this long; the buffer must not change meanwhile
+void card_set_write_delay_us(uint32_t us);
+
+// File number of path in card_log()->files, -1 if it was never opened
+int card_file(const char *path);
+
+uint32_t card_hash(const void *data, uint32_t len);
+
+int card_open(const char *path, int flags, ...);
+ssize_t card_write(int fd, const void *buf, size_t len);
+off_t card_lseek(int fd, off_t offset, int whence);
+int card_fsync(int fd);
+int card_ftruncate(int fd, off_t len);
+int card_close(int fd);
+
+#ifndef SDCARD_SIM_IMPL
+#include <fcntl.h>
+#include <unistd.h>
+#define open card_open
+#define write card_write
+#define lseek card_lseek
+#define fsync card_fsync
+#define ftruncate card_ftruncate
+#define close card_close
+#endif
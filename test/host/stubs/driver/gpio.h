@@ -0,0 +1,2 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name (test/host only)
@@ -0,0 +1,17 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name (test/host only)
+#include "driver/spi_common.h"
+
+typedef struct sdmmc_card_t sdmmc_card_t;
+
+typedef struct {
+    int slot;
+} sdmmc_host_t;
+
+typedef struct {
+    spi_host_device_t host_id;
+    int gpio_cs;
+} sdspi_device_config_t;
+
+#define SDSPI_HOST_DEFAULT()            {.slot = SPI2_HOST}
+#define SDSPI_DEVICE_CONFIG_DEFAULT()   {.host_id = SPI2_HOST, .gpio_cs = -1}
@@ -0,0 +1,17 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name (test/host only)
+#include "esp_err.h"
+
+typedef enum { SPI1_HOST, SPI2_HOST, SPI3_HOST } spi_host_device_t;
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+} spi_bus_config_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *cfg, int dma_chan);
+esp_err_t spi_bus_free(spi_host_device_t host);
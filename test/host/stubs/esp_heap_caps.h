@@ -0,0 +1,10 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name (test/host only)
+// Any heap will do on the host; sdcard_sim.c implements it with malloc
+#include <stddef.h>
+
+#define MALLOC_CAP_DMA  (1 << 3)
+#define MALLOC_CAP_8BIT (1 << 2)
+
+void *heap_caps_malloc(size_t size, unsigned caps);
+void heap_caps_free(void *ptr);
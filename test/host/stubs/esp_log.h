@@ -0,0 +1,12 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name (test/host only)
+// Errors and warnings go to stderr; info and below only with HOST_LOG=1 in the environment
+#include <stdio.h>
+
+int host_log_verbose(void);
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { if (host_log_verbose()) fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { if (host_log_verbose()) fprintf(stderr, "D %s: " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGV(tag, fmt, ...) do { (void)(tag); } while (0)
@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name (test/host only)
+// Real monotonic time, or the manual clock of host_stubs.h
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
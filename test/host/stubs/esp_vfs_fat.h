@@ -0,0 +1,18 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name (test/host only)
+// Mounting always succeeds on the host; sdcard_sim.c implements it
+#include "esp_err.h"
+#include "driver/sdspi_host.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    bool format_if_mount_failed;
+    int max_files;
+    size_t allocation_unit_size;
+} esp_vfs_fat_sdmmc_mount_config_t;
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char *base_path, const sdmmc_host_t *host,
+                                  const sdspi_device_config_t *slot, const esp_vfs_fat_sdmmc_mount_config_t *cfg,
+                                  sdmmc_card_t **card);
+esp_err_t esp_vfs_fat_sdcard_unmount(const char *base_path, sdmmc_card_t *card);
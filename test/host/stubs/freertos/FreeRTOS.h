@@ -0,0 +1,22 @@
+#pragma once
+// Host stand-in for the FreeRTOS header of the same name (test/host only)
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define portMAX_DELAY       0xFFFFFFFFu
+#define configTICK_RATE_HZ  100
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+#define tskNO_AFFINITY      0x7FFFFFFF
+#define configASSERT(x)     ((void)(x))
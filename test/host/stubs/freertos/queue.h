@@ -0,0 +1,10 @@
+#pragma once
+// Host stand-in for the FreeRTOS header of the same name (test/host only)
+// A mutex + condition variable queue, the host counterpart of a FreeRTOS queue
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
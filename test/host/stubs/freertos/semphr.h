@@ -0,0 +1,9 @@
+#pragma once
+// Host stand-in for the FreeRTOS header of the same name (test/host only)
+// Binary semaphores are queues of one empty item, as in FreeRTOS
+#include "queue.h"
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
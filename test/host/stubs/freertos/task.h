@@ -0,0 +1,18 @@
+#pragma once
+// Host stand-in for the FreeRTOS header of the same name (test/host only)
+// Tasks are pthreads; notifications are a counting semaphore per task
+#include "FreeRTOS.h"
+
+typedef enum { eNoAction, eSetBits, eIncrement, eSetValueWithOverwrite } eNotifyAction;
+
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+BaseType_t xPortGetCoreID(void);
@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name (test/host only)
+#include "driver/sdspi_host.h"
+#include <stdio.h>
+
+void sdmmc_card_print_info(FILE *stream, const sdmmc_card_t *card);
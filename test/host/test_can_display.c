@@ -0,0 +1,179 @@
+// can_display: the printf-free decimal formatter (sign, decimals, extremes)
+// against snprintf, and descriptors as the parameter list uses them: fields of
+// each size and signedness, mul/add/div truncating toward zero, units, text
+// tables and truncation to the buffer
+#include "can_display.h"
+#include "host_test.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t seed = 12;
+
+// value / 10^decimals the printf way
+static void reference(char *buf, size_t size, int32_t value, uint8_t decimals) {
+    uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+    const char *sign = value < 0 ? "-" : "";
+    if (decimals == 0) {
+        snprintf(buf, size, "%s%lu", sign, (unsigned long)mag);
+    } else {
+        snprintf(buf, size, "%s%lu.%0*lu", sign, (unsigned long)(mag / scale), decimals,
+                 (unsigned long)(mag % scale));
+    }
+}
+
+static void check_int(int32_t value, uint8_t decimals, const char *want) {
+    char buf[CAN_FORMAT_INT_MAX];
+    size_t n = can_format_int(buf, value, decimals);
+    if (strcmp(buf, want) != 0 || n != strlen(want)) {
+        fprintf(stderr, "can_format_int(%ld, %u): \"%s\", want \"%s\"\n", (long)value, decimals, buf, want);
+        host_failures++;
+    }
+}
+
+static void test_format_int(void) {
+    check_int(0, 0, "0");
+    check_int(0, 2, "0.00");
+    check_int(7, 0, "7");
+    check_int(-7, 0, "-7");
+    check_int(1234, 1, "123.4");
+    check_int(-1234, 3, "-1.234");
+
+    // Between -1 and 0 the sign stays (it used to be lost in the integer part)
+    check_int(-5, 2, "-0.05");
+    check_int(-1, 1, "-0.1");
+    check_int(-99, 2, "-0.99");
+    check_int(-123456789, 9, "-0.123456789");
+    check_int(5, 9, "0.000000005");
+
+    check_int(INT32_MAX, 0, "2147483647");
+    check_int(INT32_MIN, 0, "-2147483648");
+    check_int(INT32_MIN, 9, "-2.147483648");
+    check_int(INT32_MAX, 3, "2147483.647");
+
+    char buf[CAN_FORMAT_INT_MAX];
+    CHECK_EQ(can_format_uint(buf, UINT32_MAX), 10);
+    CHECK(strcmp(buf, "4294967295") == 0);
+    CHECK_EQ(can_format_uint(buf, 0), 1);
+    CHECK(strcmp(buf, "0") == 0);
+
+    // Random values of every magnitude, all decimals
+    for (int i = 0; i < 200000; i++) {
+        int32_t v = (int32_t)host_rand(&seed) >> (host_rand(&seed) % 32);
+        uint8_t dec = (uint8_t)(i % 10);
+        char want[24];
+        reference(want, sizeof(want), v, dec);
+        size_t n = can_format_int(buf, v, dec);
+        if (strcmp(buf, want) != 0 || n != strlen(want)) {
+            fprintf(stderr, "can_format_int(%ld, %u): \"%s\", want \"%s\"\n", (long)v, dec, buf, want);
+            host_failures++;
+            break;
+        }
+    }
+}
+
+typedef struct {
+    int8_t s8;
+    uint8_t u8;
+    int16_t s16;
+    uint16_t u16;
+    int32_t s32;
+    uint32_t u32;
+} fields_t;
+
+static const char *const gears[] = {"P", "R", "N", "D"};
+
+static void check_row(const can_display_t *d, const fields_t *f, size_t size, const char *want) {
+    char buf[32];
+    memset(buf, 'x', sizeof(buf));
+    size_t n = can_display_format(d, f, buf, size);
+    if (strcmp(buf, want) != 0 || n != strlen(want)) {
+        fprintf(stderr, "can_display_format (size %zu): \"%s\", want \"%s\"\n", size, buf, want);
+        host_failures++;
+    }
+}
+
+static void test_display_format(void) {
+    fields_t f = {0};
+    // Rows as in main.c's parameter list
+    const can_display_t lateral_g = CAN_DISPLAY_NUM(fields_t, s8, 1, 0, 1, 2, " g");       // x0.01
+    const can_display_t yaw = CAN_DISPLAY_NUM(fields_t, s16, 1, 0, 2, 2, " d/s");          // x0.005
+    const can_display_t ambient = CAN_DISPLAY_NUM(fields_t, u8, 5, -400, 1, 1, " C");      // x0.5 - 40
+    const can_display_t fuel = CAN_DISPLAY_NUM(fields_t, u16, 144, 0, 100, 2, "");
+    const can_display_t rpm = CAN_DISPLAY_NUM(fields_t, u16, 1, 0, 4, 0, "");              // x0.25
+    const can_display_t count = CAN_DISPLAY_NUM(fields_t, u32, 1, 0, 1, 0, "");
+    const can_display_t gear = CAN_DISPLAY_TEXT(fields_t, u8, gears);
+    const can_display_t gear_signed = CAN_DISPLAY_TEXT(fields_t, s8, gears);
+
+    CHECK(lateral_g.flags & CAN_SIG_SIGNED);
+    CHECK(!(ambient.flags & CAN_SIG_SIGNED));
+    CHECK_EQ(yaw.field_size, 2);
+    CHECK_EQ(count.field_size, 4);
+
+    // Small negative readings keep their sign
+    f.s8 = -5;
+    check_row(&lateral_g, &f, 32, "-0.05 g");
+    f.s8 = -128;
+    check_row(&lateral_g, &f, 32, "-1.28 g");
+    f.s8 = 127;
+    check_row(&lateral_g, &f, 32, "1.27 g");
+
+    // Division truncates toward zero: -0.005 d/s shows as 0.00, -0.015 as -0.01
+    f.s16 = -1;
+    check_row(&yaw, &f, 32, "0.00 d/s");
+    f.s16 = -3;
+    check_row(&yaw, &f, 32, "-0.01 d/s");
+    f.s16 = 3;
+    check_row(&yaw, &f, 32, "0.01 d/s");
+    f.s16 = INT16_MIN;
+    check_row(&yaw, &f, 32, "-163.84 d/s");
+
+    // Offset and scale
+    f.u8 = 0;
+    check_row(&ambient, &f, 32, "-40.0 C");
+    f.u8 = 79;
+    check_row(&ambient, &f, 32, "-0.5 C");
+    f.u8 = 80;
+    check_row(&ambient, &f, 32, "0.0 C");
+    f.u8 = 255;
+    check_row(&ambient, &f, 32, "87.5 C");
+    f.u16 = 1001;
+    check_row(&fuel, &f, 32, "14.41");
+    f.u16 = 65535;
+    check_row(&fuel, &f, 32, "943.70");
+    f.u16 = 4003;
+    check_row(&rpm, &f, 32, "1000");
+    f.u32 = UINT32_MAX;
+    check_row(&count, &f, 32, "-1");     // 4-byte fields are read as int32
+
+    // Text tables: in range, past the end, negative
+    f.u8 = 3;
+    check_row(&gear, &f, 32, "D");
+    f.u8 = 4;
+    check_row(&gear, &f, 32, "?");
+    f.u8 = 255;
+    check_row(&gear, &f, 32, "?");
+    f.s8 = -1;
+    check_row(&gear_signed, &f, 32, "?");
+
+    // Truncation: the unit goes first, then digits; always terminated
+    f.s8 = -5;
+    check_row(&lateral_g, &f, 8, "-0.05 g");
+    check_row(&lateral_g, &f, 7, "-0.05 ");
+    check_row(&lateral_g, &f, 6, "-0.05");
+    check_row(&lateral_g, &f, 4, "-0.");
+    check_row(&lateral_g, &f, 1, "");
+    f.u8 = 3;
+    check_row(&gear, &f, 1, "");
+    char buf[4] = "abc";
+    CHECK_EQ(can_display_format(&lateral_g, &f, buf, 0), 0);
+    CHECK(strcmp(buf, "abc") == 0);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) seed = (uint32_t)atoi(argv[1]);
+    test_format_int();
+    test_display_format();
+    return host_test_done("test_can_display");
+}
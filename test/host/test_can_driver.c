@@ -0,0 +1,168 @@
+// can_driver ingest routing on recorded-shape traffic: W218 broadcast frames
+// (bus_traffic.c) replayed through the TWAI stand-in (twai_sim.c) in real time,
+// with bursts of diagnostic responses on 0x7E8-0x7EF and look-alikes just
+// outside the window (0x7E7, 0x7F0, an extended 0x7E8) mixed in. Only the
+// responses may reach can_receive_message(), all of them, in the order they
+// were on the bus; every frame still reaches the sniffer. The ingest and
+// processing tasks run as threads; the SD card is not mounted.
+#include "can_driver.h"
+#include "can_config.h"
+#include "can_sniffer.h"
+#include "sd_logger.h"
+#include "mb_signals.h"
+#include "bus_traffic.h"
+#include "twai_sim.h"
+#include "esp_timer.h"
+#include "host_test.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+#define REPLAY_US       2500000     // broadcast traffic replayed
+#define MAX_FRAMES      20000
+#define RESPONSE_EVERY  40          // broadcast frames between response bursts
+#define MAX_RESPONSES   4096
+#define RECEIVE_MS      200
+
+// The SD card is never mounted here
+bool sd_logger_is_mounted(void) { return false; }
+void sd_logger_start_session(void) {}
+void sd_logger_write(uint32_t can_id, const uint8_t *data, uint8_t dlc, uint32_t timestamp_us) {}
+void sd_logger_summary_define(const sd_log_summary_signal_t *signals, uint8_t count) {}
+void sd_logger_summary_add(uint8_t signal, int32_t value) {}
+void sd_logger_end_session(void) {}
+
+static bus_frame_t frames[MAX_FRAMES];
+static int64_t fed_us[MAX_RESPONSES];      // when response n went on the bus
+static uint32_t responses_fed;
+static uint32_t frames_fed;
+static uint32_t decoys_fed;
+static atomic_uint responses_received;
+static atomic_bool feeding;
+static uint32_t seed = 18;
+
+static bool in_window(uint32_t id) {
+    return id >= CAN_RESPONSE_ID_FIRST && id <= CAN_RESPONSE_ID_LAST;
+}
+
+static void feed(uint32_t id, bool extd, uint8_t dlc, const uint8_t *data) {
+    twai_message_t m = {.identifier = id, .extd = extd, .data_length_code = dlc};
+    memcpy(m.data, data, dlc);
+    CHECK(twai_sim_feed(&m));
+    frames_fed++;
+}
+
+// A response burst: 1-8 frames from one ECU, numbered across the run
+static void feed_responses(void) {
+    uint32_t id = CAN_RESPONSE_ID_FIRST + host_rand(&seed) % 8;
+    uint32_t burst = 1 + host_rand(&seed) % 8;
+    for (uint32_t i = 0; i < burst && responses_fed < MAX_RESPONSES; i++) {
+        uint32_t n = responses_fed;
+        uint8_t data[8] = {(uint8_t)id, (uint8_t)n, (uint8_t)(n >> 8), (uint8_t)(n >> 16), 0x55, 0x55, 0x55, 0x55};
+        fed_us[n] = esp_timer_get_time();
+        responses_fed++;
+        feed(id, false, 8, data);
+    }
+}
+
+// Frames a requester must never see: just outside the window, or extended
+static void feed_decoys(void) {
+    static const uint8_t data[8] = {0xDE, 0xC0, 0xDE, 0xC0, 0xDE, 0xC0, 0xDE, 0xC0};
+    feed(CAN_RESPONSE_ID_FIRST - 1, false, 8, data);
+    feed(CAN_RESPONSE_ID_LAST + 1, false, 8, data);
+    feed(CAN_RESPONSE_ID_FIRST, true, 8, data);
+    decoys_fed += 3;
+}
+
+// The bus: broadcast frames at their own times, a burst of responses (once the
+// requester has the previous one, as it would after sending a request) and the
+// look-alikes every RESPONSE_EVERY frames
+static void *bus_thread(void *arg) {
+    size_t count = *(size_t *)arg;
+    int64_t start = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        const bus_frame_t *f = &frames[i];
+        int64_t wait = start + f->ts_us - esp_timer_get_time();
+        if (wait > 0) usleep((useconds_t)wait);
+        if (!in_window(f->id)) feed(f->id, false, f->dlc, f->data);   // the window is the test's own
+        if (i % RESPONSE_EVERY == 0 && atomic_load(&responses_received) == responses_fed) {
+            feed_responses();
+            feed_decoys();
+        }
+    }
+    atomic_store(&feeding, false);
+    return NULL;
+}
+
+int main(void) {
+    size_t count = bus_traffic_generate(&mb_profiles[0], 40, 3, frames, MAX_FRAMES);
+    while (count > 0 && frames[count - 1].ts_us > REPLAY_US) count--;
+
+    CHECK_EQ(can_driver_init(), ESP_OK);
+    CHECK(can_driver_is_running());
+    atomic_store(&feeding, true);
+    pthread_t bus;
+    pthread_create(&bus, NULL, bus_thread, &count);
+
+    // The requester: everything from can_receive_message() must be the next response
+    uint32_t next = 0, wrong_id = 0, out_of_order = 0;
+    int64_t latency_sum = 0, latency_max = 0;
+    while (atomic_load(&feeding) || next < responses_fed) {
+        can_message_t msg;
+        if (can_receive_message(&msg, RECEIVE_MS) != ESP_OK) continue;
+        uint32_t n = msg.data[1] | msg.data[2] << 8 | (uint32_t)msg.data[3] << 16;
+        if (!in_window(msg.identifier) || msg.data[0] != (uint8_t)msg.identifier || msg.data[4] != 0x55) {
+            wrong_id++;
+            continue;
+        }
+        if (n != next) out_of_order++;
+        int64_t latency = esp_timer_get_time() - fed_us[n];
+        latency_sum += latency;
+        if (latency > latency_max) latency_max = latency;
+        next = n + 1;
+        atomic_fetch_add(&responses_received, 1);
+    }
+    pthread_join(bus, NULL);
+
+    CHECK_EQ(wrong_id, 0);
+    CHECK_EQ(out_of_order, 0);
+    CHECK_EQ(atomic_load(&responses_received), responses_fed);
+    CHECK(responses_fed > 100);
+    CHECK(!can_message_available());
+
+    // Every frame went through the processing stage as well
+    for (int i = 0; i < 100; i++) {
+        sniffer_summary_t sum;
+        if (can_sniffer_snapshot_summary(&sum) && sum.total_msgs == frames_fed) break;
+        usleep(10000);
+    }
+    sniffer_summary_t sum;
+    CHECK(can_sniffer_snapshot_summary(&sum));
+    CHECK_EQ(sum.total_msgs, frames_fed);
+
+    can_pipeline_stats_t ps;
+    CHECK_EQ(can_driver_get_pipeline_stats(&ps), ESP_OK);
+    CHECK_EQ(ps.rx_routed, responses_fed);
+    CHECK_EQ(ps.rx_dropped, 0);
+    CHECK_EQ(ps.ingest_dropped, 0);
+    CHECK(ps.rx_high_water <= 8);
+    CHECK(ps.ingest_busy_us > 0 && ps.ingest_busy_us <= ps.uptime_us);
+    CHECK(ps.proc_busy_us > 0 && ps.proc_busy_us <= ps.uptime_us);
+    can_debug_info_t dbg;
+    CHECK_EQ(can_driver_get_debug_info(&dbg), ESP_OK);
+    CHECK_EQ(dbg.rx_missed_count, 0);
+    CHECK_EQ(dbg.rx_burst_frames, frames_fed);
+
+    printf("%" PRIu32 " frames (%" PRIu32 " responses, %" PRIu32 " look-alikes) in %.1f s: "
+           "%" PRIu32 " delivered in order, latency mean %lld us max %lld us, "
+           "%" PRIu32 " bursts (largest %" PRIu32 "), ingest ring high water %" PRIu32 "\n",
+           frames_fed, responses_fed, decoys_fed, REPLAY_US / 1e6, next,
+           (long long)(responses_fed ? latency_sum / responses_fed : 0), (long long)latency_max,
+           dbg.rx_burst_count, dbg.rx_burst_largest, ps.ingest_high_water);
+
+    CHECK_EQ(can_driver_deinit(), ESP_OK);
+    CHECK(!can_driver_is_running());
+    return host_test_done("test_can_driver");
+}
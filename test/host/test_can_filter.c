@@ -0,0 +1,152 @@
+// can_filter: plans cover every wanted ID, accepted_ids matches the registers,
+// and the false-accept rate on bus traffic. Traffic is the W218 and W212
+// profiles with other ECUs' IDs mixed in, or a recorded CSV session:
+//   test_can_filter [session.csv]
+#include "can_filter.h"
+#include "can_config.h"
+#include "mb_signals.h"
+#include "bus_traffic.h"
+#include "host_test.h"
+#include <stdlib.h>
+
+#define TRAFFIC_FRAMES 200000
+#define FOREIGN_IDS 40
+
+static const uint32_t extra_ids[] = { CAN_FILTER_EXTRA_IDS };
+
+static bus_frame_t frames[TRAFFIC_FRAMES];
+static uint32_t traffic[TRAFFIC_FRAMES];
+
+// What the TWAI controller does with the packed registers (standard data frame)
+static bool registers_accept(uint32_t code, uint32_t mask, bool single, uint32_t id) {
+    if (single) {
+        return (((id << 21) ^ code) & ~mask & 0xFFE00000u) == 0;
+    }
+    return (((id << 21) ^ code) & ~mask & 0xFFE00000u) == 0 ||
+           (((id << 5) ^ code) & ~mask & 0x0000FFE0u) == 0;
+}
+
+// Checks a plan against its ID set; returns the plan for the traffic figures
+static can_filter_plan_t check_plan(const uint32_t *ids, size_t n) {
+    can_filter_plan_t plan;
+    CHECK(can_filter_plan(ids, n, &plan));
+    for (size_t i = 0; i < n; i++) {
+        CHECK(can_filter_accepts(&plan, ids[i]));
+    }
+
+    uint32_t code, mask;
+    bool single;
+    can_filter_to_registers(&plan, &code, &mask, &single);
+    CHECK_EQ(single, !plan.dual);
+    uint32_t accepted = 0;
+    for (uint32_t id = 0; id <= CAN_FILTER_STD_ID_MASK; id++) {
+        bool a = can_filter_accepts(&plan, id);
+        CHECK_EQ(registers_accept(code, mask, single, id), a);
+        accepted += a;
+    }
+    CHECK_EQ(plan.accepted_ids, accepted);
+    CHECK_EQ(plan.false_accepts, plan.accepted_ids - plan.wanted_ids);
+    return plan;
+}
+
+static void test_small_sets(void) {
+    static const uint32_t one[] = { 0x308 };
+    can_filter_plan_t plan = check_plan(one, 1);
+    CHECK(!plan.dual);
+    CHECK_EQ(plan.accepted_ids, 1);
+
+    // Two unrelated IDs: one exact filter each
+    static const uint32_t two[] = { 0x003, 0x7E8, 0x003 };
+    plan = check_plan(two, 3);
+    CHECK(plan.dual);
+    CHECK_EQ(plan.wanted_ids, 2);
+    CHECK_EQ(plan.false_accepts, 0);
+
+    // The OBD-II response block is one aligned cube
+    plan = check_plan(extra_ids, sizeof(extra_ids) / sizeof(extra_ids[0]));
+    CHECK_EQ(plan.false_accepts, 0);
+
+    // Extended IDs are ignored, nothing standard left fails
+    static const uint32_t ext[] = { 0x18DAF110 };
+    CHECK(!can_filter_plan(ext, 1, &plan));
+}
+
+// The planner must beat accept-all on random sets and never miss an ID
+static void test_random_sets(void) {
+    uint32_t seed = 7;
+    for (int round = 0; round < 200; round++) {
+        uint32_t ids[16];
+        size_t n = 1 + host_rand(&seed) % 16;
+        for (size_t i = 0; i < n; i++) ids[i] = host_rand(&seed) & CAN_FILTER_STD_ID_MASK;
+        can_filter_plan_t plan = check_plan(ids, n);
+        CHECK(plan.accepted_ids >= plan.wanted_ids);
+    }
+}
+
+// Frames of the traffic the plan passes; false accepts counted by the planner
+// and by hand must agree
+static void report(const char *label, const uint32_t *ids, size_t n, size_t frames_n) {
+    can_filter_plan_t plan = check_plan(ids, n);
+    uint32_t fa = can_filter_count_false_accepts(&plan, ids, n, traffic, frames_n);
+
+    uint32_t passed = 0, wanted = 0;
+    for (size_t i = 0; i < frames_n; i++) {
+        bool want = false;
+        for (size_t k = 0; k < n && !want; k++) want = ids[k] == traffic[i];
+        bool pass = can_filter_accepts(&plan, traffic[i]);
+        CHECK(pass || !want);
+        passed += pass;
+        wanted += want;
+    }
+    CHECK_EQ(fa, passed - wanted);
+
+    printf("%-28s %2zu IDs  %s filter, %4u of 2048 IDs pass  "
+           "frames: %5.1f%% passed, %5.1f%% false accepts\n",
+           label, n, plan.dual ? "dual  " : "single", (unsigned)plan.accepted_ids,
+           100.0 * passed / frames_n, 100.0 * fa / frames_n);
+}
+
+// Decoder set of one profile plus CAN_FILTER_EXTRA_IDS, as can_driver programs it
+static size_t decode_set(const can_profile_t *p, uint32_t *ids) {
+    size_t n = 0;
+    for (uint32_t id = 0; id < CAN_PROFILE_ID_SPACE; id++) {
+        if (can_profile_find(p, id) != NULL) ids[n++] = id;
+    }
+    for (size_t i = 0; i < sizeof(extra_ids) / sizeof(extra_ids[0]); i++) ids[n++] = extra_ids[i];
+    return n;
+}
+
+static void test_traffic(const can_profile_t *p, size_t frames_n) {
+    for (size_t i = 0; i < frames_n; i++) traffic[i] = frames[i].id;
+
+    uint32_t ids[64 + 8];
+    size_t n = decode_set(p, ids);
+    char label[40];
+    snprintf(label, sizeof(label), "%s decode set", p->name);
+    report(label, ids, n, frames_n);
+
+    // A dashboard reading engine and wheel data only
+    static const uint32_t dash[] = { 0x105, 0x203, 0x308, 0x608 };
+    report("engine + wheel speeds", dash, sizeof(dash) / sizeof(dash[0]), frames_n);
+    report("OBD-II responses", extra_ids, sizeof(extra_ids) / sizeof(extra_ids[0]), frames_n);
+}
+
+int main(int argc, char **argv) {
+    test_small_sets();
+    test_random_sets();
+
+    if (argc > 1) {
+        size_t n = bus_traffic_load_csv(argv[1], frames, TRAFFIC_FRAMES);
+        CHECK(n > 0);
+        printf("%s: %zu frames\n", argv[1], n);
+        if (n) test_traffic(&mb_profiles[0], n);
+    } else {
+        for (int p = 0; p < MB_PROFILE_COUNT; p++) {
+            bus_traffic_generate(&mb_profiles[p], FOREIGN_IDS, 1 + p, frames, TRAFFIC_FRAMES);
+            printf("%s traffic with %d other IDs: %d frames\n", mb_profiles[p].name, FOREIGN_IDS,
+                   TRAFFIC_FRAMES);
+            test_traffic(&mb_profiles[p], TRAFFIC_FRAMES);
+        }
+    }
+    return host_test_done("test_can_filter");
+}
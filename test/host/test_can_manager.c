@@ -0,0 +1,271 @@
+// can_manager against simulated ECUs (ecu_sim.c): batched Mode 01 requests,
+// their multi-frame answers parsed and dispatched to vehicle_data, and the
+// PID throughput reported in the stats; supported-PID discovery over chained
+// ranges, the poll cycle it shortens, and the re-probe when the ECUs on the
+// bus change. can_manager.c is compiled into this test so the manager task can
+// run on a thread of its own until the simulated run is over, and its static
+// state can be checked afterwards.
+#include "can_manager.c"
+#include "ecu_sim.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <math.h>
+#include <pthread.h>
+
+static int64_t run_end_us;
+static int64_t event_us;            // event_fn runs once when the clock passes this
+static void (*event_fn)(void);
+
+static void stop_at_end(int64_t now_us) {
+    if (event_fn != NULL && now_us >= event_us) {
+        event_fn();
+        event_fn = NULL;
+    }
+    if (now_us >= run_end_us) can_manager_running = false;
+}
+
+static void *manager_thread(void *arg) {
+    (void)arg;
+    can_manager_task(NULL);
+    return NULL;
+}
+
+// Run the manager task on the simulated bus for run_ms of simulated time
+static void run_manager(uint32_t run_ms) {
+    memset(&stats, 0, sizeof(stats));
+    run_end_us = esp_timer_get_time() + (int64_t)run_ms * 1000;
+    host_clock_watch(stop_at_end);
+    can_manager_running = true;
+    pthread_t t;
+    pthread_create(&t, NULL, manager_thread, NULL);
+    pthread_join(t, NULL);
+    host_clock_watch(NULL);
+}
+
+static bool near(float v, float want, float tolerance) {
+    return fabsf(v - want) <= tolerance;
+}
+
+static void test_parse_multi(void) {
+    static const uint8_t msg[] = {
+        0x41, 0x0C, 0x1A, 0xF8, 0x0D, 0x58, 0x05, 0x82, 0x11, 0x33, 0x42, 0x36, 0xB0, 0x04, 0x80,
+    };
+    obd2_pid_value_t v[OBD2_MAX_PIDS_PER_REQUEST];
+    CHECK_EQ(obd2_parse_multi_response(msg, sizeof(msg), v, OBD2_MAX_PIDS_PER_REQUEST), 6);
+    CHECK(v[0].pid == 0x0C && v[0].value == 1726.0f);
+    CHECK(v[1].pid == 0x0D && v[1].value == 88.0f);
+    CHECK(v[2].pid == 0x05 && v[2].value == 90.0f);
+    CHECK(v[3].pid == 0x11 && near(v[3].value, 20.0f, 0.01f));
+    CHECK(v[4].pid == 0x42 && near(v[4].value, 14.0f, 0.001f));
+    CHECK(v[5].pid == 0x04 && near(v[5].value, 50.2f, 0.01f));
+
+    // Capacity, a truncated last PID, an unknown PID and another service
+    CHECK_EQ(obd2_parse_multi_response(msg, sizeof(msg), v, 2), 2);
+    CHECK_EQ(obd2_parse_multi_response(msg, sizeof(msg) - 1, v, OBD2_MAX_PIDS_PER_REQUEST), 5);
+    CHECK_EQ(obd2_parse_multi_response(msg, 3, v, OBD2_MAX_PIDS_PER_REQUEST), 0);
+    static const uint8_t unknown[] = {0x41, 0x0D, 0x58, 0xEE, 0x01, 0x05, 0x82};
+    CHECK_EQ(obd2_parse_multi_response(unknown, sizeof(unknown), v, OBD2_MAX_PIDS_PER_REQUEST), 1);
+    static const uint8_t mode2[] = {0x42, 0x0D, 0x58};
+    CHECK_EQ(obd2_parse_multi_response(mode2, sizeof(mode2), v, OBD2_MAX_PIDS_PER_REQUEST), 0);
+}
+
+// Engine ECU with every scheduled PID but fuel pressure, transmission with speed
+static const uint8_t engine_pids[] = {0x04, 0x05, 0x0C, 0x0D, 0x0F, 0x11, 0x14, 0x2F, 0x42};
+static const uint8_t gearbox_pids[] = {0x0D, 0x0F};
+
+static void test_batched_polling(void) {
+    ecu_sim_init(1000000);
+    ecu_sim_add(0x7E8, engine_pids, sizeof(engine_pids), 3000);
+    ecu_sim_add(0x7E9, gearbox_pids, sizeof(gearbox_pids), 6000);
+    ecu_sim_set_value(0x0C, (const uint8_t[]){0x1A, 0xF8}, 2);     // 1726 rpm
+    ecu_sim_set_value(0x0D, (const uint8_t[]){88}, 1);             // 88 km/h
+    ecu_sim_set_value(0x42, (const uint8_t[]){0x36, 0xB0}, 2);     // 14.000 V
+    ecu_sim_set_value(0x2F, (const uint8_t[]){0x80}, 1);
+
+    const uint32_t run_ms = 30000;
+    run_manager(run_ms);
+    const ecu_sim_stats_t *sim = ecu_sim_stats();
+
+    // Requests carry up to OBD2_PIDS_PER_REQUEST PIDs; their answers take several frames
+    CHECK_EQ(sim->max_pids, OBD2_PIDS_PER_REQUEST);
+    CHECK(sim->pid_requests > 0);
+    CHECK(stats.multi_frame_count > 0);
+    CHECK_EQ(sim->flow_controls, sim->multi_frame);
+    CHECK_EQ(sim->bad_flow_controls, 0);
+
+    // Every value lands in vehicle_data
+    const vehicle_data_t *v = vehicle_data_get();
+    CHECK_EQ(v->rpm, 1726);
+    CHECK_EQ(v->vehicle_speed, 88);
+    CHECK_EQ(v->battery_voltage, 14000);
+    CHECK(v->fuel_level > 0);
+
+    // Supported PIDs reach their target rate; fuel pressure is never asked for
+    for (size_t i = 0; i < NUM_SCHEDULED_PIDS; i++) {
+        float hz = sched[i].responses * 1000.0f / run_ms;
+        float target = 1000.0f / schedule[i].period_ms;
+        if (schedule[i].pid == PID_FUEL_PRESSURE) {
+            CHECK(!sched[i].supported);
+            CHECK_EQ(sched[i].requests, 0);
+        } else if (hz < target * 0.9f) {
+            fprintf(stderr, "PID 0x%02X at %.2f Hz, target %.2f Hz\n", schedule[i].pid, hz, target);
+            host_failures++;
+        }
+    }
+
+    // Throughput in the stats: several PIDs per request
+    float requests_per_s = sim->pid_requests * 1000.0f / run_ms;
+    float pids_per_request = (float)sim->pids_requested / sim->pid_requests;
+    CHECK(stats.pids_per_second > 0);
+    CHECK(stats.pids_per_second > requests_per_s * 2);
+    printf("batched polling: %.1f requests/s, %.2f PIDs per request, %.1f PIDs/s decoded, "
+           "%" PRIu32 " multi-frame answers, latency %" PRIu32 " us\n",
+           requests_per_s, pids_per_request, stats.pids_per_second, stats.multi_frame_count,
+           stats.response_latency_us);
+}
+
+static void test_parse_supported(void) {
+    // 0x00: PIDs 0x01, 0x0C, 0x0D, 0x20 (range 0x20 follows); 0x20: PIDs 0x21, 0x40
+    static const uint8_t msg[] = {
+        0x41, 0x00, 0x80, 0x18, 0x00, 0x01, 0x20, 0x80, 0x00, 0x00, 0x01, 0x0D, 0x58,
+    };
+    obd2_supported_t sup = {0};
+    CHECK_EQ(obd2_parse_supported_pids(msg, sizeof(msg), &sup), 2);   // stops at PID 0x0D
+    for (unsigned pid = 1; pid < 256; pid++) {
+        bool want = pid == 0x01 || pid == 0x0C || pid == 0x0D || pid == 0x20 || pid == 0x21 || pid == 0x40;
+        CHECK_EQ(obd2_pid_supported(&sup, (uint8_t)pid), want);
+    }
+    CHECK(obd2_pid_supported(&sup, 0x00));
+
+    // Bitmaps from further answers are merged; a short bitmap is not parsed
+    static const uint8_t more[] = {0x41, 0x40, 0x00, 0x00, 0x00, 0x02, 0x60, 0x80};
+    CHECK_EQ(obd2_parse_supported_pids(more, sizeof(more), &sup), 1);
+    CHECK(obd2_pid_supported(&sup, 0x5F));
+    CHECK(obd2_pid_supported(&sup, 0x0C));
+    CHECK(!obd2_pid_supported(&sup, 0x61));
+    static const uint8_t mode9[] = {0x49, 0x00, 0xFF, 0xFF, 0xFF, 0xFF};
+    CHECK_EQ(obd2_parse_supported_pids(mode9, sizeof(mode9), &sup), 0);
+}
+
+// Engine PIDs reaching range 0xC0: the first request asks for six ranges, a
+// second one for 0xC0, which only the engine's 0xA0 bitmap announces
+static const uint8_t engine_wide_pids[] = {
+    0x04, 0x05, 0x0C, 0x0D, 0x0F, 0x11, 0x14, 0x2F, 0x42, 0x46, 0x5C, 0xA6, 0xC4,
+};
+
+// Whether the bitmap of ECU e lists exactly the PIDs the simulated ECU has,
+// and the support PIDs leading to them
+static bool bitmap_matches(uint32_t e, const uint8_t *pids, size_t n) {
+    for (unsigned pid = 1; pid < 256; pid++) {
+        bool want = false;
+        for (size_t i = 0; i < n; i++) {
+            want |= pids[i] == pid || (pid % OBD2_SUPPORT_RANGE == 0 && pids[i] > pid);
+        }
+        if (obd2_pid_supported(&ecu_supported[e], (uint8_t)pid) != want) {
+            fprintf(stderr, "ECU %u: PID 0x%02X %s\n", (unsigned)e, pid, want ? "missing" : "not supported");
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_discover(void) {
+    ecu_sim_init(1000000);
+    ecu_sim_add(0x7E8, engine_wide_pids, sizeof(engine_wide_pids), 3000);
+    ecu_sim_add(0x7E9, gearbox_pids, sizeof(gearbox_pids), 6000);
+    ecu_sim_add(0x7EB, engine_pids, sizeof(engine_pids), 4000)->online = false;
+    memset(&stats, 0, sizeof(stats));
+    latency_us = 0;
+
+    CHECK(can_manager_discover());
+    CHECK_EQ(stats.ecu_mask, 0x03);
+    CHECK_EQ(stats.discovery_count, 1);
+    CHECK_EQ(ecu_sim_stats()->support_requests, 2);
+    CHECK(bitmap_matches(0, engine_wide_pids, sizeof(engine_wide_pids)));
+    CHECK(bitmap_matches(1, gearbox_pids, sizeof(gearbox_pids)));
+    CHECK(pid_supported(0x0C));
+    CHECK(!pid_supported(PID_FUEL_PRESSURE));
+
+    // Nobody on the bus: nothing found, every PID stays eligible
+    ecu_sim_init(1000000);
+    CHECK(!can_manager_discover());
+    CHECK_EQ(stats.ecu_mask, 0);
+    CHECK(pid_supported(PID_FUEL_PRESSURE));
+}
+
+/**
+ * Request every scheduled PID once, per_request at a time
+ * @param filter Skip PIDs no discovered ECU supports
+ * @return Simulated time taken (us)
+ */
+static int64_t poll_cycle(size_t per_request, bool filter) {
+    int64_t start = esp_timer_get_time();
+    uint8_t batch[OBD2_PIDS_PER_REQUEST];
+    size_t n = 0;
+    for (size_t i = 0; i <= NUM_SCHEDULED_PIDS; i++) {
+        bool last = i == NUM_SCHEDULED_PIDS;
+        if (!last && (!filter || pid_supported(schedule[i].pid))) batch[n++] = schedule[i].pid;
+        if (n > 0 && (n == per_request || last)) {
+            can_manager_request(OBD2_SERVICE_CURRENT_DATA, batch, n, handle_values, false);
+            n = 0;
+        }
+    }
+    return esp_timer_get_time() - start;
+}
+
+// A car with four of the ten scheduled PIDs: unsupported PIDs cost a P2 wait
+// in every batch they ride in, and a whole timeout when a batch has nothing else
+static void test_cycle_time(void) {
+    static const uint8_t few_pids[] = {0x05, 0x0C, 0x0D, 0x2F};
+    ecu_sim_init(1000000);
+    ecu_sim_add(0x7E8, few_pids, sizeof(few_pids), 3000);
+    memset(&stats, 0, sizeof(stats));
+    latency_us = 0;
+    CHECK(can_manager_discover());
+
+    int64_t single = poll_cycle(1, false);
+    int64_t batched = poll_cycle(OBD2_PIDS_PER_REQUEST, false);
+    int64_t filtered = poll_cycle(OBD2_PIDS_PER_REQUEST, true);
+    CHECK(filtered < batched);
+    CHECK(batched < single);
+    CHECK(filtered < 2 * (int64_t)latency_us + 10000);
+    printf("poll cycle, 4 of %d PIDs supported: one per request %.1f ms, batched %.1f ms, "
+           "batched supported only %.1f ms\n", (int)NUM_SCHEDULED_PIDS,
+           single / 1000.0, batched / 1000.0, filtered / 1000.0);
+}
+
+// Another car: the engine ECU goes, a new one answers; the manager probes again
+static ecu_sim_ecu_t *old_engine, *new_engine;
+
+static void swap_vehicle(void) {
+    old_engine->online = false;
+    new_engine->online = true;
+}
+
+static void test_reprobe(void) {
+    ecu_sim_init(1000000);
+    old_engine = ecu_sim_add(0x7E8, engine_pids, sizeof(engine_pids), 3000);
+    new_engine = ecu_sim_add(0x7EA, gearbox_pids, sizeof(gearbox_pids), 5000);
+    new_engine->online = false;
+    event_us = esp_timer_get_time() + 10000000;
+    event_fn = swap_vehicle;
+    run_manager(20000);
+
+    CHECK_EQ(stats.discovery_count, 2);
+    CHECK_EQ(stats.ecu_mask, 1u << 2);
+    // Only what the new ECU supports is polled after the probe
+    for (size_t i = 0; i < NUM_SCHEDULED_PIDS; i++) {
+        bool want = schedule[i].pid == PID_VEHICLE_SPEED || schedule[i].pid == PID_INTAKE_AIR_TEMP;
+        CHECK_EQ(sched[i].supported, want);
+    }
+}
+
+int main(void) {
+    test_parse_multi();
+    test_batched_polling();
+    test_parse_supported();
+    test_discover();
+    test_cycle_time();
+    test_reprobe();
+    return host_test_done("test_can_manager");
+}
@@ -0,0 +1,185 @@
+// can_ring: empty, full and wrap-around behaviour, then a two-thread
+// producer/consumer run checking that every frame arrives once, in order
+#include "can_ring.h"
+#include "host_test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define SPSC_FRAMES 2000000u
+
+static void make_frame(can_message_t *m, uint32_t seq) {
+    memset(m, 0, sizeof(*m));
+    m->identifier = seq & 0x7FF;
+    m->data_length_code = 8;
+    memcpy(m->data, &seq, sizeof(seq));
+    m->data[7] = (uint8_t)(seq * 31);
+    m->timestamp = seq;
+}
+
+static bool frame_is(const can_message_t *m, uint32_t seq) {
+    uint32_t got;
+    memcpy(&got, m->data, sizeof(got));
+    return got == seq && m->identifier == (seq & 0x7FF) && m->timestamp == seq &&
+           m->data[7] == (uint8_t)(seq * 31);
+}
+
+static void test_init(void) {
+    can_ring_t ring;
+    can_message_t slots[8];
+    CHECK(!can_ring_init(&ring, slots, 0));
+    CHECK(!can_ring_init(&ring, slots, 6));
+    CHECK(!can_ring_init(&ring, NULL, 8));
+    CHECK(can_ring_init(&ring, slots, 8));
+    CHECK_EQ(can_ring_capacity(&ring), 8);
+    CHECK_EQ(can_ring_count(&ring), 0);
+}
+
+static void test_empty_and_full(void) {
+    can_ring_t ring;
+    can_message_t slots[8];
+    can_ring_init(&ring, slots, 8);
+
+    can_message_t m;
+    const can_message_t *peeked;
+    CHECK(!can_ring_pop(&ring, &m));
+    CHECK_EQ(can_ring_peek(&ring, &peeked, 4), 0);
+
+    for (uint32_t i = 0; i < 8; i++) {
+        make_frame(&m, i);
+        CHECK(can_ring_push(&ring, &m));
+    }
+    CHECK_EQ(can_ring_count(&ring), 8);
+    CHECK_EQ(ring.high_water, 8);
+
+    can_message_t *slot;
+    CHECK_EQ(can_ring_reserve(&ring, &slot, 1), 0);
+    make_frame(&m, 99);
+    CHECK(!can_ring_push(&ring, &m));
+    CHECK(!can_ring_push(&ring, &m));
+    CHECK_EQ(atomic_load(&ring.dropped), 2);
+
+    for (uint32_t i = 0; i < 8; i++) {
+        CHECK(can_ring_pop(&ring, &m));
+        CHECK(frame_is(&m, i));
+    }
+    CHECK(!can_ring_pop(&ring, &m));
+    CHECK_EQ(can_ring_count(&ring), 0);
+
+    can_ring_reset(&ring);
+    CHECK_EQ(atomic_load(&ring.dropped), 0);
+    CHECK_EQ(ring.high_water, 0);
+}
+
+static void test_wrap(void) {
+    can_ring_t ring;
+    can_message_t slots[8];
+    can_ring_init(&ring, slots, 8);
+
+    // Move head and tail to slot 6 so the next runs straddle the end
+    can_message_t m;
+    for (uint32_t i = 0; i < 6; i++) {
+        make_frame(&m, i);
+        can_ring_push(&ring, &m);
+        can_ring_pop(&ring, &m);
+    }
+
+    // Reserve stops at the wrap: two slots now, the rest from slot 0
+    can_message_t *slot;
+    CHECK_EQ(can_ring_reserve(&ring, &slot, 5), 2);
+    CHECK(slot == &slots[6]);
+    make_frame(&slot[0], 100);
+    make_frame(&slot[1], 101);
+    can_ring_commit(&ring, 2);
+    CHECK_EQ(can_ring_reserve(&ring, &slot, 5), 5);
+    CHECK(slot == &slots[0]);
+    for (uint32_t i = 0; i < 5; i++) make_frame(&slot[i], 102 + i);
+    can_ring_commit(&ring, 5);
+    CHECK_EQ(can_ring_count(&ring), 7);
+    CHECK_EQ(can_ring_reserve(&ring, &slot, 5), 1);  // one free slot left
+
+    // Peek also stops at the wrap
+    const can_message_t *peeked;
+    CHECK_EQ(can_ring_peek(&ring, &peeked, 8), 2);
+    CHECK(frame_is(&peeked[0], 100) && frame_is(&peeked[1], 101));
+    can_ring_release(&ring, 2);
+    CHECK_EQ(can_ring_peek(&ring, &peeked, 8), 5);
+    for (uint32_t i = 0; i < 5; i++) CHECK(frame_is(&peeked[i], 102 + i));
+    can_ring_release(&ring, 5);
+    CHECK_EQ(can_ring_count(&ring), 0);
+
+    // Free-running counters past the 32-bit wrap
+    atomic_store(&ring.head, 0xFFFFFFFEu);
+    atomic_store(&ring.tail, 0xFFFFFFFEu);
+    for (uint32_t i = 0; i < 8; i++) {
+        make_frame(&m, 200 + i);
+        CHECK(can_ring_push(&ring, &m));
+    }
+    CHECK_EQ(can_ring_count(&ring), 8);
+    CHECK(!can_ring_push(&ring, &m));
+    for (uint32_t i = 0; i < 8; i++) {
+        CHECK(can_ring_pop(&ring, &m));
+        CHECK(frame_is(&m, 200 + i));
+    }
+}
+
+// Two threads: batches of varying size on both sides, as can_rx_task and the processing task use it
+static can_ring_t spsc_ring;
+static can_message_t spsc_slots[32];
+
+static void *spsc_producer(void *arg) {
+    (void)arg;
+    uint32_t rng = 1;
+    uint32_t seq = 0;
+    while (seq < SPSC_FRAMES) {
+        can_message_t *slot;
+        uint32_t want = 1 + host_rand(&rng) % 12;
+        if (want > SPSC_FRAMES - seq) want = SPSC_FRAMES - seq;
+        uint32_t n = can_ring_reserve(&spsc_ring, &slot, want);
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+        for (uint32_t i = 0; i < n; i++) make_frame(&slot[i], seq++);
+        can_ring_commit(&spsc_ring, n);
+    }
+    return NULL;
+}
+
+static void test_spsc(void) {
+    can_ring_init(&spsc_ring, spsc_slots, 32);
+    pthread_t producer;
+    pthread_create(&producer, NULL, spsc_producer, NULL);
+
+    uint32_t rng = 2;
+    uint32_t expect = 0;
+    uint32_t bad = 0;
+    while (expect < SPSC_FRAMES) {
+        const can_message_t *msgs;
+        uint32_t n = can_ring_peek(&spsc_ring, &msgs, 1 + host_rand(&rng) % 16);
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            bad += !frame_is(&msgs[i], expect);
+            expect++;
+        }
+        can_ring_release(&spsc_ring, n);
+    }
+    pthread_join(producer, NULL);
+
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(can_ring_count(&spsc_ring), 0);
+    CHECK_EQ(atomic_load(&spsc_ring.dropped), 0);
+    CHECK(spsc_ring.high_water <= 32);
+    printf("spsc: %u frames in order, high water %u of 32\n", SPSC_FRAMES, (unsigned)spsc_ring.high_water);
+}
+
+int main(void) {
+    test_init();
+    test_empty_and_full();
+    test_wrap();
+    test_spsc();
+    return host_test_done("test_can_ring");
+}
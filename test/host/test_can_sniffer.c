@@ -0,0 +1,186 @@
+// can_sniffer: per-bit change statistics and the top-bits ranking, and the
+// inter-arrival timing: missed cycles, rate changes and event-driven IDs
+#include "can_sniffer.h"
+#include "host_test.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 0x100: bit 0 toggles every frame, bit 15 every fourth, byte 3 counts up
+// 0x200: bit 18 toggles every frame, for fewer frames
+static void test_change_stats(void) {
+    can_sniffer_init();
+    const uint32_t frames = 100000;     // past the old 16-bit counter limit
+    uint8_t a[8] = {0}, b[8] = {0};
+    for (uint32_t f = 0; f < frames; f++) {
+        a[0] = f & 1;
+        a[1] = (uint8_t)(((f / 4) & 1) << 7);
+        a[3] = (uint8_t)(10 + f % 20);
+        can_sniffer_record(0x100, a, 8, f * 1000);
+        if (f < 5000) {
+            b[2] = (uint8_t)((f & 1) << 2);
+            can_sniffer_record(0x200, b, 4, f * 1000 + 500);
+        }
+    }
+
+    sniffer_entry_t e;
+    CHECK(can_sniffer_snapshot_entry(0x100, &e));
+    CHECK_EQ(e.count, frames);
+    CHECK_EQ(e.bit_flips[0], frames - 1);
+    CHECK_EQ(e.bit_flips[15], (frames - 1) / 4);
+    CHECK_EQ(e.changed_mask, 0x0B);
+    CHECK_EQ(e.byte_min[3], 10);
+    CHECK_EQ(e.byte_max[3], 29);
+    CHECK_EQ(e.byte_min[2], 0);
+    CHECK_EQ(e.byte_max[2], 0);
+    uint32_t sum = 0;
+    for (int bit = 0; bit < 64; bit++) sum += e.bit_flips[bit];
+    CHECK_EQ(e.flip_total, sum);
+
+    CHECK(can_sniffer_snapshot_entry(0x200, &e));
+    CHECK_EQ(e.bit_flips[18], 4999);
+    CHECK_EQ(e.changed_mask, 0x04);
+    CHECK(!can_sniffer_snapshot_entry(0x300, &e));
+
+    // 0x100 toggles bit 0, bit 15 and five bits of byte 3; 0x200 comes last
+    sniffer_bit_rank_t top[16];
+    size_t n = can_sniffer_top_bits(top, 16);
+    CHECK_EQ(n, 8);
+    CHECK(top[0].id == 0x100);
+    CHECK_EQ(top[0].flips, frames - 1);
+    CHECK(top[n - 1].id == 0x200 && top[n - 1].bit == 18);
+    for (size_t i = 1; i < n; i++) CHECK(top[i - 1].flips >= top[i].flips);
+}
+
+static uint32_t seed = 3;
+
+// n frames of id every period_us ± 2 %, starting one period after *t
+static void send_periodic(uint32_t id, uint32_t *t, uint32_t period_us, int n) {
+    static const uint8_t data[8] = {0};
+    for (int i = 0; i < n; i++) {
+        *t += period_us - period_us / 50 + host_rand(&seed) % (period_us / 25);
+        can_sniffer_record(id, data, 8, *t);
+    }
+}
+
+static sniffer_timing_t timing_of(uint32_t id) {
+    sniffer_entry_t e;
+    sniffer_timing_t t;
+    CHECK(can_sniffer_snapshot_entry(id, &e));
+    can_sniffer_get_timing(&e, &t);
+    return t;
+}
+
+static uint32_t summary_missed(void) {
+    sniffer_summary_t sum;
+    CHECK(can_sniffer_snapshot_summary(&sum));
+    return sum.missed_cycles;
+}
+
+static bool near(uint32_t v, uint32_t want, uint32_t tolerance) {
+    return v + tolerance >= want && v <= want + tolerance;
+}
+
+static void test_missed_cycles(void) {
+    can_sniffer_init();
+    uint32_t t = 0xFFF00000u;   // crosses the 32-bit rollover
+    send_periodic(0x308, &t, 10000, 100);
+    sniffer_timing_t tm = timing_of(0x308);
+    CHECK(near(tm.mean_us, 10000, 100));
+    CHECK(tm.jitter_us < 200);
+    CHECK_EQ(tm.missed_cycles, 0);
+
+    // Two frames lost, then on schedule again: the gap stays out of the mean
+    t += 20000;
+    send_periodic(0x308, &t, 10000, 100);
+    tm = timing_of(0x308);
+    CHECK_EQ(tm.missed_cycles, 2);
+    CHECK_EQ(summary_missed(), 2);
+    CHECK(near(tm.mean_us, 10000, 100));
+    CHECK(tm.max_us > 29000);
+}
+
+static void test_rate_change(void) {
+    can_sniffer_init();
+    uint32_t t = 0;
+    send_periodic(0x200, &t, 10000, 50);
+    t += 30000;                             // three frames lost
+    send_periodic(0x200, &t, 10000, 50);
+    CHECK_EQ(timing_of(0x200).missed_cycles, 3);
+
+    // The ECU halves its rate: after a few long periods it is the new baseline,
+    // not a stream of gaps
+    send_periodic(0x200, &t, 20000, 100);
+    sniffer_timing_t tm = timing_of(0x200);
+    CHECK(near(tm.mean_us, 20000, 200));
+    CHECK(tm.jitter_us < 400);
+    CHECK_EQ(tm.missed_cycles, 3);
+    CHECK_EQ(summary_missed(), 3);
+
+    // And back to a faster rate
+    send_periodic(0x200, &t, 5000, 100);
+    tm = timing_of(0x200);
+    CHECK(near(tm.mean_us, 5000, 50));
+    CHECK_EQ(tm.missed_cycles, 3);
+
+    // Gaps are still detected at the new rate
+    t += 10000;
+    send_periodic(0x200, &t, 5000, 20);
+    CHECK_EQ(timing_of(0x200).missed_cycles, 5);
+}
+
+// Event-driven IDs (button presses, door switches) have no cycle to miss
+static void test_aperiodic(void) {
+    can_sniffer_init();
+    static const uint8_t data[8] = {0};
+    uint32_t t = 0;
+    // Presses at random: exponential gaps, 300 ms on average, 10 ms at least
+    for (int i = 0; i < 2000; i++) {
+        double u = (host_rand(&seed) + 1.0) / 4294967296.0;
+        t += 10000 + (uint32_t)(-290000.0 * log(u));
+        can_sniffer_record(0x045, data, 8, t);
+    }
+    sniffer_timing_t tm = timing_of(0x045);
+    CHECK_EQ(tm.missed_cycles, 0);
+    CHECK_EQ(tm.samples, 1999);
+    CHECK(tm.jitter_us > tm.mean_us / 4);
+    CHECK_EQ(summary_missed(), 0);
+}
+
+// Hours of an event-driven ID at about 10 Hz, with the odd long pause (engine
+// off at a light, a door left open): the variance sum must neither wrap into
+// a small value, which makes the ID look periodic, nor overflow on long gaps
+static void test_aperiodic_long_run(void) {
+    can_sniffer_init();
+    static const uint8_t data[8] = {0};
+    const int frames = 200000;
+    uint32_t t = 0;
+    for (int i = 0; i < frames; i++) {
+        double u = (host_rand(&seed) + 1.0) / 4294967296.0;
+        uint32_t gap = 1000 + (uint32_t)(-99000.0 * log(u));
+        if (i % 20000 == 10000) gap = 60000000u;        // a minute of silence
+        if (i == 150000) gap = 1800000000u;         // half an hour parked
+        t += gap;
+        can_sniffer_record(0x045, data, 8, t);
+        if (i % 10000 == 0) {
+            sniffer_timing_t tm = timing_of(0x045);
+            CHECK_EQ(tm.missed_cycles, 0);
+            CHECK_EQ(tm.samples, (uint32_t)i);
+        }
+    }
+    sniffer_timing_t tm = timing_of(0x045);
+    CHECK_EQ(tm.missed_cycles, 0);
+    CHECK_EQ(tm.samples, frames - 1);
+    CHECK(tm.jitter_us > tm.mean_us);
+    CHECK_EQ(summary_missed(), 0);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) seed = (uint32_t)atoi(argv[1]);
+    test_change_stats();
+    test_missed_cycles();
+    test_rate_change();
+    test_aperiodic();
+    test_aperiodic_long_run();
+    return host_test_done("test_can_sniffer");
+}
@@ -0,0 +1,301 @@
+// canlog_reader on session logs laid out as sd_logger writes them (records
+// after the header, a block per chunk when compressed, an index entry per
+// keyframe at least SD_LOG_INDEX_INTERVAL_MS apart), for both binary formats:
+// full reads and seeks against a linear scan of the frames, with the file
+// positioning a seek costs counted (fseek is wrapped at link time); and the
+// files a power cut or a reused card leaves behind: a sidecar ahead of a log
+// cut short, a preallocated zero tail, stale data of an older session after
+// the end, and no sidecar at all.
+#include "canlog_reader.h"
+#include "mb_signals.h"
+#include "bus_traffic.h"
+#include "sd_logger.h"
+#include "host_test.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_FRAMES      160000
+#define SESSION_US      60000000u
+#define MAX_ENTRIES     64
+#define SEEKS           500
+#define FOLLOW          20          // frames compared after each seek
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    uint32_t flags;
+    uint64_t start_us;
+    canlog_frame_t *frames;
+    size_t *frame_end;              // file offset just past the frame (its block, if compressed)
+    size_t count;
+    canlog_index_entry_t entries[MAX_ENTRIES];
+    size_t entry_end[MAX_ENTRIES];  // file offset just past the keyframe
+    size_t num_entries;
+} session_t;
+
+static bus_frame_t traffic[MAX_FRAMES];
+static session_t plain, compressed, older;
+static char dir[] = "/tmp/canlog_reader_XXXXXX";
+static char log_path[64], idx_path[64];
+static uint32_t seed = 24;
+
+// File positioning by the reader, to tell a seek through the index from a scan
+int __real_fseek(FILE *f, long offset, int whence);
+static unsigned long fseeks;
+
+int __wrap_fseek(FILE *f, long offset, int whence) {
+    fseeks++;
+    return __real_fseek(f, offset, whence);
+}
+
+static void put(session_t *s, const void *p, size_t n) {
+    memcpy(&s->data[s->len], p, n);
+    s->len += n;
+}
+
+static void add_entry(session_t *s, uint64_t time_us, uint32_t offset, uint32_t frames, size_t end,
+                      uint64_t *next_us) {
+    if (time_us < *next_us || s->num_entries == MAX_ENTRIES) return;
+    s->entries[s->num_entries] = (canlog_index_entry_t){.time_us = time_us, .offset = offset, .frames = frames};
+    s->entry_end[s->num_entries++] = end;
+    *next_us = time_us + SD_LOG_INDEX_INTERVAL_MS * 1000ULL;
+}
+
+// Encode count frames of traffic the way sd_writer_task does
+static void build(session_t *s, uint32_t flags, uint64_t start_us, size_t count) {
+    static canlog_encoder_t enc;
+    static uint8_t chunk[CANLOG_CHUNK_SIZE];
+    static uint16_t lz_table[1 << CANLOG_LZ_HASH_BITS];
+    canlog_header_t hdr;
+
+    s->data = malloc(count * CANLOG_MAX_RECORD_LEN);
+    s->frames = malloc(count * sizeof(*s->frames));
+    s->frame_end = malloc(count * sizeof(*s->frame_end));
+    s->len = 0;
+    s->flags = flags;
+    s->start_us = start_us;
+    s->count = count;
+    s->num_entries = 0;
+    canlog_begin(&enc, &hdr, flags, start_us, 0, SD_LOG_CAN_BITRATE);
+    put(s, &hdr, sizeof(hdr));
+
+    uint64_t next_us = 0, chunk_sync_us = 0;
+    uint32_t chunk_sync_frames = 0;
+    size_t chunk_len = 0, chunk_first = 0;
+    for (size_t i = 0; i <= count; i++) {
+        bool compress = (flags & CANLOG_FLAG_COMPRESSED) &&
+                        (i == count ? chunk_len > 0 : chunk_len + CANLOG_MAX_RECORD_LEN > sizeof(chunk));
+        if (compress) {
+            size_t offset = s->len;
+            s->len += canlog_compress_chunk(chunk, chunk_len, &s->data[s->len], lz_table);
+            add_entry(s, chunk_sync_us, (uint32_t)offset, chunk_sync_frames, s->len, &next_us);
+            for (size_t k = chunk_first; k < i; k++) s->frame_end[k] = s->len;
+            canlog_begin_chunk(&enc);
+            chunk_len = 0;
+            chunk_first = i;
+        }
+        if (i == count) break;
+
+        const bus_frame_t *f = &traffic[i];
+        canlog_frame_t *fr = &s->frames[i];
+        *fr = (canlog_frame_t){.time_us = start_us + f->ts_us, .can_id = f->id, .dlc = f->dlc};
+        memcpy(fr->data, f->data, f->dlc);
+        if (flags & CANLOG_FLAG_COMPRESSED) {
+            chunk_len += canlog_encode_frame(&enc, &chunk[chunk_len], fr->time_us, fr->can_id, fr->data, fr->dlc);
+            if (i == chunk_first) {
+                chunk_sync_us = enc.last_sync_us;
+                chunk_sync_frames = enc.frames - 1;
+            }
+        } else {
+            uint8_t rec[CANLOG_MAX_RECORD_LEN];
+            size_t n = canlog_encode_frame(&enc, rec, fr->time_us, fr->can_id, fr->data, fr->dlc);
+            if (rec[0] == CANLOG_SYNC_TAG) {
+                add_entry(s, enc.last_sync_us, (uint32_t)s->len, enc.frames - 1, s->len + CANLOG_SYNC_LEN,
+                          &next_us);
+            }
+            put(s, rec, n);
+            s->frame_end[i] = s->len;
+        }
+    }
+}
+
+// Put the first len bytes of the log on the card, then tail_len bytes of tail
+// (NULL: zeros), and the first entries of its index (-1: no sidecar)
+static void write_files(const session_t *s, size_t len, const uint8_t *tail, size_t tail_len, int entries) {
+    FILE *f = fopen(log_path, "wb");
+    fwrite(s->data, 1, len, f);
+    static const uint8_t zeros[4096];
+    for (size_t done = 0; done < tail_len;) {
+        size_t n = tail_len - done < sizeof(zeros) ? tail_len - done : sizeof(zeros);
+        fwrite(tail ? &tail[done] : zeros, 1, n, f);
+        done += n;
+    }
+    fclose(f);
+
+    unlink(idx_path);
+    if (entries < 0) return;
+    canlog_index_header_t hdr = {
+        .version = CANLOG_INDEX_VERSION,
+        .entry_size = sizeof(canlog_index_entry_t),
+        .interval_ms = SD_LOG_INDEX_INTERVAL_MS,
+        .start_us = s->start_us,
+    };
+    memcpy(hdr.magic, CANLOG_INDEX_MAGIC, sizeof(hdr.magic));
+    f = fopen(idx_path, "wb");
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    fwrite(s->entries, sizeof(s->entries[0]), (size_t)entries, f);
+    fclose(f);
+}
+
+// Frames of s that lie wholly in its first len bytes
+static size_t frames_within(const session_t *s, size_t len) {
+    size_t n = 0;
+    while (n < s->count && s->frame_end[n] <= len) n++;
+    return n;
+}
+
+static size_t entries_within(const session_t *s, size_t len) {
+    size_t n = 0;
+    while (n < s->num_entries && s->entry_end[n] <= len) n++;
+    return n;
+}
+
+static bool same_frame(const canlog_frame_t *a, const canlog_frame_t *b) {
+    return a->time_us == b->time_us && a->can_id == b->can_id && a->dlc == b->dlc &&
+           memcmp(a->data, b->data, sizeof(a->data)) == 0;
+}
+
+// The whole file reads back as the first `expect` frames of s
+static void check_read(const session_t *s, size_t expect) {
+    canlog_reader_t *r = malloc(sizeof(*r));
+    CHECK_EQ(canlog_reader_open(r, log_path), ESP_OK);
+    canlog_frame_t f;
+    size_t n = 0;
+    while (canlog_reader_next(r, &f) == ESP_OK) {
+        if (n >= expect || !same_frame(&f, &s->frames[n])) break;
+        n++;
+    }
+    CHECK_EQ(n, expect);
+    CHECK_EQ(canlog_reader_next(r, &f), ESP_ERR_NOT_FOUND);
+    canlog_reader_close(r);
+    free(r);
+}
+
+// Random seeks land where a linear scan of the first `expect` frames does; returns fseeks per seek
+static double check_seeks(const session_t *s, size_t expect, uint32_t *index_count) {
+    canlog_reader_t *r = malloc(sizeof(*r));
+    CHECK_EQ(canlog_reader_open(r, log_path), ESP_OK);
+    uint64_t span = s->frames[s->count - 1].time_us - s->start_us;
+    unsigned long seeks_before = fseeks;
+    size_t bad = 0;
+    for (int k = 0; k < SEEKS; k++) {
+        uint64_t t = s->start_us + (uint64_t)host_rand(&seed) % (span + span / 10);
+        size_t lo = 0, hi = expect;
+        while (lo < hi) {       // first frame at or after t
+            size_t mid = lo + (hi - lo) / 2;
+            if (s->frames[mid].time_us < t) lo = mid + 1; else hi = mid;
+        }
+        size_t want = lo;
+        esp_err_t err = canlog_reader_seek(r, t);
+        if (want == expect) {
+            if (err != ESP_ERR_NOT_FOUND) bad++;
+            continue;
+        }
+        canlog_frame_t f;
+        for (size_t i = want; i < want + FOLLOW && i < expect; i++) {
+            if (canlog_reader_next(r, &f) != ESP_OK || !same_frame(&f, &s->frames[i])) {
+                bad++;
+                break;
+            }
+        }
+    }
+    CHECK_EQ(bad, 0);
+    if (index_count) *index_count = r->index_count;
+    canlog_reader_close(r);
+    free(r);
+    return (double)(fseeks - seeks_before) / SEEKS;
+}
+
+static void test_session(session_t *s, const char *name) {
+    // Whole file with its sidecar: seeks go through the index
+    write_files(s, s->len, NULL, 0, (int)s->num_entries);
+    check_read(s, s->count);
+    uint32_t index_count = 0;
+    double indexed = check_seeks(s, s->count, &index_count);
+    CHECK_EQ(index_count, s->num_entries);
+
+    // No sidecar: the same answers by scanning from the start
+    write_files(s, s->len, NULL, 0, -1);
+    check_read(s, s->count);
+    double scanned = check_seeks(s, s->count, &index_count);
+    CHECK_EQ(index_count, 0);
+
+    // Binary search of the sidecar plus one interval of log, against the whole file
+    unsigned log2_entries = 0;
+    while ((1u << log2_entries) < s->num_entries) log2_entries++;
+    size_t interval_bytes = s->len / s->num_entries;
+    CHECK(indexed <= log2_entries + 4 + 2.0 * interval_bytes / CANLOG_READER_WINDOW);
+    CHECK(indexed * 5 < scanned);
+    printf("%-10s %zu frames, %zu bytes, %zu index entries: %.1f fseeks/seek with the index, "
+           "%.1f without\n", name, s->count, s->len, s->num_entries, indexed, scanned);
+
+    // Power cut: the sidecar is ahead of the log, which ends mid-record or mid-block
+    for (int cut = 1; cut <= 3; cut++) {
+        size_t len = s->len * cut / 4 + 7;
+        size_t expect = frames_within(s, len);
+        write_files(s, len, NULL, 0, (int)s->num_entries);
+        check_read(s, expect);
+        check_seeks(s, expect, &index_count);
+        CHECK_EQ(index_count, entries_within(s, len));
+    }
+
+    // Preallocated space the writer never reached, with all or part of the index
+    size_t end = s->frame_end[s->count * 2 / 3];
+    size_t expect = frames_within(s, end);
+    write_files(s, end, NULL, 4u << 20, (int)entries_within(s, end));
+    check_read(s, expect);
+    check_seeks(s, expect, NULL);
+    write_files(s, end, NULL, 4u << 20, (int)s->num_entries);
+    check_read(s, expect);
+    check_seeks(s, expect, &index_count);
+    CHECK_EQ(index_count, entries_within(s, end));
+
+    // Clusters reused from an older session: its keyframe follows the end of this
+    // one, with a sync count that does not follow on
+    const session_t *o = &older;
+    size_t from = o->entries[o->num_entries / 2].offset;
+    if (s->flags != o->flags) from = o->len;        // only the same format can decode as a keyframe
+    write_files(s, end, &o->data[from], o->len - from, (int)entries_within(s, end));
+    check_read(s, expect);
+    check_seeks(s, expect, NULL);
+    write_files(s, end, &o->data[from], o->len - from, -1);
+    check_read(s, expect);
+    check_seeks(s, expect, NULL);
+}
+
+int main(void) {
+    CHECK(mkdtemp(dir) != NULL);
+    snprintf(log_path, sizeof(log_path), "%s/session%s", dir, CANLOG_EXTENSION);
+    snprintf(idx_path, sizeof(idx_path), "%s/session%s", dir, CANLOG_INDEX_EXTENSION);
+
+    size_t count = bus_traffic_generate(&mb_profiles[0], 40, 5, traffic, MAX_FRAMES);
+    while (count > 0 && traffic[count - 1].ts_us >= SESSION_US) count--;
+
+    build(&plain, 0, 5000000, count);
+    build(&compressed, CANLOG_FLAG_COMPRESSED, 5000000, count);
+
+    // An earlier, shorter session of the same format: fewer frames at every sync
+    build(&older, 0, 1000000, count / 3);
+    test_session(&plain, "binary");
+    free(older.data);
+    free(older.frames);
+    free(older.frame_end);
+    build(&older, CANLOG_FLAG_COMPRESSED, 1000000, count / 3);
+    test_session(&compressed, "compressed");
+
+    unlink(log_path);
+    unlink(idx_path);
+    rmdir(dir);
+    return host_test_done("test_canlog_reader");
+}
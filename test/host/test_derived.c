@@ -0,0 +1,257 @@
+// Derived channels (MB_CH_*) against hand-worked and analytical values, with
+// W218 frames built signal by signal: the instantaneous ones (RDU mean speed,
+// L/100 km, wheel and converter slip, gear ratio) including their validity
+// cut-offs and inputs from two messages; the trip integrators over steady and
+// stepped speeds, sub-unit steps carried in the remainder, the >500 ms gap rule
+// and frame timestamps wrapping past 2^32 us; and mercedes_decode_trip_reset()
+// taking effect on the next frame of any message.
+#include "mercedes_decode.h"
+#include "mb_signals.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RDU_PERIOD_US   20000       // RDU_A3 (wheel speeds) cycle
+#define FUEL_PERIOD_US  100000      // GW_C_B9 (fuel consumption) cycle
+
+static const can_profile_t *p;
+static uint8_t payload[MB_MSG_COUNT][8];
+static uint32_t now_us;
+static uint32_t seed = 13;
+
+// Set a signal's raw value in its message's payload
+static void put(uint16_t sig, uint32_t raw) {
+    const can_signal_t *s = &p->signals[sig];
+    uint8_t *data = payload[mb_signal_info[sig].message];
+    uint64_t word = can_signal_load(data);
+    if (s->flags & CAN_SIG_INTEL) word = __builtin_bswap64(word);
+    word = (word & ~((uint64_t)s->mask << s->shift)) | (uint64_t)(raw & s->mask) << s->shift;
+    if (s->flags & CAN_SIG_INTEL) word = __builtin_bswap64(word);
+    word = __builtin_bswap64(word);
+    memcpy(data, &word, sizeof(word));
+}
+
+// The frame of the message carrying sig, at ingest time ts (the tick count follows)
+static void send(uint16_t sig, uint32_t ts) {
+    size_t m = mb_signal_info[sig].message;
+    host_clock_advance_us((uint32_t)(ts - now_us));
+    now_us = ts;
+    mercedes_decode_message(p->messages[m].id, payload[m], 8, ts);
+}
+
+static int32_t get(uint16_t ch) {
+    mercedes_data_t d;
+    int32_t v = INT32_MIN;
+    CHECK(mercedes_decode_snapshot(&d) && mercedes_decode_get_signal(&d, ch, &v));
+    return v;
+}
+
+static void wheels(uint32_t fl, uint32_t fr, uint32_t rl, uint32_t rr) {
+    put(MB_SIG_WS_FL_RDU, fl);
+    put(MB_SIG_WS_FR_RDU, fr);
+    put(MB_SIG_WS_RL_RDU, rl);
+    put(MB_SIG_WS_RR_RDU, rr);
+}
+
+static void reset(uint32_t ts) {
+    CHECK_EQ(mercedes_decode_select_profile("w218"), ESP_OK);
+    mercedes_decode_init();
+    p = &mb_profiles[MB_PROFILE_W218];
+    memset(payload, 0, sizeof(payload));
+    now_us = ts;
+}
+
+static void test_instantaneous(void) {
+    reset(1000000);
+    // RDU mean speed in 0.01 km/h, rear/front slip in per mille
+    wheels(10000, 10050, 10150, 10200);
+    send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+    CHECK_EQ(get(MB_CH_SPEED_KMH_X100), 10100);
+    CHECK_EQ(get(MB_CH_WHEEL_SLIP_PM), (20350 - 20050) * 1000 / 20050);       // 14.96 -> 14
+    wheels(10000, 10000, 10200, 10200);
+    send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+    CHECK_EQ(get(MB_CH_WHEEL_SLIP_PM), 20);
+    wheels(10000, 10000, 9800, 9800);
+    send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+    CHECK_EQ(get(MB_CH_WHEEL_SLIP_PM), -20);
+    wheels(299, 300, 2000, 2000);                   // front under 3 km/h: no slip figure
+    send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+    CHECK_EQ(get(MB_CH_WHEEL_SLIP_PM), 0);
+
+    // 7.2 L/h (500 ul per 250 ms) at 101 km/h: 7.13 L/100 km, in tenths
+    wheels(10100, 10100, 10100, 10100);
+    send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+    put(MB_SIG_FUEL_CONSUMPTION, 500);
+    send(MB_SIG_FUEL_CONSUMPTION, now_us + 1000);
+    CHECK_EQ(get(MB_CH_FUEL_L100KM_X10), 71);
+    // Recomputed from the speed message too, and 0 below 3 km/h
+    wheels(300, 300, 300, 300);
+    send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+    CHECK_EQ(get(MB_CH_FUEL_L100KM_X10), 2400);
+    wheels(299, 299, 299, 299);
+    send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+    CHECK_EQ(get(MB_CH_FUEL_L100KM_X10), 0);
+
+    // Converter slip: engine 2000 rpm (MS_308h), turbine 1906 rpm (GS_338h): 4.7 %
+    put(MB_SIG_NMOT_RPM_RAW, 8000);
+    send(MB_SIG_NMOT_RPM_RAW, now_us + 1000);
+    put(MB_SIG_TURBINE_SPEED_RAW, 7624);
+    put(MB_SIG_TRANS_OUTPUT_RAW, 3812);
+    send(MB_SIG_TURBINE_SPEED_RAW, now_us + 1000);
+    CHECK_EQ(get(MB_CH_CONVERTER_SLIP_PM), 47);
+    CHECK_EQ(get(MB_CH_GEAR_RATIO_X1000), 2000);
+    // An engine frame alone updates it
+    put(MB_SIG_NMOT_RPM_RAW, 7624 * 2);
+    send(MB_SIG_NMOT_RPM_RAW, now_us + 1000);
+    CHECK_EQ(get(MB_CH_CONVERTER_SLIP_PM), 500);
+    put(MB_SIG_NMOT_RPM_RAW, 1599);                 // under 400 rpm
+    send(MB_SIG_NMOT_RPM_RAW, now_us + 1000);
+    CHECK_EQ(get(MB_CH_CONVERTER_SLIP_PM), 0);
+    put(MB_SIG_NMOT_RPM_RAW, 8000);
+    send(MB_SIG_NMOT_RPM_RAW, now_us + 1000);
+    put(MB_SIG_TURBINE_SPEED_RAW, 0xFFFF);          // not available
+    send(MB_SIG_TURBINE_SPEED_RAW, now_us + 1000);
+    CHECK_EQ(get(MB_CH_CONVERTER_SLIP_PM), 0);
+    CHECK_EQ(get(MB_CH_GEAR_RATIO_X1000), 0);
+
+    // Gear ratio cut-offs: output shaft under 10 rpm or not available
+    put(MB_SIG_TURBINE_SPEED_RAW, 8000);
+    put(MB_SIG_TRANS_OUTPUT_RAW, 2857);
+    send(MB_SIG_TURBINE_SPEED_RAW, now_us + 1000);
+    CHECK_EQ(get(MB_CH_GEAR_RATIO_X1000), 2800);    // 2.8002
+    put(MB_SIG_TRANS_OUTPUT_RAW, 39);
+    send(MB_SIG_TURBINE_SPEED_RAW, now_us + 1000);
+    CHECK_EQ(get(MB_CH_GEAR_RATIO_X1000), 0);
+    put(MB_SIG_TRANS_OUTPUT_RAW, 0xFFFF);
+    send(MB_SIG_TURBINE_SPEED_RAW, now_us + 1000);
+    CHECK_EQ(get(MB_CH_GEAR_RATIO_X1000), 0);
+}
+
+typedef struct {
+    uint32_t rdu_first, rdu_last;       // times of the first and last frame of each message
+    uint32_t fuel_first, fuel_last;
+} drive_t;
+
+static uint32_t jitter(uint32_t period) {
+    return period - period / 20 + host_rand(&seed) % (period / 10);
+}
+
+// Wheel-speed and fuel frames at their cycle times with ±5 % jitter, from now
+// for `us`, at the speed and consumption already in the payloads
+static drive_t drive(uint32_t us) {
+    uint32_t start = now_us, rdu = 0, fuel = 0;     // next frame of each, from start
+    drive_t d = {start, start, start, start};
+    while (rdu <= us || fuel <= us) {
+        if (rdu <= us && (rdu <= fuel || fuel > us)) {
+            send(MB_SIG_WS_FL_RDU, start + rdu);
+            d.rdu_last = start + rdu;
+            rdu += jitter(RDU_PERIOD_US);
+        } else {
+            send(MB_SIG_FUEL_CONSUMPTION, start + fuel);
+            d.fuel_last = start + fuel;
+            fuel += jitter(FUEL_PERIOD_US);
+        }
+    }
+    return d;
+}
+
+// The commit's host check: 36 s at 101 km/h and 7.2 L/h, across the 32-bit wrap of the timestamps
+static void test_trip_steady(void) {
+    reset(UINT32_MAX - 10000000u);
+    wheels(10100, 10100, 10100, 10100);
+    put(MB_SIG_FUEL_CONSUMPTION, 500);
+    drive_t d = drive(36000000);
+    CHECK(d.rdu_last < d.rdu_first);                // wrapped
+
+    double s = (uint32_t)(d.rdu_last - d.rdu_first) / 1e6;
+    double m = 101.0 / 3.6 * s;
+    double ml = 7.2 / 3.6 * (uint32_t)(d.fuel_last - d.fuel_first) / 1e6;
+    CHECK_EQ(get(MB_CH_TRIP_DISTANCE_M), (int32_t)floor(m));
+    CHECK_EQ(get(MB_CH_TRIP_FUEL_ML), (int32_t)floor(ml));
+    CHECK_EQ(get(MB_CH_TRIP_TIME_S), (int32_t)floor(s));
+    // The average from the whole millilitres and metres: within the 1/72 a millilitre is of the trip
+    CHECK_EQ(get(MB_CH_TRIP_AVG_L100KM_X10), get(MB_CH_TRIP_FUEL_ML) * 1000 / get(MB_CH_TRIP_DISTANCE_M));
+    CHECK(fabs((double)get(MB_CH_TRIP_AVG_L100KM_X10) - ml / m * 1000) <= ml / m * 1000 / 60);
+    CHECK(abs(get(MB_CH_TRIP_AVG_SPEED_X10) - 1010) <= 1);
+    CHECK_EQ(get(MB_CH_FUEL_L100KM_X10), 71);
+    printf("steady: %.3f s at 101 km/h, 7.2 L/h: %" PRId32 " m (%.2f), %" PRId32 " ml (%.2f), %" PRId32
+           " s, %.1f L/100 km, %.1f km/h\n", s, get(MB_CH_TRIP_DISTANCE_M), m, get(MB_CH_TRIP_FUEL_ML), ml,
+           get(MB_CH_TRIP_TIME_S), get(MB_CH_TRIP_AVG_L100KM_X10) / 10.0, get(MB_CH_TRIP_AVG_SPEED_X10) / 10.0);
+}
+
+// Frames of the wheel-speed message every RDU_PERIOD_US from now, the last at now + us
+static void rdu_frames(uint32_t us) {
+    for (uint32_t t = RDU_PERIOD_US; t <= us; t += RDU_PERIOD_US) send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+}
+
+static void test_trip_integration(void) {
+    // 50 km/h for 18 s, then 120 km/h for 18 s: each interval at the speed of the frame opening it
+    reset(1000000);
+    wheels(5000, 5000, 5000, 5000);
+    send(MB_SIG_WS_FL_RDU, now_us);
+    rdu_frames(18000000 - RDU_PERIOD_US);
+    wheels(12000, 12000, 12000, 12000);
+    send(MB_SIG_WS_FL_RDU, now_us + RDU_PERIOD_US);
+    rdu_frames(18000000);
+    CHECK_EQ(get(MB_CH_TRIP_DISTANCE_M), 250 + 600);
+    CHECK_EQ(get(MB_CH_TRIP_TIME_S), 36);
+    CHECK_EQ(get(MB_CH_TRIP_AVG_SPEED_X10), 850);
+
+    // The reset lands with the next frame, whichever message it is
+    mercedes_decode_trip_reset();
+    CHECK_EQ(get(MB_CH_TRIP_DISTANCE_M), 850);
+    uint32_t dirty[MB_DIRTY_WORDS];
+    mercedes_decode_fetch_dirty(dirty);
+    send(MB_SIG_FUEL_CONSUMPTION, now_us);
+    mercedes_decode_fetch_dirty(dirty);
+    for (uint16_t ch = MB_CH_TRIP_DISTANCE_M; ch <= MB_CH_TRIP_AVG_SPEED_X10; ch++) {
+        CHECK_EQ(get(ch), 0);
+        CHECK(MB_DIRTY_TEST(dirty, ch));
+    }
+    // and the trip starts from the last wheel-speed frame: 3 s at 120 km/h
+    rdu_frames(3000000);
+    CHECK_EQ(get(MB_CH_TRIP_DISTANCE_M), 100);
+    CHECK_EQ(get(MB_CH_TRIP_TIME_S), 3);
+
+    // 3.6 km/h is 2 cm per frame: only the remainder carried between frames adds up to metres
+    reset(1000000);
+    wheels(360, 360, 360, 360);
+    send(MB_SIG_WS_FL_RDU, now_us);
+    rdu_frames(100000000);
+    CHECK_EQ(get(MB_CH_TRIP_DISTANCE_M), 100);
+    CHECK_EQ(get(MB_CH_TRIP_TIME_S), 100);
+    CHECK_EQ(get(MB_CH_TRIP_AVG_SPEED_X10), 36);
+
+    // Gaps: exactly 500 ms is still integrated, 501 ms (bus asleep) is not
+    reset(1000000);
+    wheels(10000, 10000, 10000, 10000);
+    send(MB_SIG_WS_FL_RDU, now_us);
+    rdu_frames(10000000);
+    send(MB_SIG_WS_FL_RDU, now_us + 500000);
+    send(MB_SIG_WS_FL_RDU, now_us + 501000);
+    rdu_frames(10000000);
+    CHECK_EQ(get(MB_CH_TRIP_DISTANCE_M), 569);      // 20.5 s at 100 km/h: 569.4 m
+    CHECK_EQ(get(MB_CH_TRIP_TIME_S), 20);
+    CHECK_EQ(get(MB_CH_TRIP_AVG_SPEED_X10), 999);   // 569 m over 20.5 s, not 20 s
+    send(MB_SIG_WS_FL_RDU, now_us + 60000000);     // a minute parked
+    CHECK_EQ(get(MB_CH_TRIP_TIME_S), 20);
+
+    // Fuel: 7.2 L/h is 2 ml/s; a fuel frame with no wheel speed yet gives no average
+    reset(1000000);
+    put(MB_SIG_FUEL_CONSUMPTION, 500);
+    send(MB_SIG_FUEL_CONSUMPTION, now_us);
+    for (int i = 0; i < 100; i++) send(MB_SIG_FUEL_CONSUMPTION, now_us + FUEL_PERIOD_US);
+    CHECK_EQ(get(MB_CH_TRIP_FUEL_ML), 20);
+    CHECK_EQ(get(MB_CH_TRIP_AVG_L100KM_X10), 0);
+}
+
+int main(void) {
+    host_clock_manual(1000000);
+    test_instantaneous();
+    test_trip_steady();
+    test_trip_integration();
+    return host_test_done("test_derived");
+}
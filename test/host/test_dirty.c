@@ -0,0 +1,244 @@
+// Changed-channel tracking: after every frame of W218 traffic (bus_traffic.c,
+// with each frame now and then sent twice) the dirty bits fetched must be
+// exactly the channels whose value in a snapshot changed - none for a frame
+// repeated at the same time - and a second fetch must find none. A watch on a
+// few signal and derived channels calls back once per changed watched channel
+// and never for the others, wakes its task once per frame with such a change,
+// and both happen after the seqlock write: a snapshot taken in the callback,
+// or by a woken task on another thread, already holds the frame's values.
+#include "mercedes_decode.h"
+#include "mb_signals.h"
+#include "bus_traffic.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define MAX_FRAMES  40000
+#define START_US    1000000
+
+static bus_frame_t frames[MAX_FRAMES];
+static size_t count;
+static uint32_t seed = 10;
+
+// Channels decoded from frames (UDS channels are posted, not decoded)
+#define FRAME_CHANNELS MB_CH_UDS_FIRST
+
+static int32_t value(const mercedes_data_t *d, uint16_t ch) {
+    int32_t v = 0;
+    mercedes_decode_get_signal(d, ch, &v);
+    return v;
+}
+
+static void changed_between(const mercedes_data_t *a, const mercedes_data_t *b, uint32_t *out) {
+    memset(out, 0, MB_DIRTY_WORDS * sizeof(uint32_t));
+    for (uint16_t ch = 0; ch < FRAME_CHANNELS; ch++) {
+        if (value(a, ch) != value(b, ch)) out[ch / 32] |= 1u << (ch % 32);
+    }
+}
+
+static void start(void) {
+    host_clock_manual(START_US);
+    CHECK_EQ(mercedes_decode_select_profile("w218"), ESP_OK);
+    mercedes_decode_init();
+}
+
+static void feed(const bus_frame_t *f) {
+    int64_t at = START_US + f->ts_us;
+    if (at > esp_timer_get_time()) host_clock_advance_us(at - esp_timer_get_time());
+    mercedes_decode_message(f->id, f->data, f->dlc, (uint32_t)at);
+}
+
+static void test_dirty_bits(void) {
+    start();
+    uint32_t dirty[MB_DIRTY_WORDS], want[MB_DIRTY_WORDS];
+    mercedes_decode_fetch_dirty(dirty);
+    static mercedes_data_t before, after;
+    CHECK(mercedes_decode_snapshot(&before));
+
+    uint32_t frames_fed = 0, repeats = 0, repeat_bits = 0, wrong = 0, set = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool repeat = host_rand(&seed) % 8 == 0;
+        for (int pass = 0; pass < 1 + repeat; pass++) {
+            feed(&frames[i]);
+            frames_fed++;
+            CHECK(mercedes_decode_snapshot(&after));
+            mercedes_decode_fetch_dirty(dirty);
+            changed_between(&before, &after, want);
+            for (int w = 0; w < MB_DIRTY_WORDS; w++) {
+                if (dirty[w] != want[w] && wrong++ < 5) {
+                    fprintf(stderr, "frame %zu (0x%03" PRIX32 "): dirty word %d %08" PRIX32 ", changed %08" PRIX32 "\n",
+                            i, frames[i].id, w, dirty[w], want[w]);
+                }
+                set += (uint32_t)__builtin_popcount(dirty[w]);
+            }
+            // The same frame at the same time again: nothing decodes differently, trip integrators included
+            if (pass == 1) {
+                repeats++;
+                for (int w = 0; w < MB_DIRTY_WORDS; w++) repeat_bits += (uint32_t)__builtin_popcount(dirty[w]);
+            }
+            before = after;
+        }
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(repeat_bits, 0);
+    CHECK(repeats > 1000);
+    CHECK(set > 0);
+
+    // Fetching clears; bits of several frames accumulate until fetched
+    mercedes_decode_fetch_dirty(dirty);
+    for (int w = 0; w < MB_DIRTY_WORDS; w++) CHECK_EQ(dirty[w], 0);
+    static mercedes_data_t first;
+    first = after;
+    for (size_t i = 0; i < 50; i++) {
+        bus_frame_t f = frames[i];
+        f.ts_us = frames[count - 1].ts_us + 1000 * (uint32_t)(i + 1);
+        f.data[0] ^= (uint8_t)(1 + i);
+        feed(&f);
+    }
+    CHECK(mercedes_decode_snapshot(&after));
+    mercedes_decode_fetch_dirty(dirty);
+    changed_between(&first, &after, want);
+    // A superset: a channel that changed and changed back still reports
+    for (int w = 0; w < MB_DIRTY_WORDS; w++) CHECK_EQ(dirty[w] & want[w], want[w]);
+    CHECK(want[0] != 0);
+    printf("dirty: %" PRIu32 " frames, %" PRIu32 " bits all matching the changed channels; "
+           "%" PRIu32 " repeated frames set none\n", frames_fed, set, repeats);
+}
+
+// === Watch ===
+
+static const uint16_t watched[] = {MB_SIG_NMOT_RPM_RAW, MB_SIG_WS_FL_RDU, MB_CH_SPEED_KMH_X100,
+                                   MB_CH_GEAR_RATIO_X1000, MB_CH_TRIP_DISTANCE_M};
+#define NUM_WATCHED (sizeof(watched) / sizeof(watched[0]))
+
+static struct {
+    uint32_t calls[MB_CH_COUNT];        // this frame
+    mercedes_data_t seen;
+    bool have_seen;
+} cb_state;
+
+static bool is_watched(uint16_t ch) {
+    for (size_t k = 0; k < NUM_WATCHED; k++) {
+        if (watched[k] == ch) return true;
+    }
+    return false;
+}
+
+static void on_change(uint16_t ch, void *arg) {
+    CHECK(arg == &cb_state);
+    cb_state.calls[ch]++;
+    if (!cb_state.have_seen) {
+        // Taken before the seqlock write ended it would fail (sequence odd) or miss the frame
+        CHECK(mercedes_decode_snapshot(&cb_state.seen));
+        cb_state.have_seen = true;
+    }
+}
+
+static void test_watch_callback(void) {
+    start();
+    uint16_t bad = MB_CH_COUNT;
+    CHECK_EQ(mercedes_decode_watch(&bad, 1, NULL, NULL, NULL), ESP_ERR_INVALID_ARG);
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    CHECK_EQ(mercedes_decode_watch(watched, NUM_WATCHED, self, on_change, &cb_state), ESP_OK);
+    while (ulTaskNotifyTake(pdTRUE, 0) > 0) {}
+
+    static mercedes_data_t before, after;
+    CHECK(mercedes_decode_snapshot(&before));
+    uint32_t calls = 0, wrong = 0, notified = 0, want_notified = 0, stale = 0;
+    for (size_t i = 0; i < count; i++) {
+        memset(&cb_state, 0, sizeof(cb_state));
+        feed(&frames[i]);
+        CHECK(mercedes_decode_snapshot(&after));
+        uint32_t changed[MB_DIRTY_WORDS];
+        changed_between(&before, &after, changed);
+        bool any = false;
+        for (uint16_t ch = 0; ch < MB_CH_COUNT; ch++) {
+            uint32_t want = is_watched(ch) && MB_DIRTY_TEST(changed, ch);
+            any |= want;
+            calls += cb_state.calls[ch];
+            if (cb_state.calls[ch] != want) wrong++;
+        }
+        if (cb_state.have_seen && memcmp(&cb_state.seen, &after, sizeof(after)) != 0) stale++;
+        want_notified += any;
+        notified += ulTaskNotifyTake(pdTRUE, 0);
+        before = after;
+    }
+    CHECK_EQ(mercedes_decode_watch(NULL, 0, NULL, NULL, NULL), ESP_OK);
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(stale, 0);
+    CHECK(calls > 0);
+    CHECK_EQ(notified, want_notified);
+    printf("watch: %" PRIu32 " callbacks for %zu watched of %d channels, task woken for %" PRIu32
+           " of %zu frames, each snapshot in the callback holding its frame\n",
+           calls, NUM_WATCHED, MB_CH_COUNT, notified, count);
+}
+
+// A task on another thread woken by the watch: the snapshot it takes holds the
+// frame that woke it, whose engine speed is the frame number
+static atomic_uint acked;
+static atomic_uint wrong_wakeups;
+static atomic_bool watcher_done;
+
+static void watcher_task(void *arg) {
+    while (!atomic_load(&watcher_done)) {
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100)) == 0) continue;
+        static mercedes_data_t d;
+        int32_t rpm = -1;
+        unsigned want = atomic_load(&acked) + 1;
+        if (!mercedes_decode_snapshot(&d) || !mercedes_decode_get_signal(&d, MB_SIG_NMOT_RPM_RAW, &rpm) ||
+            (uint32_t)rpm != want) {
+            atomic_fetch_add(&wrong_wakeups, 1);
+        }
+        atomic_store(&acked, want);
+    }
+    vTaskDelete(NULL);
+}
+
+// The frame of the message carrying sig with its raw value set (all else 0)
+static void encode(uint16_t sig, uint32_t raw, uint8_t *data) {
+    const can_signal_t *s = &mb_profiles[MB_PROFILE_W218].signals[sig];
+    uint64_t word = (uint64_t)(raw & s->mask) << s->shift;
+    if (s->flags & CAN_SIG_INTEL) word = __builtin_bswap64(word);
+    word = __builtin_bswap64(word);
+    memcpy(data, &word, sizeof(word));
+}
+
+static void test_watch_task(void) {
+    start();
+    TaskHandle_t watcher;
+    CHECK_EQ(xTaskCreate(watcher_task, "watcher", 4096, NULL, 5, &watcher), pdPASS);
+    const uint16_t rpm = MB_SIG_NMOT_RPM_RAW;
+    CHECK_EQ(mercedes_decode_watch(&rpm, 1, watcher, NULL, NULL), ESP_OK);
+
+    const can_profile_t *p = &mb_profiles[MB_PROFILE_W218];
+    uint32_t id = p->messages[mb_signal_info[rpm].message].id;
+    uint8_t data[8];
+    const uint32_t rounds = 20000;
+    uint32_t ts = START_US;
+    for (uint32_t n = 1; n <= rounds; n++) {
+        encode(rpm, n, data);
+        mercedes_decode_message(id, data, 8, ts += 20000);
+        // The same frame again changes nothing and must not wake it a second time
+        mercedes_decode_message(id, data, 8, ts += 20000);
+        while (atomic_load(&acked) < n) sched_yield();
+    }
+    atomic_store(&watcher_done, true);
+    CHECK_EQ(mercedes_decode_watch(NULL, 0, NULL, NULL, NULL), ESP_OK);
+    CHECK_EQ(atomic_load(&wrong_wakeups), 0);
+    CHECK_EQ(atomic_load(&acked), rounds);
+    printf("watch task: %" PRIu32 " wakeups on another thread, each snapshot holding its frame\n", rounds);
+}
+
+int main(void) {
+    count = bus_traffic_generate(&mb_profiles[MB_PROFILE_W218], 0, 10, frames, MAX_FRAMES);
+    test_dirty_bits();
+    test_watch_callback();
+    test_watch_task();
+    return host_test_done("test_dirty");
+}
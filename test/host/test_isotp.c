@@ -0,0 +1,365 @@
+// isotp against a scripted ECU: the test plays the ECU frame by frame, so the
+// link under test is checked against the wire format rather than against
+// itself. Receive and transmit of single, first, consecutive and flow control
+// frames, block size and STmin in both directions, overflow, a bad sequence
+// number, the N_Cr and N_Bs timeouts and two sessions interleaved. Then
+// throughput: payload rate on a simulated 500 kbit/s bus for a 40-DTC answer
+// and a 4095-byte message under several flow control settings, and the CPU
+// cost of isotp_on_frame() per frame.
+#include "isotp.h"
+#include "can_driver.h"
+#include "host_test.h"
+#include <string.h>
+
+#define FRAME_US 222        // 8-byte standard frame at 500 kbit/s, with stuffing
+
+// Frames the links under test sent
+static can_message_t sent[64];
+static size_t num_sent;
+
+esp_err_t can_send_message(const can_message_t *msg) {
+    if (num_sent < sizeof(sent) / sizeof(sent[0])) sent[num_sent++] = *msg;
+    return ESP_OK;
+}
+
+static const uint8_t *take_sent(void) {
+    static can_message_t last;
+    CHECK(num_sent > 0);
+    last = sent[0];
+    memmove(&sent[0], &sent[1], (num_sent - 1) * sizeof(sent[0]));
+    num_sent--;
+    return last.data;
+}
+
+static void pattern(uint8_t *buf, size_t len, uint8_t seed) {
+    for (size_t i = 0; i < len; i++) buf[i] = (uint8_t)(i * 31 + seed);
+}
+
+// ECU frames: single, first (bytes 0..5), consecutive (7 bytes from offset)
+static void ecu_single(uint8_t *f, const uint8_t *msg, size_t len) {
+    memset(f, 0xAA, 8);
+    f[0] = (uint8_t)len;
+    memcpy(&f[1], msg, len);
+}
+
+static void ecu_first(uint8_t *f, const uint8_t *msg, size_t len) {
+    f[0] = (uint8_t)(0x10 | (len >> 8));
+    f[1] = (uint8_t)len;
+    memcpy(&f[2], msg, 6);
+}
+
+static void ecu_consecutive(uint8_t *f, const uint8_t *msg, size_t len, size_t offset, uint8_t seq) {
+    memset(f, 0xAA, 8);
+    f[0] = (uint8_t)(0x20 | (seq & 0x0F));
+    memcpy(&f[1], &msg[offset], len - offset < 7 ? len - offset : 7);
+}
+
+/**
+ * The ECU sends msg to the tester link on the simulated bus, pacing
+ * consecutive frames by the tester's flow control
+ * @param fcs Output: flow control frames the tester sent
+ * @return Bus time from the first frame to the last (us), -1 on a protocol error
+ */
+static int64_t ecu_send(isotp_link_t *tester, const uint8_t *msg, size_t len, uint32_t *fcs) {
+    uint8_t f[8];
+    int64_t t = FRAME_US;
+    *fcs = 0;
+    num_sent = 0;
+    if (len <= 7) {
+        ecu_single(f, msg, len);
+        return isotp_on_frame(tester, f, 8, t) == ESP_OK ? t : -1;
+    }
+    ecu_first(f, msg, len);
+    if (isotp_on_frame(tester, f, 8, t) != ESP_ERR_NOT_FINISHED) return -1;
+
+    size_t offset = 6;
+    uint8_t seq = 1;
+    int64_t last_cf = 0;
+    for (;;) {
+        // Flow control from the tester: continue, block size, STmin
+        if (num_sent != 1) return -1;
+        const uint8_t *fc = take_sent();
+        if (fc[0] != 0x30) return -1;
+        (*fcs)++;
+        t += FRAME_US;
+        uint8_t bs = fc[1];
+        int64_t st = isotp_st_min_us(fc[2]);
+
+        for (unsigned k = 0; bs == 0 || k < bs; k++) {
+            int64_t start = offset > 6 && last_cf + st > t ? last_cf + st : t;
+            last_cf = start;
+            t = start + FRAME_US;
+            ecu_consecutive(f, msg, len, offset, seq++);
+            offset += 7;
+            esp_err_t ret = isotp_on_frame(tester, f, 8, t);
+            if (offset >= len) return ret == ESP_OK ? t : -1;
+            if (ret != ESP_ERR_NOT_FINISHED) return -1;
+        }
+    }
+}
+
+static isotp_link_t tester;
+static uint8_t rx_buf[ISOTP_MAX_LEN];
+static uint8_t msg[ISOTP_MAX_LEN];
+
+static void tester_init(uint8_t bs, uint8_t st_min, size_t buf_size) {
+    isotp_config_t config = {bs, st_min};
+    isotp_link_init(&tester, 0x7E0, 0x7E8, &config);
+    isotp_rx_start(&tester, rx_buf, buf_size);
+    num_sent = 0;
+}
+
+static void test_receive(void) {
+    uint32_t fcs;
+
+    // Single frame: a Mode 01 answer
+    tester_init(0, 0, sizeof(rx_buf));
+    static const uint8_t speed[] = {0x41, 0x0D, 0x58};
+    CHECK(ecu_send(&tester, speed, sizeof(speed), &fcs) > 0);
+    CHECK_EQ(tester.rx_len, 3);
+    CHECK(!tester.rx_multi_frame);
+    CHECK(memcmp(rx_buf, speed, 3) == 0);
+    CHECK_EQ(num_sent, 0);
+
+    // First + consecutive frames, one flow control without a block limit
+    pattern(msg, 100, 1);
+    tester_init(0, 0, sizeof(rx_buf));
+    CHECK(ecu_send(&tester, msg, 100, &fcs) > 0);
+    CHECK_EQ(fcs, 1);
+    CHECK_EQ(tester.rx_len, 100);
+    CHECK(tester.rx_multi_frame);
+    CHECK_EQ(tester.rx_state, ISOTP_RX_DONE);
+    CHECK(memcmp(rx_buf, msg, 100) == 0);
+
+    // Block size 4: a flow control after the first frame and every 4 consecutive frames
+    tester_init(4, 0xF5, sizeof(rx_buf));
+    CHECK(ecu_send(&tester, msg, 100, &fcs) > 0);  // 14 consecutive frames
+    CHECK_EQ(fcs, 4);
+    CHECK(memcmp(rx_buf, msg, 100) == 0);
+
+    // Sequence numbers wrap after 15
+    pattern(msg, 300, 2);
+    tester_init(0, 0, sizeof(rx_buf));
+    CHECK(ecu_send(&tester, msg, 300, &fcs) > 0);
+    CHECK(memcmp(rx_buf, msg, 300) == 0);
+}
+
+static void test_receive_errors(void) {
+    uint8_t f[8];
+    pattern(msg, 40, 3);
+
+    // Longer than the buffer: refused with an overflow flow control
+    tester_init(0, 0, 32);
+    ecu_first(f, msg, 40);
+    CHECK_EQ(isotp_on_frame(&tester, f, 8, 0), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(tester.rx_state, ISOTP_ERROR);
+    CHECK_EQ(num_sent, 1);
+    CHECK_EQ(take_sent()[0], 0x32);
+
+    // Bad sequence number: the message is dropped
+    tester_init(0, 0, sizeof(rx_buf));
+    ecu_first(f, msg, 40);
+    CHECK_EQ(isotp_on_frame(&tester, f, 8, 0), ESP_ERR_NOT_FINISHED);
+    ecu_consecutive(f, msg, 40, 6, 1);
+    CHECK_EQ(isotp_on_frame(&tester, f, 8, 1000), ESP_ERR_NOT_FINISHED);
+    ecu_consecutive(f, msg, 40, 20, 3);
+    CHECK_EQ(isotp_on_frame(&tester, f, 8, 2000), ESP_ERR_INVALID_RESPONSE);
+    CHECK_EQ(tester.rx_state, ISOTP_ERROR);
+
+    // A consecutive frame with no transfer in progress, a short first frame
+    tester_init(0, 0, sizeof(rx_buf));
+    ecu_consecutive(f, msg, 40, 6, 1);
+    CHECK_EQ(isotp_on_frame(&tester, f, 8, 0), ESP_ERR_INVALID_RESPONSE);
+    ecu_first(f, msg, 40);
+    CHECK_EQ(isotp_on_frame(&tester, f, 6, 0), ESP_ERR_INVALID_RESPONSE);
+
+    // N_Cr: the ECU stops sending consecutive frames
+    tester_init(0, 0, sizeof(rx_buf));
+    ecu_first(f, msg, 40);
+    CHECK_EQ(isotp_on_frame(&tester, f, 8, 0), ESP_ERR_NOT_FINISHED);
+    ecu_consecutive(f, msg, 40, 6, 1);
+    CHECK_EQ(isotp_on_frame(&tester, f, 8, 5000), ESP_ERR_NOT_FINISHED);
+    int64_t expiry = 5000 + ISOTP_N_CR_MS * 1000LL;
+    CHECK_EQ(isotp_next_poll_us(&tester), expiry);
+    CHECK_EQ(isotp_poll(&tester, expiry - 1), ESP_OK);
+    CHECK_EQ(isotp_poll(&tester, expiry), ESP_ERR_TIMEOUT);
+    CHECK_EQ(tester.rx_state, ISOTP_ERROR);
+}
+
+// Consecutive frames the tester sent, appended to out from offset; returns the new offset
+static size_t collect_consecutive(uint8_t *out, size_t len, size_t offset, uint8_t *seq) {
+    while (num_sent > 0) {
+        const uint8_t *f = take_sent();
+        CHECK_EQ(f[0], 0x20 | (*seq & 0x0F));
+        (*seq)++;
+        size_t n = len - offset < 7 ? len - offset : 7;
+        memcpy(&out[offset], &f[1], n);
+        offset += n;
+    }
+    return offset;
+}
+
+static void test_transmit(void) {
+    static uint8_t got[ISOTP_MAX_LEN];
+
+    // Single frame: a UDS request
+    tester_init(0, 0, sizeof(rx_buf));
+    static const uint8_t req[] = {0x22, 0x20, 0x01};
+    CHECK_EQ(isotp_send(&tester, req, sizeof(req), 0), ESP_OK);
+    CHECK_EQ(tester.tx_state, ISOTP_TX_DONE);
+    const uint8_t *f = take_sent();
+    CHECK(f[0] == 0x03 && f[1] == 0x22 && f[3] == 0x01);
+
+    // 60 bytes: the ECU asks for blocks of 2 frames 10 ms apart, then the rest at 300 us
+    pattern(msg, 60, 4);
+    tester_init(0, 0, sizeof(rx_buf));
+    CHECK_EQ(isotp_send(&tester, msg, 60, 0), ESP_OK);
+    CHECK_EQ(tester.tx_state, ISOTP_TX_WAIT_FC);
+    f = take_sent();
+    CHECK(f[0] == 0x10 && f[1] == 60);
+    memcpy(got, &f[2], 6);
+
+    const uint8_t fc_block[3] = {0x30, 2, 10};
+    CHECK_EQ(isotp_on_frame(&tester, fc_block, 3, 1000), ESP_ERR_NOT_FINISHED);
+    CHECK_EQ(num_sent, 1);                          // the first at once
+    CHECK_EQ(isotp_next_poll_us(&tester), 11000);   // the next after STmin
+    CHECK_EQ(isotp_poll(&tester, 10999), ESP_OK);
+    CHECK_EQ(num_sent, 1);
+    CHECK_EQ(isotp_poll(&tester, 11000), ESP_OK);
+    CHECK_EQ(num_sent, 2);
+    CHECK_EQ(tester.tx_state, ISOTP_TX_WAIT_FC);    // block done
+    uint8_t seq = 1;
+    size_t offset = collect_consecutive(got, 60, 6, &seq);
+
+    // Wait, then continue without a block limit
+    const uint8_t fc_wait[3] = {0x31, 0, 0};
+    CHECK_EQ(isotp_on_frame(&tester, fc_wait, 3, 12000), ESP_ERR_NOT_FINISHED);
+    CHECK_EQ(num_sent, 0);
+    const uint8_t fc_rest[3] = {0x30, 0, 0xF3};
+    CHECK_EQ(isotp_on_frame(&tester, fc_rest, 3, 13000), ESP_ERR_NOT_FINISHED);
+    for (int64_t t = 13000; tester.tx_state == ISOTP_TX_BUSY; t += 100) {
+        CHECK_EQ(isotp_poll(&tester, t), ESP_OK);
+        if (num_sent > 0) CHECK_EQ((t - 13000) % 300, 0);
+        offset = collect_consecutive(got, 60, offset, &seq);
+    }
+    CHECK_EQ(tester.tx_state, ISOTP_TX_DONE);
+    CHECK_EQ(offset, 60);
+    CHECK(memcmp(got, msg, 60) == 0);
+
+    // The ECU refuses the length
+    tester_init(0, 0, sizeof(rx_buf));
+    CHECK_EQ(isotp_send(&tester, msg, 60, 0), ESP_OK);
+    num_sent = 0;
+    const uint8_t fc_overflow[3] = {0x32, 0, 0};
+    CHECK_EQ(isotp_on_frame(&tester, fc_overflow, 3, 1000), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(tester.tx_state, ISOTP_ERROR);
+
+    // N_Bs: no flow control comes, also not after a block
+    tester_init(0, 0, sizeof(rx_buf));
+    CHECK_EQ(isotp_send(&tester, msg, 60, 0), ESP_OK);
+    CHECK_EQ(isotp_send(&tester, msg, 60, 0), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(isotp_poll(&tester, ISOTP_N_BS_MS * 1000LL - 1), ESP_OK);
+    CHECK_EQ(isotp_poll(&tester, ISOTP_N_BS_MS * 1000LL), ESP_ERR_TIMEOUT);
+    CHECK_EQ(tester.tx_state, ISOTP_ERROR);
+
+    tester_init(0, 0, sizeof(rx_buf));
+    CHECK_EQ(isotp_send(&tester, msg, 60, 0), ESP_OK);
+    const uint8_t fc_one[3] = {0x30, 1, 0};
+    CHECK_EQ(isotp_on_frame(&tester, fc_one, 3, 1000), ESP_ERR_NOT_FINISHED);
+    CHECK_EQ(tester.tx_state, ISOTP_TX_WAIT_FC);
+    CHECK_EQ(isotp_poll(&tester, 1000 + ISOTP_N_BS_MS * 1000LL), ESP_ERR_TIMEOUT);
+    CHECK_EQ(isotp_send(&tester, msg, 60, 0), ESP_OK);  // a new send after the error
+}
+
+// Two ECUs answering at once, frames interleaved, each on its own link
+static void test_concurrent(void) {
+    static uint8_t buf_a[128], buf_b[128], msg_b[128];
+    isotp_link_t a, b;
+    isotp_link_init(&a, 0x7E0, 0x7E8, NULL);
+    isotp_link_init(&b, 0x7E1, 0x7E9, NULL);
+    isotp_rx_start(&a, buf_a, sizeof(buf_a));
+    isotp_rx_start(&b, buf_b, sizeof(buf_b));
+    pattern(msg, 50, 5);
+    pattern(msg_b, 90, 6);
+    num_sent = 0;
+
+    uint8_t f[8];
+    ecu_first(f, msg, 50);
+    CHECK_EQ(isotp_on_frame(&a, f, 8, 0), ESP_ERR_NOT_FINISHED);
+    ecu_first(f, msg_b, 90);
+    CHECK_EQ(isotp_on_frame(&b, f, 8, 100), ESP_ERR_NOT_FINISHED);
+    CHECK_EQ(num_sent, 2);
+    CHECK_EQ(sent[0].identifier, 0x7E0);
+    CHECK_EQ(sent[1].identifier, 0x7E1);
+
+    size_t off_a = 6, off_b = 6;
+    uint8_t seq_a = 1, seq_b = 1;
+    esp_err_t ra = ESP_ERR_NOT_FINISHED, rb = ESP_ERR_NOT_FINISHED;
+    for (int64_t t = 1000; off_a < 50 || off_b < 90; t += 500) {
+        if (off_a < 50) {
+            ecu_consecutive(f, msg, 50, off_a, seq_a++);
+            off_a += 7;
+            ra = isotp_on_frame(&a, f, 8, t);
+        }
+        if (off_b < 90) {
+            ecu_consecutive(f, msg_b, 90, off_b, seq_b++);
+            off_b += 7;
+            rb = isotp_on_frame(&b, f, 8, t);
+        }
+    }
+    CHECK_EQ(ra, ESP_OK);
+    CHECK_EQ(rb, ESP_OK);
+    CHECK(a.rx_len == 50 && memcmp(buf_a, msg, 50) == 0);
+    CHECK(b.rx_len == 90 && memcmp(buf_b, msg_b, 90) == 0);
+}
+
+static void test_throughput(void) {
+    static const struct {
+        uint8_t bs, st_min;
+        const char *label;
+    } configs[] = {
+        {0, 0, "BS 0, STmin 0"},
+        {8, 0, "BS 8, STmin 0"},
+        {0, 0xF5, "BS 0, STmin 500us"},
+        {0, 1, "BS 0, STmin 1ms"},
+    };
+    static const size_t lengths[] = {82, ISOTP_MAX_LEN};     // 40 DTCs (Mode 03), largest
+
+    for (size_t l = 0; l < 2; l++) {
+        size_t len = lengths[l];
+        pattern(msg, len, 7);
+        for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+            uint32_t fcs;
+            tester_init(configs[c].bs, configs[c].st_min, sizeof(rx_buf));
+            int64_t bus_us = ecu_send(&tester, msg, len, &fcs);
+            CHECK(bus_us > 0);
+            CHECK(memcmp(rx_buf, msg, len) == 0);
+            printf("%4zu bytes, %-18s %7.1f ms on the bus, %6.1f kB/s, %3u flow controls\n",
+                   len, configs[c].label, bus_us / 1000.0, len * 1000.0 / bus_us, (unsigned)fcs);
+        }
+    }
+
+    // CPU per received frame: the 4095-byte message, frames built beforehand
+    enum { CFS = (ISOTP_MAX_LEN - 6 + 6) / 7, REPEATS = 2000 };
+    static uint8_t frames[CFS + 1][8];
+    ecu_first(frames[0], msg, ISOTP_MAX_LEN);
+    for (int k = 0; k < CFS; k++) ecu_consecutive(frames[k + 1], msg, ISOTP_MAX_LEN, 6 + 7 * k, (uint8_t)(k + 1));
+    uint64_t t0 = host_now_ns();
+    int complete = 0;
+    for (int r = 0; r < REPEATS; r++) {
+        tester_init(0, 0, sizeof(rx_buf));
+        for (int k = 0; k <= CFS; k++) complete += isotp_on_frame(&tester, frames[k], 8, k * FRAME_US) == ESP_OK;
+    }
+    double ns = (double)(host_now_ns() - t0) / ((double)REPEATS * (CFS + 1));
+    CHECK_EQ(complete, REPEATS);
+    printf("isotp_on_frame: %.1f ns per frame (%.0f MB/s reassembly)\n", ns, 7e3 / ns);
+}
+
+int main(void) {
+    test_receive();
+    test_receive_errors();
+    test_transmit();
+    test_concurrent();
+    test_throughput();
+    return host_test_done("test_isotp");
+}
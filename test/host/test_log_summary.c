@@ -0,0 +1,351 @@
+// The per-minute summary sidecar (.sum) of an SD session. First sd_logger's
+// rows from samples placed on the manual clock: minute boundaries to the
+// microsecond, minutes without samples left out, signals without samples all
+// zero, min/max/sample counts and the mean rounded half away from zero, checked
+// against a double-precision reference. Then the firmware path end to end: W218
+// traffic (bus_traffic.c) through can_driver's processing stage on the manual
+// clock, which samples CAN_LOG_SUMMARY_SIGNALS once a second while they are not
+// stale, with the instrument cluster (ambient temperature, raw x 0.5 - 40) silent
+// for 21 s across a minute boundary. tools/logsummary.py must rebuild the same
+// file, byte for byte, from the session log.
+// sd_logger.c and can_driver.c are compiled into this test for their statics;
+// both name their log tag TAG.
+#define TAG SD_TAG
+#include "sd_logger.c"
+#undef TAG
+#include "can_driver.c"
+#include "mb_signals.h"
+#include "bus_traffic.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define START_US        1000000
+#define MINUTE_US       (SD_LOG_SUMMARY_PERIOD_S * 1000000LL)
+#define MAX_ROWS        16
+#define TRAFFIC_US      150000000u          // 2.5 minutes
+#define MAX_FRAMES      200000
+#define PROC_PERIOD_US  100000              // can_proc_task's wakeup on a quiet bus
+#define GAP_FROM_US     50500000u           // instrument cluster silent from here...
+#define GAP_TO_US       71500000u           // ...to here
+
+typedef struct {
+    sd_log_summary_header_t hdr;
+    sd_log_summary_signal_t sig[SD_LOG_SUMMARY_MAX_SIGNALS];
+    uint32_t rows;
+    uint32_t minute[MAX_ROWS];
+    sd_log_summary_value_t v[MAX_ROWS][SD_LOG_SUMMARY_MAX_SIGNALS];
+} summary_file_t;
+
+static bus_frame_t traffic[MAX_FRAMES];
+static char path[sizeof(session_filename)];
+static char summary_path[sizeof(session_summary_filename)];
+
+static void clock_to(int64_t t) {
+    int64_t now = esp_timer_get_time();
+    if (t > now) host_clock_advance_us(t - now);
+}
+
+// Room in the log queue for a frame and a second's samples: a drop here would not be the logger's doing
+static void wait_for_writer(void) {
+    while (uxQueueMessagesWaiting(log_queue) > LOG_QUEUE_SIZE - 8) usleep(50);
+}
+
+static void end_session(void) {
+    snprintf(path, sizeof(path), "%s", session_filename);
+    snprintf(summary_path, sizeof(summary_path), "%s", session_summary_filename);
+    clock_to((int64_t)session_start_us + MIN_SESSION_SECONDS * 1000000LL);
+    sd_logger_end_session();
+}
+
+static void remove_session(void) {
+    unlink(path);
+    unlink(summary_path);
+    char index[sizeof(path)];
+    snprintf(index, sizeof(index), "%.*s%s", (int)(strlen(path) - strlen(CANLOG_EXTENSION)), path,
+             CANLOG_INDEX_EXTENSION);
+    unlink(index);
+}
+
+static uint8_t *read_file(const char *name, size_t *len) {
+    FILE *f = fopen(name, "rb");
+    if (f == NULL) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    uint8_t *data = malloc(*len + 1);
+    fseek(f, 0, SEEK_SET);
+    if (fread(data, 1, *len, f) != *len) *len = 0;
+    fclose(f);
+    return data;
+}
+
+// Parse a .sum with the checks main.c's loader makes before it uses the rows
+static bool read_summary(const char *name, summary_file_t *s) {
+    size_t len;
+    uint8_t *data = read_file(name, &len);
+    memset(s, 0, sizeof(*s));
+    bool ok = data != NULL && len >= sizeof(s->hdr);
+    if (ok) {
+        memcpy(&s->hdr, data, sizeof(s->hdr));
+        ok = memcmp(s->hdr.magic, SD_LOG_SUMMARY_MAGIC, sizeof(s->hdr.magic)) == 0 &&
+             s->hdr.version == SD_LOG_SUMMARY_VERSION && s->hdr.signals <= SD_LOG_SUMMARY_MAX_SIGNALS &&
+             s->hdr.header_len == sizeof(s->hdr) + s->hdr.signals * sizeof(sd_log_summary_signal_t) &&
+             s->hdr.period_s == SD_LOG_SUMMARY_PERIOD_S && len >= s->hdr.header_len;
+    }
+    size_t row_len = SD_LOG_SUMMARY_ROW_LEN(s->hdr.signals);
+    ok = ok && (len - s->hdr.header_len) % row_len == 0 && (len - s->hdr.header_len) / row_len <= MAX_ROWS;
+    if (ok) {
+        memcpy(s->sig, &data[sizeof(s->hdr)], s->hdr.signals * sizeof(sd_log_summary_signal_t));
+        s->rows = (uint32_t)((len - s->hdr.header_len) / row_len);
+        for (uint32_t r = 0; r < s->rows; r++) {
+            const uint8_t *row = &data[s->hdr.header_len + r * row_len];
+            memcpy(&s->minute[r], row, sizeof(uint32_t));
+            memcpy(s->v[r], row + sizeof(uint32_t), s->hdr.signals * sizeof(sd_log_summary_value_t));
+        }
+    }
+    free(data);
+    CHECK(ok);
+    return ok;
+}
+
+// === Rows from samples on the manual clock ===
+
+#define SIGNALS 4
+
+static struct {
+    int32_t min, max;
+    int64_t sum;
+    uint32_t samples;
+} want[MAX_ROWS][SIGNALS];
+static int64_t start;
+static uint32_t last_minute;
+static uint32_t rows_emitted;
+
+// A finished row goes to sd_flush from one of two buffers, left alone for the
+// minute until the next row on the vehicle; samples come much faster here, so
+// each row is waited for on the card before the minute after it closes
+static void wait_for_row(uint32_t rows) {
+    off_t want_size = sizeof(sd_log_summary_header_t) + SIGNALS * sizeof(sd_log_summary_signal_t) +
+                      rows * SD_LOG_SUMMARY_ROW_LEN(SIGNALS);
+    struct stat st;
+    for (int i = 0; i < 5000 && (stat(session_summary_filename, &st) != 0 || st.st_size < want_size); i++) {
+        usleep(1000);
+    }
+}
+
+// A sample `at` µs into the session, and what the reference makes of it
+static void sample(int64_t at, uint8_t signal, int32_t value) {
+    clock_to(start + at);
+    wait_for_writer();
+    sd_logger_summary_add(signal, value);
+    uint32_t minute = (uint32_t)(at / MINUTE_US);
+    if (minute != last_minute) {
+        if (rows_emitted++ > 0) wait_for_row(rows_emitted - 1);
+        last_minute = minute;
+    }
+    if (want[minute][signal].samples == 0 || value < want[minute][signal].min) want[minute][signal].min = value;
+    if (want[minute][signal].samples == 0 || value > want[minute][signal].max) want[minute][signal].max = value;
+    want[minute][signal].sum += value;
+    want[minute][signal].samples++;
+}
+
+static void test_rows(void) {
+    static const sd_log_summary_signal_t defs[SIGNALS] = {
+        {"OIL_TEMP_C", 1}, {"COOLANT_TEMP_C", 1}, {"EXTREMES", 0}, {"AMBIENT_TEMP_RAW", 1},
+    };
+    sd_logger_summary_define(defs, SIGNALS);
+    sd_logger_start_session();
+    CHECK(session_active);
+    start = esp_timer_get_time();
+    memset(want, 0, sizeof(want));
+    last_minute = UINT32_MAX;
+    rows_emitted = 0;
+
+    // Minute 0: means of exact halves round away from zero; signal 3 has no samples
+    sample(1000000, 0, 1);
+    sample(2000000, 0, 2);
+    sample(2000000, 1, -1);
+    sample(3000000, 1, -2);
+    sample(4000000, 2, INT32_MIN);
+    sample(5000000, 2, INT32_MAX);
+    sample(MINUTE_US - 1, 0, 2);            // the last microsecond of minute 0
+    // Minute 1 from its first microsecond
+    sample(MINUTE_US, 0, 7);
+    sample(MINUTE_US + 1, 1, -1);
+    sample(MINUTE_US + 2, 1, 0);
+    sample(90000000, 3, 10);
+    sample(91000000, 3, 10);
+    sample(92000000, 3, 11);
+    // Minute 2 has nothing; minute 3 only signal 2
+    sample(3 * MINUTE_US, 2, 5);
+    sample(4 * MINUTE_US - 1, 2, 6);
+    // Minutes 4-7: random samples
+    uint32_t seed = 25;
+    int64_t at = 4 * MINUTE_US;
+    for (int i = 0; i < 600; i++) {
+        at += host_rand(&seed) % 800000;
+        sample(at, (uint8_t)(host_rand(&seed) % SIGNALS), (int32_t)(host_rand(&seed) % 2000001) - 1000000);
+    }
+    end_session();
+
+    summary_file_t s;
+    if (!read_summary(summary_path, &s)) return;
+    CHECK_EQ(s.hdr.signals, SIGNALS);
+    CHECK_EQ(s.hdr.start_us, (uint64_t)start);
+    for (int k = 0; k < SIGNALS; k++) {
+        CHECK(strcmp(s.sig[k].name, defs[k].name) == 0 && s.sig[k].decimals == defs[k].decimals);
+    }
+
+    // The hand-worked cases
+    CHECK_EQ(s.minute[0], 0);
+    CHECK(s.v[0][0].min == 1 && s.v[0][0].max == 2 && s.v[0][0].mean == 2 && s.v[0][0].samples == 3);  // 5/3
+    CHECK(s.v[0][1].min == -2 && s.v[0][1].max == -1 && s.v[0][1].mean == -2 && s.v[0][1].samples == 2);  // -1.5
+    CHECK(s.v[0][2].min == INT32_MIN && s.v[0][2].max == INT32_MAX && s.v[0][2].mean == -1);    // -0.5
+    CHECK(s.v[0][3].min == 0 && s.v[0][3].max == 0 && s.v[0][3].mean == 0 && s.v[0][3].samples == 0);
+    CHECK_EQ(s.minute[1], 1);
+    CHECK(s.v[1][0].mean == 7 && s.v[1][0].samples == 1);
+    CHECK(s.v[1][1].mean == -1 && s.v[1][1].samples == 2);                                      // -0.5
+    CHECK(s.v[1][3].min == 10 && s.v[1][3].max == 11 && s.v[1][3].mean == 10);                 // 10.33
+    CHECK_EQ(s.minute[2], 3);
+    CHECK(s.v[2][2].mean == 6 && s.v[2][2].samples == 2);                                       // 5.5
+
+    // Every row against the reference
+    uint32_t rows = 0, mismatched = 0, samples = 0;
+    for (uint32_t m = 0; m < MAX_ROWS; m++) {
+        uint32_t n = 0;
+        for (int k = 0; k < SIGNALS; k++) n += want[m][k].samples;
+        if (n == 0) continue;
+        samples += n;
+        if (rows >= s.rows || s.minute[rows] != m) {
+            mismatched++;
+            continue;
+        }
+        for (int k = 0; k < SIGNALS; k++) {
+            const sd_log_summary_value_t *v = &s.v[rows][k];
+            uint32_t cnt = want[m][k].samples;
+            int32_t mean = cnt ? (int32_t)llround((double)want[m][k].sum / cnt) : 0;
+            if (v->samples != cnt || v->min != (cnt ? want[m][k].min : 0) ||
+                v->max != (cnt ? want[m][k].max : 0) || v->mean != mean) {
+                fprintf(stderr, "minute %" PRIu32 " signal %d: %" PRId32 "/%" PRId32 "/%" PRId32 " x%" PRIu32
+                        ", want %" PRId32 "/%" PRId32 "/%" PRId32 " x%" PRIu32 "\n", m, k, v->min, v->max,
+                        v->mean, v->samples, want[m][k].min, want[m][k].max, mean, cnt);
+                mismatched++;
+            }
+        }
+        rows++;
+    }
+    CHECK_EQ(mismatched, 0);
+    CHECK_EQ(s.rows, rows);
+    CHECK_EQ(rows, 7);
+    printf("rows: %" PRIu32 " samples in %" PRIu32 " rows over %" PRId64 " minutes, all as the reference\n",
+           samples, rows, (int64_t)(at / MINUTE_US + 1));
+    remove_session();
+}
+
+// === The firmware against tools/logsummary.py ===
+
+// Frames up to `until` through the processing stage at their own times, the
+// instrument cluster left out during the gap
+static size_t feed_until(int64_t base, int64_t until, size_t i, size_t count, uint32_t kombi) {
+    for (; i < count && base + traffic[i].ts_us <= until; i++) {
+        const bus_frame_t *f = &traffic[i];
+        if (f->id == kombi && f->ts_us >= GAP_FROM_US && f->ts_us < GAP_TO_US) continue;
+        clock_to(base + f->ts_us);
+        wait_for_writer();
+        can_message_t msg = {.identifier = f->id, .data_length_code = f->dlc,
+                             .timestamp = (uint32_t)esp_timer_get_time()};
+        memcpy(msg.data, f->data, sizeof(msg.data));
+        can_process_batch(&msg, 1);
+    }
+    return i;
+}
+
+static void test_matches_logsummary(void) {
+    size_t count = bus_traffic_generate(&mb_profiles[0], 0, 25, traffic, MAX_FRAMES);
+    while (count > 0 && traffic[count - 1].ts_us > TRAFFIC_US) count--;
+    const can_message_def_t *cluster = &mb_profiles[0].messages[mb_signal_info[MB_SIG_AMBIENT_TEMP_RAW].message];
+    CHECK(cluster->cycle_ms > 0);
+
+    // can_driver_init() without the TWAI driver and its tasks: this thread is can_proc_task
+    mercedes_decode_init();
+    can_sniffer_init();
+    can_log_summary_define();
+    log_summary_last_us = 0;
+
+    int64_t base = esp_timer_get_time();
+    int64_t end = base + traffic[count - 1].ts_us;
+    size_t i = 0;
+    for (int64_t t = base + traffic[0].ts_us; t <= end; t += PROC_PERIOD_US) {
+        i = feed_until(base, t, i, count, cluster->id);
+        clock_to(t);
+        wait_for_writer();
+        mercedes_decode_apply_posted();
+        mercedes_decode_check_stale();
+        mercedes_decode_detect_profile();
+        can_log_summary_sample();
+    }
+    feed_until(base, end, i, count, cluster->id);
+    CHECK(logging_session_active);
+    end_session();
+    logging_session_active = false;
+    CHECK_EQ(stats.dropped, 0);
+
+    char tool_path[sizeof(summary_path) + 8];
+    snprintf(tool_path, sizeof(tool_path), "%s.tool", summary_path);
+    char cmd[3 * sizeof(path) + 256];
+    snprintf(cmd, sizeof(cmd), "\"%s\" \"%s\" \"%s\" -o \"%s\"", PYTHON_EXECUTABLE, LOGSUMMARY_PY, path, tool_path);
+    CHECK_EQ(system(cmd), 0);
+
+    size_t len, tool_len;
+    uint8_t *firmware = read_file(summary_path, &len);
+    uint8_t *tool = read_file(tool_path, &tool_len);
+    CHECK(firmware != NULL && tool != NULL);
+    CHECK(len == tool_len && memcmp(firmware, tool, len) == 0);
+    free(firmware);
+    free(tool);
+
+    summary_file_t s, t;
+    if (!read_summary(summary_path, &s) || !read_summary(tool_path, &t)) return;
+    CHECK_EQ(s.hdr.signals, LOG_SUMMARY_COUNT);
+    CHECK_EQ(s.rows, 3);
+    CHECK(strcmp(s.sig[3].name, "AMBIENT_TEMP_RAW") == 0 && s.sig[3].decimals == 1);
+    for (uint32_t r = 0; r < s.rows && r < t.rows; r++) {
+        for (int k = 0; k < s.hdr.signals; k++) {
+            const sd_log_summary_value_t *a = &s.v[r][k], *b = &t.v[r][k];
+            if (memcmp(a, b, sizeof(*a)) != 0) {
+                fprintf(stderr, "minute %" PRIu32 " %s: firmware %" PRId32 "/%" PRId32 "/%" PRId32 " x%" PRIu32
+                        ", logsummary.py %" PRId32 "/%" PRId32 "/%" PRId32 " x%" PRIu32 "\n", s.minute[r],
+                        s.sig[k].name, a->min, a->max, a->mean, a->samples, b->min, b->max, b->mean, b->samples);
+            }
+        }
+    }
+    // Ambient temperature in its physical range (-40.0 to 87.5 C), missing while the cluster was silent
+    for (uint32_t r = 0; r < s.rows; r++) {
+        CHECK(s.v[r][3].min >= -400 && s.v[r][3].max <= 875 && s.v[r][3].min <= s.v[r][3].mean &&
+              s.v[r][3].mean <= s.v[r][3].max);
+    }
+    // Samples at 51-71 s found it stale: 9 in minute 0, 12 in minute 1
+    CHECK_EQ(s.v[1][0].samples, 60);
+    CHECK_EQ(s.v[0][3].samples, s.v[0][0].samples - 9);
+    CHECK_EQ(s.v[1][3].samples, 60 - 12);
+    CHECK_EQ(s.v[2][3].samples, s.v[2][0].samples);
+    printf("firmware: %zu frames, %" PRIu32 " rows in %zu bytes (logsummary.py %zu); ambient "
+           "%" PRIu32 "/%" PRIu32 "/%" PRIu32 " samples (oil %" PRIu32 "/%" PRIu32 "/%" PRIu32 ")\n",
+           count, s.rows, len, tool_len, s.v[0][3].samples, s.v[1][3].samples, s.v[2][3].samples,
+           s.v[0][0].samples, s.v[1][0].samples, s.v[2][0].samples);
+    unlink(tool_path);
+    remove_session();
+}
+
+int main(void) {
+    host_clock_manual(START_US);
+    CHECK_EQ(sd_logger_init(), ESP_OK);
+    CHECK(sd_logger_is_mounted());
+
+    test_rows();
+    test_matches_logsummary();
+    return host_test_done("test_log_summary");
+}
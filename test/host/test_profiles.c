@@ -0,0 +1,138 @@
+// Vehicle profiles: auto-detection from the IDs on the bus, replaying traffic
+// of each profile (bus_traffic.c) through the sniffer and the decoder as the
+// CAN processing task does, then checking every channel against a decode with
+// the detected profile's tables. A recorded CSV session given on the command
+// line is replayed the same way and the detected profile printed.
+#include "mercedes_decode.h"
+#include "can_config.h"
+#include "can_sniffer.h"
+#include "bus_traffic.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <string.h>
+
+#define FRAMES 40000u
+
+static bus_frame_t frames[FRAMES];
+
+// Replays n frames with the tick count following the timestamps
+// Returns the index of the frame after which detection settled, n if it did not
+static size_t replay(const bus_frame_t *f, size_t n) {
+    host_clock_manual(1000);
+    can_sniffer_init();
+    mercedes_decode_init();
+    size_t settled = n;
+    uint32_t now_us = 0;
+    for (size_t i = 0; i < n; i++) {
+        host_clock_advance_us(f[i].ts_us - now_us);
+        now_us = f[i].ts_us;
+        can_sniffer_record(f[i].id, f[i].data, f[i].dlc, f[i].ts_us);
+        mercedes_decode_message(f[i].id, f[i].data, f[i].dlc, f[i].ts_us);
+        mercedes_decode_detect_profile();
+
+        bool detecting;
+        mercedes_decode_get_profile(&detecting);
+        if (!detecting && settled == n) settled = i;
+    }
+    return settled;
+}
+
+// Every broadcast channel holds what the profile's tables make of the last
+// frame of its message (all of them arrive again after detection)
+static void check_channels(const can_profile_t *p, const bus_frame_t *f, size_t n) {
+    static mercedes_data_t expect;
+    memset(&expect, 0, sizeof(expect));
+    mercedes_data_t live;
+    CHECK(mercedes_decode_snapshot(&live));
+    int compared = 0;
+    for (uint16_t ch = 0; ch < MB_SIG_COUNT; ch++) {
+        const can_message_def_t *msg = &p->messages[mercedes_decode_channel_message(ch)];
+        if (can_profile_find(p, msg->id) != msg) continue;   // not in this profile
+        size_t last = n;
+        for (size_t i = n; i-- > 0;) {
+            if (f[i].id == msg->id && f[i].dlc >= msg->min_dlc) {
+                last = i;
+                break;
+            }
+        }
+        CHECK(last < n);
+        compared++;
+        can_signal_decode(msg, p->signals, can_signal_load(f[last].data), &expect);
+        int32_t want, got;
+        mercedes_decode_get_signal(&expect, ch, &want);
+        mercedes_decode_get_signal(&live, ch, &got);
+        if (want != got) {
+            fprintf(stderr, "%s: %s is %ld, want %ld\n", p->name, mercedes_decode_channel_name(ch),
+                    (long)got, (long)want);
+            host_failures++;
+        }
+    }
+    CHECK(compared > 0);
+}
+
+static void test_detect(int p) {
+    const can_profile_t *want = &mb_profiles[p];
+    size_t n = bus_traffic_generate(want, 8, 7u + (uint32_t)p, frames, FRAMES);
+    CHECK(frames[n - 1].ts_us > 3 * CAN_PROFILE_DETECT_MS * 1000u);
+
+    CHECK_EQ(mercedes_decode_select_profile("auto"), ESP_OK);
+    size_t settled = replay(frames, n);
+    bool detecting;
+    const can_profile_t *got = mercedes_decode_get_profile(&detecting);
+    CHECK(!detecting);
+    CHECK(got == want);
+
+    // Not before CAN_PROFILE_DETECT_MS of traffic, and soon after
+    CHECK(settled < n);
+    uint32_t settle_ms = frames[settled].ts_us / 1000;
+    CHECK(settle_ms >= CAN_PROFILE_DETECT_MS);
+    CHECK(settle_ms <= CAN_PROFILE_DETECT_MS + 100);
+    printf("%s traffic: detected %s after %u ms\n", want->name, got->name, (unsigned)settle_ms);
+
+    CHECK_EQ(mercedes_decode_get_ids(NULL, 0), (size_t)want->num_messages);
+    check_channels(want, frames, n);
+}
+
+// Traffic no profile claims (or all equally) keeps detection pending, and a
+// fixed selection never detects
+static void test_undecided(void) {
+    size_t n = 0;
+    for (uint32_t t = 0; n < 2000; t += 10000) {
+        bus_frame_t *f = &frames[n++];
+        memset(f, 0, sizeof(*f));
+        f->ts_us = t;
+        f->id = 0x7F0 + n % 4;
+        f->dlc = 8;
+    }
+    mercedes_decode_select_profile("auto");
+    CHECK_EQ(replay(frames, n), n);
+    size_t all = mercedes_decode_get_ids(NULL, 0);
+    for (int p = 0; p < MB_PROFILE_COUNT; p++) CHECK(all >= (size_t)mb_profiles[p].num_messages);
+
+    CHECK_EQ(mercedes_decode_select_profile("w212"), ESP_OK);
+    mercedes_decode_init();
+    bool detecting;
+    CHECK(mercedes_decode_get_profile(&detecting) == &mb_profiles[MB_PROFILE_W212]);
+    CHECK(!detecting);
+    CHECK_EQ(mercedes_decode_get_ids(NULL, 0), (size_t)mb_profiles[MB_PROFILE_W212].num_messages);
+    CHECK_EQ(mercedes_decode_select_profile("W999"), ESP_ERR_NOT_FOUND);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        size_t n = bus_traffic_load_csv(argv[1], frames, FRAMES);
+        CHECK(n > 0);
+        mercedes_decode_select_profile("auto");
+        replay(frames, n);
+        bool detecting;
+        const can_profile_t *p = mercedes_decode_get_profile(&detecting);
+        printf("%s: %zu frames, %s\n", argv[1], n, detecting ? "no profile detected" : p->name);
+        if (!detecting) check_channels(p, frames, n);
+        return host_test_done("test_profiles");
+    }
+
+    test_detect(MB_PROFILE_W218);
+    test_detect(MB_PROFILE_W212);
+    test_undecided();
+    return host_test_done("test_profiles");
+}
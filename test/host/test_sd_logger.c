@@ -0,0 +1,268 @@
+// sd_logger's writer and flush tasks against the simulated card (sdcard_sim.c),
+// one session per case, fed with W218 traffic (bus_traffic.c) on the manual
+// clock: the block_free handoff on a slow card (the writer waits, no block
+// changes while it is written), partly filled blocks written and synced each
+// SD_LOG_FLUSH_MS and then rewritten whole, preallocation in
+// SD_LOG_PREALLOC_SIZE steps and the fallback when the card cannot grow the
+// file, and the trim on close. Every case checks that full writes are whole,
+// block-aligned blocks, that what was written agrees with the final file,
+// that the file ends at its data and that the frames read back intact.
+// sd_logger.c is compiled into this test so its file calls go to the card.
+#include "sdcard_sim.h"
+#include "sd_logger.c"
+#include "canlog_reader.h"
+#include "mb_signals.h"
+#include "bus_traffic.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <inttypes.h>
+#include <stdlib.h>
+
+#define MAX_FRAMES  160000
+#define START_US    1000000
+
+static bus_frame_t traffic[MAX_FRAMES];
+static size_t traffic_count;
+static bus_frame_t frames[MAX_FRAMES];     // the frames of the current session
+static size_t count;
+static char path[sizeof(session_filename)];
+static char index_path[sizeof(session_index_filename)];
+
+typedef struct {
+    uint32_t full, partial, grow, grow_failed, rewritten, fsyncs;
+    uint32_t misaligned, straddling, mismatched, failed;
+    uint32_t truncated_to;      // length of the last ftruncate, 0 if none
+    uint32_t max_size;
+    uint32_t size;
+} session_check_t;
+
+// Log frames[0..count) in the given format, then a quiet bus until the session
+// is long enough to be kept
+static void run_session(sd_log_format_t format) {
+    card_reset();
+    sd_logger_set_format(format);
+    sd_logger_start_session();
+    CHECK(session_active);
+    snprintf(path, sizeof(path), "%s", session_filename);
+    snprintf(index_path, sizeof(index_path), "%s", session_index_filename);
+
+    int64_t base = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        int64_t at = base + frames[i].ts_us;
+        if (at > esp_timer_get_time()) host_clock_advance_us(at - esp_timer_get_time());
+        // As fast as the writer takes them: a frame dropped here would not be the card's doing
+        while (uxQueueMessagesWaiting(log_queue) > LOG_QUEUE_SIZE - 4) usleep(50);
+        sd_logger_write(frames[i].id, frames[i].data, frames[i].dlc, (uint32_t)esp_timer_get_time());
+        frames[i].ts_us = (uint32_t)(at - START_US);       // as the log will have it
+    }
+    host_clock_advance_us(MIN_SESSION_SECONDS * 1000000LL);
+    sd_logger_end_session();
+    CHECK_EQ(stats.frames, count);
+}
+
+// Go through the card's record of the session file against the file as it ends up
+static session_check_t check_card(void) {
+    session_check_t c = {0};
+    FILE *f = fopen(path, "rb");
+    CHECK(f != NULL);
+    if (f == NULL) return c;
+    fseek(f, 0, SEEK_END);
+    c.size = (uint32_t)ftell(f);
+    uint8_t *data = malloc(c.size + 1);
+    fseek(f, 0, SEEK_SET);
+    CHECK_EQ(fread(data, 1, c.size, f), c.size);
+    fclose(f);
+
+    int file = card_file(path);
+    const card_log_t *log = card_log();
+    uint32_t blocks = SD_LOG_PREALLOC_SIZE / SD_LOG_BLOCK_SIZE * 4;
+    uint8_t *partly = calloc(blocks, 1);       // blocks with a partial write not yet rewritten
+    c.max_size = log->files[file].max_size;
+
+    for (uint32_t i = 0; i < log->num_ops; i++) {
+        const card_op_t *op = &log->ops[i];
+        if (op->file != file) continue;
+        if (op->kind == CARD_FSYNC) {
+            c.fsyncs++;
+            continue;
+        }
+        if (op->kind == CARD_TRUNCATE) {
+            c.truncated_to = op->offset;
+            continue;
+        }
+        if (op->len == 1 && (op->offset + 1) % SD_LOG_PREALLOC_SIZE == 0) {
+            if (op->ok) c.grow++; else c.grow_failed++;
+            continue;
+        }
+        if (!op->ok) {
+            c.failed++;
+            continue;
+        }
+        uint32_t block = op->offset / SD_LOG_BLOCK_SIZE;
+        if (op->len == SD_LOG_BLOCK_SIZE) {
+            c.full++;
+            if (op->offset % SD_LOG_BLOCK_SIZE != 0) c.misaligned++;
+            if (block < blocks && partly[block]) c.rewritten++;
+        } else {
+            c.partial++;
+            if ((op->offset + op->len - 1) / SD_LOG_BLOCK_SIZE != block) c.straddling++;
+            if (block < blocks) partly[block] = 1;
+        }
+        // Later writes may only repeat what was there, never change it
+        if (op->offset + op->len > c.size || card_hash(&data[op->offset], op->len) != op->hash) {
+            c.mismatched++;
+        }
+    }
+    free(partly);
+    free(data);
+
+    CHECK_EQ(c.misaligned, 0);
+    CHECK_EQ(c.straddling, 0);
+    CHECK_EQ(c.mismatched, 0);
+    CHECK_EQ(c.failed, 0);
+    CHECK_EQ(c.full, stats.blocks);
+    CHECK_EQ(c.truncated_to, c.size);
+    CHECK_EQ(c.full, c.size / SD_LOG_BLOCK_SIZE);
+    CHECK(c.fsyncs >= c.partial);
+    CHECK_EQ(card_log()->torn, 0);
+    return c;
+}
+
+static bool same_frame(const canlog_frame_t *a, const bus_frame_t *b) {
+    return a->time_us == START_US + b->ts_us && a->can_id == b->id && a->dlc == b->dlc &&
+           memcmp(a->data, b->data, b->dlc) == 0;
+}
+
+// A binary session reads back frame for frame
+static void check_frames_binary(void) {
+    canlog_reader_t *r = malloc(sizeof(*r));
+    CHECK_EQ(canlog_reader_open(r, path), ESP_OK);
+    canlog_frame_t f;
+    size_t n = 0;
+    while (canlog_reader_next(r, &f) == ESP_OK && n < count && same_frame(&f, &frames[n])) n++;
+    CHECK_EQ(n, count);
+    CHECK(r->index_count > 0);
+
+    // The index sidecar gets a seek to the middle there
+    const bus_frame_t *mid = &frames[count / 2];
+    CHECK_EQ(canlog_reader_seek(r, START_US + mid->ts_us), ESP_OK);
+    CHECK(canlog_reader_next(r, &f) == ESP_OK && f.time_us == START_US + mid->ts_us);
+    canlog_reader_close(r);
+    free(r);
+}
+
+// A CSV session has a line per frame, at ms resolution
+static void check_frames_csv(void) {
+    FILE *f = fopen(path, "r");
+    CHECK(f != NULL);
+    if (f == NULL) return;
+    char line[CSV_MAX_LINE + 1];
+    CHECK(fgets(line, sizeof(line), f) != NULL && strncmp(line, "timestamp_ms,", 13) == 0);
+    size_t n = 0;
+    unsigned long ms, id;
+    unsigned d[8];
+    int dlc;
+    while (n < count && fgets(line, sizeof(line), f) != NULL &&
+           sscanf(line, "%lu,0x%lX,%d,%X,%X,%X,%X,%X,%X,%X,%X", &ms, &id, &dlc,
+                  &d[0], &d[1], &d[2], &d[3], &d[4], &d[5], &d[6], &d[7]) == 11) {
+        const bus_frame_t *b = &frames[n];
+        bool same = ms == (START_US + b->ts_us) / 1000 && id == b->id && dlc == b->dlc;
+        for (int k = 0; k < 8; k++) same = same && d[k] == (k < b->dlc ? b->data[k] : 0);
+        if (!same) break;
+        n++;
+    }
+    CHECK_EQ(n, count);
+    CHECK(fgets(line, sizeof(line), f) == NULL);
+    fclose(f);
+}
+
+static void remove_session(void) {
+    unlink(path);
+    if (index_path[0]) unlink(index_path);
+}
+
+// Every `every`-th frame of the first `seconds` of traffic
+static void take_traffic(uint32_t seconds, size_t every) {
+    count = 0;
+    for (size_t i = 0; i < traffic_count && traffic[i].ts_us < seconds * 1000000u; i += every) {
+        frames[count++] = traffic[i];
+    }
+}
+
+// The card takes 3 ms per write while frames come as fast as the writer can
+// encode them: the writer runs into the block still being written and waits
+static void test_block_handoff(void) {
+    take_traffic(30, 1);
+    card_set_write_delay_us(3000);
+    run_session(SD_LOG_FORMAT_BINARY);
+    card_set_write_delay_us(0);
+    session_check_t c = check_card();
+    check_frames_binary();
+    CHECK(c.full > 40);
+    CHECK(stats.queue_high_water > LOG_QUEUE_SIZE / 2);
+    CHECK_EQ(stats.dropped, 0);
+    printf("handoff: %zu frames, %" PRIu32 " full blocks on a 3 ms/write card, queue high water %u/%d, "
+           "%" PRIu32 " blocks changed while written\n", count, c.full, stats.queue_high_water, LOG_QUEUE_SIZE,
+           card_log()->torn);
+    remove_session();
+}
+
+// An eighth of the traffic, compressed: a block takes several SD_LOG_FLUSH_MS to
+// fill, so its data goes out in synced pieces before the whole block is rewritten
+static void test_partial_then_full(void) {
+    take_traffic(60, 8);
+    run_session(SD_LOG_FORMAT_COMPRESSED);
+    session_check_t c = check_card();
+    check_frames_binary();
+    CHECK(c.partial > 2 * c.full);
+    CHECK(c.rewritten > 0 && c.rewritten == c.full);
+    CHECK_EQ(c.grow, 1);
+    CHECK_EQ(c.max_size, SD_LOG_PREALLOC_SIZE);
+    printf("partial: %zu frames, %" PRIu32 " bytes: %" PRIu32 " partial writes, %" PRIu32 " full blocks "
+           "(%" PRIu32 " rewriting partial ones), %" PRIu32 " fsyncs\n",
+           count, c.size, c.partial, c.full, c.rewritten, c.fsyncs);
+    remove_session();
+}
+
+// A CSV session past SD_LOG_PREALLOC_SIZE grows twice and is trimmed on close
+static void test_preallocation(void) {
+    take_traffic(60, 1);
+    run_session(SD_LOG_FORMAT_CSV);
+    session_check_t c = check_card();
+    check_frames_csv();
+    CHECK(c.size > SD_LOG_PREALLOC_SIZE);
+    CHECK_EQ(c.grow, 2);
+    CHECK_EQ(c.grow_failed, 0);
+    CHECK_EQ(c.max_size, 2 * SD_LOG_PREALLOC_SIZE);
+    printf("preallocation: %zu frames, %" PRIu32 " bytes in %" PRIu32 " byte steps, trimmed from %" PRIu32 "\n",
+           count, c.size, (uint32_t)SD_LOG_PREALLOC_SIZE, c.max_size);
+    remove_session();
+}
+
+// A card with 3 MB free: the 4 MB preallocation fails once, then the file grows as written
+static void test_no_room_to_preallocate(void) {
+    take_traffic(60, 1);
+    card_set_capacity(3u << 20);
+    run_session(SD_LOG_FORMAT_BINARY);
+    card_set_capacity(0);
+    session_check_t c = check_card();
+    check_frames_binary();
+    CHECK_EQ(c.grow, 0);
+    CHECK_EQ(c.grow_failed, 1);
+    CHECK_EQ(c.max_size, c.size);
+    printf("no room: %zu frames, %" PRIu32 " bytes written without preallocation\n", count, c.size);
+    remove_session();
+}
+
+int main(void) {
+    traffic_count = bus_traffic_generate(&mb_profiles[0], 40, 22, traffic, MAX_FRAMES);
+    host_clock_manual(START_US);
+    CHECK_EQ(sd_logger_init(), ESP_OK);
+    CHECK(sd_logger_is_mounted());
+
+    test_block_handoff();
+    test_partial_then_full();
+    test_preallocation();
+    test_no_room_to_preallocate();
+    return host_test_done("test_sd_logger");
+}
@@ -0,0 +1,144 @@
+// can_seqlock under contention: one thread writes as fast as it can (the CAN
+// processing task), another takes snapshots (the LVGL task) and checks
+// invariants that only hold for a copy taken between two writes:
+//   - a plain seqlock-guarded struct whose words all carry the same sequence
+//   - mercedes_decode_snapshot(): 0x203 frames with all four wheel speeds
+//     equal to the frame number, so the wheels, the derived vehicle speed and
+//     decode_count must agree
+//   - can_sniffer snapshots: every byte of the payload, count and last_us
+//     derive from the frame number
+// Torn reads of the live structs (no seqlock) are counted for comparison only.
+#include "can_seqlock.h"
+#include "can_sniffer.h"
+#include "mercedes_decode.h"
+#include "host_test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define WRITES 2000000u
+
+typedef struct {
+    uint32_t seq[16];
+} guarded_t;
+
+static can_seqlock_t lock;
+static guarded_t guarded;
+static atomic_bool writer_done;
+
+static void *plain_writer(void *arg) {
+    (void)arg;
+    for (uint32_t k = 1; k <= WRITES; k++) {
+        can_seqlock_write_begin(&lock);
+        for (int i = 0; i < 16; i++) guarded.seq[i] = k;
+        can_seqlock_write_end(&lock);
+    }
+    atomic_store(&writer_done, true);
+    return NULL;
+}
+
+static void test_plain(void) {
+    atomic_store(&writer_done, false);
+    pthread_t t;
+    pthread_create(&t, NULL, plain_writer, NULL);
+    uint32_t reads = 0, busy = 0, last = 0;
+    while (!atomic_load(&writer_done)) {
+        guarded_t g;
+        if (!can_seqlock_read(&lock, &g, &guarded, sizeof(g))) {
+            busy++;
+            continue;
+        }
+        reads++;
+        for (int i = 1; i < 16; i++) CHECK_EQ(g.seq[i], g.seq[0]);
+        CHECK(g.seq[0] >= last);   // never goes back
+        last = g.seq[0];
+    }
+    pthread_join(t, NULL);
+    CHECK(reads > 0);
+    printf("seqlock: %u consistent reads, %u gave up\n", reads, busy);
+}
+
+// Wheel speed raw value k in all four 11-bit fields (big-endian, bits 2..0 of byte 2n + byte 2n+1)
+static void *decode_writer(void *arg) {
+    (void)arg;
+    for (uint32_t k = 1; k <= WRITES; k++) {
+        uint16_t v = k & 0x7FF;
+        uint8_t d[8];
+        for (int w = 0; w < 4; w++) {
+            d[2 * w] = (uint8_t)(v >> 8);
+            d[2 * w + 1] = (uint8_t)v;
+        }
+        mercedes_decode_message(MB_ID_WHEEL_SPEEDS, d, 8, k * 20);
+
+        uint8_t s[8];
+        memset(s, (uint8_t)k, sizeof(s));
+        can_sniffer_record(0x123, s, 8, k * 10);
+    }
+    atomic_store(&writer_done, true);
+    return NULL;
+}
+
+static void test_snapshots(void) {
+    mercedes_decode_init();
+    can_sniffer_init();
+    atomic_store(&writer_done, false);
+    pthread_t t;
+    pthread_create(&t, NULL, decode_writer, NULL);
+
+    uint32_t decode_reads = 0, sniffer_reads = 0, summary_reads = 0, torn = 0;
+    uint32_t last_decode = 0, last_count = 0, last_total = 0;
+    while (!atomic_load(&writer_done)) {
+        mercedes_data_t m;
+        if (mercedes_decode_snapshot(&m) && m.decode_count > 0) {
+            decode_reads++;
+            CHECK_EQ(m.wheel_speed_fr, m.wheel_speed_fl);
+            CHECK_EQ(m.wheel_speed_rl, m.wheel_speed_fl);
+            CHECK_EQ(m.wheel_speed_rr, m.wheel_speed_fl);
+            CHECK_EQ(m.wheel_speed_fl, m.decode_count & 0x7FF);
+            CHECK_EQ(m.vehicle_speed_kmh, (uint8_t)(m.wheel_speed_fl * 603u / 10000));
+            CHECK(m.decode_count >= last_decode);
+            last_decode = m.decode_count;
+        }
+
+        sniffer_entry_t e;
+        if (can_sniffer_snapshot_entry(0x123, &e)) {
+            sniffer_reads++;
+            for (int i = 1; i < 8; i++) CHECK_EQ(e.last_data[i], e.last_data[0]);
+            CHECK_EQ(e.last_data[0], (uint8_t)e.count);
+            CHECK_EQ(e.last_us, e.count * 10);
+            CHECK(e.count >= last_count);
+            last_count = e.count;
+        }
+
+        sniffer_summary_t s;
+        if (can_sniffer_snapshot_summary(&s)) {
+            summary_reads++;
+            CHECK(s.num_ids <= 1);
+            CHECK_EQ(s.untracked_msgs, 0);
+            CHECK(s.total_msgs >= last_total);
+            last_total = s.total_msgs;
+        }
+
+        // The same invariant on the live struct, as the dashboard used to read it
+        const mercedes_data_t *live = mercedes_decode_get_data();
+        uint16_t fl = live->wheel_speed_fl;
+        uint16_t rr = live->wheel_speed_rr;
+        torn += fl != rr;
+    }
+    pthread_join(t, NULL);
+
+    CHECK(decode_reads > 0);
+    CHECK(sniffer_reads > 0);
+    CHECK(summary_reads > 0);
+    CHECK_EQ(mercedes_decode_get_data()->decode_count, WRITES);
+    printf("snapshots: %u decoder, %u sniffer entry, %u sniffer summary; "
+           "%u torn reads of the live decoder struct\n",
+           decode_reads, sniffer_reads, summary_reads, torn);
+}
+
+int main(void) {
+    test_plain();
+    test_snapshots();
+    return host_test_done("test_seqlock");
+}
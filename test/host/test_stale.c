@@ -0,0 +1,233 @@
+// Stale-message detection (the decoder's timing wheel) on the manual clock,
+// one RTOS tick = 10 ms: a message is stale until its first frame and again
+// from CAN_STALE_CYCLES periods (at least CAN_STALE_MIN_MS) after its last one;
+// event-driven messages never go stale once seen. Cases: the CAN_STALE_MIN_MS
+// floor, deadlines more than the wheel's 64 slots ahead (a wheel pass reaches
+// the slot before the deadline), mercedes_decode_set_period(), and everything
+// periodic stale after a silence. Then W218 traffic with random dropouts,
+// checked at random intervals (every tick up to several wheel turns) against a
+// direct computation from each message's last frame.
+#include "mercedes_decode.h"
+#include "can_config.h"
+#include "mb_signals.h"
+#include "bus_traffic.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <string.h>
+
+#define TICK_US         (1000000 / configTICK_RATE_HZ)
+#define MAX_FRAMES      60000
+#define START_US        1000000
+
+static const can_profile_t *p;
+static bus_frame_t frames[MAX_FRAMES];
+static uint32_t seed = 11;
+
+// Message index and a channel it carries, for the message with CAN ID id
+static size_t msg_index(uint32_t id) {
+    return (size_t)(can_profile_find(p, id) - p->messages);
+}
+
+static uint16_t channel_of(size_t m) {
+    for (uint16_t ch = 0; ch < MB_SIG_COUNT; ch++) {
+        if (mb_signal_info[ch].message == m) return ch;
+    }
+    return UINT16_MAX;
+}
+
+static void frame(uint32_t id) {
+    static const uint8_t data[8] = {0};
+    mercedes_decode_message(id, data, 8, (uint32_t)esp_timer_get_time());
+}
+
+static void ticks(uint32_t n) {
+    host_clock_advance_us((int64_t)n * TICK_US);
+}
+
+static bool stale(uint32_t id) {
+    return mercedes_decode_is_stale(channel_of(msg_index(id)));
+}
+
+static void reset(void) {
+    CHECK_EQ(mercedes_decode_select_profile("w218"), ESP_OK);
+    mercedes_decode_init();
+    p = &mb_profiles[MB_PROFILE_W218];
+}
+
+// Messages the profile sends
+static uint32_t count_messages(void) {
+    uint32_t count = 0;
+    for (int m = 0; m < MB_MSG_COUNT; m++) count += p->message_index[p->messages[m].id] == m + 1;
+    return count;
+}
+
+// Both DBCs give every message a cycle time; this one is made event-driven (period 0)
+#define EVENT_ID    0x608               // MS_608h
+
+static void test_rules(void) {
+    reset();
+    uint32_t out[MB_STALE_WORDS];
+    uint32_t messages = count_messages();
+
+    // Nothing received yet: all stale
+    mercedes_decode_check_stale();
+    CHECK_EQ(mercedes_decode_get_stale(out), messages);
+
+    // 20 ms message: 3 periods are 60 ms, raised to CAN_STALE_MIN_MS (10 ticks)
+    const uint32_t fast = 0x228;                // RDU_A3
+    CHECK_EQ(p->messages[msg_index(fast)].cycle_ms, 20);
+    frame(fast);
+    CHECK(!stale(fast));
+    for (int i = 0; i < CAN_STALE_MIN_MS / portTICK_PERIOD_MS - 1; i++) {
+        ticks(1);
+        mercedes_decode_check_stale();
+    }
+    CHECK(!stale(fast));
+    ticks(1);
+    mercedes_decode_check_stale();
+    CHECK(stale(fast));
+    CHECK(mercedes_decode_age_ms(channel_of(msg_index(fast))) == CAN_STALE_MIN_MS);
+    frame(fast);
+    CHECK(!stale(fast));                        // back with its next frame
+
+    // 100 ms message: 300 ms, 30 ticks
+    const uint32_t body = 0x3F0;                // KOMBI_3F0h
+    frame(body);
+    ticks(29);
+    mercedes_decode_check_stale();
+    CHECK(!stale(body));
+    ticks(1);
+    mercedes_decode_check_stale();
+    CHECK(stale(body));
+
+    // 1 s period: 300 ticks, the deadline's slot comes round four times before it is due
+    CHECK_EQ(mercedes_decode_set_period(body, 1000), ESP_OK);
+    frame(body);
+    for (int i = 0; i < 299; i++) {
+        ticks(1);
+        mercedes_decode_check_stale();
+        if (stale(body)) break;
+    }
+    CHECK(!stale(body));
+    ticks(1);
+    mercedes_decode_check_stale();
+    CHECK(stale(body));
+    // Same, checked only every 90 ticks (more than a wheel turn between checks)
+    frame(body);
+    for (int i = 0; i < 3; i++) {
+        ticks(90);
+        mercedes_decode_check_stale();
+    }
+    CHECK(!stale(body));
+    ticks(29);
+    mercedes_decode_check_stale();
+    CHECK(!stale(body));
+    ticks(1);
+    mercedes_decode_check_stale();
+    CHECK(stale(body));
+    CHECK_EQ(mercedes_decode_set_period(0x7FF, 1000), ESP_ERR_NOT_FOUND);
+
+    // Event-driven: stale until seen, then never, however long the silence
+    const uint32_t coolant = EVENT_ID;
+    CHECK_EQ(mercedes_decode_set_period(coolant, 0), ESP_OK);
+    CHECK(stale(coolant));
+    frame(coolant);
+    for (int i = 0; i < 10; i++) {
+        ticks(1000);
+        mercedes_decode_check_stale();
+    }
+    CHECK(!stale(coolant));
+
+    // A periodic message made event-driven stops expiring from its next frame
+    CHECK_EQ(mercedes_decode_set_period(fast, 0), ESP_OK);
+    frame(fast);
+    ticks(100);
+    mercedes_decode_check_stale();
+    CHECK(!stale(fast));
+
+    // Silence after every message has been seen: all periodic ones go stale, in one check
+    reset();
+    CHECK_EQ(mercedes_decode_set_period(EVENT_ID, 0), ESP_OK);
+    for (int m = 0; m < MB_MSG_COUNT; m++) {
+        if (p->message_index[p->messages[m].id] == m + 1) frame(p->messages[m].id);
+    }
+    mercedes_decode_check_stale();
+    CHECK_EQ(mercedes_decode_get_stale(out), 0);
+    ticks(5 * configTICK_RATE_HZ);
+    mercedes_decode_check_stale();
+    CHECK_EQ(mercedes_decode_get_stale(out), messages - 1);
+    for (int m = 0; m < MB_MSG_COUNT; m++) {
+        if (p->message_index[p->messages[m].id] != m + 1) continue;
+        CHECK_EQ((out[m / 32] >> (m % 32)) & 1u, p->messages[m].id != EVENT_ID);
+    }
+}
+
+// Traffic with dropouts, checked at random intervals against each message's last frame
+static void test_random(void) {
+    size_t n = bus_traffic_generate(&mb_profiles[MB_PROFILE_W218], 0, 31, frames, MAX_FRAMES);
+    reset();
+    CHECK_EQ(mercedes_decode_set_period(EVENT_ID, 0), ESP_OK);
+    int64_t base = esp_timer_get_time();
+    TickType_t last[MB_MSG_COUNT] = {0};
+    bool seen[MB_MSG_COUNT] = {false};
+    int64_t muted_until[MB_MSG_COUNT] = {0};
+    int64_t next_check = base;
+    uint32_t checks = 0, compared = 0, went_stale = 0, wrong = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int64_t at = base + frames[i].ts_us;
+        // Checks due before this frame
+        while (next_check <= at) {
+            host_clock_advance_us(next_check - esp_timer_get_time());
+            mercedes_decode_check_stale();
+            TickType_t now = xTaskGetTickCount();
+            for (int m = 0; m < MB_MSG_COUNT; m++) {
+                if (p->message_index[p->messages[m].id] != m + 1) continue;
+                TickType_t timeout = 0;
+                if (p->messages[m].cycle_ms && p->messages[m].id != EVENT_ID) {
+                    uint32_t ms = p->messages[m].cycle_ms * CAN_STALE_CYCLES;
+                    timeout = pdMS_TO_TICKS(ms < CAN_STALE_MIN_MS ? CAN_STALE_MIN_MS : ms);
+                }
+                bool want = !seen[m] || (timeout && now - last[m] >= timeout);
+                uint32_t out[MB_STALE_WORDS];
+                mercedes_decode_get_stale(out);
+                bool got = (out[m / 32] >> (m % 32)) & 1u;
+                if (got != want && wrong++ < 5) {
+                    fprintf(stderr, "%s at tick %" PRIu32 ": stale %d, last frame tick %" PRIu32 "\n",
+                            p->messages[m].name, (uint32_t)now, got, (uint32_t)last[m]);
+                }
+                compared++;
+                went_stale += want && seen[m];
+            }
+            checks++;
+            // Every tick, a few ticks, or several wheel turns apart
+            uint32_t r = host_rand(&seed) % 16;
+            next_check += (r < 12 ? 1 : r < 15 ? 1 + host_rand(&seed) % 64 : 64 + host_rand(&seed) % 200) * TICK_US;
+        }
+        size_t m = msg_index(frames[i].id);
+        if (at < muted_until[m]) continue;
+        if (host_rand(&seed) % 2000 == 0) {
+            muted_until[m] = at + (int64_t)(host_rand(&seed) % 3000) * 1000;   // up to 3 s
+            continue;
+        }
+        host_clock_advance_us(at - esp_timer_get_time());
+        mercedes_decode_message(frames[i].id, frames[i].data, frames[i].dlc, (uint32_t)at);
+        last[m] = xTaskGetTickCount();
+        seen[m] = true;
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK(went_stale > 100);
+    printf("random: %zu frames over %.1f s, %" PRIu32 " checks, %" PRIu32 " message states compared, "
+           "%" PRIu32 " stale after a dropout\n", n, frames[n - 1].ts_us / 1e6, checks, compared, went_stale);
+}
+
+int main(void) {
+    host_clock_manual(START_US);
+    test_rules();
+    test_random();
+    return host_test_done("test_stale");
+}
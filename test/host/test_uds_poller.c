@@ -0,0 +1,201 @@
+// uds_poller driven by the CAN manager task against simulated ECUs (ecu_sim.c):
+// DIDs of one ECU batched into one ReadDataByIdentifier request, the batch
+// halved after incorrectMessageLength, a refused batch split and a DID the ECU
+// does not have dropped, the wait stretched to P2* by responsePending, back-off
+// from an ECU that is gone, and the poller's frames held to its bus budget.
+// The build sets ENABLE_UDS_POLLING and a UDS_BUS_LOAD_PERMILLE of 5 (0.5 %),
+// about half of what the DID table asks for at its periods, so the token
+// bucket is what paces the requests.
+#include "can_manager.c"
+#include "ecu_sim.h"
+#include "host_stubs.h"
+#include "host_test.h"
+#include <math.h>
+#include <pthread.h>
+
+_Static_assert(ENABLE_UDS_POLLING && UDS_BUS_LOAD_PERMILLE == 5, "set by test/host/CMakeLists.txt");
+
+#define ENGINE_RX   0x7E8       // ECU 0 in the poller's table
+#define AIRMATIC_RX 0x7EC       // ECU 4
+
+static int64_t run_end_us;
+
+static void stop_at_end(int64_t now_us) {
+    if (now_us >= run_end_us) can_manager_running = false;
+}
+
+static void *manager_thread(void *arg) {
+    (void)arg;
+    can_manager_task(NULL);
+    return NULL;
+}
+
+// Run the manager task on the simulated bus for run_ms of simulated time
+static void run_manager(uint32_t run_ms) {
+    run_end_us = esp_timer_get_time() + (int64_t)run_ms * 1000;
+    host_clock_watch(stop_at_end);
+    can_manager_running = true;
+    pthread_t t;
+    pthread_create(&t, NULL, manager_thread, NULL);
+    pthread_join(t, NULL);
+    host_clock_watch(NULL);
+}
+
+static ecu_sim_did_t engine_dids[2];
+static ecu_sim_did_t airmatic_dids[2];
+static ecu_sim_ecu_t *engine, *airmatic;
+
+// Both ECUs with every DID of the poller's table, answering after 5 ms
+static void setup(void) {
+    static const ecu_sim_did_t engine_init[] = {
+        {0x2001, 4, {0x03, 0xE8, 0x04, 0x4C}, 0},    // boost 1000 hPa, target 1100 hPa
+        {0x2002, 2, {0x01, 0x2C}, 0},               // injection 3.00
+    };
+    static const ecu_sim_did_t airmatic_init[] = {
+        {0x2101, 1, {0x05}, 0},
+        {0x2102, 1, {0x01}, 0},
+    };
+    memcpy(engine_dids, engine_init, sizeof(engine_dids));
+    memcpy(airmatic_dids, airmatic_init, sizeof(airmatic_dids));
+    ecu_sim_init(1000000);
+    mercedes_decode_init();
+    engine = ecu_sim_add(ENGINE_RX, NULL, 0, 5000);
+    engine->dids = engine_dids;
+    engine->num_dids = 2;
+    airmatic = ecu_sim_add(AIRMATIC_RX, NULL, 0, 5000);
+    airmatic->dids = airmatic_dids;
+    airmatic->num_dids = 2;
+}
+
+static int32_t channel(uint16_t ch) {
+    mercedes_data_t d;
+    int32_t v = -1;
+    mercedes_decode_apply_posted();
+    CHECK(mercedes_decode_snapshot(&d));
+    CHECK(mercedes_decode_get_signal(&d, ch, &v));
+    return v;
+}
+
+// Poller frames on the bus as % of CAN_BAUDRATE over run_ms
+static float bus_load_pct(uint32_t run_ms) {
+    return ecu_sim_stats()->uds_frames * (float)UDS_FRAME_BITS * 100.0f / (run_ms * 1e-3f * CAN_BAUDRATE);
+}
+
+static void test_batching_and_budget(void) {
+    setup();
+    const uint32_t run_ms = 60000;
+    run_manager(run_ms);
+    const ecu_sim_stats_t *sim = ecu_sim_stats();
+    const uds_poller_stats_t *st = uds_poller_get_stats();
+
+    // DIDs of one ECU share a request; every DID is read, the faster ones more often
+    CHECK_EQ(sim->uds_max_dids, 2);
+    uint32_t reads = engine_dids[0].reads + engine_dids[1].reads + airmatic_dids[0].reads + airmatic_dids[1].reads;
+    CHECK(reads > sim->uds_requests * 5 / 4);
+    CHECK(engine_dids[0].reads > engine_dids[1].reads);
+    CHECK(engine_dids[1].reads > airmatic_dids[0].reads);
+    CHECK(airmatic_dids[0].reads >= airmatic_dids[1].reads && airmatic_dids[1].reads > 0);
+    CHECK_EQ(st->requests, sim->uds_requests);
+    CHECK_EQ(st->responses, sim->uds_requests);
+    CHECK_EQ(st->values, engine_dids[0].reads * 2 + engine_dids[1].reads + airmatic_dids[0].reads +
+                         airmatic_dids[1].reads);
+    CHECK_EQ(st->negative + st->timeouts + sim->uds_negative, 0);
+
+    // Values reach the decoder's UDS channels
+    CHECK_EQ(channel(MB_CH_BOOST_PRESSURE_HPA), 1000);
+    CHECK_EQ(channel(MB_CH_BOOST_TARGET_HPA), 1100);
+    CHECK_EQ(channel(MB_CH_INJECTION_QTY_X100), 300);
+    CHECK_EQ(channel(MB_CH_AIRMATIC_VALVES), 5);
+    CHECK_EQ(channel(MB_CH_AIRMATIC_COMPRESSOR), 1);
+
+    // Held to the budget on the wire, plus the bucket it starts with (room for the
+    // largest transaction), and using most of it; the poller's own figure agrees
+    float budget = UDS_BUS_LOAD_PERMILLE / 10.0f;
+    float load = bus_load_pct(run_ms);
+    float burst = (uds_poller_frames(UDS_MAX_REQUEST_LEN) + uds_poller_frames(UDS_MAX_RESPONSE_LEN)) *
+                  (float)UDS_FRAME_BITS * 100.0f / (run_ms * 1e-3f * CAN_BAUDRATE);
+    CHECK(st->throttled > 0);
+    CHECK(load <= budget + burst);
+    CHECK(load > budget * 0.85f);
+    CHECK(fabsf(st->bus_load_pct - load) < budget * 0.05f);
+    printf("batching: %" PRIu32 " requests for %" PRIu32 " DID reads, %" PRIu32 " throttled, "
+           "bus load %.3f %% (poller %.3f %%, budget %.1f %%)\n",
+           sim->uds_requests, reads, st->throttled, load, st->bus_load_pct, budget);
+}
+
+// The engine ECU takes one DID per request: the first batch is refused, the rest go singly
+static void test_length_limit(void) {
+    setup();
+    engine->max_dids = 1;
+    run_manager(20000);
+    const ecu_sim_stats_t *sim = ecu_sim_stats();
+    const uds_poller_stats_t *st = uds_poller_get_stats();
+
+    CHECK_EQ(sim->uds_negative, 1);
+    CHECK_EQ(st->negative, 1);
+    CHECK(engine_dids[0].reads > 0 && engine_dids[1].reads > 0);
+    CHECK(airmatic_dids[0].reads > 0 && airmatic_dids[1].reads > 0);
+    CHECK_EQ(st->unsupported, 0);
+}
+
+// AIRMATIC lacks 0x2102: left out of the batch answer, asked alone, dropped.
+// With no DIDs at all: the batch is refused, each DID asked alone and dropped.
+static void test_out_of_range(void) {
+    setup();
+    airmatic->num_dids = 1;
+    run_manager(20000);
+    const uds_poller_stats_t *st = uds_poller_get_stats();
+    CHECK_EQ(st->unsupported, 1);
+    CHECK(airmatic_dids[0].reads > 10);
+    CHECK_EQ(airmatic_dids[1].reads, 0);
+    CHECK_EQ(ecu_sim_stats()->uds_negative, 1);
+
+    setup();
+    airmatic->num_dids = 0;
+    run_manager(20000);
+    st = uds_poller_get_stats();
+    CHECK_EQ(st->unsupported, 2);
+    CHECK_EQ(airmatic->uds_requests, 3);
+    CHECK_EQ(st->negative, 3);
+    CHECK(engine_dids[0].reads > 0 && engine_dids[1].reads > 0);
+}
+
+// Two responsePending answers 100 ms apart: well past P2, still inside P2*
+static void test_response_pending(void) {
+    setup();
+    engine->pending = 2;
+    engine->pending_us = 100000;
+    airmatic->pending = 2;
+    airmatic->pending_us = 100000;
+    run_manager(20000);
+    const uds_poller_stats_t *st = uds_poller_get_stats();
+    CHECK_EQ(st->timeouts, 0);
+    CHECK_EQ(st->negative, 0);
+    CHECK_EQ(ecu_sim_stats()->uds_negative, 2 * ecu_sim_stats()->uds_requests);
+    CHECK(engine_dids[0].reads > 0 && airmatic_dids[0].reads > 0);
+    CHECK(st->response_latency_us > 2 * 100000);
+}
+
+// AIRMATIC gone: its requests time out at P2 and space out, doubling each time
+static void test_timeout_backoff(void) {
+    setup();
+    airmatic->online = false;
+    const uint32_t run_ms = 60000;
+    run_manager(run_ms);
+    const uds_poller_stats_t *st = uds_poller_get_stats();
+    // 0x2101 every 500 ms would be 120 requests; backing off to 32 periods leaves a handful
+    CHECK(st->timeouts > 0);
+    CHECK(st->timeouts <= 12);
+    CHECK_EQ(airmatic->uds_requests, 0);
+    CHECK(engine_dids[0].reads > 100);
+    printf("timeout back-off: %" PRIu32 " timeouts in %" PRIu32 " s\n", st->timeouts, run_ms / 1000);
+}
+
+int main(void) {
+    test_batching_and_budget();
+    test_length_limit();
+    test_out_of_range();
+    test_response_pending();
+    test_timeout_backoff();
+    return host_test_done("test_uds_poller");
+}
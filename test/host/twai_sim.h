@@ -0,0 +1,17 @@
+#pragma once
+// The TWAI driver on the host (driver/twai.h): received frames come from
+// twai_sim_feed(), in order, through a queue of rx_queue_len frames as in the
+// real driver; a feed waits while the queue is full and counts a missed frame
+// only if the driver never makes room. Transmitted frames are
+// counted and handed to an optional hook. Real time, not the manual clock.
+#include "driver/twai.h"
+#include <stdbool.h>
+
+// Put a frame on the bus; false (and rx_missed_count) if the RX queue stays full
+bool twai_sim_feed(const twai_message_t *msg);
+
+// Wait until the driver has taken every fed frame from the RX queue
+void twai_sim_drain(void);
+
+// Called for every twai_transmit(); NULL to remove
+void twai_sim_on_transmit(void (*fn)(const twai_message_t *msg));
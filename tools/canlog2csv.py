@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+"""Convert a binary CAN session log (.cbl, see components/sd_logger/include/canlog.h) to CSV.
+
+The output has the columns of the logger's own CSV sessions:
+  timestamp_ms,can_id,dlc,d0,d1,d2,d3,d4,d5,d6,d7
+with timestamp_ms in esp_timer milliseconds since boot. --us adds a
+timestamp_us column with the full-resolution time.
+
+Plain and compressed (XOR + LZ4 blocks) files are both read.
+
+A file cut short (power loss, card pulled) converts up to its last complete
+record, or for compressed files its last whole block. Such a file still has
+its preallocated length; the unwritten rest reads as zeros or as stale card
+data, and conversion stops at a run of zeros or at a sync record that does
+not continue the session's time and frame count. A damaged stretch is
+skipped up to the next sync record (next block when compressed), and the
+frames lost there are reported on stderr.
+
+Usage:
+  canlog2csv.py session.cbl [-o session.csv] [--us]
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b'MBCANLOG'
+HEADER = struct.Struct('<8sHHIQqII')
+FLAG_COMPRESSED = 0x01
+SYNC_TAG = 0x80
+SYNC_MARK = b'\x80SYN'
+SYNC_LEN = 16
+BLOCK_MARK = b'\x81CB'
+BLOCK_HEADER = struct.Struct('<4sHH')
+BLOCK_STORED = 0x01
+FRAME_XOR = 0x20
+FRAME_EXTENDED = 0x10
+UNWRITTEN = bytes(SYNC_LEN)     # never a valid record sequence
+MIN_FRAME_BITS = 47             # shortest CAN frame on the wire
+
+
+class LogError(Exception):
+    pass
+
+
+class EndOfLog(Exception):
+    """The rest of the file was never written by this session."""
+
+
+def read_header(buf):
+    if len(buf) < HEADER.size or buf[:8] != MAGIC:
+        raise LogError('not a binary CAN log (bad magic)')
+    magic, version, header_len, flags, start_us, wall_time, bitrate, sync_ms = HEADER.unpack_from(buf)
+    if version != 1:
+        raise LogError(f'unsupported log version {version}')
+    if flags & ~FLAG_COMPRESSED:
+        raise LogError(f'unknown header flags 0x{flags:x}')
+    return {'version': version, 'header_len': header_len, 'flags': flags, 'start_us': start_us,
+            'wall_time': wall_time, 'bitrate': bitrate, 'sync_interval_ms': sync_ms}
+
+
+def read_varint(buf, pos, end):
+    value = 0
+    shift = 0
+    while pos < end and shift < 35:
+        b = buf[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        if not b & 0x80:
+            return value, pos
+        shift += 7
+    return None, pos
+
+
+def lz4_decompress(src, raw_len):
+    out = bytearray()
+    pos = 0
+    while pos < len(src):
+        token = src[pos]
+        pos += 1
+        lit = token >> 4
+        if lit == 15:
+            while True:
+                b = src[pos]
+                pos += 1
+                lit += b
+                if b != 255:
+                    break
+        out += src[pos:pos + lit]
+        pos += lit
+        if pos >= len(src):
+            break       # the last sequence has literals only
+        offset = src[pos] | src[pos + 1] << 8
+        pos += 2
+        mlen = (token & 0x0F) + 4
+        if mlen == 19:
+            while True:
+                b = src[pos]
+                pos += 1
+                mlen += b
+                if b != 255:
+                    break
+        if offset == 0 or offset > len(out):
+            raise LogError('bad match offset')
+        start = len(out) - offset
+        for i in range(mlen):   # byte by byte: a match may overlap its own output
+            out.append(out[start + i])
+    if len(out) != raw_len:
+        raise LogError('block length mismatch')
+    return bytes(out)
+
+
+class Decoder:
+    """Record decoder that carries time and frame count across chunks."""
+
+    def __init__(self, hdr):
+        self.max_delta = hdr['sync_interval_ms'] * 1000   # the writer keeps deltas below this
+        self.bitrate = hdr['bitrate']
+        self.xor = bool(hdr['flags'] & FLAG_COMPRESSED)
+        self.last_t = 0         # time of the last record decoded
+        self.expected = 0       # frame count the next sync should carry
+        self.lost = 0
+        self.skipped = 0
+        self.pos = 0            # end of the last record decoded in the current buffer
+        self.new_chunk()
+
+    def new_chunk(self):
+        self.t = None           # no deltas before the first sync
+        self.payloads = {}
+
+    def sync(self, buf, pos):
+        sync_t, count = struct.unpack_from('<QI', buf, pos + 4)
+        # A sync from some older file on the card: time or count do not follow on
+        most = self.expected + (sync_t - self.last_t) * self.bitrate // (MIN_FRAME_BITS * 1000000) + 1
+        if self.expected and (sync_t < self.last_t or not self.expected <= count <= most):
+            raise EndOfLog()
+        self.t = self.last_t = sync_t
+        if count != self.expected:
+            self.lost += count - self.expected
+            self.expected = count
+
+    def records(self, buf, pos, end):
+        """Yield (time_us, can_id, data) from buf[pos:end]."""
+        self.pos = pos
+        while pos < end:
+            if buf[pos:pos + SYNC_LEN] == UNWRITTEN:
+                raise EndOfLog()
+            tag = buf[pos]
+            if tag == SYNC_TAG:
+                if pos + SYNC_LEN > end:
+                    return
+                if buf[pos:pos + 4] != SYNC_MARK:
+                    pos = self.resync(buf, pos + 1, end)
+                    continue
+                self.sync(buf, pos)
+                pos = self.pos = pos + SYNC_LEN
+                continue
+            bad_bits = 0xC0 if self.xor else 0xE0
+            if tag & bad_bits or (tag & 0x0F) > 8 or self.t is None:
+                pos = self.resync(buf, pos + 1, end)
+                continue
+
+            dlc = tag & 0x0F
+            delta, p = read_varint(buf, pos + 1, end)
+            id_len = 4 if tag & FRAME_EXTENDED else 2
+            if delta is None and p < end or delta is not None and delta >= self.max_delta:
+                pos = self.resync(buf, pos + 1, end)
+                continue
+            if delta is None or p + id_len + dlc > end:
+                return          # truncated last record
+            can_id = int.from_bytes(buf[p:p + id_len], 'little')
+            p += id_len
+            data = bytes(buf[p:p + dlc])
+            if tag & FRAME_XOR:
+                prev = self.payloads.get(can_id, bytes(8))
+                data = bytes(d ^ q for d, q in zip(data, prev))
+            if self.xor:
+                self.payloads[can_id] = data + bytes(8 - dlc)
+            self.t += delta
+            self.last_t = self.t
+            self.expected += 1
+            pos = self.pos = p + dlc
+            yield self.t, can_id, data
+
+    def resync(self, buf, pos, end):
+        nxt = buf.find(SYNC_MARK, pos, end)
+        stop = end if nxt < 0 else nxt
+        self.skipped += stop - pos + 1
+        self.t = None
+        return stop
+
+
+def blocks(buf, pos, dec):
+    """Yield (chunk, end offset) for each block of a compressed file."""
+    while pos < len(buf):
+        if buf[pos:pos + SYNC_LEN] == UNWRITTEN:
+            raise EndOfLog()
+        if pos + BLOCK_HEADER.size > len(buf):
+            return
+        mark, raw_len, data_len = BLOCK_HEADER.unpack_from(buf, pos)
+        if mark[:3] != BLOCK_MARK or mark[3] & ~BLOCK_STORED:
+            nxt = buf.find(BLOCK_MARK, pos + 1)
+            stop = len(buf) if nxt < 0 else nxt
+            dec.skipped += stop - pos
+            pos = stop
+            continue
+        start = pos + BLOCK_HEADER.size
+        if start + data_len > len(buf):
+            return      # truncated last block
+        data = buf[start:start + data_len]
+        pos = start + data_len
+        if mark[3] & BLOCK_STORED:
+            chunk = bytes(data)
+        else:
+            try:
+                chunk = lz4_decompress(data, raw_len)
+            except (LogError, IndexError):
+                dec.skipped += data_len
+                continue
+        yield chunk, pos
+
+
+def frames(buf, hdr, dec):
+    """Yield (time_us, can_id, data) for the whole file; dec.pos ends at the last byte used."""
+    try:
+        if hdr['flags'] & FLAG_COMPRESSED:
+            end = hdr['header_len']
+            for chunk, block_end in blocks(buf, hdr['header_len'], dec):
+                dec.new_chunk()
+                yield from dec.records(chunk, 0, len(chunk))
+                end = block_end
+            dec.pos = end
+        else:
+            yield from dec.records(buf, hdr['header_len'], len(buf))
+    except EndOfLog:
+        pass
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('input', help='binary log (.cbl)')
+    ap.add_argument('-o', '--output', help='CSV file (default: stdout)')
+    ap.add_argument('--us', action='store_true', help='add a timestamp_us column')
+    args = ap.parse_args()
+
+    with open(args.input, 'rb') as f:
+        buf = f.read()
+    try:
+        hdr = read_header(buf)
+    except LogError as e:
+        sys.exit(f'{args.input}: {e}')
+
+    out = open(args.output, 'w', newline='') if args.output else sys.stdout
+    out.write('timestamp_ms,can_id,dlc,d0,d1,d2,d3,d4,d5,d6,d7' + (',timestamp_us' if args.us else '') + '\n')
+    dec = Decoder(hdr)
+    count = 0
+    for t, can_id, data in frames(buf, hdr, dec):
+        padded = data + bytes(8 - len(data))
+        line = f'{t // 1000},0x{can_id:03X},{len(data)},' + ','.join(f'{b:02X}' for b in padded)
+        if args.us:
+            line += f',{t}'
+        out.write(line + '\n')
+        count += 1
+    if out is not sys.stdout:
+        out.close()
+
+    print(f'{args.input}: {count} frames', file=sys.stderr)
+    if dec.skipped:
+        print(f'  skipped {dec.skipped} damaged bytes, {dec.lost} frames lost', file=sys.stderr)
+    tail = len(buf) - dec.pos
+    if tail > 0:
+        print(f'  ignored {tail} bytes at the end (incomplete record or never written)', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""Build the per-minute summary (.sum, see components/sd_logger/include/sd_logger.h)
+of a CAN session log, for sessions recorded before the logger wrote one.
+
+The log screens read a session's timeline from its summary and leave sessions
+without one out of the list. Copy the .sum this writes next to the session
+file on the card.
+
+Signals are decoded with the DBC file the firmware tables are generated from
+and summarised the way the logger does: once a second the latest value of each
+signal is sampled (skipped while its message is stale), and every minute gets
+the min, max and rounded mean of those samples, as the physical value
+x 10^decimals. The default signals match CAN_LOG_SUMMARY_SIGNALS in
+components/can_driver/include/can_config.h.
+
+Binary logs (.cbl) and CSV sessions both work. A CSV session has no header, so
+its start is the first frame and its wall time comes from the file name
+(YYYY-MM-DD_HHMMSS.csv, local time).
+
+Usage:
+  logsummary.py session.cbl [-o session.sum] [--dbc w212.dbc] [--signal NAME[:decimals] ...]
+"""
+
+import argparse
+import csv
+import math
+import os
+import re
+import struct
+import sys
+import time
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+DBC_DIR = os.path.join(TOOLS_DIR, '..', 'components', 'can_driver', 'dbc')
+sys.path.insert(0, DBC_DIR)
+
+from canlog2csv import Decoder, LogError, frames, read_header   # noqa: E402
+from dbc_codegen import DbcError, parse_dbc, signal_shift       # noqa: E402
+
+MAGIC = b'MBCANSUM'
+VERSION = 1
+HEADER = struct.Struct('<8sHHHHQq')
+SIGNAL = struct.Struct('<23sB')
+MINUTE = struct.Struct('<I')
+VALUE = struct.Struct('<iiiI')
+MAX_SIGNALS = 8
+PERIOD_S = 60
+SAMPLE_US = 1000000             # CAN_LOG_SUMMARY_SAMPLE_MS
+STALE_CYCLES = 3                # CAN_STALE_CYCLES
+STALE_MIN_MS = 100              # CAN_STALE_MIN_MS
+
+DEFAULT_DBC = os.path.join(DBC_DIR, 'mercedes_w218.dbc')
+DEFAULT_SIGNALS = ['OIL_TEMP_C:1', 'COOLANT_TEMP_C:1', 'TRANS_OIL_TEMP_C:1', 'AMBIENT_TEMP_RAW:1']
+
+RE_SESSION_TIME = re.compile(r'(\d{4})-(\d{2})-(\d{2})_(\d{2})(\d{2})(\d{2})')
+
+
+def find_signals(messages, attrs, specs):
+    """Resolve NAME[:decimals] specs to decoding info, grouped by CAN ID."""
+    by_id = {}
+    found = []
+    for index, spec in enumerate(specs):
+        name, _, dec = spec.partition(':')
+        decimals = int(dec) if dec else 0
+        for msg in messages:
+            sig = next((s for s in msg['signals'] if s['name'] == name), None)
+            if sig:
+                break
+        else:
+            raise DbcError(f'signal {name} not in the DBC file')
+        if len(name.encode()) > SIGNAL.size - 1:
+            raise DbcError(f'signal name {name} is longer than {SIGNAL.size - 1} bytes')
+        cycle_ms = int(attrs.get((msg['id'], None, 'GenMsgCycleTime'), 0))
+        stale_us = max(cycle_ms * STALE_CYCLES, STALE_MIN_MS) * 1000 if cycle_ms else 0
+        info = {'index': index, 'name': name, 'decimals': decimals, 'sig': sig,
+                'shift': signal_shift(sig), 'mask': (1 << sig['length']) - 1}
+        by_id.setdefault(msg['id'], {'stale_us': stale_us, 'signals': []})['signals'].append(info)
+        found.append(info)
+    return found, by_id
+
+
+def decode(info, data):
+    sig = info['sig']
+    padded = bytes(data) + bytes(8 - len(data))
+    word = int.from_bytes(padded, 'little' if sig['intel'] else 'big')
+    raw = (word >> info['shift']) & info['mask']
+    if sig['signed'] and raw >> (sig['length'] - 1):
+        raw -= 1 << sig['length']
+    scaled = (raw * sig['factor'] + sig['offset']) * 10 ** info['decimals']
+    return int(math.copysign(math.floor(abs(scaled) + 0.5), scaled))
+
+
+def c_div(a, n):
+    """Integer division truncating toward zero, as in C."""
+    q = abs(a) // n
+    return q if a >= 0 else -q
+
+
+class Summary:
+    def __init__(self, signals, by_id, start_us):
+        self.signals = signals
+        self.by_id = by_id
+        self.start_us = start_us
+        self.value = [None] * len(signals)  # latest decoded value per signal
+        self.seen = {}                      # CAN ID -> time of its last frame
+        self.next_sample = start_us
+        self.rows = {}                      # minute -> [[min, max, sum, samples]] per signal
+
+    def frame(self, t, can_id, data):
+        while self.next_sample < t:
+            self.sample(self.next_sample)
+            self.next_sample += SAMPLE_US
+        msg = self.by_id.get(can_id)
+        if msg:
+            self.seen[can_id] = t
+            for info in msg['signals']:
+                self.value[info['index']] = decode(info, data)
+
+    def finish(self, end_us):
+        while self.next_sample <= end_us:
+            self.sample(self.next_sample)
+            self.next_sample += SAMPLE_US
+
+    def sample(self, t):
+        minute = (t - self.start_us) // (PERIOD_S * 1000000)
+        for can_id, msg in self.by_id.items():
+            last = self.seen.get(can_id)
+            if last is None or msg['stale_us'] and t - last > msg['stale_us']:
+                continue
+            for info in msg['signals']:
+                v = self.value[info['index']]
+                row = self.rows.setdefault(minute, [[0, 0, 0, 0] for _ in self.signals])
+                acc = row[info['index']]
+                if acc[3] == 0 or v < acc[0]:
+                    acc[0] = v
+                if acc[3] == 0 or v > acc[1]:
+                    acc[1] = v
+                acc[2] += v
+                acc[3] += 1
+
+    def write(self, path, wall_time):
+        header_len = HEADER.size + SIGNAL.size * len(self.signals)
+        with open(path, 'wb') as f:
+            f.write(HEADER.pack(MAGIC, VERSION, header_len, len(self.signals), PERIOD_S,
+                                self.start_us, wall_time))
+            for info in self.signals:
+                f.write(SIGNAL.pack(info['name'].encode(), info['decimals']))
+            for minute in sorted(self.rows):
+                f.write(MINUTE.pack(minute))
+                for lo, hi, total, n in self.rows[minute]:
+                    if n:
+                        f.write(VALUE.pack(lo, hi, c_div(total + (n // 2 if total >= 0 else -(n // 2)), n), n))
+                    else:
+                        f.write(VALUE.pack(0, 0, 0, 0))
+
+
+def cbl_frames(path):
+    """Header info and (time_us, can_id, data) of a binary log."""
+    with open(path, 'rb') as f:
+        buf = f.read()
+    hdr = read_header(buf)
+    return hdr['start_us'], hdr['wall_time'], frames(buf, hdr, Decoder(hdr))
+
+
+def csv_frames(path):
+    """Start, wall time and (time_us, can_id, data) of a CSV session."""
+    f = open(path, newline='')
+    rows = csv.reader(f)
+    columns = next(rows, None)
+    if not columns or columns[0] != 'timestamp_ms':
+        raise LogError('not a CAN session CSV (bad header)')
+    us_column = columns.index('timestamp_us') if 'timestamp_us' in columns else None
+
+    def parse():
+        for row in rows:
+            if len(row) < 3:
+                continue
+            t = int(row[us_column]) if us_column is not None else int(row[0]) * 1000
+            dlc = int(row[2])
+            yield t, int(row[1], 16), bytes(int(b, 16) for b in row[3:3 + dlc])
+        f.close()
+
+    it = parse()
+    first = next(it, None)
+    if first is None:
+        raise LogError('no frames')
+
+    def chained():
+        yield first
+        yield from it
+
+    m = RE_SESSION_TIME.search(os.path.basename(path))
+    wall_time = int(time.mktime(tuple(int(g) for g in m.groups()) + (0, 0, -1))) if m else 0
+    return first[0], wall_time, chained()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('input', help='session log (.cbl or .csv)')
+    ap.add_argument('-o', '--output', help='summary file (default: input with .sum)')
+    ap.add_argument('--dbc', default=DEFAULT_DBC, help='DBC file of the vehicle (default: %(default)s)')
+    ap.add_argument('--signal', action='append', metavar='NAME[:decimals]',
+                    help='signal to summarise, repeatable (default: ' + ' '.join(DEFAULT_SIGNALS) + ')')
+    args = ap.parse_args()
+
+    specs = args.signal or DEFAULT_SIGNALS
+    if len(specs) > MAX_SIGNALS:
+        sys.exit(f'at most {MAX_SIGNALS} signals')
+    try:
+        messages, attrs = parse_dbc(args.dbc)
+        signals, by_id = find_signals(messages, attrs, specs)
+        if args.input.lower().endswith('.csv'):
+            start_us, wall_time, log = csv_frames(args.input)
+        else:
+            start_us, wall_time, log = cbl_frames(args.input)
+    except (DbcError, LogError, OSError, ValueError) as e:
+        sys.exit(f'{args.input}: {e}')
+
+    summary = Summary(signals, by_id, start_us)
+    end_us = start_us
+    count = 0
+    try:
+        for t, can_id, data in log:
+            summary.frame(t, can_id, data)
+            end_us = t
+            count += 1
+    except ValueError as e:
+        print(f'{args.input}: stopped at a bad CSV line ({e})', file=sys.stderr)
+    summary.finish(end_us)
+
+    output = args.output or os.path.splitext(args.input)[0] + '.sum'
+    summary.write(output, wall_time)
+    print(f'{args.input}: {count} frames, {len(summary.rows)} minutes -> {output}', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()